@@ -0,0 +1,166 @@
+local class = require 'pl.class'
+local Batch = class()
+
+--- Collect a list of PCI accesses and run them with one USB command.
+-- Each add function returns the index of the new entry. Use this index
+-- to get the read value from the result of the "execute" function.
+function Batch:_init(tPapaSchlumpfFlex)
+  self.tPapaSchlumpfFlex = tPapaSchlumpfFlex
+
+  -- These are the operations from PAPA_SCHLUMPF_BATCH_OPERATION_T.
+  self.OPERATION = {
+    IoRead    = 0,
+    MemRead   = 1,
+    Cfg0Read  = 2,
+    Cfg1Read  = 3,
+    IoWrite   = 4,
+    MemWrite  = 5,
+    Cfg0Write = 6,
+    Cfg1Write = 7
+  }
+
+  -- These are the names of the operations for error messages.
+  self.astrOperationNames = {
+    [0] = 'ioRead',
+    [1] = 'memRead',
+    [2] = 'cfg0Read',
+    [3] = 'cfg1Read',
+    [4] = 'ioWrite',
+    [5] = 'memWrite',
+    [6] = 'cfg0Write',
+    [7] = 'cfg1Write'
+  }
+
+  -- One entry is PAPA_SCHLUMPF_BATCH_ENTRY_T, one result is PAPA_SCHLUMPF_BATCH_RESULT_T.
+  self.strEntryFormat = '<I4I4I4'
+  self.strResultFormat = '<I4I4'
+  self.sizResult = 8
+
+  self.atEntries = {}
+end
+
+
+
+function Batch:addEntry(ulOperation, ulAddress, ulData)
+  local atEntries = self.atEntries
+  table.insert(atEntries, {
+    ulOperation = ulOperation,
+    ulAddress = ulAddress,
+    ulData = ulData or 0
+  })
+
+  return #atEntries
+end
+
+
+
+function Batch:ioRead(ulAddress)
+  return self:addEntry(self.OPERATION.IoRead, ulAddress)
+end
+
+
+
+function Batch:memRead(ulAddress)
+  return self:addEntry(self.OPERATION.MemRead, ulAddress)
+end
+
+
+
+function Batch:cfg0Read(ulAddress)
+  return self:addEntry(self.OPERATION.Cfg0Read, ulAddress)
+end
+
+
+
+function Batch:cfg1Read(ulAddress)
+  return self:addEntry(self.OPERATION.Cfg1Read, ulAddress)
+end
+
+
+
+function Batch:ioWrite(ulAddress, ulData)
+  return self:addEntry(self.OPERATION.IoWrite, ulAddress, ulData)
+end
+
+
+
+function Batch:memWrite(ulAddress, ulData)
+  return self:addEntry(self.OPERATION.MemWrite, ulAddress, ulData)
+end
+
+
+
+function Batch:cfg0Write(ulAddress, ulData)
+  return self:addEntry(self.OPERATION.Cfg0Write, ulAddress, ulData)
+end
+
+
+
+function Batch:cfg1Write(ulAddress, ulData)
+  return self:addEntry(self.OPERATION.Cfg1Write, ulAddress, ulData)
+end
+
+
+
+--- Remove all entries from the batch.
+function Batch:clear()
+  self.atEntries = {}
+end
+
+
+
+--- Run all entries of the batch.
+-- The firmware processes the entries in order and stops at the first failed
+-- entry.
+--
+-- @return A table with the read values on success. The index of a value is
+--         the index returned by the add function. Write entries have a value
+--         of 0. On error it returns nil, an error message and the index of
+--         the failed entry if the error was caused by an entry.
+function Batch:execute()
+  local atEntries = self.atEntries
+  local sizEntries = #atEntries
+  if sizEntries==0 then
+    return {}
+  end
+
+  -- Encode all entries.
+  local strEntryFormat = self.strEntryFormat
+  local astrEntries = {}
+  for uiCnt, tEntry in ipairs(atEntries) do
+    astrEntries[uiCnt] = string.pack(strEntryFormat, tEntry.ulOperation, tEntry.ulAddress, tEntry.ulData)
+  end
+
+  local strResults, strError = self.tPapaSchlumpfFlex.tP:executeBatch(table.concat(astrEntries))
+  if strResults==nil then
+    return nil, string.format('Failed to execute the batch: %s', tostring(strError))
+  end
+
+  -- Decode the results.
+  local strResultFormat = self.strResultFormat
+  local sizResult = self.sizResult
+  local sizResults = string.len(strResults) // sizResult
+  local aulData = {}
+  for uiCnt=1,sizResults do
+    local ulStatus, ulData = string.unpack(strResultFormat, strResults, (uiCnt-1)*sizResult + 1)
+    if ulStatus~=0 then
+      local tEntry = atEntries[uiCnt]
+      return nil, string.format(
+        'Entry %d (%s 0x%08x) failed with status %d.',
+        uiCnt,
+        self.astrOperationNames[tEntry.ulOperation] or tostring(tEntry.ulOperation),
+        tEntry.ulAddress,
+        ulStatus
+      ), uiCnt
+    end
+    aulData[uiCnt] = ulData
+  end
+  if sizResults~=sizEntries then
+    return nil, string.format('Only %d of %d entries were processed.', sizResults, sizEntries), sizResults + 1
+  end
+
+  return aulData
+end
+
+
+return Batch
@@ -45,6 +45,11 @@ function Plugin:_init(strPluginName, strPluginTyp, tLogWriter, strLogLevel, tPap
     ulReserved0c:u4
   ]])
   self.sizMailboxControl = 16
+  -- Read the start of the TX buffer together with the control block. Most
+  -- packets fit into this, so they need no extra read.
+  self.sizMailboxPrefetch = 256
+  -- The firmware waits this long for a mailbox change before the plugin checks again.
+  self.ulMailboxPollTimeoutUs = 100000
 
   self.tStructurePacketReadWrite = vstruct.compile([[
     ucType:u1
@@ -286,14 +291,16 @@ function Plugin:sendMailboxData(strData)
   end
 
   -- Wait until the mailbox is free.
+  local tControl
   repeat
     local fMailboxIsFree
     -- Read the RX control block.
     local strControlBlock = tP:memReadArea(ulControlRxAddress, sizMailboxControl)
-    local tControl = tStructureMailboxControl:read(strControlBlock)
+    tControl = tStructureMailboxControl:read(strControlBlock)
     if tControl.ulReqCnt~=tControl.ulAckCnt then
-      tLog.debug('The RX mailbox is full, retry in 100ms.')
-      self:sleep(0.1)
+      -- Let the firmware wait for the acknowledge of the netX.
+      tLog.debug('The RX mailbox is full, waiting for the acknowledge.')
+      tP:pollMem(tP.DMATYPE.Mem, ulControlRxAddress+4, 0xffffffff, tControl.ulReqCnt, self.ulMailboxPollTimeoutUs)
     else
       fMailboxIsFree = true
     end
@@ -306,18 +313,17 @@ function Plugin:sendMailboxData(strData)
 --  tLog.debug('Sending packet with data:')
 --  _G.tester:hexdump(strDataPadded)
 
-  -- Write the data to the buffer.
-  tP:memWriteArea(self.ulBufferRxAddress, strDataPadded)
+  -- Increment and wrap the request counter. Only this side writes it, so
+  -- the value from the control block is still valid.
+  local ulReqCnt = bit.band(tControl.ulReqCnt+1, 0xffffffff)
 
-  -- Set the size of the data.
-  tP:memWrite(ulControlRxAddress+8, sizData)
-
-  -- Increase the request counter.
-  local ulReqCnt = tP:memRead(ulControlRxAddress)
-  -- Increment and wrap the counter.
-  ulReqCnt = bit.band(ulReqCnt+1, 0xffffffff)
-  -- Write the new request counter to the mailbox.
-  tP:memWrite(ulControlRxAddress, ulReqCnt)
+  -- Write the data to the buffer, then the size of the data and the new
+  -- request counter. The firmware writes the areas in this order.
+  tP:memWriteScatter{
+    { self.ulBufferRxAddress, strDataPadded },
+    { ulControlRxAddress+8, string.pack('<I4', sizData) },
+    { ulControlRxAddress, string.pack('<I4', ulReqCnt) }
+  }
 end
 
 
@@ -328,12 +334,19 @@ function Plugin:receiveMailboxData()
   local ulControlTxAddress = self.ulControlTxAddress
   local tStructureMailboxControl = self.tStructureMailboxControl
 
+  -- The prefetch is read after the control block. It is complete if the
+  -- control block shows a full mailbox.
+  local sizPrefetch = bit.band(math.min(self.ulBufferTxSize, self.sizMailboxPrefetch), 0xfffffffc)
+
   -- Wait for a response.
   local strResponse
   repeat
-    -- Read the control block.
-    local strControlBlock = tP:memReadArea(ulControlTxAddress, self.sizMailboxControl)
-    local tControl = tStructureMailboxControl:read(strControlBlock)
+    -- Read the control block and the start of the buffer.
+    local astrData = tP:memReadScatter{
+      { ulControlTxAddress, self.sizMailboxControl },
+      { self.ulBufferTxAddress, sizPrefetch }
+    }
+    local tControl = tStructureMailboxControl:read(astrData[1])
     if tControl.ulReqCnt~=tControl.ulAckCnt then
       -- The mailbox is full.
 
@@ -347,14 +360,20 @@ function Plugin:receiveMailboxData()
 
       -- Round up the read size to the next DWORD.
       local strDataSizePadded = bit.band(ulSize+3, 0xfffffffc)
-      local strResponsePadded = tP:memReadArea(self.ulBufferTxAddress, strDataSizePadded)
+      local strResponsePadded
+      if strDataSizePadded<=sizPrefetch then
+        strResponsePadded = astrData[2]
+      else
+        strResponsePadded = tP:memReadArea(self.ulBufferTxAddress, strDataSizePadded)
+      end
       strResponse = string.sub(strResponsePadded, 1, ulSize)
 
       -- Acknowledge the data.
       tP:memWrite(ulControlTxAddress+4, tControl.ulReqCnt)
     else
-      -- Delay a little while.
-      self:sleep(0.001)
+      -- Let the firmware wait for the next packet. The netX increments the
+      -- request counter by one for each packet.
+      tP:pollMem(tP.DMATYPE.Mem, ulControlTxAddress, 0xffffffff, bit.band(tControl.ulAckCnt+1, 0xffffffff), self.ulMailboxPollTimeoutUs)
     end
   until strResponse~=nil
 
@@ -10,6 +10,11 @@ function papaSchlumpfFlex:_init(tLog)
   self.p = p
   self.tP = p.PapaSchlumpfFlex()
 
+  -- This is the maximum number of entries in one DMA list program of the firmware.
+  self.DMALIST_MAXIMUM_ENTRIES = 128
+  -- These are the DMA list programs which were uploaded to the firmware.
+  self.atDmaListPrograms = {}
+
   -- This is the VID/PID of the papa schlumpf PCI->PCIe bridge.
   self.PCI_VID_PID_PLX_BRIDGE = 0x811210b5
 
@@ -24,6 +29,12 @@ function papaSchlumpfFlex:_init(tLog)
     Cfg0  = 2,
     Cfg1  = 3
   }
+  self.DMALIST_FAILURE = {
+    None         = 0,
+    Compare      = 1,
+    Transfer     = 2,
+    InvalidEntry = 3
+  }
   self.PCIADR = {
     MSK_PCI_CONFIGURATION_ADDRESS_REGISTER = 0x000000ff,
     SRT_PCI_CONFIGURATION_ADDRESS_REGISTER = 0,
@@ -101,17 +112,42 @@ end
 
 
 
+--- List all connected papa schlumpf devices.
+-- Each entry of the list is a table with the USB path (e.g. "1-4.2"), the bus
+-- number and the serial number. The serial number is nil if the device is in
+-- use by another process.
+--
+-- @return the list of devices on success or nil and error message otherwise.
+function papaSchlumpfFlex:listDevices()
+  local tLog = self.tLog
+
+  local atDevices, strError = self.tP:listDevices()
+  if atDevices==nil then
+    tLog.error('Failed to list the devices: %s', strError)
+  end
+
+  return atDevices, strError
+end
+
+
+
 --- Connect to the papa schlumpf device.
--- Search for available papa schumpf devices. There must be only one device
--- or the function will throw an error. Connect to the device and print the
--- firmware version.
+-- Search for available papa schumpf devices. Without a selector there must be
+-- only one device or the function will throw an error. The selector is the
+-- USB path or the serial number of one device from listDevices. Connect to the
+-- device and print the firmware version.
+--
+-- @param strSelector The optional USB path or serial number of the device.
 --
 -- @return true on success or nil and error message otherwise.
-function papaSchlumpfFlex:connect()
+function papaSchlumpfFlex:connect(strSelector)
   local tLog = self.tLog
   local tP = self.tP
 
-  local tResult, strError = tP:connect()
+  -- A new connection does not know any uploaded DMA list programs.
+  self.atDmaListPrograms = {}
+
+  local tResult, strError = tP:connect(strSelector)
   if tResult~=true then
     tLog.error('Failed to connect: %s', strError)
   else
@@ -130,6 +166,232 @@ end
 
 
 
+--- Connect again to the device of the last connect.
+-- This is much faster than connect. It opens the device at the last USB path
+-- directly and scans all devices only if it is not there anymore.
+--
+-- @return true on success or nil and error message otherwise.
+function papaSchlumpfFlex:reconnect()
+  local tLog = self.tLog
+
+  local tResult, strError = self.tP:reconnect()
+  if tResult~=true then
+    tLog.error('Failed to reconnect: %s', strError)
+  end
+
+  return tResult, strError
+end
+
+
+
+--- Create a simulator for the papa schlumpf firmware.
+-- The simulator runs the firmware in this process on a model of the PCI
+-- memory, configuration and I/O spaces. Add the regions of the model with
+-- addRegion. The spaces are the values of DMATYPE.
+--
+-- @return the simulator object.
+function papaSchlumpfFlex:createSimulator()
+  return self.p.PapaSchlumpfSimulator()
+end
+
+
+
+--- Connect to the simulated firmware instead of a device.
+--
+-- @param tSimulator The simulator from createSimulator.
+--
+-- @return true on success or nil and error message otherwise.
+function papaSchlumpfFlex:connectSimulator(tSimulator)
+  local tLog = self.tLog
+
+  -- A new connection does not know any uploaded DMA list programs.
+  self.atDmaListPrograms = {}
+
+  local tResult, strError = tSimulator:connect(self.tP)
+  if tResult~=true then
+    tLog.error('Failed to connect to the simulator: %s', strError)
+  end
+
+  return tResult, strError
+end
+
+
+
+--- Get the hotplug tracker. Start it on the first call.
+function papaSchlumpfFlex:__getHotplug()
+  local tHotplug = self.tHotplug
+  if tHotplug==nil then
+    tHotplug = self.p.PapaSchlumpfHotplug()
+    local tResult, strError = tHotplug:start()
+    if tResult~=true then
+      self.tLog.error('Failed to start the hotplug tracking: %s', strError)
+      tHotplug = nil
+    else
+      self.tHotplug = tHotplug
+    end
+  end
+
+  return tHotplug
+end
+
+
+
+--- Set the functions which are called when a papa schlumpf device appears or disappears.
+-- The functions get the USB path of the device. They are called from
+-- processDeviceEvents and waitForDevice.
+--
+-- @param fnArrived The function for a new device or nil.
+-- @param fnLeft The function for a removed device or nil.
+function papaSchlumpfFlex:setDeviceCallbacks(fnArrived, fnLeft)
+  self.fnDeviceArrived = fnArrived
+  self.fnDeviceLeft = fnLeft
+  self:__getHotplug()
+end
+
+
+
+--- Wait for hotplug events and call the device callbacks.
+--
+-- @param ulTimeoutMs The maximum time to wait for the first event in milliseconds.
+--
+-- @return the list of events or nil and an error message.
+function papaSchlumpfFlex:processDeviceEvents(ulTimeoutMs)
+  local tHotplug = self:__getHotplug()
+  if tHotplug==nil then
+    return nil, 'The hotplug tracking is not available.'
+  end
+
+  local sizEvents, strError = tHotplug:waitForEvents(ulTimeoutMs or 0)
+  if sizEvents==nil then
+    return nil, strError
+  end
+
+  local atEvents = tHotplug:getEvents()
+  for _, tEvent in ipairs(atEvents) do
+    local fnCallback = self.fnDeviceLeft
+    if tEvent.event=='arrived' then
+      fnCallback = self.fnDeviceArrived
+    end
+    if fnCallback~=nil then
+      fnCallback(tEvent.path)
+    end
+  end
+
+  return atEvents
+end
+
+
+
+--- Get the USB paths of all attached papa schlumpf devices.
+-- The list comes from the hotplug events, so this does not scan the bus.
+--
+-- @return the list of paths or nil and an error message.
+function papaSchlumpfFlex:getAttachedDevices()
+  local tHotplug = self:__getHotplug()
+  if tHotplug==nil then
+    return nil, 'The hotplug tracking is not available.'
+  end
+
+  -- Collect the pending events first to get an up to date list.
+  self:processDeviceEvents(0)
+
+  return tHotplug:getDevices()
+end
+
+
+
+--- Wait until a papa schlumpf device is attached.
+-- Use this after a reset of the board instead of calling connect in a loop.
+--
+-- @param strSelector The USB path or serial number of the device. nil accepts any device.
+-- @param ulTimeoutMs The maximum time without any hotplug event in milliseconds.
+--
+-- @return the USB path of the device or nil and an error message.
+function papaSchlumpfFlex:waitForDevice(strSelector, ulTimeoutMs)
+  local tLog = self.tLog
+
+  local function isMatch(strPath)
+    if strSelector==nil or strSelector==strPath then
+      return true
+    end
+    -- The selector can be a serial number. This needs to open the device.
+    local atDevices = self.tP:listDevices()
+    if atDevices~=nil then
+      for _, tDevice in ipairs(atDevices) do
+        if tDevice.path==strPath and tDevice.serial==strSelector then
+          return true
+        end
+      end
+    end
+    return false
+  end
+
+  -- Is the device already there?
+  local astrPaths, strError = self:getAttachedDevices()
+  if astrPaths==nil then
+    return nil, strError
+  end
+  for _, strPath in ipairs(astrPaths) do
+    if isMatch(strPath) then
+      return strPath
+    end
+  end
+
+  while true do
+    local atEvents
+    atEvents, strError = self:processDeviceEvents(ulTimeoutMs)
+    if atEvents==nil then
+      return nil, strError
+    elseif #atEvents==0 then
+      strError = 'Timeout while waiting for the device.'
+      tLog.error(strError)
+      return nil, strError
+    end
+
+    for _, tEvent in ipairs(atEvents) do
+      if tEvent.event=='arrived' and isMatch(tEvent.path) then
+        return tEvent.path
+      end
+    end
+  end
+end
+
+
+
+--- Run the same job on several papa schlumpf devices in parallel.
+-- Each device is opened by its own worker thread, so the job takes about as
+-- long on N devices as on one. The devices must not be connected by anyone
+-- else, including this object.
+--
+-- @param tJob The job. This is a list of steps like { 'memWrite', ulAddress, ulData }
+--             and an optional list "devices" with the USB paths or serial numbers.
+--             Without "devices" the job runs on all connected devices. See
+--             "papa_schlumpf_orchestrator.h" for all steps.
+--
+-- @return a list with one result table per device or nil and an error message
+--         if the job is invalid or no device was found.
+function papaSchlumpfFlex:runJob(tJob)
+  local tLog = self.tLog
+
+  local tOrchestrator = self.p.PapaSchlumpfOrchestrator()
+  local atResults, strError = tOrchestrator:run(tJob)
+  if atResults==nil then
+    tLog.error('Failed to run the job: %s', strError)
+  else
+    for _, tResult in ipairs(atResults) do
+      if tResult.result==true then
+        tLog.debug('%s: finished the job in %.3fs.', tResult.device, tResult.seconds)
+      else
+        tLog.error('%s: step %d failed after %.3fs: %s', tResult.device, tResult.failedStep, tResult.seconds, tResult.error)
+      end
+    end
+  end
+
+  return atResults, strError
+end
+
+
+
 --- Disconnect to the papa schlumpf device.
 function papaSchlumpfFlex:disconnect()
   local tLog = self.tLog
@@ -200,14 +462,23 @@ end
 
 
 
+--- Process a DMA list.
+-- The list is uploaded to the firmware and runs there without any further USB
+-- round trips. The firmware keeps the uploaded programs, so the next run of
+-- the same list needs only one command. Lists with more entries than one
+-- program can hold are split in several programs.
+--
+-- @param atDma The list of DMA entries. Each entry is a table with the action, type, address and value.
+--
+-- @return true on success, false if a compare failed or nil for all other errors.
 function papaSchlumpfFlex:processDmaList(atDma)
   local tLog = self.tLog
-  local tP = self.tP
   local tResult = true
 
   local DMAACTION = self.DMAACTION
   local DMATYPE = self.DMATYPE
 
+  local astrEntries = {}
   for uiLine, tDma in ipairs(atDma) do
     local tAction = tDma[1]
     local tType = tDma[2]
@@ -215,10 +486,10 @@ function papaSchlumpfFlex:processDmaList(atDma)
     local ulValue = tDma[4]
 
     -- The results of the bit module are signed. Convert them to unsigned here.
-    if ulAddress<0 then
+    if type(ulAddress)=='number' and ulAddress<0 then
       ulAddress = 0x100000000 + ulAddress
     end
-    if ulValue<0 then
+    if type(ulValue)=='number' and ulValue<0 then
       ulValue = 0x100000000 + ulValue
     end
 
@@ -247,51 +518,22 @@ function papaSchlumpfFlex:processDmaList(atDma)
       tResult = nil
       break
     else
-      local strError
-      if tAction==DMAACTION.Write then
-        if tType==DMATYPE.IO then
-          tResult, strError = tP:ioWrite(ulAddress, ulValue)
-        elseif tType==DMATYPE.Mem then
-          tResult, strError = tP:memWrite(ulAddress, ulValue)
-        elseif tType==DMATYPE.Cfg0 then
-          tResult, strError = tP:cfg0Write(ulAddress, ulValue)
-        elseif tType==DMATYPE.Cfg1 then
-          tResult, strError = tP:cfg1Write(ulAddress, ulValue)
-        end
-        if tResult==nil then
-          tLog.error('DMA list entry %02d failed to write: %s', uiLine, tostring(strError))
-          break
-        end
-      else
-        local ulReadValue
-        if tType==DMATYPE.IO then
-          ulReadValue, strError = tP:ioRead(ulAddress)
-        elseif tType==DMATYPE.Mem then
-          ulReadValue, strError = tP:memRead(ulAddress)
-        elseif tType==DMATYPE.Cfg0 then
-          ulReadValue, strError = tP:cfg0Read(ulAddress)
-        elseif tType==DMATYPE.Cfg1 then
-          ulReadValue, strError = tP:cfg1Read(ulAddress)
-        end
+      -- This is PAPA_SCHLUMPF_DMALIST_ENTRY_T.
+      astrEntries[uiLine] = string.pack('<I4I4I4I4', tAction, tType, math.tointeger(ulAddress), math.tointeger(ulValue))
+    end
+  end
 
-        if ulReadValue==nil then
-          tResult = nil
-          tLog.error('DMA list entry %02d failed to read: %s', uiLine, tostring(strError))
-          break
-        else
-          if tAction==DMAACTION.Compare then
-            if ulReadValue==ulValue then
-              tLog.debug('DMA list entry %02d compare is equal: 0x%08x', uiLine, ulReadValue)
-            else
-              tLog.error('DMA list entry %02d compare is not equal: expected 0x%08x, read 0x%08x', uiLine, ulValue, ulReadValue)
-              tResult = false
-              break
-            end
-          else
-            tLog.debug('DMA list entry %02d dump: 0x%08x', uiLine, ulReadValue)
-          end
-        end
+  if tResult==true then
+    -- Run the list in pieces which fit into one program.
+    local sizProgramMax = self.DMALIST_MAXIMUM_ENTRIES
+    local uiFirst = 1
+    while uiFirst<=#astrEntries do
+      local uiLast = math.min(uiFirst + sizProgramMax - 1, #astrEntries)
+      tResult = self:__runDmaListProgram(atDma, astrEntries, uiFirst, uiLast)
+      if tResult~=true then
+        break
       end
+      uiFirst = uiLast + 1
     end
   end
 
@@ -300,47 +542,407 @@ end
 
 
 
---- Find the root bridge.
--- Find the PCI->PCIe bridge on the papa schlumpf board.
---
--- @return the address of the root bridge on success or nil and error message otherwise.
-function papaSchlumpfFlex:findRootBridge()
+function papaSchlumpfFlex:__runDmaListProgram(atDma, astrEntries, uiFirst, uiLast)
   local tLog = self.tLog
   local tP = self.tP
+  local p = self.p
+  local atPrograms = self.atDmaListPrograms
+
+  local strProgram = table.concat(astrEntries, '', uiFirst, uiLast)
+
+  -- Run the stored program. Upload it if the firmware does not know it yet.
+  local ulFailure, ulFailedIndex, ulFailedValue, strDump
+  local tProgram = atPrograms[strProgram]
+  for uiTry=1,2 do
+    if tProgram==nil then
+      local ulProgramId, ulProgramHash = tP:dmaListUpload(strProgram)
+      if ulProgramId==nil then
+        tLog.error('Failed to upload the DMA list: %s', tostring(ulProgramHash))
+        return nil
+      end
+      tProgram = { id=ulProgramId, hash=ulProgramHash }
+      atPrograms[strProgram] = tProgram
+    end
+
+    ulFailure, ulFailedIndex, ulFailedValue, strDump = tP:dmaListRun(tProgram.id, tProgram.hash)
+    if ulFailure~=nil then
+      break
+    end
+
+    -- An error returns nil, the message and the result code.
+    local strError = ulFailedIndex
+    local iResult = ulFailedValue
+
+    -- The firmware replaced the program or was restarted.
+    atPrograms[strProgram] = nil
+    tProgram = nil
+    if iResult~=p.PAPA_SCHLUMPF_RESULT_UnknownProgram or uiTry==2 then
+      tLog.error('Failed to run the DMA list: %s', tostring(strError))
+      return nil
+    end
+  end
+
+  -- Show the dumped values. They belong to the dump entries before the failed entry.
+  local uiDump = 0
+  for uiLine=uiFirst,uiFirst+ulFailedIndex-1 do
+    if atDma[uiLine][1]==self.DMAACTION.Dump then
+      uiDump = uiDump + 1
+      local ulDump = string.unpack('<I4', strDump, (uiDump-1)*4 + 1)
+      tLog.debug('DMA list entry %02d dump: 0x%08x', uiLine, ulDump)
+    end
+  end
+
+  local DMALIST_FAILURE = self.DMALIST_FAILURE
   local tResult = true
-  local strError
+  local uiFailedLine = uiFirst + ulFailedIndex
+  if ulFailure==DMALIST_FAILURE.Compare then
+    tLog.error('DMA list entry %02d compare is not equal: expected 0x%08x, read 0x%08x', uiFailedLine, string.unpack('<I4', astrEntries[uiFailedLine], 13), ulFailedValue)
+    tResult = false
+  elseif ulFailure==DMALIST_FAILURE.Transfer then
+    tLog.error('DMA list entry %02d failed to transfer.', uiFailedLine)
+    tResult = nil
+  elseif ulFailure~=DMALIST_FAILURE.None then
+    tLog.error('DMA list entry %02d is invalid.', uiFailedLine)
+    tResult = nil
+  end
 
-  -- Scan for devices.
-  local ulBridgeAddress
+  return tResult
+end
+
+
+
+--- Get the sizes of the BARs from the masks of the EnumerateBus command.
+-- A 64 bit BAR has the complete size at its own index and 0 at the index of
+-- the upper half.
+function papaSchlumpfFlex:__getBarSizes(aulMasks, uiBars)
+  local bit = self.bit
+
+  local aulSizes = {}
+  local uiBar = 1
+  while uiBar<=uiBars do
+    local ulMask = aulMasks[uiBar]
+    local ulSize = 0
+    if bit.band(ulMask, 1)==1 then
+      -- This is an I/O BAR. The upper 16 bits may be hard wired to 0.
+      local ulBase = bit.band(ulMask, 0xfffc)
+      if ulBase~=0 then
+        ulSize = 0x10000 - ulBase
+      end
+    else
+      local ulBase = bit.band(ulMask, 0xfffffff0) % 0x100000000
+      if bit.band(ulMask, 6)==4 and uiBar<uiBars then
+        -- This is a 64 bit memory BAR. The next BAR has the upper half.
+        local ulMaskHigh = aulMasks[uiBar+1]
+        if ulBase~=0 or ulMaskHigh~=0 then
+          ulSize = (0xffffffff - ulMaskHigh) * 0x100000000 + 0x100000000 - ulBase
+        end
+        aulSizes[uiBar] = ulSize
+        uiBar = uiBar + 1
+        ulSize = 0
+      elseif ulBase~=0 then
+        ulSize = 0x100000000 - ulBase
+      end
+    end
+    aulSizes[uiBar] = ulSize
+    uiBar = uiBar + 1
+  end
+
+  return aulSizes
+end
+
+
+
+--- Scan all buses in the firmware.
+-- The firmware scans the IDSEL lines of the local bus and continues behind
+-- all bridges. The bus numbers of the bridges must be set already.
+--
+-- @param fSizeBars Size the BARs of all functions. This disables the decoders
+--                  of each function while all ones are written to its BARs.
+--
+-- @return a list of functions and true if the firmware found more functions
+--         than fit into its response. Each function has the fields ulAddress,
+--         ulBus, ulDevice, ulFunction, ulHeaderType, fMultiFunction,
+--         ulVendorId, ulDeviceId, ulClass, ulRevision and aulBarSizes. On
+--         the local bus the device is the IDSEL line. Bridges also have
+--         ulPrimaryBus, ulSecondaryBus and ulSubordinateBus.
+function papaSchlumpfFlex:enumerateBus(fSizeBars)
+  local bit = self.bit
+
+  local ulFlags = 0
+  if fSizeBars==true then
+    ulFlags = 1
+  end
+
+  local ulTruncated, strFunctions = self.tP:enumerateBus(ulFlags)
+  if ulTruncated==nil then
+    error(string.format('enumerateBus failed: %s', strFunctions))
+  end
+
+  -- One entry is PAPA_SCHLUMPF_ENUMERATE_FUNCTION_T.
+  local strFunctionFormat = '<I4I1I1I1I1I4I4I4I4I4I4I4I4I4'
+  local sizFunction = 44
+  local atFunctions = {}
+  for uiCnt=1,string.len(strFunctions)//sizFunction do
+    local ulAddress, ucBus, ucDevice, ucFunction, ucHeaderType, ulVidPid, ulClassRev, ulBusNumbers,
+          ulBar0, ulBar1, ulBar2, ulBar3, ulBar4, ulBar5 = string.unpack(strFunctionFormat, strFunctions, (uiCnt-1)*sizFunction + 1)
+    local ulHeaderType = bit.band(ucHeaderType, 0x7f)
+    local tFunction = {
+      ulAddress = ulAddress,
+      ulBus = ucBus,
+      ulDevice = ucDevice,
+      ulFunction = ucFunction,
+      ulHeaderType = ulHeaderType,
+      fMultiFunction = (bit.band(ucHeaderType, 0x80)~=0),
+      ulVendorId = bit.band(ulVidPid, 0xffff),
+      ulDeviceId = bit.band(bit.rshift(ulVidPid, 16), 0xffff),
+      ulClass = bit.band(bit.rshift(ulClassRev, 8), 0xffffff),
+      ulRevision = bit.band(ulClassRev, 0xff)
+    }
+    local uiBars = 0
+    if ulHeaderType==0 then
+      uiBars = 6
+    elseif ulHeaderType==1 then
+      uiBars = 2
+      tFunction.ulPrimaryBus = bit.band(ulBusNumbers, 0xff)
+      tFunction.ulSecondaryBus = bit.band(bit.rshift(ulBusNumbers, 8), 0xff)
+      tFunction.ulSubordinateBus = bit.band(bit.rshift(ulBusNumbers, 16), 0xff)
+    end
+    tFunction.aulBarSizes = self:__getBarSizes({ ulBar0, ulBar1, ulBar2, ulBar3, ulBar4, ulBar5 }, uiBars)
+    atFunctions[uiCnt] = tFunction
+  end
+
+  return atFunctions, (ulTruncated~=0)
+end
+
+
+
+--- Scan the IDSEL lines of the local bus with one cfg0Read each.
+-- This works with old firmware which does not know the EnumerateBus command.
+--
+-- @return a list of devices with the fields ulAddress and ulVidPid.
+function papaSchlumpfFlex:__scanLocalBus()
+  local tP = self.tP
+
+  local atDevices = {}
   local ulAddress = 0x00010000
   repeat
-    local ulVidPid, strError = tP:cfg0Read(ulAddress)
+    local ulVidPid = tP:cfg0Read(ulAddress)
     -- Ignore failed transfers. This means that no device is there.
     if ulVidPid~=nil and ulVidPid~=0x00000000 then
-      if ulVidPid==self.PCI_VID_PID_PLX_BRIDGE then
-        ulBridgeAddress = ulAddress
-        tLog.debug('Found papa schlumpf bridge at 0x%08x.', ulAddress)
-      else
-        local ulVid = math.floor(ulVidPid / 0x00010000)
-        local ulPid = ulVidPid - 0x00010000*ulVid
-        tLog.error('Found unexpected device with VID=%04x and PID=%04x at address 0x%08x.', ulVid, ulPid, ulAddress)
-        tResult = false
-      end
+      table.insert(atDevices, { ulAddress=ulAddress, ulVidPid=ulVidPid })
     end
 
     ulAddress = ulAddress * 2
   until ulAddress>0x10000000
 
+  return atDevices
+end
+
+
+
+--- Find the root bridge.
+-- Find the PCI->PCIe bridge on the papa schlumpf board.
+--
+-- @return the address of the root bridge on success or nil and error message otherwise.
+function papaSchlumpfFlex:findRootBridge()
+  local tLog = self.tLog
+  local tResult = true
+  local strError
+
+  -- Scan all devices of the local bus with one command. Fall back to one
+  -- access per IDSEL line if this fails.
+  local atDevices
+  local fOk, atFunctions = pcall(self.enumerateBus, self, false)
+  if fOk==true then
+    atDevices = {}
+    for _, tFunction in ipairs(atFunctions) do
+      if tFunction.ulBus==0 and tFunction.ulFunction==0 then
+        table.insert(atDevices, { ulAddress=tFunction.ulAddress, ulVidPid=tFunction.ulDeviceId*0x00010000 + tFunction.ulVendorId })
+      end
+    end
+  else
+    tLog.debug('Failed to enumerate the bus, scanning the IDSEL lines: %s', tostring(atFunctions))
+    atDevices = self:__scanLocalBus()
+  end
+
+  local ulBridgeAddress
+  for _, tDevice in ipairs(atDevices) do
+    local ulAddress = tDevice.ulAddress
+    local ulVidPid = tDevice.ulVidPid
+    if ulVidPid==self.PCI_VID_PID_PLX_BRIDGE then
+      ulBridgeAddress = ulAddress
+      tLog.debug('Found papa schlumpf bridge at 0x%08x.', ulAddress)
+    else
+      local ulPid = math.floor(ulVidPid / 0x00010000)
+      local ulVid = ulVidPid - 0x00010000*ulPid
+      tLog.error('Found unexpected device with VID=%04x and PID=%04x at address 0x%08x.', ulVid, ulPid, ulAddress)
+      tResult = false
+    end
+  end
+
   if ulBridgeAddress==nil then
     strError = 'No papa schlumpf device found.'
-    tResult = false
+    tResult = nil
   elseif tResult~=true then
     strError = 'Unexpected devices found.'
+    tResult = nil
   else
     tResult = ulBridgeAddress
   end
 
-  return tResult
+  return tResult, strError
+end
+
+
+
+--- Run a function with a fixed USB timeout.
+-- All transfers use timeouts derived from the measured latency and throughput
+-- of the link. Use this for single calls which need more time, e.g. accesses
+-- to a slow PCI device.
+--
+-- @param ulTimeoutMs The timeout for all transfers in milliseconds.
+-- @param fn The function to run. All further parameters are passed to it.
+--
+-- @return all results of the function.
+function papaSchlumpfFlex:withTimeout(ulTimeoutMs, fn, ...)
+  local tP = self.tP
+
+  local utils = self.pl.utils
+
+  tP:setTimeout(ulTimeoutMs)
+  local atResults = utils.pack(pcall(fn, ...))
+  tP:setTimeout(0)
+
+  if atResults[1]~=true then
+    error(atResults[2], 0)
+  end
+  return utils.unpack(atResults, 2, atResults.n)
+end
+
+
+
+--- Get the current estimates of the USB link.
+--
+-- @return the round trip time of a small command in microseconds and the throughput of area transfers in bytes per second.
+function papaSchlumpfFlex:getLinkEstimate()
+  return self.tP:getLinkEstimate()
+end
+
+
+
+--- Get the statistics of all USB commands since the last reset.
+-- See "getStatistics" in "papa_schlumpf.cpp" for the fields.
+--
+-- @return the statistics table.
+function papaSchlumpfFlex:getStatistics()
+  return self.tP:getStatistics()
+end
+
+
+
+function papaSchlumpfFlex:resetStatistics()
+  self.tP:resetStatistics()
+end
+
+
+
+--- Show a summary of the statistics in the log.
+-- The time outside of the USB commands is spent in Lua or elsewhere on the PC.
+function papaSchlumpfFlex:logStatistics()
+  local tLog = self.tLog
+
+  local tStatistics = self.tP:getStatistics()
+  local ulUsbUs = 0
+  for strName, tCommand in pairs(tStatistics.commands) do
+    tLog.info('%-20s %8d calls %10d bytes %4d errors %4d timeouts  send %.3fs  receive %.3fs  total %.3fs',
+      strName,
+      tCommand.calls,
+      tCommand.bytes,
+      tCommand.errors,
+      tCommand.timeouts,
+      tCommand.sendUs / 1000000,
+      tCommand.receiveUs / 1000000,
+      tCommand.totalUs / 1000000
+    )
+    ulUsbUs = ulUsbUs + tCommand.totalUs
+  end
+  tLog.info('%.3fs in USB commands, %.3fs outside.', ulUsbUs / 1000000, tStatistics.seconds - ulUsbUs / 1000000)
+end
+
+
+
+--- Record all USB commands in a ring buffer.
+-- If the buffer is full, the oldest commands are dropped. Without the payload
+-- only the first 16 bytes of each command and response are recorded.
+--
+-- @param sizBuffer the size of the ring buffer in bytes. The default is 4MB.
+-- @param fWithPayload record the complete commands and responses.
+function papaSchlumpfFlex:traceStart(sizBuffer, fWithPayload)
+  sizBuffer = sizBuffer or 4*1024*1024
+  local tResult, strError = self.tP:traceStart(sizBuffer, fWithPayload==true and 1 or 0)
+  if tResult==nil then
+    error(string.format('Failed to start the trace: %s', strError))
+  end
+end
+
+
+
+--- Stop the trace and write it to a file.
+-- @param strPath the path of the trace file. Without a path the trace is discarded.
+function papaSchlumpfFlex:traceStop(strPath)
+  local tResult, strError = self.tP:traceStop(strPath)
+  if tResult==nil then
+    error(string.format('Failed to write the trace to "%s": %s', tostring(strPath), strError))
+  end
+end
+
+
+
+--- Send all commands of a trace file to the connected device.
+-- Show the recorded and the replayed times for each command and the number
+-- of responses which differ from the recording. The trace must be recorded
+-- with the payload.
+-- See "replayTrace" in "papa_schlumpf.cpp" for the fields of the result.
+--
+-- @param strPath the path of the trace file.
+-- @return the result table.
+function papaSchlumpfFlex:replayTrace(strPath)
+  local tLog = self.tLog
+
+  local tReplay, strError = self.tP:replayTrace(strPath)
+  if tReplay==nil then
+    error(string.format('Failed to replay "%s": %s', strPath, strError))
+  end
+
+  for strName, tCommand in pairs(tReplay.commands) do
+    tLog.info('%-20s %8d calls  recorded %.3fs  replayed %.3fs',
+      strName,
+      tCommand.calls,
+      tCommand.recordedUs / 1000000,
+      tCommand.replayedUs / 1000000
+    )
+  end
+  tLog.info('Replayed %d commands in %.3fs, recorded %.3fs.', tReplay.records, tReplay.replayedUs / 1000000, tReplay.recordedUs / 1000000)
+  if tReplay.dropped~=0 then
+    tLog.warning('The recording lost %d commands in the ring buffer.', tReplay.dropped)
+  end
+  if tReplay.statusMismatches~=0 or tReplay.responseMismatches~=0 then
+    tLog.warning('%d commands returned a different status, %d different data.', tReplay.statusMismatches, tReplay.responseMismatches)
+  end
+
+  return tReplay
+end
+
+
+
+--- Create a new batch.
+-- A batch collects IO, memory and configuration accesses and runs them with
+-- one USB round trip. See "papa_schlumpf.batch" for details.
+--
+-- @return a new batch object.
+function papaSchlumpfFlex:createBatch()
+  local Batch = require 'papa_schlumpf.batch'
+  return Batch(self)
 end
 
 
@@ -375,6 +977,67 @@ end
 
 
 
+--- Dump an area to a file.
+-- The data goes straight to the file. It is never kept in memory as a whole.
+function papaSchlumpfFlex:memReadAreaToFile(ulAddress, ulSize, strPath)
+  local tResult, strError = self.tP:memReadAreaToFile(ulAddress, ulSize, strPath)
+  if tResult~=true then
+    error(string.format('memReadAreaToFile(0x%08x, %d, %s) failed: %s', ulAddress, ulSize, strPath, strError))
+  end
+end
+
+
+
+--- Read an area with a single streaming command.
+-- The firmware sends all chunks without a request for each one. This is
+-- faster than memReadArea for big areas.
+function papaSchlumpfFlex:memReadStream(ulAddress, ulSize)
+  local tData, strError = self.tP:memReadStream(ulAddress, ulSize)
+  if tData==nil then
+    error(string.format('memReadStream(0x%08x, %d) failed: %s', ulAddress, ulSize, strError))
+  end
+  return tData
+end
+
+
+
+--- Dump an area to a file with a single streaming command.
+function papaSchlumpfFlex:memReadStreamToFile(ulAddress, ulSize, strPath)
+  local tResult, strError = self.tP:memReadStreamToFile(ulAddress, ulSize, strPath)
+  if tResult~=true then
+    error(string.format('memReadStreamToFile(0x%08x, %d, %s) failed: %s', ulAddress, ulSize, strPath, strError))
+  end
+end
+
+
+
+--- Create a buffer for memReadAreaToBuffer.
+-- The buffer can be used for any number of reads. Use "get" to copy a part
+-- of the buffer to a string.
+--
+-- @param sizBuffer The size of the buffer in bytes.
+--
+-- @return a new buffer object.
+function papaSchlumpfFlex:createBuffer(sizBuffer)
+  local tBuffer = self.p.PapaSchlumpfBuffer(sizBuffer)
+  if tBuffer:size()~=sizBuffer then
+    error(string.format('Failed to allocate a buffer with %d bytes.', sizBuffer))
+  end
+  return tBuffer
+end
+
+
+
+function papaSchlumpfFlex:memReadAreaToBuffer(ulAddress, ulSize, tBuffer, ulBufferOffset)
+  ulBufferOffset = ulBufferOffset or 0
+  local tResult, strError = self.tP:memReadAreaToBuffer(ulAddress, ulSize, tBuffer, ulBufferOffset)
+  if tResult~=true then
+    error(string.format('memReadAreaToBuffer(0x%08x, %d, ..., %d) failed: %s', ulAddress, ulSize, ulBufferOffset, strError))
+  end
+end
+
+
+
 function papaSchlumpfFlex:cfg0Read(ulAddress)
   local tData, strError = self.tP:cfg0Read(ulAddress)
   if tData==nil then
@@ -395,6 +1058,34 @@ end
 
 
 
+--- Read a range of configuration registers with one USB transaction.
+-- The range must be inside the 256 bytes of the header.
+--
+-- @param ulAddress The address with the offset of the first register.
+-- @param ulSize The size in bytes. It must be a multiple of 4. The default
+--               reads up to the end of the header.
+function papaSchlumpfFlex:cfg0ReadArea(ulAddress, ulSize)
+  ulSize = ulSize or (256 - ulAddress % 256)
+  local tData, strError = self.tP:cfg0ReadArea(ulAddress, ulSize)
+  if tData==nil then
+    error(string.format('cfg0ReadArea(0x%08x, %d) failed: %s', ulAddress, ulSize, strError))
+  end
+  return tData
+end
+
+
+
+function papaSchlumpfFlex:cfg1ReadArea(ulAddress, ulSize)
+  ulSize = ulSize or (256 - ulAddress % 256)
+  local tData, strError = self.tP:cfg1ReadArea(ulAddress, ulSize)
+  if tData==nil then
+    error(string.format('cfg1ReadArea(0x%08x, %d) failed: %s', ulAddress, ulSize, strError))
+  end
+  return tData
+end
+
+
+
 function papaSchlumpfFlex:ioWrite(ulAddress, ulData)
   local tResult, strError = self.tP:ioWrite(ulAddress, ulData)
   if tResult~=true then
@@ -422,6 +1113,20 @@ end
 
 
 
+--- Write a part of a file to an area.
+-- @param ulFileOffset The offset in the file. This parameter has a default of 0.
+-- @param ulSize The number of bytes to write. The default of 0 writes everything up to the end of the file.
+function papaSchlumpfFlex:memWriteAreaFromFile(ulAddress, strPath, ulFileOffset, ulSize)
+  ulFileOffset = ulFileOffset or 0
+  ulSize = ulSize or 0
+  local tResult, strError = self.tP:memWriteAreaFromFile(ulAddress, strPath, ulFileOffset, ulSize)
+  if tResult~=true then
+    error(string.format('memWriteAreaFromFile(0x%08x, %s, %d, %d) failed: %s', ulAddress, strPath, ulFileOffset, ulSize, strError))
+  end
+end
+
+
+
 function papaSchlumpfFlex:cfg0Write(ulAddress, ulData)
   local tResult, strError = self.tP:cfg0Write(ulAddress, ulData)
   if tResult~=true then
@@ -439,4 +1144,182 @@ function papaSchlumpfFlex:cfg1Write(ulAddress, ulData)
 end
 
 
+
+--- Change some bits of an I/O register with one USB round trip.
+-- The new value is (old & ~ulMask) | (ulData & ulMask).
+--
+-- @return the old value of the register.
+function papaSchlumpfFlex:ioModify(ulAddress, ulMask, ulData)
+  local tData, strError = self.tP:ioModify(ulAddress, ulMask, ulData)
+  if tData==nil then
+    error(string.format('ioModify(0x%08x, 0x%08x, 0x%08x) failed: %s', ulAddress, ulMask, ulData, strError))
+  end
+  return tData
+end
+
+
+
+--- Change some bits of a memory DWORD with one USB round trip.
+-- The new value is (old & ~ulMask) | (ulData & ulMask).
+--
+-- @return the old value of the DWORD.
+function papaSchlumpfFlex:memModify(ulAddress, ulMask, ulData)
+  local tData, strError = self.tP:memModify(ulAddress, ulMask, ulData)
+  if tData==nil then
+    error(string.format('memModify(0x%08x, 0x%08x, 0x%08x) failed: %s', ulAddress, ulMask, ulData, strError))
+  end
+  return tData
+end
+
+
+
+--- Let the firmware wait until (value & ulMask) == ulExpected.
+-- The firmware reads the address again and again, so a change is detected
+-- within microseconds and without any USB traffic. The firmware does not
+-- answer other commands while it waits.
+--
+-- @param tType The space of the address. This is one of the DMATYPE values.
+-- @param ulTimeoutUs The maximum time to wait in microseconds. The limit is 10 seconds.
+--
+-- @return true if the value matched or false after the timeout, the last
+--         value, the number of reads and the elapsed time in microseconds.
+function papaSchlumpfFlex:pollMem(tType, ulAddress, ulMask, ulExpected, ulTimeoutUs)
+  local ulMatched, ulData, ulIterations, ulElapsedUs = self.tP:pollMem(tType, ulAddress, ulMask, ulExpected, ulTimeoutUs)
+  if ulMatched==nil then
+    error(string.format('pollMem(%d, 0x%08x, 0x%08x, 0x%08x, %d) failed: %s', tType, ulAddress, ulMask, ulExpected, ulTimeoutUs, ulData))
+  end
+  return ulMatched~=0, ulData, ulIterations, ulElapsedUs
+end
+
+
+
+--- Fill an area in the firmware.
+-- Only the pattern is transferred over USB.
+--
+-- @param ulSize The size of the area in bytes. It must be a multiple of 4.
+-- @param tPattern A DWORD value or a string with 4 to 64 bytes in steps of 4.
+--                 The pattern is repeated over the area.
+function papaSchlumpfFlex:memFill(ulAddress, ulSize, tPattern)
+  local bit = self.bit
+
+  local strPattern = tPattern
+  if type(tPattern)=='number' then
+    strPattern = string.char(
+      bit.band(tPattern, 0xff),
+      bit.band(bit.rshift(tPattern, 8), 0xff),
+      bit.band(bit.rshift(tPattern, 16), 0xff),
+      bit.band(bit.rshift(tPattern, 24), 0xff)
+    )
+  end
+
+  local tResult, strError = self.tP:memFill(ulAddress, ulSize, strPattern)
+  if tResult~=true then
+    error(string.format('memFill(0x%08x, %d, ...) failed: %s', ulAddress, ulSize, strError))
+  end
+end
+
+
+
+--- Copy an area in the PCI memory space.
+-- The firmware copies the data through its DMA buffer, so nothing goes over
+-- USB. Overlapping areas are allowed.
+--
+-- @param ulSize The size of the area in bytes. It must be a multiple of 4.
+function papaSchlumpfFlex:memCopy(ulDestinationAddress, ulSourceAddress, ulSize)
+  local tResult, strError = self.tP:memCopy(ulDestinationAddress, ulSourceAddress, ulSize)
+  if tResult~=true then
+    error(string.format('memCopy(0x%08x, 0x%08x, %d) failed: %s', ulDestinationAddress, ulSourceAddress, ulSize, strError))
+  end
+end
+
+
+
+--- Read several areas with one USB transaction.
+-- Large lists are split over several transactions.
+--
+-- @param atAreas A list of areas. Each area is a table with the address and
+--                the size in bytes, e.g. { 0x10000000, 16 }. The size must
+--                be a multiple of 4.
+--
+-- @return A list with the data of each area.
+function papaSchlumpfFlex:memReadScatter(atAreas)
+  local astrDescriptors = {}
+  for uiCnt, tArea in ipairs(atAreas) do
+    local ulAddress, ulSize = tArea[1], tArea[2]
+    if ulSize%4~=0 then
+      error(string.format('memReadScatter: the size of area %d is no multiple of 4: %d', uiCnt, ulSize))
+    end
+    astrDescriptors[uiCnt] = string.pack('<I4I4', ulAddress, ulSize // 4)
+  end
+
+  local strData, strError = self.tP:memReadScatter(table.concat(astrDescriptors))
+  if strData==nil then
+    error(string.format('memReadScatter with %d areas failed: %s', #atAreas, strError))
+  end
+
+  -- Split the data in the areas.
+  local astrData = {}
+  local uiOffset = 1
+  for uiCnt, tArea in ipairs(atAreas) do
+    astrData[uiCnt] = string.sub(strData, uiOffset, uiOffset + tArea[2] - 1)
+    uiOffset = uiOffset + tArea[2]
+  end
+
+  return astrData
+end
+
+
+
+--- Write several areas with one USB transaction.
+-- Large lists are split over several transactions. The areas are written in
+-- the order of the list.
+--
+-- @param atAreas A list of areas. Each area is a table with the address and
+--                the data, e.g. { 0x10000000, strData }. The size of the
+--                data must be a multiple of 4.
+function papaSchlumpfFlex:memWriteScatter(atAreas)
+  local astrRecords = {}
+  for uiCnt, tArea in ipairs(atAreas) do
+    local ulAddress, strData = tArea[1], tArea[2]
+    local sizData = string.len(strData)
+    if sizData%4~=0 then
+      error(string.format('memWriteScatter: the size of area %d is no multiple of 4: %d', uiCnt, sizData))
+    end
+    astrRecords[uiCnt] = string.pack('<I4I4', ulAddress, sizData // 4) .. strData
+  end
+
+  local tResult, strError = self.tP:memWriteScatter(table.concat(astrRecords))
+  if tResult~=true then
+    error(string.format('memWriteScatter with %d areas failed: %s', #atAreas, strError))
+  end
+end
+
+
+
+--- Get the CRC32 of an area from the firmware.
+-- Only the 4 byte result is transferred over USB.
+--
+-- @param ulSize The size of the area in bytes. It must be a multiple of 4.
+function papaSchlumpfFlex:memChecksum(ulAddress, ulSize)
+  local ulChecksum, strError = self.tP:memChecksum(ulAddress, ulSize)
+  if ulChecksum==nil then
+    error(string.format('memChecksum(0x%08x, %d) failed: %s', ulAddress, ulSize, strError))
+  end
+  return ulChecksum
+end
+
+
+
+--- Check if an area has the contents of a string.
+-- This compares the CRC32 of the firmware with the CRC32 of the string. Use
+-- it instead of reading the area back after memWriteArea.
+--
+-- @return true if the checksums match, false otherwise.
+function papaSchlumpfFlex:memVerify(ulAddress, strData)
+  local ulDevice = self:memChecksum(ulAddress, string.len(strData))
+  local ulHost = self.tP:checksum(strData)
+  return ulDevice==ulHost
+end
+
+
 return papaSchlumpfFlex
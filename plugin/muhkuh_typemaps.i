@@ -23,11 +23,15 @@
 %{
 	char *pcOutputData;
 	size_t sizOutputData;
+	pcOutputData = NULL;
+	sizOutputData = 0;
 	$1 = &pcOutputData;
 	$2 = &sizOutputData;
 %}
 
-/* NOTE: This "argout" typemap can only be used in combination with the above "in" typemap. */
+/* NOTE: This "argout" typemap can only be used in combination with the above "in" typemap.
+ *       The function must allocate the output buffer with malloc. Lua gets a copy of it.
+ */
 %typemap(argout) (char **ppcBUFFER_OUT, size_t *psizBUFFER_OUT)
 %{
 	if( pcOutputData!=NULL && sizOutputData!=0 )
@@ -38,6 +42,10 @@
 	{
 		lua_pushnil(L);
 	}
+	if( pcOutputData!=NULL )
+	{
+		free(pcOutputData);
+	}
 	++SWIG_arg;
 %}
 
@@ -1,22 +1,138 @@
 #include "papa_schlumpf.h"
+#include "papa_schlumpf_trace.h"
+#include "papa_schlumpf_transport_libusb.h"
 
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <time.h>
 #include "papa_schlumpf_firmware_interface.h"
+#include "papa_schlumpf_crc32.h"
+
+#include <lua.h>
+
+
+PapaSchlumpfBuffer::PapaSchlumpfBuffer(size_t sizBuffer)
+ : m_pucBuffer(NULL)
+ , m_sizBuffer(0)
+{
+	if( sizBuffer!=0 )
+	{
+		m_pucBuffer = (unsigned char*)malloc(sizBuffer);
+		if( m_pucBuffer!=NULL )
+		{
+			m_sizBuffer = sizBuffer;
+		}
+	}
+}
+
+
+
+PapaSchlumpfBuffer::~PapaSchlumpfBuffer(void)
+{
+	if( m_pucBuffer!=NULL )
+	{
+		free(m_pucBuffer);
+		m_pucBuffer = NULL;
+	}
+	m_sizBuffer = 0;
+}
+
+
+
+/* The size is 0 if the buffer could not be allocated. */
+size_t PapaSchlumpfBuffer::size(void)
+{
+	return m_sizBuffer;
+}
+
+
+
+/* Push a part of the buffer as a string or nil if the part is out of range. */
+void PapaSchlumpfBuffer::get(size_t sizOffset, size_t sizLength, lua_State *MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT)
+{
+	if( sizOffset>m_sizBuffer || sizLength>(m_sizBuffer-sizOffset) )
+	{
+		lua_pushnil(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT);
+	}
+	else
+	{
+		lua_pushlstring(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, (const char*)(m_pucBuffer + sizOffset), sizLength);
+	}
+}
+
+
+
+void PapaSchlumpfBuffer::fill(unsigned char ucValue)
+{
+	if( m_pucBuffer!=NULL )
+	{
+		memset(m_pucBuffer, ucValue, m_sizBuffer);
+	}
+}
+
+
+
+unsigned char *PapaSchlumpfBuffer::data(void)
+{
+	return m_pucBuffer;
+}
+
+
+
+/* All instances share one libusb context. It is created on the first use and
+ * stays open until the plugin is unloaded. This saves the libusb_init and the
+ * complete enumeration of the bus on every connect.
+ */
+libusb_context *PapaSchlumpfFlex::s_ptLibUsbContext = NULL;
+unsigned int PapaSchlumpfFlex::s_uiLibUsbUsers = 0;
+pthread_mutex_t PapaSchlumpfFlex::s_tLibUsbContextMutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+
+/* Close the shared libusb context when the plugin is unloaded. */
+static void __attribute__((destructor)) papa_schlumpf_close_libusb_context(void)
+{
+	PapaSchlumpfFlex::__close_libusb_context();
+}
+
 
 
 PapaSchlumpfFlex::PapaSchlumpfFlex(void)
  : m_ptLibUsbContext(NULL)
- , m_ptDevHandlePapaSchlumpf(NULL)
+ , m_pcLastSelector(NULL)
+ , m_ptTransport(NULL)
+ , m_ptPipelineSlots(NULL)
  , m_pcPluginId(NULL)
  , m_uiPluginConnections(0)
+ , m_uiTimeoutOverrideMs(0)
+ , m_ulLatencyUs(TIMEOUT_INITIAL_LATENCY_US)
+ , m_ulBytesPerSecond(TIMEOUT_INITIAL_BYTES_PER_SECOND)
+ , m_iRoundTripActive(0)
+ , m_sizRoundTrip(0)
+ , m_ulRoundTripCommand(0)
+ , m_pucRoundTripCommand(NULL)
+ , m_sizRoundTripCommand(0)
+ , m_ulRoundTripSendUs(0)
+ , m_ptTrace(NULL)
 {
 	const struct libusb_version *ptLibUsbVersion;
 
 
 	m_pcPluginId = strdup("papa_schlumpf");
+	m_acLastPath[0] = '\0';
+
+	resetStatistics();
+
+	pthread_mutex_init(&m_tPipelineMutex, NULL);
+	pthread_cond_init(&m_tPipelineCondition, NULL);
+
+	__add_libusb_user();
 
 	/* Show the libusb version. */
 	ptLibUsbVersion = libusb_get_version();
@@ -29,6 +145,23 @@ PapaSchlumpfFlex::~PapaSchlumpfFlex(void)
 {
 	__disconnect();
 
+	__remove_libusb_user();
+
+	if( m_ptTrace!=NULL )
+	{
+		delete m_ptTrace;
+		m_ptTrace = NULL;
+	}
+
+	pthread_cond_destroy(&m_tPipelineCondition);
+	pthread_mutex_destroy(&m_tPipelineMutex);
+
+	if( m_pcLastSelector!=NULL )
+	{
+		free(m_pcLastSelector);
+		m_pcLastSelector = NULL;
+	}
+
 	if( m_pcPluginId!=NULL )
 	{
 		free(m_pcPluginId);
@@ -37,37 +170,145 @@ PapaSchlumpfFlex::~PapaSchlumpfFlex(void)
 }
 
 
-RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::connect(void)
+/* Push a table with all connected Papa Schlumpf devices. Each entry has the
+ * USB path and the serial number of one device. The serial number is nil
+ * if the device can not be opened, e.g. because another process uses it.
+ * Pass the path or the serial number to connect to open one device.
+ */
+RESULT_INT_NOTHING_OR_NIL_WITH_ERR PapaSchlumpfFlex::listDevices(lua_State *MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT)
 {
-	int iResult;
 	PAPA_SCHLUMPF_RESULT_T tResult;
+	int iResult;
+	libusb_context *ptLibUsbContext;
+	ssize_t ssizDevList;
+	libusb_device **ptDeviceList;
+	libusb_device **ptDevCnt, **ptDevEnd;
+	libusb_device *ptDevice;
+	struct libusb_device_descriptor sDevDesc;
+	char acPath[64];
+	char acSerial[64];
+	lua_Integer iIndex;
 
 
-	/* Close any existing connection first. */
-	__disconnect();
-
-	/* Initialize the libusb context. */
-	iResult = libusb_init(&m_ptLibUsbContext);
-	if( iResult!=0 )
+	ptLibUsbContext = __get_libusb_context();
+	if( ptLibUsbContext==NULL )
 	{
-		printf("Error initializing libusb: %d\n", iResult);
 		tResult = PAPA_SCHLUMPF_RESULT_USBError;
 	}
 	else
 	{
-		/* Set the debug level to a bit more verbose. */
-		libusb_set_option(m_ptLibUsbContext, LIBUSB_OPTION_LOG_LEVEL, LIBUSB_LOG_LEVEL_INFO);
+		ptDeviceList = NULL;
+		ssizDevList = libusb_get_device_list(ptLibUsbContext, &ptDeviceList);
+		if( ssizDevList<0 )
+		{
+			fprintf(stderr, "%s: failed to detect USB devices: %ld:%s\n", m_pcPluginId, ssizDevList, libusb_strerror(libusb_error(ssizDevList)));
+			tResult = PAPA_SCHLUMPF_RESULT_USBError;
+		}
+		else
+		{
+			lua_newtable(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT);
+			iIndex = 1;
 
-		printf("libusb is open!\n");
+			ptDevCnt = ptDeviceList;
+			ptDevEnd = ptDevCnt + ssizDevList;
+			while( ptDevCnt<ptDevEnd )
+			{
+				ptDevice = *ptDevCnt;
 
-		/* Search for exactly one papa schlumpf hardware and open it. */
-		tResult = __scan_for_papa_schlumpf_hardware();
-		if( tResult==PAPA_SCHLUMPF_RESULT_Ok )
+				iResult = libusb_get_device_descriptor(ptDevice, &sDevDesc);
+				if( iResult==LIBUSB_SUCCESS && sDevDesc.idVendor==PAPA_SCHLUMPF_USB_VENDOR_ID && sDevDesc.idProduct==PAPA_SCHLUMPF_USB_PRODUCT_ID )
+				{
+					__get_device_path(ptDevice, acPath, sizeof(acPath));
+
+					lua_newtable(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT);
+					lua_pushstring(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, acPath);
+					lua_setfield(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, -2, "path");
+					lua_pushinteger(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, libusb_get_bus_number(ptDevice));
+					lua_setfield(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, -2, "bus");
+					if( __get_device_serial(ptDevice, acSerial, sizeof(acSerial))==0 )
+					{
+						lua_pushstring(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, acSerial);
+						lua_setfield(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, -2, "serial");
+					}
+					lua_rawseti(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, -2, iIndex);
+					++iIndex;
+				}
+
+				++ptDevCnt;
+			}
+
+			libusb_free_device_list(ptDeviceList, 1);
+			tResult = PAPA_SCHLUMPF_RESULT_Ok;
+		}
+	}
+
+	return tResult;
+}
+
+
+
+/* Connect to a Papa Schlumpf device.
+ * Without a selector there must be exactly one device. The selector is
+ * either the USB path or the serial number of a device as returned by
+ * listDevices.
+ */
+RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::connect(const char *pcSelector)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+
+
+	/* Close any existing connection first. */
+	__disconnect();
+
+	/* Forget the last device. */
+	if( m_pcLastSelector!=NULL )
+	{
+		free(m_pcLastSelector);
+		m_pcLastSelector = NULL;
+	}
+	m_acLastPath[0] = '\0';
+
+	tResult = PAPA_SCHLUMPF_RESULT_Ok;
+	if( pcSelector!=NULL )
+	{
+		m_pcLastSelector = strdup(pcSelector);
+		if( m_pcLastSelector==NULL )
 		{
-			printf("Found HW!\n");
+			tResult = PAPA_SCHLUMPF_RESULT_OutOfMemory;
 		}
 	}
 
+	if( tResult==PAPA_SCHLUMPF_RESULT_Ok )
+	{
+		tResult = __connect(NULL, pcSelector);
+	}
+
+	return tResult;
+}
+
+
+
+/* Connect again to the device of the last successful connect.
+ * This opens the device at the last USB path without looking at any other
+ * device. If the device is not there anymore, it falls back to a complete
+ * scan with the selector of the last connect.
+ */
+RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::reconnect(void)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+
+
+	__disconnect();
+
+	if( m_acLastPath[0]=='\0' )
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_NotConnected;
+	}
+	else
+	{
+		tResult = __connect(m_acLastPath, m_pcLastSelector);
+	}
+
 	return tResult;
 }
 
@@ -83,14 +324,14 @@ RESULT_INT_NOTHING_OR_NIL_WITH_ERR PapaSchlumpfFlex::getFirmwareVersion(PUL_ARGU
 	char *pcVcsVersion;
 
 
-	if( m_ptDevHandlePapaSchlumpf==NULL )
+	if( m_ptTransport==NULL )
 	{
 		tResult = PAPA_SCHLUMPF_RESULT_NotConnected;
 	}
 	else
 	{
 		tCommand.ulCommand = PAPA_SCHLUMPF_USB_COMMAND_GetFirmwareVersion;
-		iResult = __send_packet((const unsigned char *)&tCommand, sizeof(tCommand), 100);
+		iResult = __send_packet((const unsigned char *)&tCommand, sizeof(tCommand));
 		if( iResult!=0 )
 		{
 			fprintf(stderr, "%s: failed to send packet: %d\n", m_pcPluginId, iResult);
@@ -98,7 +339,7 @@ RESULT_INT_NOTHING_OR_NIL_WITH_ERR PapaSchlumpfFlex::getFirmwareVersion(PUL_ARGU
 		}
 		else
 		{
-			iResult = __receivePacket((unsigned char *)&tResponse, sizeof(tResponse), &iTransfered, 100);
+			iResult = __receivePacket((unsigned char *)&tResponse, sizeof(tResponse), &iTransfered, 0, 0);
 			if( iResult!=0 )
 			{
 				fprintf(stderr, "%s: failed to receive packet: %d\n", m_pcPluginId, iResult);
@@ -145,7 +386,7 @@ RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::resetPCI(uint32_t ulResetActiv
 	PAPA_SCHLUMPF_USB_COMMAND_RESULT_STATUS_T tResponse;
 
 
-	if( m_ptDevHandlePapaSchlumpf==NULL )
+	if( m_ptTransport==NULL )
 	{
 		tResult = PAPA_SCHLUMPF_RESULT_NotConnected;
 	}
@@ -155,7 +396,7 @@ RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::resetPCI(uint32_t ulResetActiv
 		tCommand.ulResetActiveToClock = ulResetActiveToClock;
 		tCommand.ulResetActiveDelayAfterClock = ulResetActiveDelayAfterClock;
 		tCommand.ulBusIdleDelay = ulBusIdleDelay;
-		iResult = __send_packet((const unsigned char *)&tCommand, sizeof(tCommand), 100);
+		iResult = __send_packet((const unsigned char *)&tCommand, sizeof(tCommand));
 		if( iResult!=0 )
 		{
 			fprintf(stderr, "%s: failed to send packet: %d\n", m_pcPluginId, iResult);
@@ -170,7 +411,7 @@ RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::resetPCI(uint32_t ulResetActiv
 			ulExpectedDelay  = (ulResetActiveToClock + ulResetActiveDelayAfterClock + ulBusIdleDelay) * 10U;
 			ulExpectedDelay += 100U;
 
-			iResult = __receivePacket((unsigned char *)&tResponse, sizeof(tResponse), &iTransfered, ulExpectedDelay);
+			iResult = __receivePacket((unsigned char *)&tResponse, sizeof(tResponse), &iTransfered, ulExpectedDelay, 0);
 			if( iResult!=0 )
 			{
 				fprintf(stderr, "%s: failed to receive packet: %d\n", m_pcPluginId, iResult);
@@ -207,7 +448,7 @@ RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::setPCIReset(uint32_t ulResetSt
 	PAPA_SCHLUMPF_USB_COMMAND_RESULT_STATUS_T tResponse;
 
 
-	if( m_ptDevHandlePapaSchlumpf==NULL )
+	if( m_ptTransport==NULL )
 	{
 		tResult = PAPA_SCHLUMPF_RESULT_NotConnected;
 	}
@@ -215,7 +456,7 @@ RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::setPCIReset(uint32_t ulResetSt
 	{
 		tCommand.ulCommand = PAPA_SCHLUMPF_USB_COMMAND_SetPCIReset;
 		tCommand.ulResetState = ulResetState;
-		iResult = __send_packet((const unsigned char *)&tCommand, sizeof(tCommand), 100);
+		iResult = __send_packet((const unsigned char *)&tCommand, sizeof(tCommand));
 		if( iResult!=0 )
 		{
 			fprintf(stderr, "%s: failed to send packet: %d\n", m_pcPluginId, iResult);
@@ -223,7 +464,7 @@ RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::setPCIReset(uint32_t ulResetSt
 		}
 		else
 		{
-			iResult = __receivePacket((unsigned char *)&tResponse, sizeof(tResponse), &iTransfered, 500);
+			iResult = __receivePacket((unsigned char *)&tResponse, sizeof(tResponse), &iTransfered, 0, 0);
 			if( iResult!=0 )
 			{
 				fprintf(stderr, "%s: failed to receive packet: %d\n", m_pcPluginId, iResult);
@@ -260,14 +501,14 @@ RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::setupNetx(void)
 	PAPA_SCHLUMPF_USB_COMMAND_RESULT_STATUS_T tResponse;
 
 
-	if( m_ptDevHandlePapaSchlumpf==NULL )
+	if( m_ptTransport==NULL )
 	{
 		tResult = PAPA_SCHLUMPF_RESULT_NotConnected;
 	}
 	else
 	{
 		tCommand.ulCommand = PAPA_SCHLUMPF_USB_COMMAND_SetupNetx;
-		iResult = __send_packet((const unsigned char *)&tCommand, sizeof(tCommand), 100);
+		iResult = __send_packet((const unsigned char *)&tCommand, sizeof(tCommand));
 		if( iResult!=0 )
 		{
 			fprintf(stderr, "%s: failed to send packet: %d\n", m_pcPluginId, iResult);
@@ -275,7 +516,7 @@ RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::setupNetx(void)
 		}
 		else
 		{
-			iResult = __receivePacket((unsigned char *)&tResponse, sizeof(tResponse), &iTransfered, 500);
+			iResult = __receivePacket((unsigned char *)&tResponse, sizeof(tResponse), &iTransfered, 0, 0);
 			if( iResult!=0 )
 			{
 				fprintf(stderr, "%s: failed to receive packet: %d\n", m_pcPluginId, iResult);
@@ -312,7 +553,7 @@ RESULT_INT_NOTHING_OR_NIL_WITH_ERR PapaSchlumpfFlex::ioRead(uint32_t ulAddress,
 	PAPA_SCHLUMPF_USB_COMMAND_RESULT_DMA_IO_READ_T tResponse;
 
 
-	if( m_ptDevHandlePapaSchlumpf==NULL )
+	if( m_ptTransport==NULL )
 	{
 		tResult = PAPA_SCHLUMPF_RESULT_NotConnected;
 	}
@@ -320,7 +561,7 @@ RESULT_INT_NOTHING_OR_NIL_WITH_ERR PapaSchlumpfFlex::ioRead(uint32_t ulAddress,
 	{
 		tCommand.ulCommand = PAPA_SCHLUMPF_USB_COMMAND_DMAIoRead;
 		tCommand.ulDeviceAddress = ulAddress;
-		iResult = __send_packet((const unsigned char *)&tCommand, sizeof(tCommand), 100);
+		iResult = __send_packet((const unsigned char *)&tCommand, sizeof(tCommand));
 		if( iResult!=0 )
 		{
 			fprintf(stderr, "%s: failed to send packet: %d\n", m_pcPluginId, iResult);
@@ -328,7 +569,7 @@ RESULT_INT_NOTHING_OR_NIL_WITH_ERR PapaSchlumpfFlex::ioRead(uint32_t ulAddress,
 		}
 		else
 		{
-			iResult = __receivePacket((unsigned char *)&tResponse, sizeof(tResponse), &iTransfered, 500);
+			iResult = __receivePacket((unsigned char *)&tResponse, sizeof(tResponse), &iTransfered, 0, 1);
 			if( iResult!=0 )
 			{
 				fprintf(stderr, "%s: failed to receive packet: %d\n", m_pcPluginId, iResult);
@@ -366,7 +607,7 @@ RESULT_INT_NOTHING_OR_NIL_WITH_ERR PapaSchlumpfFlex::memRead(uint32_t ulAddress,
 	PAPA_SCHLUMPF_USB_COMMAND_RESULT_DMA_MEM_READ_T tResponse;
 
 
-	if( m_ptDevHandlePapaSchlumpf==NULL )
+	if( m_ptTransport==NULL )
 	{
 		tResult = PAPA_SCHLUMPF_RESULT_NotConnected;
 	}
@@ -374,7 +615,7 @@ RESULT_INT_NOTHING_OR_NIL_WITH_ERR PapaSchlumpfFlex::memRead(uint32_t ulAddress,
 	{
 		tCommand.ulCommand = PAPA_SCHLUMPF_USB_COMMAND_DMAMemRead;
 		tCommand.ulDeviceAddress = ulAddress;
-		iResult = __send_packet((const unsigned char *)&tCommand, sizeof(tCommand), 100);
+		iResult = __send_packet((const unsigned char *)&tCommand, sizeof(tCommand));
 		if( iResult!=0 )
 		{
 			fprintf(stderr, "%s: failed to send packet: %d\n", m_pcPluginId, iResult);
@@ -382,7 +623,7 @@ RESULT_INT_NOTHING_OR_NIL_WITH_ERR PapaSchlumpfFlex::memRead(uint32_t ulAddress,
 		}
 		else
 		{
-			iResult = __receivePacket((unsigned char *)&tResponse, sizeof(tResponse), &iTransfered, 500);
+			iResult = __receivePacket((unsigned char *)&tResponse, sizeof(tResponse), &iTransfered, 0, 1);
 			if( iResult!=0 )
 			{
 				fprintf(stderr, "%s: failed to receive packet: %d\n", m_pcPluginId, iResult);
@@ -411,36 +652,13 @@ RESULT_INT_NOTHING_OR_NIL_WITH_ERR PapaSchlumpfFlex::memRead(uint32_t ulAddress,
 
 
 
-/* Make the buffer a little bit bigger to allow proper termination of transactions.
- * The netX sends a zero packet regardless of if the maximum transaction size was reached or not.
- * If the PC uses the maximum transaction size for the read request, the following zero packet will not
- * be received and is stuck in the netX.
- *
- * Example:
- * The maximum transaction size is set to 128 bytes. If the PC requests a memory size of 124, the netX will
- * respond with 4 bytes status plus 124 bytes data. This makes 128 bytes in total. The netX will also send
- * a zero packet to terminate the transaction. If the PC limits the read operation to 128 bytes, it will
- * not wait for the following zero packet sent by the netX. It messes up the following communication.
- */
-typedef union BIGGER_U
-{
-	PAPA_SCHLUMPF_USB_COMMAND_RESULT_DMA_MEM_READ_AREA_T tResponse;
-	unsigned char auc[sizeof(PAPA_SCHLUMPF_USB_COMMAND_RESULT_DMA_MEM_READ_AREA_T) + 4];
-} BIGGER_T;
 RESULT_INT_NOTHING_OR_NIL_WITH_ERR PapaSchlumpfFlex::memReadArea(uint32_t ulAddress, uint32_t ulSize, char **ppcBUFFER_OUT, size_t *psizBUFFER_OUT)
 {
 	PAPA_SCHLUMPF_RESULT_T tResult;
-	int iResult;
-	int iTransfered;
 	char *pcBuffer;
-	uint32_t ulOffset;
-	uint32_t ulChunk;
-	uint32_t ulChunkMax;
-	PAPA_SCHLUMPF_USB_COMMAND_DMA_MEM_READ_AREA_T tCommand;
-	BIGGER_T tBigger;
 
 
-	if( m_ptDevHandlePapaSchlumpf==NULL )
+	if( m_ptTransport==NULL )
 	{
 		tResult = PAPA_SCHLUMPF_RESULT_NotConnected;
 	}
@@ -458,63 +676,7 @@ RESULT_INT_NOTHING_OR_NIL_WITH_ERR PapaSchlumpfFlex::memReadArea(uint32_t ulAddr
 		}
 		else
 		{
-			/* Cut the read command in chunks. */
-			tResult = PAPA_SCHLUMPF_RESULT_Ok;
-			ulOffset = 0;
-			ulChunkMax = sizeof(tBigger.tResponse.aucData);
-			while( ulOffset<ulSize )
-			{
-				ulChunk = ulSize - ulOffset;
-				if( ulChunk>ulChunkMax )
-				{
-					ulChunk = ulChunkMax;
-				}
-
-				tCommand.ulCommand = PAPA_SCHLUMPF_USB_COMMAND_DMAMemReadArea;
-				tCommand.ulDeviceAddress = ulAddress + ulOffset;
-				tCommand.ulSize = ulChunk;
-				iResult = __send_packet((const unsigned char *)&tCommand, sizeof(tCommand), 100);
-				if( iResult!=0 )
-				{
-					fprintf(stderr, "%s: failed to send packet: %d\n", m_pcPluginId, iResult);
-					tResult = PAPA_SCHLUMPF_RESULT_USBError;
-				}
-				else
-				{
-					iResult = __receivePacket(tBigger.auc, sizeof(tBigger), &iTransfered, 500);
-					if( iResult!=0 )
-					{
-						fprintf(stderr, "%s: failed to receive packet: %d\n", m_pcPluginId, iResult);
-						tResult = PAPA_SCHLUMPF_RESULT_USBError;
-					}
-					else if( iTransfered<sizeof(uint32_t) )
-					{
-						fprintf(stderr, "%s: the received packet is too small, it has only %d bytes.\n", m_pcPluginId, iTransfered);
-						tResult = PAPA_SCHLUMPF_RESULT_USBError;
-					}
-					else if( tBigger.tResponse.ulStatus!=USB_COMMAND_STATUS_Ok )
-					{
-						fprintf(stderr, "%s: received an error: %d.\n", m_pcPluginId, tBigger.tResponse.ulStatus);
-						tResult = PAPA_SCHLUMPF_RESULT_CommandFailed;
-					}
-					else if( iTransfered!=sizeof(uint32_t)+ulChunk )
-					{
-						fprintf(stderr, "%s: received an unexpected amount of data. wanted %zd bytes, but got %d.\n", m_pcPluginId, sizeof(uint32_t)+ulChunk, iTransfered);
-						tResult = PAPA_SCHLUMPF_RESULT_USBError;
-					}
-					else
-					{
-						memcpy(pcBuffer+ulOffset, tBigger.tResponse.aucData, ulChunk);
-						ulOffset += ulChunk;
-					}
-				}
-
-				if( tResult!=PAPA_SCHLUMPF_RESULT_Ok )
-				{
-					break;
-				}
-			}
-
+			tResult = memReadArea(ulAddress, ulSize, pcBuffer);
 			if( tResult==PAPA_SCHLUMPF_RESULT_Ok )
 			{
 				*ppcBUFFER_OUT = pcBuffer;
@@ -532,53 +694,29 @@ RESULT_INT_NOTHING_OR_NIL_WITH_ERR PapaSchlumpfFlex::memReadArea(uint32_t ulAddr
 
 
 
-RESULT_INT_NOTHING_OR_NIL_WITH_ERR PapaSchlumpfFlex::cfg0Read(uint32_t ulAddress, PUL_ARGUMENT_OUT pulData)
+RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::memReadAreaToBuffer(uint32_t ulAddress, uint32_t ulSize, PapaSchlumpfBuffer *ptBuffer, uint32_t ulBufferOffset)
 {
 	PAPA_SCHLUMPF_RESULT_T tResult;
-	int iResult;
-	int iTransfered;
-	PAPA_SCHLUMPF_USB_COMMAND_DMA_CFG0_READ_T tCommand;
-	PAPA_SCHLUMPF_USB_COMMAND_RESULT_DMA_CFG0_READ_T tResponse;
+	size_t sizBuffer;
+
 
+	sizBuffer = 0;
+	if( ptBuffer!=NULL )
+	{
+		sizBuffer = ptBuffer->size();
+	}
 
-	if( m_ptDevHandlePapaSchlumpf==NULL )
+	if( m_ptTransport==NULL )
 	{
 		tResult = PAPA_SCHLUMPF_RESULT_NotConnected;
 	}
+	else if( ulSize==0 || ulBufferOffset>sizBuffer || ulSize>(sizBuffer-ulBufferOffset) )
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_InvalidSize;
+	}
 	else
 	{
-		tCommand.ulCommand = PAPA_SCHLUMPF_USB_COMMAND_DMACfg0Read;
-		tCommand.ulDeviceAddress = ulAddress;
-		iResult = __send_packet((const unsigned char *)&tCommand, sizeof(tCommand), 100);
-		if( iResult!=0 )
-		{
-			fprintf(stderr, "%s: failed to send packet: %d\n", m_pcPluginId, iResult);
-			tResult = PAPA_SCHLUMPF_RESULT_USBError;
-		}
-		else
-		{
-			iResult = __receivePacket((unsigned char *)&tResponse, sizeof(tResponse), &iTransfered, 500);
-			if( iResult!=0 )
-			{
-				fprintf(stderr, "%s: failed to receive packet: %d\n", m_pcPluginId, iResult);
-				tResult = PAPA_SCHLUMPF_RESULT_USBError;
-			}
-			else if( iTransfered!=sizeof(tResponse) )
-			{
-				fprintf(stderr, "%s: received an unexpected amount of data. wanted %zd bytes, but got %d.\n", m_pcPluginId, sizeof(tResponse), iTransfered);
-				tResult = PAPA_SCHLUMPF_RESULT_USBError;
-			}
-			else if( tResponse.ulStatus!=USB_COMMAND_STATUS_Ok )
-			{
-				fprintf(stderr, "%s: received an error: %d.\n", m_pcPluginId, tResponse.ulStatus);
-				tResult = PAPA_SCHLUMPF_RESULT_CommandFailed;
-			}
-			else
-			{
-				*pulData = tResponse.ulData;
-				tResult = PAPA_SCHLUMPF_RESULT_Ok;
-			}
-		}
+		tResult = memReadArea(ulAddress, ulSize, ptBuffer->data() + ulBufferOffset);
 	}
 
 	return tResult;
@@ -586,51 +724,70 @@ RESULT_INT_NOTHING_OR_NIL_WITH_ERR PapaSchlumpfFlex::cfg0Read(uint32_t ulAddress
 
 
 
-RESULT_INT_NOTHING_OR_NIL_WITH_ERR PapaSchlumpfFlex::cfg1Read(uint32_t ulAddress, PUL_ARGUMENT_OUT pulData)
+PAPA_SCHLUMPF_RESULT_T PapaSchlumpfFlex::memReadArea(uint32_t ulAddress, uint32_t ulSize, void *pvBuffer)
 {
 	PAPA_SCHLUMPF_RESULT_T tResult;
-	int iResult;
-	int iTransfered;
-	PAPA_SCHLUMPF_USB_COMMAND_DMA_CFG1_READ_T tCommand;
-	PAPA_SCHLUMPF_USB_COMMAND_RESULT_DMA_CFG1_READ_T tResponse;
 
 
-	if( m_ptDevHandlePapaSchlumpf==NULL )
+	if( m_ptTransport==NULL )
 	{
 		tResult = PAPA_SCHLUMPF_RESULT_NotConnected;
 	}
+	else if( ulSize==0 )
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_InvalidSize;
+	}
 	else
 	{
-		tCommand.ulCommand = PAPA_SCHLUMPF_USB_COMMAND_DMACfg1Read;
-		tCommand.ulDeviceAddress = ulAddress;
-		iResult = __send_packet((const unsigned char *)&tCommand, sizeof(tCommand), 100);
-		if( iResult!=0 )
-		{
-			fprintf(stderr, "%s: failed to send packet: %d\n", m_pcPluginId, iResult);
-			tResult = PAPA_SCHLUMPF_RESULT_USBError;
-		}
-		else
-		{
-			iResult = __receivePacket((unsigned char *)&tResponse, sizeof(tResponse), &iTransfered, 500);
-			if( iResult!=0 )
-			{
-				fprintf(stderr, "%s: failed to receive packet: %d\n", m_pcPluginId, iResult);
-				tResult = PAPA_SCHLUMPF_RESULT_USBError;
-			}
-			else if( iTransfered!=sizeof(tResponse) )
-			{
-				fprintf(stderr, "%s: received an unexpected amount of data. wanted %zd bytes, but got %d.\n", m_pcPluginId, sizeof(tResponse), iTransfered);
-				tResult = PAPA_SCHLUMPF_RESULT_USBError;
-			}
-			else if( tResponse.ulStatus!=USB_COMMAND_STATUS_Ok )
-			{
-				fprintf(stderr, "%s: received an error: %d.\n", m_pcPluginId, tResponse.ulStatus);
-				tResult = PAPA_SCHLUMPF_RESULT_CommandFailed;
-			}
-			else
+#ifdef __linux__
+		/* Receive the chunks directly at their final position. */
+		tResult = __pipeline_read_area_in_place(ulAddress, ulSize, (unsigned char*)pvBuffer);
+#else
+		/* Only usbfs is known to copy the data when the transfer is reaped. */
+		tResult = __pipeline_read_area(ulAddress, ulSize, __consume_to_memory, pvBuffer);
+#endif
+	}
+
+	return tResult;
+}
+
+
+
+/* Dump an area to a file. Each chunk is written to the file as soon as it
+ * arrives. The memory use does not depend on the size of the area.
+ */
+RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::memReadAreaToFile(uint32_t ulAddress, uint32_t ulSize, const char *pcPath)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	PIPELINE_FILE_T tFile;
+
+
+	if( m_ptTransport==NULL )
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_NotConnected;
+	}
+	else if( ulSize==0 )
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_InvalidSize;
+	}
+	else
+	{
+		tFile.iFd = open(pcPath, O_WRONLY|O_CREAT|O_TRUNC, 0666);
+		if( tFile.iFd==-1 )
+		{
+			fprintf(stderr, "%s: failed to open the file %s: %s\n", m_pcPluginId, pcPath, strerror(errno));
+			tResult = PAPA_SCHLUMPF_RESULT_FileError;
+		}
+		else
+		{
+			tFile.tFileOffset = 0;
+			tFile.pcPluginId = m_pcPluginId;
+			tResult = __pipeline_read_area(ulAddress, ulSize, __consume_to_file, &tFile);
+
+			if( close(tFile.iFd)!=0 && tResult==PAPA_SCHLUMPF_RESULT_Ok )
 			{
-				*pulData = tResponse.ulData;
-				tResult = PAPA_SCHLUMPF_RESULT_Ok;
+				fprintf(stderr, "%s: failed to close the file %s: %s\n", m_pcPluginId, pcPath, strerror(errno));
+				tResult = PAPA_SCHLUMPF_RESULT_FileError;
 			}
 		}
 	}
@@ -640,51 +797,83 @@ RESULT_INT_NOTHING_OR_NIL_WITH_ERR PapaSchlumpfFlex::cfg1Read(uint32_t ulAddress
 
 
 
-RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::ioWrite(uint32_t ulAddress, uint32_t ulData)
+/* Read an area with a single MemReadStream command. This is faster than
+ * memReadArea for big areas, as there is no command for each chunk.
+ */
+RESULT_INT_NOTHING_OR_NIL_WITH_ERR PapaSchlumpfFlex::memReadStream(uint32_t ulAddress, uint32_t ulSize, char **ppcBUFFER_OUT, size_t *psizBUFFER_OUT)
 {
 	PAPA_SCHLUMPF_RESULT_T tResult;
-	int iResult;
-	int iTransfered;
-	PAPA_SCHLUMPF_USB_COMMAND_DMA_IO_WRITE_T tCommand;
-	PAPA_SCHLUMPF_USB_COMMAND_RESULT_STATUS_T tResponse;
+	char *pcBuffer;
 
 
-	if( m_ptDevHandlePapaSchlumpf==NULL )
+	if( m_ptTransport==NULL )
 	{
 		tResult = PAPA_SCHLUMPF_RESULT_NotConnected;
 	}
+	else if( ulSize==0 )
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_InvalidSize;
+	}
 	else
 	{
-		tCommand.ulCommand = PAPA_SCHLUMPF_USB_COMMAND_DMAIoWrite;
-		tCommand.ulDeviceAddress = ulAddress;
-		tCommand.ulData = ulData;
-		iResult = __send_packet((const unsigned char *)&tCommand, sizeof(tCommand), 100);
-		if( iResult!=0 )
+		pcBuffer = (char*)malloc(ulSize);
+		if( pcBuffer==NULL )
 		{
-			fprintf(stderr, "%s: failed to send packet: %d\n", m_pcPluginId, iResult);
-			tResult = PAPA_SCHLUMPF_RESULT_USBError;
+			tResult = PAPA_SCHLUMPF_RESULT_OutOfMemory;
 		}
 		else
 		{
-			iResult = __receivePacket((unsigned char *)&tResponse, sizeof(tResponse), &iTransfered, 500);
-			if( iResult!=0 )
-			{
-				fprintf(stderr, "%s: failed to receive packet: %d\n", m_pcPluginId, iResult);
-				tResult = PAPA_SCHLUMPF_RESULT_USBError;
-			}
-			else if( iTransfered!=sizeof(tResponse) )
+			tResult = __stream_read_area(ulAddress, ulSize, __consume_to_memory, pcBuffer);
+			if( tResult==PAPA_SCHLUMPF_RESULT_Ok )
 			{
-				fprintf(stderr, "%s: received an unexpected amount of data. wanted %zd bytes, but got %d.\n", m_pcPluginId, sizeof(tResponse), iTransfered);
-				tResult = PAPA_SCHLUMPF_RESULT_USBError;
+				*ppcBUFFER_OUT = pcBuffer;
+				*psizBUFFER_OUT = ulSize;
 			}
-			else if( tResponse.ulStatus!=USB_COMMAND_STATUS_Ok )
+			else
 			{
-				fprintf(stderr, "%s: received an error: %d.\n", m_pcPluginId, tResponse.ulStatus);
-				tResult = PAPA_SCHLUMPF_RESULT_CommandFailed;
+				free(pcBuffer);
 			}
-			else
+		}
+	}
+
+	return tResult;
+}
+
+
+
+/* Dump an area to a file with a single MemReadStream command. */
+RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::memReadStreamToFile(uint32_t ulAddress, uint32_t ulSize, const char *pcPath)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	PIPELINE_FILE_T tFile;
+
+
+	if( m_ptTransport==NULL )
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_NotConnected;
+	}
+	else if( ulSize==0 )
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_InvalidSize;
+	}
+	else
+	{
+		tFile.iFd = open(pcPath, O_WRONLY|O_CREAT|O_TRUNC, 0666);
+		if( tFile.iFd==-1 )
+		{
+			fprintf(stderr, "%s: failed to open the file %s: %s\n", m_pcPluginId, pcPath, strerror(errno));
+			tResult = PAPA_SCHLUMPF_RESULT_FileError;
+		}
+		else
+		{
+			tFile.tFileOffset = 0;
+			tFile.pcPluginId = m_pcPluginId;
+			tResult = __stream_read_area(ulAddress, ulSize, __consume_to_file, &tFile);
+
+			if( close(tFile.iFd)!=0 && tResult==PAPA_SCHLUMPF_RESULT_Ok )
 			{
-				tResult = PAPA_SCHLUMPF_RESULT_Ok;
+				fprintf(stderr, "%s: failed to close the file %s: %s\n", m_pcPluginId, pcPath, strerror(errno));
+				tResult = PAPA_SCHLUMPF_RESULT_FileError;
 			}
 		}
 	}
@@ -694,25 +883,24 @@ RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::ioWrite(uint32_t ulAddress, ui
 
 
 
-RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::memWrite(uint32_t ulAddress, uint32_t ulData)
+RESULT_INT_NOTHING_OR_NIL_WITH_ERR PapaSchlumpfFlex::cfg0Read(uint32_t ulAddress, PUL_ARGUMENT_OUT pulData)
 {
 	PAPA_SCHLUMPF_RESULT_T tResult;
 	int iResult;
 	int iTransfered;
-	PAPA_SCHLUMPF_USB_COMMAND_DMA_MEM_WRITE_T tCommand;
-	PAPA_SCHLUMPF_USB_COMMAND_RESULT_STATUS_T tResponse;
+	PAPA_SCHLUMPF_USB_COMMAND_DMA_CFG0_READ_T tCommand;
+	PAPA_SCHLUMPF_USB_COMMAND_RESULT_DMA_CFG0_READ_T tResponse;
 
 
-	if( m_ptDevHandlePapaSchlumpf==NULL )
+	if( m_ptTransport==NULL )
 	{
 		tResult = PAPA_SCHLUMPF_RESULT_NotConnected;
 	}
 	else
 	{
-		tCommand.ulCommand = PAPA_SCHLUMPF_USB_COMMAND_DMAMemWrite;
+		tCommand.ulCommand = PAPA_SCHLUMPF_USB_COMMAND_DMACfg0Read;
 		tCommand.ulDeviceAddress = ulAddress;
-		tCommand.ulData = ulData;
-		iResult = __send_packet((const unsigned char *)&tCommand, sizeof(tCommand), 100);
+		iResult = __send_packet((const unsigned char *)&tCommand, sizeof(tCommand));
 		if( iResult!=0 )
 		{
 			fprintf(stderr, "%s: failed to send packet: %d\n", m_pcPluginId, iResult);
@@ -720,7 +908,7 @@ RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::memWrite(uint32_t ulAddress, u
 		}
 		else
 		{
-			iResult = __receivePacket((unsigned char *)&tResponse, sizeof(tResponse), &iTransfered, 500);
+			iResult = __receivePacket((unsigned char *)&tResponse, sizeof(tResponse), &iTransfered, 0, 1);
 			if( iResult!=0 )
 			{
 				fprintf(stderr, "%s: failed to receive packet: %d\n", m_pcPluginId, iResult);
@@ -738,6 +926,7 @@ RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::memWrite(uint32_t ulAddress, u
 			}
 			else
 			{
+				*pulData = tResponse.ulData;
 				tResult = PAPA_SCHLUMPF_RESULT_Ok;
 			}
 		}
@@ -748,92 +937,51 @@ RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::memWrite(uint32_t ulAddress, u
 
 
 
-RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::memWriteArea(uint32_t ulAddress, const char *pcBUFFER_IN, size_t sizBUFFER_IN)
+RESULT_INT_NOTHING_OR_NIL_WITH_ERR PapaSchlumpfFlex::cfg1Read(uint32_t ulAddress, PUL_ARGUMENT_OUT pulData)
 {
 	PAPA_SCHLUMPF_RESULT_T tResult;
 	int iResult;
-	int iSendSize;
 	int iTransfered;
-	char *pcBuffer;
-	uint32_t ulOffset;
-	uint32_t ulChunk;
-	uint32_t ulChunkMax;
-	PAPA_SCHLUMPF_USB_COMMAND_DMA_MEM_WRITE_AREA_T tCommand;
-	PAPA_SCHLUMPF_USB_COMMAND_RESULT_STATUS_T tResponse;
+	PAPA_SCHLUMPF_USB_COMMAND_DMA_CFG1_READ_T tCommand;
+	PAPA_SCHLUMPF_USB_COMMAND_RESULT_DMA_CFG1_READ_T tResponse;
 
 
-	if( m_ptDevHandlePapaSchlumpf==NULL )
+	if( m_ptTransport==NULL )
 	{
 		tResult = PAPA_SCHLUMPF_RESULT_NotConnected;
 	}
-	else if( sizBUFFER_IN==0 )
-	{
-		tResult = PAPA_SCHLUMPF_RESULT_InvalidSize;
-	}
 	else
 	{
-		/* Cut the read command in chunks. */
-		tResult = PAPA_SCHLUMPF_RESULT_Ok;
-		ulOffset = 0;
-		ulChunkMax = sizeof(tCommand.aucData);
-//		ulChunkMax = 112;
-		while( ulOffset<sizBUFFER_IN )
+		tCommand.ulCommand = PAPA_SCHLUMPF_USB_COMMAND_DMACfg1Read;
+		tCommand.ulDeviceAddress = ulAddress;
+		iResult = __send_packet((const unsigned char *)&tCommand, sizeof(tCommand));
+		if( iResult!=0 )
 		{
-			ulChunk = sizBUFFER_IN - ulOffset;
-			if( ulChunk>ulChunkMax )
+			fprintf(stderr, "%s: failed to send packet: %d\n", m_pcPluginId, iResult);
+			tResult = PAPA_SCHLUMPF_RESULT_USBError;
+		}
+		else
+		{
+			iResult = __receivePacket((unsigned char *)&tResponse, sizeof(tResponse), &iTransfered, 0, 1);
+			if( iResult!=0 )
 			{
-				ulChunk = ulChunkMax;
+				fprintf(stderr, "%s: failed to receive packet: %d\n", m_pcPluginId, iResult);
+				tResult = PAPA_SCHLUMPF_RESULT_USBError;
 			}
-
-			tCommand.ulCommand = PAPA_SCHLUMPF_USB_COMMAND_DMAMemWriteArea;
-			tCommand.ulDeviceAddress = ulAddress + ulOffset;
-			tCommand.ulSize = ulChunk;
-			memcpy(tCommand.aucData, pcBUFFER_IN+ulOffset, ulChunk);
-			iSendSize = sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint32_t) + ulChunk;
-			iResult = __send_packet((const unsigned char *)&tCommand, iSendSize, 500);
-			if( iResult!=0 )
+			else if( iTransfered!=sizeof(tResponse) )
 			{
-				fprintf(stderr, "%s: failed to send packet: %d\n", m_pcPluginId, iResult);
+				fprintf(stderr, "%s: received an unexpected amount of data. wanted %zd bytes, but got %d.\n", m_pcPluginId, sizeof(tResponse), iTransfered);
 				tResult = PAPA_SCHLUMPF_RESULT_USBError;
 			}
-			else
+			else if( tResponse.ulStatus!=USB_COMMAND_STATUS_Ok )
 			{
-				/* Terminate the transaction with a ZLP if the last block was full. */
-				if( (iSendSize&0x0000003f)==0 )
-				{
-					iResult = __send_packet(NULL, 0, 100);
-					if( iResult!=0 )
-					{
-						fprintf(stderr, "%s: failed to send ZLP packet: %d\n", m_pcPluginId, iResult);
-						tResult = PAPA_SCHLUMPF_RESULT_USBError;
-					}
-				}
-				if( tResult==PAPA_SCHLUMPF_RESULT_Ok )
-				{
-					iResult = __receivePacket((unsigned char*)&tResponse, sizeof(tResponse), &iTransfered, 500);
-					if( iResult!=0 )
-					{
-						fprintf(stderr, "%s: failed to receive packet: %d\n", m_pcPluginId, iResult);
-						tResult = PAPA_SCHLUMPF_RESULT_USBError;
-					}
-					else if( iTransfered!=sizeof(tResponse) )
-					{
-						fprintf(stderr, "%s: received an unexpected amount of data. wanted %zd bytes, but got %d.\n", m_pcPluginId, sizeof(tResponse), iTransfered);
-						tResult = PAPA_SCHLUMPF_RESULT_USBError;
-					}
-					else if( tResponse.ulStatus!=USB_COMMAND_STATUS_Ok )
-					{
-						fprintf(stderr, "%s: received an error: %d.\n", m_pcPluginId, tResponse.ulStatus);
-						tResult = PAPA_SCHLUMPF_RESULT_CommandFailed;
-					}
-				}
+				fprintf(stderr, "%s: received an error: %d.\n", m_pcPluginId, tResponse.ulStatus);
+				tResult = PAPA_SCHLUMPF_RESULT_CommandFailed;
 			}
-
-			ulOffset += ulChunk;
-
-			if( tResult!=PAPA_SCHLUMPF_RESULT_Ok )
+			else
 			{
-				break;
+				*pulData = tResponse.ulData;
+				tResult = PAPA_SCHLUMPF_RESULT_Ok;
 			}
 		}
 	}
@@ -843,25 +991,42 @@ RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::memWriteArea(uint32_t ulAddres
 
 
 
-RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::cfg0Write(uint32_t ulAddress, uint32_t ulData)
+/* Read a range of configuration registers with one command, e.g. the
+ * complete header with an offset of 0 and a size of 256.
+ */
+RESULT_INT_NOTHING_OR_NIL_WITH_ERR PapaSchlumpfFlex::cfg0ReadArea(uint32_t ulAddress, uint32_t ulSize, char **ppcBUFFER_OUT, size_t *psizBUFFER_OUT)
+{
+	return __cfg_read_area(PAPA_SCHLUMPF_USB_COMMAND_DMACfg0ReadArea, ulAddress, ulSize, ppcBUFFER_OUT, psizBUFFER_OUT);
+}
+
+
+
+RESULT_INT_NOTHING_OR_NIL_WITH_ERR PapaSchlumpfFlex::cfg1ReadArea(uint32_t ulAddress, uint32_t ulSize, char **ppcBUFFER_OUT, size_t *psizBUFFER_OUT)
+{
+	return __cfg_read_area(PAPA_SCHLUMPF_USB_COMMAND_DMACfg1ReadArea, ulAddress, ulSize, ppcBUFFER_OUT, psizBUFFER_OUT);
+}
+
+
+
+RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::ioWrite(uint32_t ulAddress, uint32_t ulData)
 {
 	PAPA_SCHLUMPF_RESULT_T tResult;
 	int iResult;
 	int iTransfered;
-	PAPA_SCHLUMPF_USB_COMMAND_DMA_CFG0_WRITE_T tCommand;
+	PAPA_SCHLUMPF_USB_COMMAND_DMA_IO_WRITE_T tCommand;
 	PAPA_SCHLUMPF_USB_COMMAND_RESULT_STATUS_T tResponse;
 
 
-	if( m_ptDevHandlePapaSchlumpf==NULL )
+	if( m_ptTransport==NULL )
 	{
 		tResult = PAPA_SCHLUMPF_RESULT_NotConnected;
 	}
 	else
 	{
-		tCommand.ulCommand = PAPA_SCHLUMPF_USB_COMMAND_DMACfg0Write;
+		tCommand.ulCommand = PAPA_SCHLUMPF_USB_COMMAND_DMAIoWrite;
 		tCommand.ulDeviceAddress = ulAddress;
 		tCommand.ulData = ulData;
-		iResult = __send_packet((const unsigned char *)&tCommand, sizeof(tCommand), 100);
+		iResult = __send_packet((const unsigned char *)&tCommand, sizeof(tCommand));
 		if( iResult!=0 )
 		{
 			fprintf(stderr, "%s: failed to send packet: %d\n", m_pcPluginId, iResult);
@@ -869,7 +1034,7 @@ RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::cfg0Write(uint32_t ulAddress,
 		}
 		else
 		{
-			iResult = __receivePacket((unsigned char *)&tResponse, sizeof(tResponse), &iTransfered, 500);
+			iResult = __receivePacket((unsigned char *)&tResponse, sizeof(tResponse), &iTransfered, 0, 1);
 			if( iResult!=0 )
 			{
 				fprintf(stderr, "%s: failed to receive packet: %d\n", m_pcPluginId, iResult);
@@ -897,25 +1062,25 @@ RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::cfg0Write(uint32_t ulAddress,
 
 
 
-RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::cfg1Write(uint32_t ulAddress, uint32_t ulData)
+RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::memWrite(uint32_t ulAddress, uint32_t ulData)
 {
 	PAPA_SCHLUMPF_RESULT_T tResult;
 	int iResult;
 	int iTransfered;
-	PAPA_SCHLUMPF_USB_COMMAND_DMA_CFG1_WRITE_T tCommand;
+	PAPA_SCHLUMPF_USB_COMMAND_DMA_MEM_WRITE_T tCommand;
 	PAPA_SCHLUMPF_USB_COMMAND_RESULT_STATUS_T tResponse;
 
 
-	if( m_ptDevHandlePapaSchlumpf==NULL )
+	if( m_ptTransport==NULL )
 	{
 		tResult = PAPA_SCHLUMPF_RESULT_NotConnected;
 	}
 	else
 	{
-		tCommand.ulCommand = PAPA_SCHLUMPF_USB_COMMAND_DMACfg1Write;
+		tCommand.ulCommand = PAPA_SCHLUMPF_USB_COMMAND_DMAMemWrite;
 		tCommand.ulDeviceAddress = ulAddress;
 		tCommand.ulData = ulData;
-		iResult = __send_packet((const unsigned char *)&tCommand, sizeof(tCommand), 100);
+		iResult = __send_packet((const unsigned char *)&tCommand, sizeof(tCommand));
 		if( iResult!=0 )
 		{
 			fprintf(stderr, "%s: failed to send packet: %d\n", m_pcPluginId, iResult);
@@ -923,7 +1088,7 @@ RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::cfg1Write(uint32_t ulAddress,
 		}
 		else
 		{
-			iResult = __receivePacket((unsigned char *)&tResponse, sizeof(tResponse), &iTransfered, 500);
+			iResult = __receivePacket((unsigned char *)&tResponse, sizeof(tResponse), &iTransfered, 0, 1);
 			if( iResult!=0 )
 			{
 				fprintf(stderr, "%s: failed to receive packet: %d\n", m_pcPluginId, iResult);
@@ -951,44 +1116,1636 @@ RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::cfg1Write(uint32_t ulAddress,
 
 
 
-RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::disconnect(void)
+RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::memWriteArea(uint32_t ulAddress, const char *pcBUFFER_IN, size_t sizBUFFER_IN)
 {
-	__disconnect();
-	return PAPA_SCHLUMPF_RESULT_Ok;
-}
+	PAPA_SCHLUMPF_RESULT_T tResult;
 
 
+	if( m_ptTransport==NULL )
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_NotConnected;
+	}
+	else if( sizBUFFER_IN==0 )
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_InvalidSize;
+	}
+	else
+	{
+		/* Stream the write command in chunks through the pipeline. */
+		tResult = __pipeline_write_area(ulAddress, sizBUFFER_IN, __produce_from_memory, (void*)pcBUFFER_IN);
+	}
 
-RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::plugin_connect(void)
-{
-	/* Increase the reference counter. */
-	++m_uiPluginConnections;
+	return tResult;
 }
 
 
 
-RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::plugin_disconnect(void)
+/* Write a part of a file to an area. The part starts at ulFileOffset in
+ * the file. A size of 0 writes everything from the offset to the end of the
+ * file. Each chunk is read from the file right before it is sent.
+ */
+RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::memWriteAreaFromFile(uint32_t ulAddress, const char *pcPath, uint32_t ulFileOffset, uint32_t ulSize)
 {
-	/* Are any references left? */
-	if( m_uiPluginConnections!=0 )
-	{
-		/* Decrement the reference counter. */
-		--m_uiPluginConnections;
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	int iResult;
+	PIPELINE_FILE_T tFile;
+	struct stat tStat;
 
-		/* Close the PapaSchlumpf connection if the reference reached 0. */
-		if( m_uiPluginConnections==0 )
+
+	if( m_ptTransport==NULL )
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_NotConnected;
+	}
+	else
+	{
+		tFile.iFd = open(pcPath, O_RDONLY);
+		if( tFile.iFd==-1 )
 		{
-			disconnect();
+			fprintf(stderr, "%s: failed to open the file %s: %s\n", m_pcPluginId, pcPath, strerror(errno));
+			tResult = PAPA_SCHLUMPF_RESULT_FileError;
+		}
+		else
+		{
+			iResult = fstat(tFile.iFd, &tStat);
+			if( iResult!=0 )
+			{
+				fprintf(stderr, "%s: failed to get the size of the file %s: %s\n", m_pcPluginId, pcPath, strerror(errno));
+				tResult = PAPA_SCHLUMPF_RESULT_FileError;
+			}
+			else if( (off_t)ulFileOffset>tStat.st_size )
+			{
+				fprintf(stderr, "%s: the offset 0x%08x is outside the file %s with %lld bytes.\n", m_pcPluginId, ulFileOffset, pcPath, (long long)tStat.st_size);
+				tResult = PAPA_SCHLUMPF_RESULT_InvalidSize;
+			}
+			else if( ulSize==0 && (tStat.st_size - (off_t)ulFileOffset)>(off_t)0xffffffffU )
+			{
+				fprintf(stderr, "%s: the rest of the file %s from offset 0x%08x has %lld bytes. This is too much for one area.\n", m_pcPluginId, pcPath, ulFileOffset, (long long)(tStat.st_size - (off_t)ulFileOffset));
+				tResult = PAPA_SCHLUMPF_RESULT_InvalidSize;
+			}
+			else
+			{
+				if( ulSize==0 )
+				{
+					ulSize = (uint32_t)(tStat.st_size - (off_t)ulFileOffset);
+				}
+
+				if( ulSize==0 || (off_t)ulFileOffset+(off_t)ulSize>tStat.st_size )
+				{
+					fprintf(stderr, "%s: the file %s has %lld bytes, but 0x%08x bytes from offset 0x%08x are requested.\n", m_pcPluginId, pcPath, (long long)tStat.st_size, ulSize, ulFileOffset);
+					tResult = PAPA_SCHLUMPF_RESULT_InvalidSize;
+				}
+				else
+				{
+					tFile.tFileOffset = (off_t)ulFileOffset;
+					tFile.pcPluginId = m_pcPluginId;
+					tResult = __pipeline_write_area(ulAddress, ulSize, __produce_from_file, &tFile);
+				}
+			}
+
+			close(tFile.iFd);
 		}
 	}
+
+	return tResult;
 }
 
 
 
-/* Look through all USB devices. If one Papa Schlumpf device was found, open it.
- * 0 or more than one Papa Schlumpf device results in an error.
- */
-PAPA_SCHLUMPF_RESULT_T PapaSchlumpfFlex::__scan_for_papa_schlumpf_hardware(void)
+RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::cfg0Write(uint32_t ulAddress, uint32_t ulData)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	int iResult;
+	int iTransfered;
+	PAPA_SCHLUMPF_USB_COMMAND_DMA_CFG0_WRITE_T tCommand;
+	PAPA_SCHLUMPF_USB_COMMAND_RESULT_STATUS_T tResponse;
+
+
+	if( m_ptTransport==NULL )
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_NotConnected;
+	}
+	else
+	{
+		tCommand.ulCommand = PAPA_SCHLUMPF_USB_COMMAND_DMACfg0Write;
+		tCommand.ulDeviceAddress = ulAddress;
+		tCommand.ulData = ulData;
+		iResult = __send_packet((const unsigned char *)&tCommand, sizeof(tCommand));
+		if( iResult!=0 )
+		{
+			fprintf(stderr, "%s: failed to send packet: %d\n", m_pcPluginId, iResult);
+			tResult = PAPA_SCHLUMPF_RESULT_USBError;
+		}
+		else
+		{
+			iResult = __receivePacket((unsigned char *)&tResponse, sizeof(tResponse), &iTransfered, 0, 1);
+			if( iResult!=0 )
+			{
+				fprintf(stderr, "%s: failed to receive packet: %d\n", m_pcPluginId, iResult);
+				tResult = PAPA_SCHLUMPF_RESULT_USBError;
+			}
+			else if( iTransfered!=sizeof(tResponse) )
+			{
+				fprintf(stderr, "%s: received an unexpected amount of data. wanted %zd bytes, but got %d.\n", m_pcPluginId, sizeof(tResponse), iTransfered);
+				tResult = PAPA_SCHLUMPF_RESULT_USBError;
+			}
+			else if( tResponse.ulStatus!=USB_COMMAND_STATUS_Ok )
+			{
+				fprintf(stderr, "%s: received an error: %d.\n", m_pcPluginId, tResponse.ulStatus);
+				tResult = PAPA_SCHLUMPF_RESULT_CommandFailed;
+			}
+			else
+			{
+				tResult = PAPA_SCHLUMPF_RESULT_Ok;
+			}
+		}
+	}
+
+	return tResult;
+}
+
+
+
+RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::cfg1Write(uint32_t ulAddress, uint32_t ulData)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	int iResult;
+	int iTransfered;
+	PAPA_SCHLUMPF_USB_COMMAND_DMA_CFG1_WRITE_T tCommand;
+	PAPA_SCHLUMPF_USB_COMMAND_RESULT_STATUS_T tResponse;
+
+
+	if( m_ptTransport==NULL )
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_NotConnected;
+	}
+	else
+	{
+		tCommand.ulCommand = PAPA_SCHLUMPF_USB_COMMAND_DMACfg1Write;
+		tCommand.ulDeviceAddress = ulAddress;
+		tCommand.ulData = ulData;
+		iResult = __send_packet((const unsigned char *)&tCommand, sizeof(tCommand));
+		if( iResult!=0 )
+		{
+			fprintf(stderr, "%s: failed to send packet: %d\n", m_pcPluginId, iResult);
+			tResult = PAPA_SCHLUMPF_RESULT_USBError;
+		}
+		else
+		{
+			iResult = __receivePacket((unsigned char *)&tResponse, sizeof(tResponse), &iTransfered, 0, 1);
+			if( iResult!=0 )
+			{
+				fprintf(stderr, "%s: failed to receive packet: %d\n", m_pcPluginId, iResult);
+				tResult = PAPA_SCHLUMPF_RESULT_USBError;
+			}
+			else if( iTransfered!=sizeof(tResponse) )
+			{
+				fprintf(stderr, "%s: received an unexpected amount of data. wanted %zd bytes, but got %d.\n", m_pcPluginId, sizeof(tResponse), iTransfered);
+				tResult = PAPA_SCHLUMPF_RESULT_USBError;
+			}
+			else if( tResponse.ulStatus!=USB_COMMAND_STATUS_Ok )
+			{
+				fprintf(stderr, "%s: received an error: %d.\n", m_pcPluginId, tResponse.ulStatus);
+				tResult = PAPA_SCHLUMPF_RESULT_CommandFailed;
+			}
+			else
+			{
+				tResult = PAPA_SCHLUMPF_RESULT_Ok;
+			}
+		}
+	}
+
+	return tResult;
+}
+
+
+
+/* Change only the bits in the mask with one USB round trip:
+ * new = (old & ~mask) | (data & mask). The old value is returned.
+ */
+RESULT_INT_NOTHING_OR_NIL_WITH_ERR PapaSchlumpfFlex::ioModify(uint32_t ulAddress, uint32_t ulMask, uint32_t ulData, PUL_ARGUMENT_OUT pulOldData)
+{
+	return __modify(PAPA_SCHLUMPF_USB_COMMAND_DMAIoModify, ulAddress, ulMask, ulData, pulOldData);
+}
+
+
+
+RESULT_INT_NOTHING_OR_NIL_WITH_ERR PapaSchlumpfFlex::memModify(uint32_t ulAddress, uint32_t ulMask, uint32_t ulData, PUL_ARGUMENT_OUT pulOldData)
+{
+	return __modify(PAPA_SCHLUMPF_USB_COMMAND_DMAMemModify, ulAddress, ulMask, ulData, pulOldData);
+}
+
+
+
+PAPA_SCHLUMPF_RESULT_T PapaSchlumpfFlex::__cfg_read_area(uint32_t ulCommand, uint32_t ulAddress, uint32_t ulSize, char **ppcBUFFER_OUT, size_t *psizBUFFER_OUT)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	int iResult;
+	int iTransfered;
+	int sizExpected;
+	char *pcData;
+	PAPA_SCHLUMPF_USB_COMMAND_DMA_CFG_READ_AREA_T tCommand;
+	union
+	{
+		PAPA_SCHLUMPF_USB_COMMAND_RESULT_DMA_CFG_READ_AREA_T tCfgReadArea;
+		unsigned char auc[sizeof(PAPA_SCHLUMPF_USB_COMMAND_RESULT_DMA_CFG_READ_AREA_T) + 4];
+	} uResponse;
+
+
+	if( m_ptTransport==NULL )
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_NotConnected;
+	}
+	/* The range must be in the header of the function. */
+	else if( ulSize==0 || (ulSize&3U)!=0 || ulSize>sizeof(uResponse.tCfgReadArea.aulData)-(ulAddress&0xfcU) )
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_InvalidSize;
+	}
+	else
+	{
+		tCommand.ulCommand = ulCommand;
+		tCommand.ulDeviceAddress = ulAddress;
+		tCommand.ulSize = ulSize;
+		iResult = __send_packet((const unsigned char *)&tCommand, sizeof(tCommand));
+		if( iResult!=0 )
+		{
+			fprintf(stderr, "%s: failed to send packet: %d\n", m_pcPluginId, iResult);
+			tResult = PAPA_SCHLUMPF_RESULT_USBError;
+		}
+		else
+		{
+			sizExpected = (int)(sizeof(uint32_t) + ulSize);
+			iResult = __receivePacket(uResponse.auc, sizeof(uResponse), &iTransfered, 0, 1);
+			if( iResult!=0 )
+			{
+				fprintf(stderr, "%s: failed to receive packet: %d\n", m_pcPluginId, iResult);
+				tResult = PAPA_SCHLUMPF_RESULT_USBError;
+			}
+			else if( iTransfered<(int)sizeof(uint32_t) )
+			{
+				fprintf(stderr, "%s: received an unexpected amount of data. wanted at least %zd bytes, but got %d.\n", m_pcPluginId, sizeof(uint32_t), iTransfered);
+				tResult = PAPA_SCHLUMPF_RESULT_USBError;
+			}
+			else if( uResponse.tCfgReadArea.ulStatus!=USB_COMMAND_STATUS_Ok )
+			{
+				fprintf(stderr, "%s: received an error: %d.\n", m_pcPluginId, uResponse.tCfgReadArea.ulStatus);
+				tResult = PAPA_SCHLUMPF_RESULT_CommandFailed;
+			}
+			else if( iTransfered!=sizExpected )
+			{
+				fprintf(stderr, "%s: received an unexpected amount of data. wanted %d bytes, but got %d.\n", m_pcPluginId, sizExpected, iTransfered);
+				tResult = PAPA_SCHLUMPF_RESULT_USBError;
+			}
+			else
+			{
+				pcData = (char*)malloc(ulSize);
+				if( pcData==NULL )
+				{
+					tResult = PAPA_SCHLUMPF_RESULT_OutOfMemory;
+				}
+				else
+				{
+					memcpy(pcData, uResponse.tCfgReadArea.aulData, ulSize);
+					*ppcBUFFER_OUT = pcData;
+					*psizBUFFER_OUT = ulSize;
+					tResult = PAPA_SCHLUMPF_RESULT_Ok;
+				}
+			}
+		}
+	}
+
+	return tResult;
+}
+
+
+
+PAPA_SCHLUMPF_RESULT_T PapaSchlumpfFlex::__modify(uint32_t ulCommand, uint32_t ulAddress, uint32_t ulMask, uint32_t ulData, unsigned long *pulOldData)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	int iResult;
+	int iTransfered;
+	PAPA_SCHLUMPF_USB_COMMAND_DMA_MODIFY_T tCommand;
+	PAPA_SCHLUMPF_USB_COMMAND_RESULT_DMA_MODIFY_T tResponse;
+
+
+	if( m_ptTransport==NULL )
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_NotConnected;
+	}
+	else
+	{
+		tCommand.ulCommand = ulCommand;
+		tCommand.ulDeviceAddress = ulAddress;
+		tCommand.ulMask = ulMask;
+		tCommand.ulData = ulData;
+		iResult = __send_packet((const unsigned char *)&tCommand, sizeof(tCommand));
+		if( iResult!=0 )
+		{
+			fprintf(stderr, "%s: failed to send packet: %d\n", m_pcPluginId, iResult);
+			tResult = PAPA_SCHLUMPF_RESULT_USBError;
+		}
+		else
+		{
+			iResult = __receivePacket((unsigned char *)&tResponse, sizeof(tResponse), &iTransfered, 0, 2);
+			if( iResult!=0 )
+			{
+				fprintf(stderr, "%s: failed to receive packet: %d\n", m_pcPluginId, iResult);
+				tResult = PAPA_SCHLUMPF_RESULT_USBError;
+			}
+			else if( iTransfered!=sizeof(tResponse) )
+			{
+				fprintf(stderr, "%s: received an unexpected amount of data. wanted %zd bytes, but got %d.\n", m_pcPluginId, sizeof(tResponse), iTransfered);
+				tResult = PAPA_SCHLUMPF_RESULT_USBError;
+			}
+			else if( tResponse.ulStatus!=USB_COMMAND_STATUS_Ok )
+			{
+				fprintf(stderr, "%s: received an error: %d.\n", m_pcPluginId, tResponse.ulStatus);
+				tResult = PAPA_SCHLUMPF_RESULT_CommandFailed;
+			}
+			else
+			{
+				*pulOldData = tResponse.ulData;
+				tResult = PAPA_SCHLUMPF_RESULT_Ok;
+			}
+		}
+	}
+
+	return tResult;
+}
+
+
+
+/* Repeat a pattern over an area. The pattern has 4 to 64 bytes in steps of
+ * 4. Only the pattern goes over USB, the firmware writes the area.
+ */
+RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::memFill(uint32_t ulAddress, uint32_t ulSize, const char *pcBUFFER_IN, size_t sizBUFFER_IN)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	int iResult;
+	int iTransfered;
+	PAPA_SCHLUMPF_USB_COMMAND_MEM_FILL_T tCommand;
+	PAPA_SCHLUMPF_USB_COMMAND_RESULT_STATUS_T tResponse;
+	size_t sizCommand;
+
+
+	if( m_ptTransport==NULL )
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_NotConnected;
+	}
+	else if( (ulSize&3U)!=0 || sizBUFFER_IN==0 || (sizBUFFER_IN&3U)!=0 || sizBUFFER_IN>sizeof(tCommand.aulPattern) )
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_InvalidSize;
+	}
+	else
+	{
+		tCommand.ulCommand = PAPA_SCHLUMPF_USB_COMMAND_MemFill;
+		tCommand.ulDeviceAddress = ulAddress;
+		tCommand.ulSize = ulSize;
+		tCommand.ulPatternDwords = (uint32_t)(sizBUFFER_IN / sizeof(uint32_t));
+		memcpy(tCommand.aulPattern, pcBUFFER_IN, sizBUFFER_IN);
+		sizCommand = sizeof(tCommand) - sizeof(tCommand.aulPattern) + sizBUFFER_IN;
+		iResult = __send_packet((const unsigned char *)&tCommand, (int)sizCommand);
+		if( iResult!=0 )
+		{
+			fprintf(stderr, "%s: failed to send packet: %d\n", m_pcPluginId, iResult);
+			tResult = PAPA_SCHLUMPF_RESULT_USBError;
+		}
+		else
+		{
+			iResult = __receivePacket((unsigned char *)&tResponse, sizeof(tResponse), &iTransfered, (ulSize / PAPA_SCHLUMPF_FILL_MINIMUM_BYTES_PER_MS) + 1U, 1);
+			if( iResult!=0 )
+			{
+				fprintf(stderr, "%s: failed to receive packet: %d\n", m_pcPluginId, iResult);
+				tResult = PAPA_SCHLUMPF_RESULT_USBError;
+			}
+			else if( iTransfered!=sizeof(tResponse) )
+			{
+				fprintf(stderr, "%s: received an unexpected amount of data. wanted %zd bytes, but got %d.\n", m_pcPluginId, sizeof(tResponse), iTransfered);
+				tResult = PAPA_SCHLUMPF_RESULT_USBError;
+			}
+			else if( tResponse.ulStatus!=USB_COMMAND_STATUS_Ok )
+			{
+				fprintf(stderr, "%s: received an error: %d.\n", m_pcPluginId, tResponse.ulStatus);
+				tResult = PAPA_SCHLUMPF_RESULT_CommandFailed;
+			}
+			else
+			{
+				tResult = PAPA_SCHLUMPF_RESULT_Ok;
+			}
+		}
+	}
+
+	return tResult;
+}
+
+
+
+/* Copy an area in the PCI memory space. The data does not go over USB. */
+RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::memCopy(uint32_t ulDestinationAddress, uint32_t ulSourceAddress, uint32_t ulSize)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	int iResult;
+	int iTransfered;
+	PAPA_SCHLUMPF_USB_COMMAND_MEM_COPY_T tCommand;
+	PAPA_SCHLUMPF_USB_COMMAND_RESULT_STATUS_T tResponse;
+
+
+	if( m_ptTransport==NULL )
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_NotConnected;
+	}
+	else if( (ulSize&3U)!=0 )
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_InvalidSize;
+	}
+	else
+	{
+		tCommand.ulCommand = PAPA_SCHLUMPF_USB_COMMAND_MemCopy;
+		tCommand.ulDestinationAddress = ulDestinationAddress;
+		tCommand.ulSourceAddress = ulSourceAddress;
+		tCommand.ulSize = ulSize;
+		iResult = __send_packet((const unsigned char *)&tCommand, sizeof(tCommand));
+		if( iResult!=0 )
+		{
+			fprintf(stderr, "%s: failed to send packet: %d\n", m_pcPluginId, iResult);
+			tResult = PAPA_SCHLUMPF_RESULT_USBError;
+		}
+		else
+		{
+			iResult = __receivePacket((unsigned char *)&tResponse, sizeof(tResponse), &iTransfered, (ulSize / PAPA_SCHLUMPF_COPY_MINIMUM_BYTES_PER_MS) + 1U, 1);
+			if( iResult!=0 )
+			{
+				fprintf(stderr, "%s: failed to receive packet: %d\n", m_pcPluginId, iResult);
+				tResult = PAPA_SCHLUMPF_RESULT_USBError;
+			}
+			else if( iTransfered!=sizeof(tResponse) )
+			{
+				fprintf(stderr, "%s: received an unexpected amount of data. wanted %zd bytes, but got %d.\n", m_pcPluginId, sizeof(tResponse), iTransfered);
+				tResult = PAPA_SCHLUMPF_RESULT_USBError;
+			}
+			else if( tResponse.ulStatus!=USB_COMMAND_STATUS_Ok )
+			{
+				fprintf(stderr, "%s: received an error: %d.\n", m_pcPluginId, tResponse.ulStatus);
+				tResult = PAPA_SCHLUMPF_RESULT_CommandFailed;
+			}
+			else
+			{
+				tResult = PAPA_SCHLUMPF_RESULT_Ok;
+			}
+		}
+	}
+
+	return tResult;
+}
+
+
+
+/* Read several areas with as few commands as possible.
+ * The input is an array of PAPA_SCHLUMPF_SCATTER_DESCRIPTOR_T elements. The
+ * result has the data of all areas without gaps.
+ */
+RESULT_INT_NOTHING_OR_NIL_WITH_ERR PapaSchlumpfFlex::memReadScatter(const char *pcBUFFER_IN, size_t sizBUFFER_IN, char **ppcBUFFER_OUT, size_t *psizBUFFER_OUT)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	const PAPA_SCHLUMPF_SCATTER_DESCRIPTOR_T *ptDescriptors;
+	size_t sizDescriptors;
+	size_t sizCnt;
+	size_t sizData;
+	unsigned char *pucData;
+
+
+	if( m_ptTransport==NULL )
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_NotConnected;
+	}
+	else if( sizBUFFER_IN==0 || (sizBUFFER_IN%sizeof(PAPA_SCHLUMPF_SCATTER_DESCRIPTOR_T))!=0 )
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_InvalidSize;
+	}
+	else
+	{
+		ptDescriptors = (const PAPA_SCHLUMPF_SCATTER_DESCRIPTOR_T*)pcBUFFER_IN;
+		sizDescriptors = sizBUFFER_IN / sizeof(PAPA_SCHLUMPF_SCATTER_DESCRIPTOR_T);
+
+		sizData = 0;
+		for(sizCnt=0; sizCnt<sizDescriptors; ++sizCnt)
+		{
+			sizData += (size_t)ptDescriptors[sizCnt].ulDwords * sizeof(uint32_t);
+		}
+
+		/* Allocate at least one byte for areas with a size of 0. */
+		pucData = (unsigned char*)malloc(sizData + 1U);
+		if( pucData==NULL )
+		{
+			tResult = PAPA_SCHLUMPF_RESULT_OutOfMemory;
+		}
+		else
+		{
+			tResult = __scatter(PAPA_SCHLUMPF_USB_COMMAND_MemReadScatter, ptDescriptors, sizDescriptors, pucData);
+			if( tResult==PAPA_SCHLUMPF_RESULT_Ok )
+			{
+				*ppcBUFFER_OUT = (char*)pucData;
+				*psizBUFFER_OUT = sizData;
+			}
+			else
+			{
+				free(pucData);
+			}
+		}
+	}
+
+	return tResult;
+}
+
+
+
+/* Write several areas with as few commands as possible.
+ * The input is a list of records. Each record is a
+ * PAPA_SCHLUMPF_SCATTER_DESCRIPTOR_T followed by the data of the area.
+ * The areas are written in the order of the list.
+ */
+RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::memWriteScatter(const char *pcBUFFER_IN, size_t sizBUFFER_IN)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	PAPA_SCHLUMPF_SCATTER_DESCRIPTOR_T *ptDescriptors;
+	size_t sizDescriptors;
+	size_t sizCnt;
+	size_t sizOffset;
+	size_t sizRecord;
+	size_t sizData;
+	unsigned char *pucData;
+	PAPA_SCHLUMPF_SCATTER_DESCRIPTOR_T tDescriptor;
+
+
+	if( m_ptTransport==NULL )
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_NotConnected;
+	}
+	else
+	{
+		/* Count the records and check their sizes. */
+		tResult = PAPA_SCHLUMPF_RESULT_Ok;
+		sizDescriptors = 0;
+		sizData = 0;
+		sizOffset = 0;
+		while( sizOffset<sizBUFFER_IN )
+		{
+			if( sizBUFFER_IN-sizOffset<sizeof(PAPA_SCHLUMPF_SCATTER_DESCRIPTOR_T) )
+			{
+				tResult = PAPA_SCHLUMPF_RESULT_InvalidSize;
+				break;
+			}
+			memcpy(&tDescriptor, pcBUFFER_IN + sizOffset, sizeof(PAPA_SCHLUMPF_SCATTER_DESCRIPTOR_T));
+			sizOffset += sizeof(PAPA_SCHLUMPF_SCATTER_DESCRIPTOR_T);
+
+			sizRecord = (size_t)tDescriptor.ulDwords * sizeof(uint32_t);
+			if( sizRecord>sizBUFFER_IN-sizOffset )
+			{
+				tResult = PAPA_SCHLUMPF_RESULT_InvalidSize;
+				break;
+			}
+			sizOffset += sizRecord;
+			sizData += sizRecord;
+			++sizDescriptors;
+		}
+		if( tResult==PAPA_SCHLUMPF_RESULT_Ok && sizDescriptors==0 )
+		{
+			tResult = PAPA_SCHLUMPF_RESULT_InvalidSize;
+		}
+
+		if( tResult==PAPA_SCHLUMPF_RESULT_Ok )
+		{
+			/* Separate the descriptors and the data. */
+			ptDescriptors = (PAPA_SCHLUMPF_SCATTER_DESCRIPTOR_T*)malloc(sizDescriptors * sizeof(PAPA_SCHLUMPF_SCATTER_DESCRIPTOR_T));
+			pucData = (unsigned char*)malloc(sizData + 1U);
+			if( ptDescriptors==NULL || pucData==NULL )
+			{
+				tResult = PAPA_SCHLUMPF_RESULT_OutOfMemory;
+			}
+			else
+			{
+				sizOffset = 0;
+				sizData = 0;
+				for(sizCnt=0; sizCnt<sizDescriptors; ++sizCnt)
+				{
+					memcpy(ptDescriptors + sizCnt, pcBUFFER_IN + sizOffset, sizeof(PAPA_SCHLUMPF_SCATTER_DESCRIPTOR_T));
+					sizOffset += sizeof(PAPA_SCHLUMPF_SCATTER_DESCRIPTOR_T);
+
+					sizRecord = (size_t)ptDescriptors[sizCnt].ulDwords * sizeof(uint32_t);
+					memcpy(pucData + sizData, pcBUFFER_IN + sizOffset, sizRecord);
+					sizOffset += sizRecord;
+					sizData += sizRecord;
+				}
+
+				tResult = __scatter(PAPA_SCHLUMPF_USB_COMMAND_MemWriteScatter, ptDescriptors, sizDescriptors, pucData);
+			}
+
+			if( ptDescriptors!=NULL )
+			{
+				free(ptDescriptors);
+			}
+			if( pucData!=NULL )
+			{
+				free(pucData);
+			}
+		}
+	}
+
+	return tResult;
+}
+
+
+
+/* Get the CRC32 of an area from the firmware. Compare it with the result of
+ * checksum to verify the area without reading it back.
+ */
+RESULT_INT_NOTHING_OR_NIL_WITH_ERR PapaSchlumpfFlex::memChecksum(uint32_t ulAddress, uint32_t ulSize, PUL_ARGUMENT_OUT pulChecksum)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	int iResult;
+	int iTransfered;
+	PAPA_SCHLUMPF_USB_COMMAND_MEM_CHECKSUM_T tCommand;
+	PAPA_SCHLUMPF_USB_COMMAND_RESULT_MEM_CHECKSUM_T tResponse;
+
+
+	if( m_ptTransport==NULL )
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_NotConnected;
+	}
+	else if( (ulSize&3U)!=0 )
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_InvalidSize;
+	}
+	else
+	{
+		tCommand.ulCommand = PAPA_SCHLUMPF_USB_COMMAND_MemChecksum;
+		tCommand.ulDeviceAddress = ulAddress;
+		tCommand.ulSize = ulSize;
+		iResult = __send_packet((const unsigned char *)&tCommand, sizeof(tCommand));
+		if( iResult!=0 )
+		{
+			fprintf(stderr, "%s: failed to send packet: %d\n", m_pcPluginId, iResult);
+			tResult = PAPA_SCHLUMPF_RESULT_USBError;
+		}
+		else
+		{
+			iResult = __receivePacket((unsigned char *)&tResponse, sizeof(tResponse), &iTransfered, (ulSize / PAPA_SCHLUMPF_CHECKSUM_MINIMUM_BYTES_PER_MS) + 1U, 1);
+			if( iResult!=0 )
+			{
+				fprintf(stderr, "%s: failed to receive packet: %d\n", m_pcPluginId, iResult);
+				tResult = PAPA_SCHLUMPF_RESULT_USBError;
+			}
+			else if( iTransfered!=sizeof(tResponse) )
+			{
+				fprintf(stderr, "%s: received an unexpected amount of data. wanted %zd bytes, but got %d.\n", m_pcPluginId, sizeof(tResponse), iTransfered);
+				tResult = PAPA_SCHLUMPF_RESULT_USBError;
+			}
+			else if( tResponse.ulStatus!=USB_COMMAND_STATUS_Ok )
+			{
+				fprintf(stderr, "%s: received an error: %d.\n", m_pcPluginId, tResponse.ulStatus);
+				tResult = PAPA_SCHLUMPF_RESULT_CommandFailed;
+			}
+			else
+			{
+				*pulChecksum = tResponse.ulChecksum;
+				tResult = PAPA_SCHLUMPF_RESULT_Ok;
+			}
+		}
+	}
+
+	return tResult;
+}
+
+
+
+/* Build the CRC32 of memChecksum on the host. */
+void PapaSchlumpfFlex::checksum(const char *pcBUFFER_IN, size_t sizBUFFER_IN, PUL_ARGUMENT_OUT pulChecksum)
+{
+	*pulChecksum = papa_schlumpf_crc32(0, (const unsigned char*)pcBUFFER_IN, sizBUFFER_IN);
+}
+
+
+
+/* Let the firmware read an address until (value & mask) == expected or the
+ * timeout expires. The type is a DMATYPE value. A timeout is no error:
+ * pulMatched is 0 then and pulData has the last value.
+ */
+RESULT_INT_NOTHING_OR_NIL_WITH_ERR PapaSchlumpfFlex::pollMem(uint32_t ulType, uint32_t ulAddress, uint32_t ulMask, uint32_t ulExpected, uint32_t ulTimeoutUs, PUL_ARGUMENT_OUT pulMatched, PUL_ARGUMENT_OUT pulData, PUL_ARGUMENT_OUT pulIterations, PUL_ARGUMENT_OUT pulElapsedUs)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	int iResult;
+	int iTransfered;
+	PAPA_SCHLUMPF_USB_COMMAND_POLL_MEM_T tCommand;
+	PAPA_SCHLUMPF_USB_COMMAND_RESULT_POLL_MEM_T tResponse;
+
+
+	if( m_ptTransport==NULL )
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_NotConnected;
+	}
+	else if( ulTimeoutUs>PAPA_SCHLUMPF_POLL_MAXIMUM_TIMEOUT_US )
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_InvalidSize;
+	}
+	else
+	{
+		tCommand.ulCommand = PAPA_SCHLUMPF_USB_COMMAND_PollMem;
+		tCommand.ulType = ulType;
+		tCommand.ulDeviceAddress = ulAddress;
+		tCommand.ulMask = ulMask;
+		tCommand.ulExpected = ulExpected;
+		tCommand.ulTimeoutUs = ulTimeoutUs;
+		iResult = __send_packet((const unsigned char *)&tCommand, sizeof(tCommand));
+		if( iResult!=0 )
+		{
+			fprintf(stderr, "%s: failed to send packet: %d\n", m_pcPluginId, iResult);
+			tResult = PAPA_SCHLUMPF_RESULT_USBError;
+		}
+		else
+		{
+			/* The firmware answers after the timeout at the latest. */
+			iResult = __receivePacket((unsigned char *)&tResponse, sizeof(tResponse), &iTransfered, (ulTimeoutUs + 999U) / 1000U, 1);
+			if( iResult!=0 )
+			{
+				fprintf(stderr, "%s: failed to receive packet: %d\n", m_pcPluginId, iResult);
+				tResult = PAPA_SCHLUMPF_RESULT_USBError;
+			}
+			else if( iTransfered!=sizeof(tResponse) )
+			{
+				fprintf(stderr, "%s: received an unexpected amount of data. wanted %zd bytes, but got %d.\n", m_pcPluginId, sizeof(tResponse), iTransfered);
+				tResult = PAPA_SCHLUMPF_RESULT_USBError;
+			}
+			else if( tResponse.ulStatus!=USB_COMMAND_STATUS_Ok )
+			{
+				fprintf(stderr, "%s: received an error: %d.\n", m_pcPluginId, tResponse.ulStatus);
+				tResult = PAPA_SCHLUMPF_RESULT_CommandFailed;
+			}
+			else
+			{
+				*pulMatched = tResponse.ulMatched;
+				*pulData = tResponse.ulData;
+				*pulIterations = tResponse.ulIterations;
+				*pulElapsedUs = tResponse.ulElapsedUs;
+				tResult = PAPA_SCHLUMPF_RESULT_Ok;
+			}
+		}
+	}
+
+	return tResult;
+}
+
+
+
+/* Scan all buses in the firmware. The result is an array of
+ * PAPA_SCHLUMPF_ENUMERATE_FUNCTION_T elements. pulTruncated is 1 if the
+ * firmware found more functions than fit into the response.
+ */
+RESULT_INT_NOTHING_OR_NIL_WITH_ERR PapaSchlumpfFlex::enumerateBus(uint32_t ulFlags, PUL_ARGUMENT_OUT pulTruncated, char **ppcBUFFER_OUT, size_t *psizBUFFER_OUT)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	int iResult;
+	int iTransfered;
+	int sizHeader;
+	int sizExpected;
+	size_t sizFunctions;
+	char *pcFunctions;
+	PAPA_SCHLUMPF_USB_COMMAND_ENUMERATE_BUS_T tCommand;
+	union
+	{
+		PAPA_SCHLUMPF_USB_COMMAND_RESULT_ENUMERATE_BUS_T tEnumerate;
+		unsigned char auc[sizeof(PAPA_SCHLUMPF_USB_COMMAND_RESULT_ENUMERATE_BUS_T) + 4];
+	} uResponse;
+
+
+	if( m_ptTransport==NULL )
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_NotConnected;
+	}
+	else
+	{
+		tCommand.ulCommand = PAPA_SCHLUMPF_USB_COMMAND_EnumerateBus;
+		tCommand.ulFlags = ulFlags;
+		iResult = __send_packet((const unsigned char *)&tCommand, sizeof(tCommand));
+		if( iResult!=0 )
+		{
+			fprintf(stderr, "%s: failed to send packet: %d\n", m_pcPluginId, iResult);
+			tResult = PAPA_SCHLUMPF_RESULT_USBError;
+		}
+		else
+		{
+			sizHeader = (int)(sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint32_t));
+			iResult = __receivePacket(uResponse.auc, sizeof(uResponse), &iTransfered, PAPA_SCHLUMPF_ENUMERATE_TIMEOUT_MS, 0);
+			if( iResult!=0 )
+			{
+				fprintf(stderr, "%s: failed to receive packet: %d\n", m_pcPluginId, iResult);
+				tResult = PAPA_SCHLUMPF_RESULT_USBError;
+			}
+			else if( iTransfered<(int)sizeof(uint32_t) )
+			{
+				fprintf(stderr, "%s: received an unexpected amount of data. wanted at least %zd bytes, but got %d.\n", m_pcPluginId, sizeof(uint32_t), iTransfered);
+				tResult = PAPA_SCHLUMPF_RESULT_USBError;
+			}
+			else if( uResponse.tEnumerate.ulStatus!=USB_COMMAND_STATUS_Ok )
+			{
+				fprintf(stderr, "%s: received an error: %d.\n", m_pcPluginId, uResponse.tEnumerate.ulStatus);
+				tResult = PAPA_SCHLUMPF_RESULT_CommandFailed;
+			}
+			else if( iTransfered<sizHeader || uResponse.tEnumerate.ulFunctions>PAPA_SCHLUMPF_ENUMERATE_MAXIMUM_FUNCTIONS )
+			{
+				fprintf(stderr, "%s: received an invalid response with %d bytes.\n", m_pcPluginId, iTransfered);
+				tResult = PAPA_SCHLUMPF_RESULT_USBError;
+			}
+			else
+			{
+				sizFunctions = uResponse.tEnumerate.ulFunctions * sizeof(PAPA_SCHLUMPF_ENUMERATE_FUNCTION_T);
+				sizExpected = sizHeader + (int)sizFunctions;
+				if( iTransfered!=sizExpected )
+				{
+					fprintf(stderr, "%s: received an unexpected amount of data. wanted %d bytes, but got %d.\n", m_pcPluginId, sizExpected, iTransfered);
+					tResult = PAPA_SCHLUMPF_RESULT_USBError;
+				}
+				else
+				{
+					/* Allocate at least one byte for an empty bus. */
+					pcFunctions = (char*)malloc(sizFunctions + 1U);
+					if( pcFunctions==NULL )
+					{
+						tResult = PAPA_SCHLUMPF_RESULT_OutOfMemory;
+					}
+					else
+					{
+						memcpy(pcFunctions, uResponse.tEnumerate.atFunctions, sizFunctions);
+						*pulTruncated = uResponse.tEnumerate.ulTruncated;
+						*ppcBUFFER_OUT = pcFunctions;
+						*psizBUFFER_OUT = sizFunctions;
+						tResult = PAPA_SCHLUMPF_RESULT_Ok;
+					}
+				}
+			}
+		}
+	}
+
+	return tResult;
+}
+
+
+
+/* Run a list of sub-commands with as few USB round trips as possible.
+ * The input is an array of PAPA_SCHLUMPF_BATCH_ENTRY_T elements. The output
+ * is an array of PAPA_SCHLUMPF_BATCH_RESULT_T elements with one result for
+ * each processed entry. The firmware stops at the first failed entry, so the
+ * output can be shorter than the input. Check the status of the last result.
+ */
+RESULT_INT_NOTHING_OR_NIL_WITH_ERR PapaSchlumpfFlex::executeBatch(const char *pcBUFFER_IN, size_t sizBUFFER_IN, char **ppcBUFFER_OUT, size_t *psizBUFFER_OUT)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	const PAPA_SCHLUMPF_BATCH_ENTRY_T *ptEntries;
+	PAPA_SCHLUMPF_BATCH_RESULT_T *ptResults;
+	size_t sizEntries;
+	size_t sizOffset;
+	uint32_t ulChunk;
+	uint32_t ulProcessed;
+
+
+	if( m_ptTransport==NULL )
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_NotConnected;
+	}
+	else if( sizBUFFER_IN==0 || (sizBUFFER_IN%sizeof(PAPA_SCHLUMPF_BATCH_ENTRY_T))!=0 )
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_InvalidSize;
+	}
+	else
+	{
+		sizEntries = sizBUFFER_IN / sizeof(PAPA_SCHLUMPF_BATCH_ENTRY_T);
+
+		ptResults = (PAPA_SCHLUMPF_BATCH_RESULT_T*)malloc(sizEntries * sizeof(PAPA_SCHLUMPF_BATCH_RESULT_T));
+		if( ptResults==NULL )
+		{
+			tResult = PAPA_SCHLUMPF_RESULT_OutOfMemory;
+		}
+		else
+		{
+			ptEntries = (const PAPA_SCHLUMPF_BATCH_ENTRY_T*)pcBUFFER_IN;
+
+			/* Split the list in packets. Stop at the first failed entry. */
+			tResult = PAPA_SCHLUMPF_RESULT_Ok;
+			sizOffset = 0;
+			while( sizOffset<sizEntries )
+			{
+				ulChunk = PAPA_SCHLUMPF_BATCH_MAXIMUM_ENTRIES;
+				if( ulChunk>sizEntries-sizOffset )
+				{
+					ulChunk = (uint32_t)(sizEntries - sizOffset);
+				}
+
+				tResult = __execute_batch_packet(ptEntries + sizOffset, ulChunk, ptResults + sizOffset, &ulProcessed);
+				if( tResult!=PAPA_SCHLUMPF_RESULT_Ok )
+				{
+					break;
+				}
+
+				sizOffset += ulProcessed;
+				if( ulProcessed!=ulChunk || ptResults[sizOffset-1].ulStatus!=USB_COMMAND_STATUS_Ok )
+				{
+					break;
+				}
+			}
+
+			if( tResult==PAPA_SCHLUMPF_RESULT_Ok )
+			{
+				*ppcBUFFER_OUT = (char*)ptResults;
+				*psizBUFFER_OUT = sizOffset * sizeof(PAPA_SCHLUMPF_BATCH_RESULT_T);
+			}
+			else
+			{
+				free(ptResults);
+			}
+		}
+	}
+
+	return tResult;
+}
+
+
+
+/* Store a DMA list program in the firmware.
+ * The input is an array of PAPA_SCHLUMPF_DMALIST_ENTRY_T elements. Use the
+ * returned ID and hash with dmaListRun.
+ */
+RESULT_INT_NOTHING_OR_NIL_WITH_ERR PapaSchlumpfFlex::dmaListUpload(const char *pcBUFFER_IN, size_t sizBUFFER_IN, PUL_ARGUMENT_OUT pulProgramId, PUL_ARGUMENT_OUT pulProgramHash)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	int iResult;
+	int iTransfered;
+	size_t sizEntries;
+	int sizCommand;
+	PAPA_SCHLUMPF_USB_COMMAND_DMALIST_UPLOAD_T tCommand;
+	PAPA_SCHLUMPF_USB_COMMAND_RESULT_DMALIST_UPLOAD_T tResponse;
+
+
+	sizEntries = sizBUFFER_IN / sizeof(PAPA_SCHLUMPF_DMALIST_ENTRY_T);
+	if( m_ptTransport==NULL )
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_NotConnected;
+	}
+	else if( sizEntries==0 || sizEntries>PAPA_SCHLUMPF_DMALIST_MAXIMUM_ENTRIES || (sizBUFFER_IN%sizeof(PAPA_SCHLUMPF_DMALIST_ENTRY_T))!=0 )
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_InvalidSize;
+	}
+	else
+	{
+		tCommand.ulCommand = PAPA_SCHLUMPF_USB_COMMAND_DmaListUpload;
+		tCommand.ulEntries = (uint32_t)sizEntries;
+		memcpy(tCommand.atEntries, pcBUFFER_IN, sizBUFFER_IN);
+		sizCommand = sizeof(uint32_t) + sizeof(uint32_t) + sizBUFFER_IN;
+
+		iResult = __send_packet((const unsigned char *)&tCommand, sizCommand);
+		if( iResult!=0 )
+		{
+			fprintf(stderr, "%s: failed to send packet: %d\n", m_pcPluginId, iResult);
+			tResult = PAPA_SCHLUMPF_RESULT_USBError;
+		}
+		else
+		{
+			iResult = __receivePacket((unsigned char *)&tResponse, sizeof(tResponse), &iTransfered, 0, 0);
+			if( iResult!=0 )
+			{
+				fprintf(stderr, "%s: failed to receive packet: %d\n", m_pcPluginId, iResult);
+				tResult = PAPA_SCHLUMPF_RESULT_USBError;
+			}
+			else if( iTransfered!=sizeof(tResponse) )
+			{
+				fprintf(stderr, "%s: received an unexpected amount of data. wanted %zd bytes, but got %d.\n", m_pcPluginId, sizeof(tResponse), iTransfered);
+				tResult = PAPA_SCHLUMPF_RESULT_USBError;
+			}
+			else if( tResponse.ulStatus!=USB_COMMAND_STATUS_Ok )
+			{
+				fprintf(stderr, "%s: received an error: %d.\n", m_pcPluginId, tResponse.ulStatus);
+				tResult = PAPA_SCHLUMPF_RESULT_CommandFailed;
+			}
+			else
+			{
+				*pulProgramId = tResponse.ulProgramId;
+				*pulProgramHash = tResponse.ulProgramHash;
+				tResult = PAPA_SCHLUMPF_RESULT_Ok;
+			}
+		}
+	}
+
+	return tResult;
+}
+
+
+
+/* Run a DMA list program which was stored with dmaListUpload.
+ * This returns the failure code (see PAPA_SCHLUMPF_DMALIST_FAILURE_T), the
+ * index of the failed entry, the received value of a failed compare and all
+ * dumped values as an array of 32 bit values.
+ * It returns PAPA_SCHLUMPF_RESULT_UnknownProgram if the firmware does not
+ * know the program. Upload it again in this case. An error has the result
+ * code after the message, so this case can be detected.
+ */
+RESULT_INT_NOTHING_OR_NIL_WITH_ERR_AND_CODE PapaSchlumpfFlex::dmaListRun(uint32_t ulProgramId, uint32_t ulProgramHash, PUL_ARGUMENT_OUT pulFailure, PUL_ARGUMENT_OUT pulFailedIndex, PUL_ARGUMENT_OUT pulFailedValue, char **ppcBUFFER_OUT, size_t *psizBUFFER_OUT)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	int iResult;
+	int iTransfered;
+	int sizHeader;
+	size_t sizDump;
+	char *pcDump;
+	PAPA_SCHLUMPF_USB_COMMAND_DMALIST_RUN_T tCommand;
+	union
+	{
+		PAPA_SCHLUMPF_USB_COMMAND_RESULT_DMALIST_RUN_T tRun;
+		unsigned char auc[sizeof(PAPA_SCHLUMPF_USB_COMMAND_RESULT_DMALIST_RUN_T) + 4];
+	} uResponse;
+
+
+	sizHeader = sizeof(uResponse.tRun) - sizeof(uResponse.tRun.aulDump);
+	if( m_ptTransport==NULL )
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_NotConnected;
+	}
+	else
+	{
+		tCommand.ulCommand = PAPA_SCHLUMPF_USB_COMMAND_DmaListRun;
+		tCommand.ulProgramId = ulProgramId;
+		tCommand.ulProgramHash = ulProgramHash;
+		iResult = __send_packet((const unsigned char *)&tCommand, sizeof(tCommand));
+		if( iResult!=0 )
+		{
+			fprintf(stderr, "%s: failed to send packet: %d\n", m_pcPluginId, iResult);
+			tResult = PAPA_SCHLUMPF_RESULT_USBError;
+		}
+		else
+		{
+			/* The program stops at the first failed DMA. */
+			iResult = __receivePacket(uResponse.auc, sizeof(uResponse), &iTransfered, 0, 1);
+			if( iResult!=0 )
+			{
+				fprintf(stderr, "%s: failed to receive packet: %d\n", m_pcPluginId, iResult);
+				tResult = PAPA_SCHLUMPF_RESULT_USBError;
+			}
+			else if( iTransfered<sizHeader )
+			{
+				fprintf(stderr, "%s: received an unexpected amount of data. wanted at least %d bytes, but got %d.\n", m_pcPluginId, sizHeader, iTransfered);
+				tResult = PAPA_SCHLUMPF_RESULT_USBError;
+			}
+			else if( uResponse.tRun.ulStatus==USB_COMMAND_STATUS_UnknownProgram )
+			{
+				tResult = PAPA_SCHLUMPF_RESULT_UnknownProgram;
+			}
+			else if( uResponse.tRun.ulStatus!=USB_COMMAND_STATUS_Ok )
+			{
+				fprintf(stderr, "%s: received an error: %d.\n", m_pcPluginId, uResponse.tRun.ulStatus);
+				tResult = PAPA_SCHLUMPF_RESULT_CommandFailed;
+			}
+			else if( uResponse.tRun.ulDumpCount>PAPA_SCHLUMPF_DMALIST_MAXIMUM_ENTRIES || iTransfered!=(int)(sizHeader + uResponse.tRun.ulDumpCount * sizeof(uint32_t)) )
+			{
+				fprintf(stderr, "%s: received an unexpected amount of data. got %d bytes for %d dumped values.\n", m_pcPluginId, iTransfered, uResponse.tRun.ulDumpCount);
+				tResult = PAPA_SCHLUMPF_RESULT_USBError;
+			}
+			else
+			{
+				/* Always return a buffer, even if nothing was dumped. */
+				sizDump = uResponse.tRun.ulDumpCount * sizeof(uint32_t);
+				pcDump = (char*)malloc(sizDump + 1);
+				if( pcDump==NULL )
+				{
+					tResult = PAPA_SCHLUMPF_RESULT_OutOfMemory;
+				}
+				else
+				{
+					memcpy(pcDump, uResponse.tRun.aulDump, sizDump);
+					*pulFailure = uResponse.tRun.ulFailure;
+					*pulFailedIndex = uResponse.tRun.ulFailedIndex;
+					*pulFailedValue = uResponse.tRun.ulFailedValue;
+					*ppcBUFFER_OUT = pcDump;
+					*psizBUFFER_OUT = sizDump;
+					tResult = PAPA_SCHLUMPF_RESULT_Ok;
+				}
+			}
+		}
+	}
+
+	return tResult;
+}
+
+
+
+RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::disconnect(void)
+{
+	__disconnect();
+	return PAPA_SCHLUMPF_RESULT_Ok;
+}
+
+
+
+RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::plugin_connect(void)
+{
+	/* Increase the reference counter. */
+	++m_uiPluginConnections;
+}
+
+
+
+RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::plugin_disconnect(void)
+{
+	/* Are any references left? */
+	if( m_uiPluginConnections!=0 )
+	{
+		/* Decrement the reference counter. */
+		--m_uiPluginConnections;
+
+		/* Close the PapaSchlumpf connection if the reference reached 0. */
+		if( m_uiPluginConnections==0 )
+		{
+			disconnect();
+		}
+	}
+}
+
+
+
+/* Look through all USB devices. If one Papa Schlumpf device was found, open it.
+ * 0 or more than one Papa Schlumpf device results in an error.
+ */
+PAPA_SCHLUMPF_RESULT_T PapaSchlumpfFlex::__scan_for_papa_schlumpf_hardware(const char *pcSelector)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	int iLibUsbResult;
+	int iIsMatch;
+	ssize_t ssizDevList;
+	libusb_device **ptDeviceList;
+	libusb_device **ptDevCnt, **ptDevEnd;
+	libusb_device *ptDevice;
+	libusb_device *ptDevPapaSchlumpf;
+	struct libusb_device_descriptor sDevDesc;
+	char acPath[64];
+	char acSerial[64];
+
+
+	/* Expect success. */
+	tResult = PAPA_SCHLUMPF_RESULT_Ok;
+
+	/* Get the list of all connected USB devices. */
+	ptDeviceList = NULL;
+	ssizDevList = libusb_get_device_list(m_ptLibUsbContext, &ptDeviceList);
+	if( ssizDevList<0 )
+	{
+		/* Failed to get the list of all USB devices. */
+		fprintf(stderr, "%s: failed to detect USB devices: %ld:%s\n", m_pcPluginId, ssizDevList, libusb_strerror(libusb_error(ssizDevList)));
+		tResult = PAPA_SCHLUMPF_RESULT_USBError;
+	}
+	else
+	{
+		/* No Papa Schlumpf device found yet. */
+		ptDevPapaSchlumpf = NULL;
+
+		/* Loop over all devices. */
+		ptDevCnt = ptDeviceList;
+		ptDevEnd = ptDevCnt + ssizDevList;
+		while( ptDevCnt<ptDevEnd )
+		{
+			ptDevice = *ptDevCnt;
+
+			/* Get the device descriptor. This does not need to open the device. */
+			iLibUsbResult = libusb_get_device_descriptor(ptDevice, &sDevDesc);
+			if( iLibUsbResult==LIBUSB_SUCCESS )
+			{
+				/* Is this a "Papa Schlumpf" device? */
+				if( sDevDesc.idVendor==PAPA_SCHLUMPF_USB_VENDOR_ID && sDevDesc.idProduct==PAPA_SCHLUMPF_USB_PRODUCT_ID )
+				{
+					__get_device_path(ptDevice, acPath, sizeof(acPath));
+					printf("Found a Papa Schlumpf device at %s.\n", acPath);
+
+					/* Does the device match the selector? */
+					iIsMatch = 1;
+					if( pcSelector!=NULL && strcmp(pcSelector, acPath)!=0 )
+					{
+						iIsMatch = 0;
+						if( __get_device_serial(ptDevice, acSerial, sizeof(acSerial))==0 && strcmp(pcSelector, acSerial)==0 )
+						{
+							iIsMatch = 1;
+						}
+					}
+
+					if( iIsMatch!=0 )
+					{
+						if( ptDevPapaSchlumpf == NULL)
+						{
+							/* Check if this device is the first which gets found*/
+							ptDevPapaSchlumpf = ptDevice;
+						}
+						else
+						{
+							printf("Error! More than one Papa Schlumpf device connected!\n");
+							tResult = PAPA_SCHLUMPF_RESULT_MoreThanOneDeviceFound;
+							break;
+						}
+					}
+				}
+			}
+
+			/* Next device in the list... */
+			++ptDevCnt;
+		}
+
+		/* Did no error occur and found a device? */
+		if( tResult==PAPA_SCHLUMPF_RESULT_Ok )
+		{
+			if( ptDevPapaSchlumpf==NULL )
+			{
+				fprintf(stderr, "%s: no hardware found!\n", m_pcPluginId);
+				tResult = PAPA_SCHLUMPF_RESULT_NoDeviceFound;
+			}
+			else
+			{
+				tResult = __open_device(ptDevPapaSchlumpf);
+			}
+		}
+
+
+		/* Free the device list. */
+		if( ptDeviceList!=NULL )
+		{
+			libusb_free_device_list(ptDeviceList, 1);
+		}
+	}
+
+	return tResult;
+}
+
+
+
+PAPA_SCHLUMPF_RESULT_T PapaSchlumpfFlex::__execute_batch_packet(const PAPA_SCHLUMPF_BATCH_ENTRY_T *ptEntries, uint32_t ulEntries, PAPA_SCHLUMPF_BATCH_RESULT_T *ptResults, uint32_t *pulProcessed)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	int iResult;
+	int iTransfered;
+	int sizCommand;
+	int sizExpected;
+	PAPA_SCHLUMPF_USB_COMMAND_BATCH_T tCommand;
+	union
+	{
+		PAPA_SCHLUMPF_USB_COMMAND_RESULT_BATCH_T tBatch;
+		unsigned char auc[sizeof(PAPA_SCHLUMPF_USB_COMMAND_RESULT_BATCH_T) + 4];
+	} uResponse;
+
+
+	tCommand.ulCommand = PAPA_SCHLUMPF_USB_COMMAND_Batch;
+	tCommand.ulEntries = ulEntries;
+	memcpy(tCommand.atEntries, ptEntries, ulEntries * sizeof(PAPA_SCHLUMPF_BATCH_ENTRY_T));
+	sizCommand = sizeof(uint32_t) + sizeof(uint32_t) + ulEntries * sizeof(PAPA_SCHLUMPF_BATCH_ENTRY_T);
+
+	iResult = __send_packet((const unsigned char *)&tCommand, sizCommand);
+	if( iResult!=0 )
+	{
+		fprintf(stderr, "%s: failed to send packet: %d\n", m_pcPluginId, iResult);
+		tResult = PAPA_SCHLUMPF_RESULT_USBError;
+	}
+	else
+	{
+		/* Each entry can take up to one DMA timeout in the firmware. It stops at the first failed entry. */
+		iResult = __receivePacket(uResponse.auc, sizeof(uResponse), &iTransfered, 0, ulEntries);
+		if( iResult!=0 )
+		{
+			fprintf(stderr, "%s: failed to receive packet: %d\n", m_pcPluginId, iResult);
+			tResult = PAPA_SCHLUMPF_RESULT_USBError;
+		}
+		else if( iTransfered<(int)(sizeof(uint32_t) + sizeof(uint32_t)) )
+		{
+			fprintf(stderr, "%s: received an unexpected amount of data. wanted at least %zd bytes, but got %d.\n", m_pcPluginId, sizeof(uint32_t) + sizeof(uint32_t), iTransfered);
+			tResult = PAPA_SCHLUMPF_RESULT_USBError;
+		}
+		else if( uResponse.tBatch.ulStatus!=USB_COMMAND_STATUS_Ok )
+		{
+			fprintf(stderr, "%s: received an error: %d.\n", m_pcPluginId, uResponse.tBatch.ulStatus);
+			tResult = PAPA_SCHLUMPF_RESULT_CommandFailed;
+		}
+		else if( uResponse.tBatch.ulEntries==0 )
+		{
+			/* The firmware always returns at least the result of the first entry. */
+			fprintf(stderr, "%s: the batch response has no results.\n", m_pcPluginId);
+			tResult = PAPA_SCHLUMPF_RESULT_USBError;
+		}
+		else
+		{
+			sizExpected = sizeof(uint32_t) + sizeof(uint32_t) + uResponse.tBatch.ulEntries * sizeof(PAPA_SCHLUMPF_BATCH_RESULT_T);
+			if( uResponse.tBatch.ulEntries>ulEntries || iTransfered!=sizExpected )
+			{
+				fprintf(stderr, "%s: received an unexpected amount of data. wanted %d bytes, but got %d.\n", m_pcPluginId, sizExpected, iTransfered);
+				tResult = PAPA_SCHLUMPF_RESULT_USBError;
+			}
+			else
+			{
+				memcpy(ptResults, uResponse.tBatch.atResults, uResponse.tBatch.ulEntries * sizeof(PAPA_SCHLUMPF_BATCH_RESULT_T));
+				*pulProcessed = uResponse.tBatch.ulEntries;
+				tResult = PAPA_SCHLUMPF_RESULT_Ok;
+			}
+		}
+	}
+
+	return tResult;
+}
+
+
+
+/* Split a list of areas in scatter commands. An area which does not fit
+ * into the rest of a command continues in the next one. pucData is the
+ * destination for MemReadScatter and the source for MemWriteScatter.
+ */
+PAPA_SCHLUMPF_RESULT_T PapaSchlumpfFlex::__scatter(uint32_t ulCommand, const PAPA_SCHLUMPF_SCATTER_DESCRIPTOR_T *ptDescriptors, size_t sizDescriptors, unsigned char *pucData)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	PAPA_SCHLUMPF_SCATTER_DESCRIPTOR_T atPacket[PAPA_SCHLUMPF_SCATTER_MAXIMUM_DESCRIPTORS];
+	uint32_t ulDescriptors;
+	uint32_t ulDwords;
+	uint32_t ulMaximumDwords;
+	uint32_t ulOffsetDw;
+	uint32_t ulChunk;
+	size_t sizIndex;
+
+
+	tResult = PAPA_SCHLUMPF_RESULT_Ok;
+	sizIndex = 0;
+	ulOffsetDw = 0;
+	while( tResult==PAPA_SCHLUMPF_RESULT_Ok && sizIndex<sizDescriptors )
+	{
+		ulDescriptors = 0;
+		ulDwords = 0;
+		while( sizIndex<sizDescriptors && ulDescriptors<PAPA_SCHLUMPF_SCATTER_MAXIMUM_DESCRIPTORS )
+		{
+			/* The response of a read command must fit into the FIFO of the endpoint.
+			 * The descriptors of a write command share the space with the data.
+			 */
+			if( ulCommand==PAPA_SCHLUMPF_USB_COMMAND_MemReadScatter )
+			{
+				ulMaximumDwords = (uint32_t)PAPA_SCHLUMPF_SCATTER_READ_MAXIMUM_DWORDS;
+			}
+			else
+			{
+				ulMaximumDwords = (uint32_t)(PAPA_SCHLUMPF_SCATTER_COMMAND_DWORDS - (ulDescriptors + 1U) * (sizeof(PAPA_SCHLUMPF_SCATTER_DESCRIPTOR_T) / sizeof(uint32_t)));
+			}
+			if( ulDwords>=ulMaximumDwords )
+			{
+				break;
+			}
+
+			ulChunk = ptDescriptors[sizIndex].ulDwords - ulOffsetDw;
+			if( ulChunk>ulMaximumDwords-ulDwords )
+			{
+				ulChunk = ulMaximumDwords - ulDwords;
+			}
+			if( ulChunk!=0 )
+			{
+				atPacket[ulDescriptors].ulDeviceAddress = ptDescriptors[sizIndex].ulDeviceAddress + ulOffsetDw * sizeof(uint32_t);
+				atPacket[ulDescriptors].ulDwords = ulChunk;
+				++ulDescriptors;
+				ulDwords += ulChunk;
+				ulOffsetDw += ulChunk;
+			}
+			if( ulOffsetDw==ptDescriptors[sizIndex].ulDwords )
+			{
+				++sizIndex;
+				ulOffsetDw = 0;
+			}
+		}
+
+		if( ulDescriptors!=0 )
+		{
+			tResult = __scatter_packet(ulCommand, atPacket, ulDescriptors, pucData, ulDwords);
+			pucData += ulDwords * sizeof(uint32_t);
+		}
+	}
+
+	return tResult;
+}
+
+
+
+PAPA_SCHLUMPF_RESULT_T PapaSchlumpfFlex::__scatter_packet(uint32_t ulCommand, const PAPA_SCHLUMPF_SCATTER_DESCRIPTOR_T *ptDescriptors, uint32_t ulDescriptors, unsigned char *pucData, uint32_t ulDwords)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	int iResult;
+	int iTransfered;
+	int sizCommand;
+	int sizExpected;
+	size_t sizDescriptors;
+	PAPA_SCHLUMPF_USB_COMMAND_SCATTER_T tCommand;
+	union
+	{
+		PAPA_SCHLUMPF_USB_COMMAND_RESULT_MEM_READ_SCATTER_T tReadScatter;
+		unsigned char auc[sizeof(PAPA_SCHLUMPF_USB_COMMAND_RESULT_MEM_READ_SCATTER_T) + 4];
+	} uResponse;
+
+
+	sizDescriptors = ulDescriptors * sizeof(PAPA_SCHLUMPF_SCATTER_DESCRIPTOR_T);
+	tCommand.ulCommand = ulCommand;
+	tCommand.ulDescriptors = ulDescriptors;
+	memcpy(tCommand.aulData, ptDescriptors, sizDescriptors);
+	sizCommand = (int)(sizeof(uint32_t) + sizeof(uint32_t) + sizDescriptors);
+	if( ulCommand==PAPA_SCHLUMPF_USB_COMMAND_MemWriteScatter )
+	{
+		memcpy(((unsigned char*)tCommand.aulData) + sizDescriptors, pucData, ulDwords * sizeof(uint32_t));
+		sizCommand += (int)(ulDwords * sizeof(uint32_t));
+		sizExpected = sizeof(uint32_t);
+	}
+	else
+	{
+		sizExpected = (int)(sizeof(uint32_t) + ulDwords * sizeof(uint32_t));
+	}
+
+	iResult = __send_packet((const unsigned char *)&tCommand, sizCommand);
+	if( iResult!=0 )
+	{
+		fprintf(stderr, "%s: failed to send packet: %d\n", m_pcPluginId, iResult);
+		tResult = PAPA_SCHLUMPF_RESULT_USBError;
+	}
+	else
+	{
+		/* Each area can take up to one DMA timeout in the firmware. */
+		iResult = __receivePacket(uResponse.auc, sizeof(uResponse), &iTransfered, 0, ulDescriptors);
+		if( iResult!=0 )
+		{
+			fprintf(stderr, "%s: failed to receive packet: %d\n", m_pcPluginId, iResult);
+			tResult = PAPA_SCHLUMPF_RESULT_USBError;
+		}
+		else if( iTransfered<(int)sizeof(uint32_t) )
+		{
+			fprintf(stderr, "%s: received an unexpected amount of data. wanted at least %zd bytes, but got %d.\n", m_pcPluginId, sizeof(uint32_t), iTransfered);
+			tResult = PAPA_SCHLUMPF_RESULT_USBError;
+		}
+		else if( uResponse.tReadScatter.ulStatus!=USB_COMMAND_STATUS_Ok )
+		{
+			fprintf(stderr, "%s: received an error: %d.\n", m_pcPluginId, uResponse.tReadScatter.ulStatus);
+			tResult = PAPA_SCHLUMPF_RESULT_CommandFailed;
+		}
+		else if( iTransfered!=sizExpected )
+		{
+			fprintf(stderr, "%s: received an unexpected amount of data. wanted %d bytes, but got %d.\n", m_pcPluginId, sizExpected, iTransfered);
+			tResult = PAPA_SCHLUMPF_RESULT_USBError;
+		}
+		else
+		{
+			if( ulCommand==PAPA_SCHLUMPF_USB_COMMAND_MemReadScatter )
+			{
+				memcpy(pucData, uResponse.tReadScatter.aulData, ulDwords * sizeof(uint32_t));
+			}
+			tResult = PAPA_SCHLUMPF_RESULT_Ok;
+		}
+	}
+
+	return tResult;
+}
+
+
+
+/* Get the shared libusb context. Create it on the first call.
+ * This returns NULL if libusb can not be initialized.
+ */
+libusb_context *PapaSchlumpfFlex::__get_libusb_context(void)
+{
+	int iResult;
+	libusb_context *ptLibUsbContext;
+
+
+	pthread_mutex_lock(&s_tLibUsbContextMutex);
+	if( s_ptLibUsbContext==NULL )
+	{
+		iResult = libusb_init(&ptLibUsbContext);
+		if( iResult!=0 )
+		{
+			fprintf(stderr, "papa_schlumpf: failed to initialize libusb: %d\n", iResult);
+		}
+		else
+		{
+			/* Set the debug level to a bit more verbose. */
+			libusb_set_option(ptLibUsbContext, LIBUSB_OPTION_LOG_LEVEL, LIBUSB_LOG_LEVEL_INFO);
+
+			printf("libusb is open!\n");
+			s_ptLibUsbContext = ptLibUsbContext;
+		}
+	}
+	ptLibUsbContext = s_ptLibUsbContext;
+	pthread_mutex_unlock(&s_tLibUsbContextMutex);
+
+	return ptLibUsbContext;
+}
+
+
+
+/* Count the objects which can use the shared context. It is not closed while there are any. */
+void PapaSchlumpfFlex::__add_libusb_user(void)
+{
+	pthread_mutex_lock(&s_tLibUsbContextMutex);
+	++s_uiLibUsbUsers;
+	pthread_mutex_unlock(&s_tLibUsbContextMutex);
+}
+
+
+
+void PapaSchlumpfFlex::__remove_libusb_user(void)
+{
+	pthread_mutex_lock(&s_tLibUsbContextMutex);
+	--s_uiLibUsbUsers;
+	pthread_mutex_unlock(&s_tLibUsbContextMutex);
+}
+
+
+
+/* Close the shared libusb context if nobody uses it anymore. */
+void PapaSchlumpfFlex::__close_libusb_context(void)
+{
+	pthread_mutex_lock(&s_tLibUsbContextMutex);
+	if( s_ptLibUsbContext!=NULL && s_uiLibUsbUsers==0 )
+	{
+		libusb_exit(s_ptLibUsbContext);
+		s_ptLibUsbContext = NULL;
+	}
+	pthread_mutex_unlock(&s_tLibUsbContextMutex);
+}
+
+
+
+/* Open a device and start the pipeline.
+ * Try the last path first if it is not NULL. Scan all devices with the
+ * selector if there is no last path or the device is not there anymore.
+ */
+PAPA_SCHLUMPF_RESULT_T PapaSchlumpfFlex::__connect(const char *pcLastPath, const char *pcSelector)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+
+
+	m_ptLibUsbContext = __get_libusb_context();
+	if( m_ptLibUsbContext==NULL )
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_USBError;
+	}
+	else
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_NoDeviceFound;
+		if( pcLastPath!=NULL )
+		{
+			tResult = __open_device_at_path(pcLastPath);
+			if( tResult!=PAPA_SCHLUMPF_RESULT_Ok )
+			{
+				fprintf(stderr, "%s: the device is not at %s anymore. Scanning all devices.\n", m_pcPluginId, pcLastPath);
+			}
+		}
+
+		if( tResult!=PAPA_SCHLUMPF_RESULT_Ok )
+		{
+			/* Search for exactly one papa schlumpf hardware and open it. */
+			tResult = __scan_for_papa_schlumpf_hardware(pcSelector);
+		}
+
+		if( tResult==PAPA_SCHLUMPF_RESULT_Ok )
+		{
+			printf("Found HW!\n");
+
+			/* Start the event thread for the asynchronous transfers. */
+			tResult = __pipeline_start();
+		}
+
+		if( tResult!=PAPA_SCHLUMPF_RESULT_Ok )
+		{
+			__disconnect();
+		}
+	}
+
+	return tResult;
+}
+
+
+
+/* Use a transport which is already open, e.g. a simulator.
+ * There is no USB path, so a reconnect is not possible.
+ */
+PAPA_SCHLUMPF_RESULT_T PapaSchlumpfFlex::connectTransport(PapaSchlumpfTransport *ptTransport)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+
+
+	__disconnect();
+
+	m_acLastPath[0] = '\0';
+	m_ptTransport = ptTransport;
+	tResult = __pipeline_start();
+	if( tResult!=PAPA_SCHLUMPF_RESULT_Ok )
+	{
+		__disconnect();
+	}
+
+	return tResult;
+}
+
+
+
+/* Open the Papa Schlumpf device at a USB path.
+ * This compares only the bus and port numbers, so no other device is opened.
+ */
+PAPA_SCHLUMPF_RESULT_T PapaSchlumpfFlex::__open_device_at_path(const char *pcPath)
 {
 	PAPA_SCHLUMPF_RESULT_T tResult;
 	int iLibUsbResult;
@@ -996,168 +2753,1429 @@ PAPA_SCHLUMPF_RESULT_T PapaSchlumpfFlex::__scan_for_papa_schlumpf_hardware(void)
 	libusb_device **ptDeviceList;
 	libusb_device **ptDevCnt, **ptDevEnd;
 	libusb_device *ptDevice;
-	libusb_device *ptDevPapaSchlumpf;
-	libusb_device_handle *ptDevHandle;
+	struct libusb_device_descriptor sDevDesc;
+	char acPath[64];
+
+
+	tResult = PAPA_SCHLUMPF_RESULT_NoDeviceFound;
+
+	/* The shared context keeps the list up to date, so this does not enumerate the bus again. */
+	ptDeviceList = NULL;
+	ssizDevList = libusb_get_device_list(m_ptLibUsbContext, &ptDeviceList);
+	if( ssizDevList<0 )
+	{
+		fprintf(stderr, "%s: failed to detect USB devices: %ld:%s\n", m_pcPluginId, ssizDevList, libusb_strerror(libusb_error(ssizDevList)));
+		tResult = PAPA_SCHLUMPF_RESULT_USBError;
+	}
+	else
+	{
+		ptDevCnt = ptDeviceList;
+		ptDevEnd = ptDevCnt + ssizDevList;
+		while( ptDevCnt<ptDevEnd )
+		{
+			ptDevice = *ptDevCnt;
+
+			__get_device_path(ptDevice, acPath, sizeof(acPath));
+			if( strcmp(acPath, pcPath)==0 )
+			{
+				/* Another device could be plugged into the same port. */
+				iLibUsbResult = libusb_get_device_descriptor(ptDevice, &sDevDesc);
+				if( iLibUsbResult==LIBUSB_SUCCESS && sDevDesc.idVendor==PAPA_SCHLUMPF_USB_VENDOR_ID && sDevDesc.idProduct==PAPA_SCHLUMPF_USB_PRODUCT_ID )
+				{
+					tResult = __open_device(ptDevice);
+				}
+				break;
+			}
+
+			++ptDevCnt;
+		}
+
+		libusb_free_device_list(ptDeviceList, 1);
+	}
+
+	return tResult;
+}
+
+
+
+/* Open a device, claim interface #0 and create the USB transport for it. */
+PAPA_SCHLUMPF_RESULT_T PapaSchlumpfFlex::__open_device(libusb_device *ptDevice)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	int iLibUsbResult;
 	libusb_device_handle *ptDevHandlePapaSchlumpf;
+
+
+	/* Open the device. */
+	iLibUsbResult = libusb_open(ptDevice, &ptDevHandlePapaSchlumpf);
+	if( iLibUsbResult==LIBUSB_SUCCESS )
+	{
+		/* Claim interface #0. */
+		iLibUsbResult = libusb_claim_interface(ptDevHandlePapaSchlumpf, 0);
+		if( iLibUsbResult==LIBUSB_SUCCESS )
+		{
+			/* Remember the path for a reconnect. */
+			__get_device_path(ptDevice, m_acLastPath, sizeof(m_acLastPath));
+
+			/* The transport owns the handle from now on. */
+			m_ptTransport = new PapaSchlumpfTransportLibUsb(m_ptLibUsbContext, ptDevHandlePapaSchlumpf, m_acLastPath);
+			tResult = PAPA_SCHLUMPF_RESULT_Ok;
+		}
+		else
+		{
+			fprintf(stderr, "%s: failed to claim the interface: %d:%s\n", m_pcPluginId, iLibUsbResult, libusb_strerror(libusb_error(iLibUsbResult)));
+			libusb_close(ptDevHandlePapaSchlumpf);
+			tResult = PAPA_SCHLUMPF_RESULT_USBError;
+		}
+	}
+	else
+	{
+		fprintf(stderr, "%s: failed to open the usb devices: %d:%s\n", m_pcPluginId, iLibUsbResult, libusb_strerror(libusb_error(iLibUsbResult)));
+		tResult = PAPA_SCHLUMPF_RESULT_USBError;
+	}
+
+	return tResult;
+}
+
+
+
+/* Build the path of a device from the bus and port numbers. This is the same
+ * format as the names in /sys/bus/usb/devices, e.g. "1-4.2".
+ */
+void PapaSchlumpfFlex::__get_device_path(libusb_device *ptDevice, char *pcPath, size_t sizPath)
+{
+	int iPorts;
+	int iCnt;
+	size_t sizUsed;
+	uint8_t aucPorts[8];
+
+
+	sizUsed = (size_t)snprintf(pcPath, sizPath, "%d", libusb_get_bus_number(ptDevice));
+	iPorts = libusb_get_port_numbers(ptDevice, aucPorts, sizeof(aucPorts));
+	for(iCnt=0; iCnt<iPorts && sizUsed<sizPath; ++iCnt)
+	{
+		sizUsed += (size_t)snprintf(pcPath + sizUsed, sizPath - sizUsed, "%c%d", (iCnt==0) ? '-' : '.', aucPorts[iCnt]);
+	}
+}
+
+
+
+/* Read the serial number of a device. This must open the device. */
+int PapaSchlumpfFlex::__get_device_serial(libusb_device *ptDevice, char *pcSerial, size_t sizSerial)
+{
+	int iResult;
+	libusb_device_handle *ptDevHandle;
 	struct libusb_device_descriptor sDevDesc;
 
 
-	/* Expect success. */
+	iResult = libusb_get_device_descriptor(ptDevice, &sDevDesc);
+	if( iResult==LIBUSB_SUCCESS )
+	{
+		iResult = libusb_open(ptDevice, &ptDevHandle);
+		if( iResult==LIBUSB_SUCCESS )
+		{
+			iResult = libusb_get_string_descriptor_ascii(ptDevHandle, sDevDesc.iSerialNumber, (unsigned char*)pcSerial, (int)sizSerial);
+			if( iResult>=0 )
+			{
+				iResult = 0;
+			}
+			libusb_close(ptDevHandle);
+		}
+	}
+
+	return iResult;
+}
+
+
+
+/* Send a command. The first packet of a command starts the round trip measurement.
+ * The firmware starts a command on a short packet, so a command with a
+ * multiple of 64 bytes is terminated with a zero packet.
+ */
+int PapaSchlumpfFlex::__send_packet(const unsigned char *pucOutBuf, int sizOutBuf)
+{
+	int iResult;
+	struct timespec tStart;
+	unsigned long ulSendUs;
+
+
+	clock_gettime(CLOCK_MONOTONIC, &tStart);
+	if( m_iRoundTripActive==0 )
+	{
+		m_tRoundTripStart = tStart;
+		m_sizRoundTrip = 0;
+		m_ulRoundTripSendUs = 0;
+		/* All commands start with the command ID. */
+		m_ulRoundTripCommand = 0xffffffffU;
+		if( sizOutBuf>=(int)sizeof(uint32_t) )
+		{
+			memcpy(&m_ulRoundTripCommand, pucOutBuf, sizeof(uint32_t));
+		}
+		/* The trace needs the first packet of the command. */
+		m_pucRoundTripCommand = pucOutBuf;
+		m_sizRoundTripCommand = (size_t)sizOutBuf;
+		m_iRoundTripActive = 1;
+	}
+	m_sizRoundTrip += (size_t)sizOutBuf;
+
+	iResult = m_ptTransport->send(pucOutBuf, sizOutBuf, __get_timeout((size_t)sizOutBuf, 1, 0));
+	if( iResult==0 && sizOutBuf!=0 && (sizOutBuf&0x0000003f)==0 )
+	{
+		iResult = m_ptTransport->send(pucOutBuf, 0, __get_timeout(0, 1, 0));
+	}
+	ulSendUs = __get_elapsed_us(&tStart);
+	m_ulRoundTripSendUs += ulSendUs;
+	if( iResult!=0 )
+	{
+		__record_statistics(m_ulRoundTripCommand, m_sizRoundTrip, m_ulRoundTripSendUs, 0, __get_elapsed_us(&m_tRoundTripStart), 1, (iResult==LIBUSB_ERROR_TIMEOUT) ? 1 : 0);
+		if( m_ptTrace!=NULL )
+		{
+			m_ptTrace->record(m_pucRoundTripCommand, m_sizRoundTripCommand, PAPA_SCHLUMPF_TRACE_STATUS_NO_RESPONSE, NULL, 0, &m_tRoundTripStart, __get_elapsed_us(&m_tRoundTripStart));
+		}
+		m_iRoundTripActive = 0;
+	}
+	return iResult;
+}
+
+
+
+/* Receive the response of a command.
+ * uiExecutionMs is the known execution time of the command in the firmware,
+ * e.g. the delays of a PCI reset. Only commands without a known execution
+ * time update the latency estimate. uiDmaTransfers is the number of PCI DMA
+ * transfers of the command. Each can hang until the firmware gives up.
+ */
+int PapaSchlumpfFlex::__receivePacket(unsigned char *pucInBuf, int sizInBufMax, int *psizInBuf, unsigned int uiExecutionMs, unsigned int uiDmaTransfers)
+{
+	int iResult;
+	int iError;
+	uint32_t ulStatus;
+	struct timespec tStart;
+	unsigned long ulReceiveUs;
+
+
+	clock_gettime(CLOCK_MONOTONIC, &tStart);
+	iResult = m_ptTransport->receive(pucInBuf, sizInBufMax, psizInBuf, __get_timeout(m_sizRoundTrip + (size_t)sizInBufMax, 1, uiExecutionMs + uiDmaTransfers * TIMEOUT_PCI_DMA_MS));
+	ulReceiveUs = __get_elapsed_us(&tStart);
+	if( m_iRoundTripActive!=0 )
+	{
+		/* All responses start with the status. */
+		iError = 1;
+		ulStatus = PAPA_SCHLUMPF_TRACE_STATUS_NO_RESPONSE;
+		if( iResult==0 && *psizInBuf>=(int)sizeof(uint32_t) )
+		{
+			memcpy(&ulStatus, pucInBuf, sizeof(uint32_t));
+			if( ulStatus==USB_COMMAND_STATUS_Ok )
+			{
+				iError = 0;
+			}
+		}
+		__record_statistics(m_ulRoundTripCommand, m_sizRoundTrip + (size_t)((iResult==0) ? *psizInBuf : 0), m_ulRoundTripSendUs, ulReceiveUs, __get_elapsed_us(&m_tRoundTripStart), iError, (iResult==LIBUSB_ERROR_TIMEOUT) ? 1 : 0);
+		if( m_ptTrace!=NULL )
+		{
+			m_ptTrace->record(m_pucRoundTripCommand, m_sizRoundTripCommand, ulStatus, pucInBuf + sizeof(uint32_t), (ulStatus==PAPA_SCHLUMPF_TRACE_STATUS_NO_RESPONSE) ? 0 : (size_t)*psizInBuf, &m_tRoundTripStart, __get_elapsed_us(&m_tRoundTripStart));
+		}
+
+		if( iResult==0 && uiExecutionMs==0 && (m_sizRoundTrip + (size_t)*psizInBuf)<=(2U * PAPA_SCHLUMPF_MAXIMUM_PACKET_SIZE) )
+		{
+			__sample_latency(&m_tRoundTripStart);
+		}
+	}
+	m_iRoundTripActive = 0;
+
+	/* The response might still arrive. It must not be taken as the response of the next command. */
+	if( iResult==LIBUSB_ERROR_TIMEOUT )
+	{
+		__drain_responses();
+	}
+
+	return iResult;
+}
+
+
+
+/* Drop all responses which arrive late, e.g. after a timeout or for cancelled
+ * commands. Stop when the firmware was quiet for the DMA timeout.
+ */
+void PapaSchlumpfFlex::__drain_responses(void)
+{
+	int iResult;
+	int iTransfered;
+	unsigned int uiDropped;
+	PIPELINE_RESPONSE_T tResponse;
+
+
+	uiDropped = 0;
+	do
+	{
+		iResult = m_ptTransport->receive(tResponse.auc, sizeof(tResponse), &iTransfered, TIMEOUT_PCI_DMA_MS);
+		if( iResult==0 )
+		{
+			++uiDropped;
+		}
+	} while( iResult==0 );
+
+	if( uiDropped!=0 )
+	{
+		fprintf(stderr, "%s: dropped %u late responses.\n", m_pcPluginId, uiDropped);
+	}
+}
+
+
+
+/* Get the timeout for a transfer from the current estimates of the link.
+ * The estimates cover sizTransfer bytes and uiCommands round trips. Add the
+ * known execution time of the command and a safety factor for a busy bus.
+ */
+unsigned int PapaSchlumpfFlex::__get_timeout(size_t sizTransfer, unsigned int uiCommands, unsigned int uiExecutionMs)
+{
+	unsigned long long ullTimeoutUs;
+	unsigned int uiTimeoutMs;
+
+
+	if( m_uiTimeoutOverrideMs!=0 )
+	{
+		uiTimeoutMs = m_uiTimeoutOverrideMs;
+	}
+	else
+	{
+		ullTimeoutUs  = (unsigned long long)uiCommands * m_ulLatencyUs;
+		ullTimeoutUs += ((unsigned long long)sizTransfer * 1000000ULL) / m_ulBytesPerSecond;
+		ullTimeoutUs *= TIMEOUT_SAFETY_FACTOR;
+		ullTimeoutUs += (unsigned long long)uiExecutionMs * 1000ULL;
+
+		uiTimeoutMs = TIMEOUT_MAXIMUM_MS;
+		if( ullTimeoutUs<(unsigned long long)TIMEOUT_MAXIMUM_MS * 1000ULL )
+		{
+			uiTimeoutMs = (unsigned int)((ullTimeoutUs + 999ULL) / 1000ULL);
+			if( uiTimeoutMs<TIMEOUT_MINIMUM_MS )
+			{
+				uiTimeoutMs = TIMEOUT_MINIMUM_MS;
+			}
+		}
+	}
+
+	return uiTimeoutMs;
+}
+
+
+
+unsigned long PapaSchlumpfFlex::__get_elapsed_us(const struct timespec *ptStart)
+{
+	struct timespec tNow;
+	long long llElapsedUs;
+
+
+	clock_gettime(CLOCK_MONOTONIC, &tNow);
+	llElapsedUs = (long long)(tNow.tv_sec - ptStart->tv_sec) * 1000000LL + (long long)(tNow.tv_nsec - ptStart->tv_nsec) / 1000LL;
+	if( llElapsedUs<1 )
+	{
+		llElapsedUs = 1;
+	}
+
+	return (unsigned long)llElapsedUs;
+}
+
+
+
+unsigned long PapaSchlumpfFlex::__get_difference_us(const struct timespec *ptStart, const struct timespec *ptEnd)
+{
+	long long llDifferenceUs;
+
+
+	llDifferenceUs = (long long)(ptEnd->tv_sec - ptStart->tv_sec) * 1000000LL + (long long)(ptEnd->tv_nsec - ptStart->tv_nsec) / 1000LL;
+	if( llDifferenceUs<0 )
+	{
+		llDifferenceUs = 0;
+	}
+
+	return (unsigned long)llDifferenceUs;
+}
+
+
+
+/* Add one command to the statistics. */
+void PapaSchlumpfFlex::__record_statistics(uint32_t ulCommand, size_t sizBytes, unsigned long ulSendUs, unsigned long ulReceiveUs, unsigned long ulTotalUs, int iError, int iTimeout)
+{
+	COMMAND_STATISTICS_T *ptStatistics;
+	unsigned int uiBucket;
+	unsigned long ulValue;
+
+
+	if( ulCommand<STATISTICS_COMMANDS )
+	{
+		ptStatistics = m_atStatistics + ulCommand;
+		++ptStatistics->ulCalls;
+		ptStatistics->ullBytes += sizBytes;
+		if( iError!=0 )
+		{
+			++ptStatistics->ulErrors;
+		}
+		if( iTimeout!=0 )
+		{
+			++ptStatistics->ulTimeouts;
+		}
+		ptStatistics->ullSendUs += ulSendUs;
+		ptStatistics->ullReceiveUs += ulReceiveUs;
+		ptStatistics->ullTotalUs += ulTotalUs;
+
+		/* Get the bucket from the position of the highest set bit. */
+		uiBucket = 0;
+		ulValue = ulTotalUs >> 1U;
+		while( ulValue!=0 && uiBucket<(STATISTICS_HISTOGRAM_BUCKETS - 1U) )
+		{
+			++uiBucket;
+			ulValue >>= 1U;
+		}
+		++ptStatistics->aulHistogram[uiBucket];
+	}
+}
+
+
+
+/* Update the round trip time of a small command. This includes the execution in the firmware. */
+void PapaSchlumpfFlex::__sample_latency(const struct timespec *ptStart)
+{
+	m_ulLatencyUs = (m_ulLatencyUs * 7U + __get_elapsed_us(ptStart)) / 8U;
+}
+
+
+
+/* Update the throughput with a complete area transfer. Small areas say more about the latency than about the throughput. */
+void PapaSchlumpfFlex::__sample_throughput(uint32_t ulSize, const struct timespec *ptStart)
+{
+	unsigned long long ullBytesPerSecond;
+
+
+	if( ulSize>=4096U )
+	{
+		ullBytesPerSecond = ((unsigned long long)ulSize * 1000000ULL) / __get_elapsed_us(ptStart);
+		if( ullBytesPerSecond<1000ULL )
+		{
+			ullBytesPerSecond = 1000ULL;
+		}
+		m_ulBytesPerSecond = (unsigned long)(((unsigned long long)m_ulBytesPerSecond * 3ULL + ullBytesPerSecond) / 4ULL);
+	}
+}
+
+
+
+/* Allocate the pipeline slots and start the event handling of the transport.
+ * The transport handles the completion of all asynchronous transfers. This
+ * keeps several commands in flight while the caller waits for the oldest one.
+ */
+PAPA_SCHLUMPF_RESULT_T PapaSchlumpfFlex::__pipeline_start(void)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	int iResult;
+	unsigned int uiCnt;
+	PIPELINE_SLOT_T *ptSlot;
+
+
+	/* Expect success. */
+	tResult = PAPA_SCHLUMPF_RESULT_Ok;
+
+	m_ptPipelineSlots = (PIPELINE_SLOT_T*)calloc(PIPELINE_DEPTH, sizeof(PIPELINE_SLOT_T));
+	if( m_ptPipelineSlots==NULL )
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_OutOfMemory;
+	}
+	else
+	{
+		for(uiCnt=0; uiCnt<PIPELINE_DEPTH; ++uiCnt)
+		{
+			ptSlot = m_ptPipelineSlots + uiCnt;
+			ptSlot->ptThis = this;
+			ptSlot->ptTransferOut = m_ptTransport->allocTransfer();
+			ptSlot->ptTransferIn = m_ptTransport->allocTransfer();
+			if( ptSlot->ptTransferOut==NULL || ptSlot->ptTransferIn==NULL )
+			{
+				tResult = PAPA_SCHLUMPF_RESULT_OutOfMemory;
+				break;
+			}
+		}
+
+		if( tResult==PAPA_SCHLUMPF_RESULT_Ok )
+		{
+			iResult = m_ptTransport->startEvents();
+			if( iResult!=0 )
+			{
+				fprintf(stderr, "%s: failed to start the event handling of %s: %d:%s\n", m_pcPluginId, m_ptTransport->getName(), iResult, libusb_strerror(libusb_error(iResult)));
+				tResult = PAPA_SCHLUMPF_RESULT_USBError;
+			}
+		}
+	}
+
+	if( tResult!=PAPA_SCHLUMPF_RESULT_Ok )
+	{
+		__pipeline_stop();
+	}
+
+	return tResult;
+}
+
+
+
+void PapaSchlumpfFlex::__pipeline_stop(void)
+{
+	unsigned int uiCnt;
+	PIPELINE_SLOT_T *ptSlot;
+
+
+	if( m_ptTransport!=NULL )
+	{
+		m_ptTransport->stopEvents();
+
+		if( m_ptPipelineSlots!=NULL )
+		{
+			for(uiCnt=0; uiCnt<PIPELINE_DEPTH; ++uiCnt)
+			{
+				ptSlot = m_ptPipelineSlots + uiCnt;
+				if( ptSlot->ptTransferOut!=NULL )
+				{
+					m_ptTransport->freeTransfer(ptSlot->ptTransferOut);
+				}
+				if( ptSlot->ptTransferIn!=NULL )
+				{
+					m_ptTransport->freeTransfer(ptSlot->ptTransferIn);
+				}
+			}
+		}
+	}
+
+	if( m_ptPipelineSlots!=NULL )
+	{
+		free(m_ptPipelineSlots);
+		m_ptPipelineSlots = NULL;
+	}
+}
+
+
+
+void PapaSchlumpfFlex::__pipeline_transfer_callback(PAPA_SCHLUMPF_TRANSFER_T *ptTransfer)
+{
+	PIPELINE_SLOT_T *ptSlot;
+	PapaSchlumpfFlex *ptThis;
+
+
+	ptSlot = (PIPELINE_SLOT_T*)(ptTransfer->pvUser);
+	ptThis = ptSlot->ptThis;
+
+	/* A response which is received in place has its status in front of the
+	 * data. The next response overwrites it, so get it now.
+	 */
+	if( ptTransfer==ptSlot->ptTransferIn && ptSlot->pucInPlace!=NULL && ptTransfer->sizTransfered>=(int)sizeof(uint32_t) )
+	{
+		memcpy(&(ptSlot->uResponse.tStatus.ulStatus), ptSlot->pucInPlace, sizeof(uint32_t));
+	}
+
+	pthread_mutex_lock(&ptThis->m_tPipelineMutex);
+	if( ptTransfer==ptSlot->ptTransferOut )
+	{
+		clock_gettime(CLOCK_MONOTONIC, &(ptSlot->tOutDone));
+		ptSlot->iOutPending = 0;
+	}
+	else
+	{
+		clock_gettime(CLOCK_MONOTONIC, &(ptSlot->tInDone));
+		ptSlot->iInPending = 0;
+	}
+	pthread_cond_broadcast(&ptThis->m_tPipelineCondition);
+	pthread_mutex_unlock(&ptThis->m_tPipelineMutex);
+}
+
+
+
+/* Submit the command in the slot and a receive transfer for the response. */
+int PapaSchlumpfFlex::__pipeline_submit(PIPELINE_SLOT_T *ptSlot, int sizCommand, unsigned int uiTimeoutMs)
+{
+	int iResult;
+	PAPA_SCHLUMPF_TRANSFER_T *ptTransferOut;
+	PAPA_SCHLUMPF_TRANSFER_T *ptTransferIn;
+
+
+	ptTransferOut = ptSlot->ptTransferOut;
+	ptTransferOut->iIn = 0;
+	ptTransferOut->pucBuffer = ptSlot->uCommand.auc;
+	ptTransferOut->sizBuffer = sizCommand;
+	/* Terminate the transaction with a ZLP if the last block is full. */
+	ptTransferOut->iAddZeroPacket = ((sizCommand&0x0000003f)==0) ? 1 : 0;
+	ptTransferOut->uiTimeoutMs = uiTimeoutMs;
+	ptTransferOut->pfnCallback = __pipeline_transfer_callback;
+	ptTransferOut->pvUser = ptSlot;
+
+	ptTransferIn = ptSlot->ptTransferIn;
+	ptTransferIn->iIn = 1;
+	if( ptSlot->pucInPlace!=NULL )
+	{
+		ptTransferIn->pucBuffer = ptSlot->pucInPlace;
+		ptTransferIn->sizBuffer = ptSlot->sizInPlace;
+	}
+	else
+	{
+		ptTransferIn->pucBuffer = ptSlot->uResponse.auc;
+		ptTransferIn->sizBuffer = sizeof(ptSlot->uResponse);
+	}
+	ptTransferIn->iAddZeroPacket = 0;
+	ptTransferIn->uiTimeoutMs = uiTimeoutMs;
+	ptTransferIn->pfnCallback = __pipeline_transfer_callback;
+	ptTransferIn->pvUser = ptSlot;
+
+	pthread_mutex_lock(&m_tPipelineMutex);
+	ptSlot->iOutPending = 1;
+	ptSlot->iInPending = 1;
+	pthread_mutex_unlock(&m_tPipelineMutex);
+
+	clock_gettime(CLOCK_MONOTONIC, &(ptSlot->tSubmitted));
+
+	iResult = m_ptTransport->submit(ptTransferOut);
+	if( iResult!=0 )
+	{
+		pthread_mutex_lock(&m_tPipelineMutex);
+		ptSlot->iOutPending = 0;
+		ptSlot->iInPending = 0;
+		pthread_mutex_unlock(&m_tPipelineMutex);
+	}
+	else
+	{
+		iResult = m_ptTransport->submit(ptTransferIn);
+		if( iResult!=0 )
+		{
+			pthread_mutex_lock(&m_tPipelineMutex);
+			ptSlot->iInPending = 0;
+			pthread_mutex_unlock(&m_tPipelineMutex);
+
+			/* Take back the command. */
+			m_ptTransport->cancel(ptTransferOut);
+			__pipeline_wait(ptSlot);
+		}
+	}
+
+	return iResult;
+}
+
+
+
+/* Submit only a receive transfer. A stream sends its transfers without further commands. */
+int PapaSchlumpfFlex::__pipeline_submit_receive(PIPELINE_SLOT_T *ptSlot, unsigned int uiTimeoutMs)
+{
+	int iResult;
+	PAPA_SCHLUMPF_TRANSFER_T *ptTransferIn;
+
+
+	ptSlot->pucInPlace = NULL;
+
+	ptTransferIn = ptSlot->ptTransferIn;
+	ptTransferIn->iIn = 1;
+	ptTransferIn->pucBuffer = ptSlot->uResponse.auc;
+	ptTransferIn->sizBuffer = sizeof(ptSlot->uResponse);
+	ptTransferIn->iAddZeroPacket = 0;
+	ptTransferIn->uiTimeoutMs = uiTimeoutMs;
+	ptTransferIn->pfnCallback = __pipeline_transfer_callback;
+	ptTransferIn->pvUser = ptSlot;
+
+	pthread_mutex_lock(&m_tPipelineMutex);
+	ptSlot->iOutPending = 0;
+	ptSlot->iInPending = 1;
+	pthread_mutex_unlock(&m_tPipelineMutex);
+
+	clock_gettime(CLOCK_MONOTONIC, &(ptSlot->tSubmitted));
+
+	iResult = m_ptTransport->submit(ptTransferIn);
+	if( iResult!=0 )
+	{
+		pthread_mutex_lock(&m_tPipelineMutex);
+		ptSlot->iInPending = 0;
+		pthread_mutex_unlock(&m_tPipelineMutex);
+	}
+
+	return iResult;
+}
+
+
+
+/* Wait until the command and the response of a slot are finished. */
+void PapaSchlumpfFlex::__pipeline_wait(PIPELINE_SLOT_T *ptSlot)
+{
+	pthread_mutex_lock(&m_tPipelineMutex);
+	while( ptSlot->iOutPending!=0 || ptSlot->iInPending!=0 )
+	{
+		pthread_cond_wait(&m_tPipelineCondition, &m_tPipelineMutex);
+	}
+	pthread_mutex_unlock(&m_tPipelineMutex);
+}
+
+
+
+void PapaSchlumpfFlex::__pipeline_cancel(PIPELINE_SLOT_T *ptSlot)
+{
+	m_ptTransport->cancel(ptSlot->ptTransferOut);
+	m_ptTransport->cancel(ptSlot->ptTransferIn);
+	__pipeline_wait(ptSlot);
+}
+
+
+
+/* Check the transfers of a finished slot and the status in the response.
+ * The response must have exactly "sizExpected" bytes.
+ */
+PAPA_SCHLUMPF_RESULT_T PapaSchlumpfFlex::__pipeline_check(PIPELINE_SLOT_T *ptSlot, int sizExpected)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	PAPA_SCHLUMPF_TRANSFER_T *ptTransferOut;
+	PAPA_SCHLUMPF_TRANSFER_T *ptTransferIn;
+	uint32_t ulCommand;
+	unsigned long ulSendUs;
+	unsigned long ulTotalUs;
+	int iTimeout;
+
+
+	memcpy(&ulCommand, ptSlot->uCommand.auc, sizeof(uint32_t));
+	ptTransferOut = ptSlot->ptTransferOut;
+	ptTransferIn = ptSlot->ptTransferIn;
+	if( ptTransferOut->tStatus!=PAPA_SCHLUMPF_TRANSFER_STATUS_Completed || ptTransferOut->sizTransfered!=ptTransferOut->sizBuffer )
+	{
+		fprintf(stderr, "%s: failed to send packet: %d\n", m_pcPluginId, ptTransferOut->tStatus);
+		tResult = PAPA_SCHLUMPF_RESULT_USBError;
+	}
+	else if( ptTransferIn->tStatus!=PAPA_SCHLUMPF_TRANSFER_STATUS_Completed )
+	{
+		fprintf(stderr, "%s: failed to receive packet: %d\n", m_pcPluginId, ptTransferIn->tStatus);
+		tResult = PAPA_SCHLUMPF_RESULT_USBError;
+	}
+	else if( ptTransferIn->sizTransfered<(int)sizeof(uint32_t) )
+	{
+		fprintf(stderr, "%s: the received packet is too small, it has only %d bytes.\n", m_pcPluginId, ptTransferIn->sizTransfered);
+		tResult = PAPA_SCHLUMPF_RESULT_USBError;
+	}
+	else if( ptSlot->uResponse.tStatus.ulStatus!=USB_COMMAND_STATUS_Ok )
+	{
+		fprintf(stderr, "%s: received an error: %d.\n", m_pcPluginId, ptSlot->uResponse.tStatus.ulStatus);
+		tResult = PAPA_SCHLUMPF_RESULT_CommandFailed;
+	}
+	else if( ptTransferIn->sizTransfered<sizExpected && ulCommand==PAPA_SCHLUMPF_USB_COMMAND_DMAMemReadArea )
+	{
+		/* The firmware ends the response early if a PCI transfer fails after the first chunk. */
+		fprintf(stderr, "%s: the PCI transfer failed after %d bytes.\n", m_pcPluginId, ptTransferIn->sizTransfered - (int)sizeof(uint32_t));
+		tResult = PAPA_SCHLUMPF_RESULT_CommandFailed;
+	}
+	else if( ptTransferIn->sizTransfered!=sizExpected )
+	{
+		fprintf(stderr, "%s: received an unexpected amount of data. wanted %d bytes, but got %d.\n", m_pcPluginId, sizExpected, ptTransferIn->sizTransfered);
+		tResult = PAPA_SCHLUMPF_RESULT_USBError;
+	}
+	else
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_Ok;
+	}
+
+	/* The response arrives after the command, so the receive time is the rest of the total time. */
+	ulSendUs = __get_difference_us(&(ptSlot->tSubmitted), &(ptSlot->tOutDone));
+	ulTotalUs = __get_difference_us(&(ptSlot->tSubmitted), &(ptSlot->tInDone));
+	iTimeout = (ptTransferOut->tStatus==PAPA_SCHLUMPF_TRANSFER_STATUS_TimedOut || ptTransferIn->tStatus==PAPA_SCHLUMPF_TRANSFER_STATUS_TimedOut) ? 1 : 0;
+	__record_statistics(ulCommand, (size_t)(ptTransferOut->sizTransfered + ptTransferIn->sizTransfered), ulSendUs, (ulTotalUs>ulSendUs) ? (ulTotalUs - ulSendUs) : 0, ulTotalUs, (tResult!=PAPA_SCHLUMPF_RESULT_Ok) ? 1 : 0, iTimeout);
+	if( m_ptTrace!=NULL )
+	{
+		/* The end of a response which was received in place is already overwritten by the status of the next one. */
+		if( ptTransferIn->tStatus!=PAPA_SCHLUMPF_TRANSFER_STATUS_Completed || ptTransferIn->sizTransfered<(int)sizeof(uint32_t) )
+		{
+			m_ptTrace->record(ptSlot->uCommand.auc, (size_t)ptTransferOut->sizBuffer, PAPA_SCHLUMPF_TRACE_STATUS_NO_RESPONSE, NULL, 0, &(ptSlot->tSubmitted), ulTotalUs);
+		}
+		else
+		{
+			m_ptTrace->record(ptSlot->uCommand.auc, (size_t)ptTransferOut->sizBuffer, ptSlot->uResponse.tStatus.ulStatus, (ptSlot->pucInPlace!=NULL) ? NULL : (ptSlot->uResponse.auc + sizeof(uint32_t)), (size_t)ptTransferIn->sizTransfered, &(ptSlot->tSubmitted), ulTotalUs);
+		}
+	}
+
+	return tResult;
+}
+
+
+
+/* Read an area in chunks. Up to PIPELINE_DEPTH read commands are in flight
+ * at the same time. The responses arrive in the same order as the commands
+ * were sent. Each chunk is passed to the consumer as soon as it arrives.
+ */
+PAPA_SCHLUMPF_RESULT_T PapaSchlumpfFlex::__pipeline_read_area(uint32_t ulAddress, uint32_t ulSize, PFN_PIPELINE_CONSUMER_T pfnConsumer, void *pvUser)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	int iResult;
+	int iDrain;
+	unsigned int uiSlotFirst;
+	unsigned int uiSlotsBusy;
+	unsigned int uiTimeoutMs;
+	uint32_t ulOffset;
+	uint32_t ulChunk;
+	uint32_t ulChunkMax;
+	PIPELINE_SLOT_T *ptSlot;
+	struct timespec tStart;
+
+
+	clock_gettime(CLOCK_MONOTONIC, &tStart);
+
 	tResult = PAPA_SCHLUMPF_RESULT_Ok;
+	uiSlotFirst = 0;
+	uiSlotsBusy = 0;
+	ulOffset = 0;
+	ulChunkMax = sizeof(m_ptPipelineSlots->uResponse.tReadArea.aucData);
+	/* A command in the pipeline must wait for all commands before it. */
+	uiTimeoutMs = __get_timeout(PIPELINE_DEPTH * sizeof(PIPELINE_COMMAND_T), PIPELINE_DEPTH, PIPELINE_DEPTH * TIMEOUT_PCI_DMA_MS);
+
+	while( tResult==PAPA_SCHLUMPF_RESULT_Ok && (ulOffset<ulSize || uiSlotsBusy!=0) )
+	{
+		/* Fill all free slots with new commands. */
+		while( ulOffset<ulSize && uiSlotsBusy<PIPELINE_DEPTH )
+		{
+			ptSlot = m_ptPipelineSlots + ((uiSlotFirst + uiSlotsBusy) % PIPELINE_DEPTH);
 
-	/* No device open yet. */
-	ptDevHandlePapaSchlumpf = NULL;
+			ulChunk = ulSize - ulOffset;
+			if( ulChunk>ulChunkMax )
+			{
+				ulChunk = ulChunkMax;
+			}
 
-	/* Get the list of all connected USB devices. */
-	ptDeviceList = NULL;
-	ssizDevList = libusb_get_device_list(m_ptLibUsbContext, &ptDeviceList);
-	if( ssizDevList<0 )
+			ptSlot->pucInPlace = NULL;
+			ptSlot->ulOffset = ulOffset;
+			ptSlot->ulChunk = ulChunk;
+			ptSlot->uCommand.tReadArea.ulCommand = PAPA_SCHLUMPF_USB_COMMAND_DMAMemReadArea;
+			ptSlot->uCommand.tReadArea.ulDeviceAddress = ulAddress + ulOffset;
+			ptSlot->uCommand.tReadArea.ulSize = ulChunk;
+			iResult = __pipeline_submit(ptSlot, sizeof(PAPA_SCHLUMPF_USB_COMMAND_DMA_MEM_READ_AREA_T), uiTimeoutMs);
+			if( iResult!=0 )
+			{
+				fprintf(stderr, "%s: failed to submit the transfer: %d:%s\n", m_pcPluginId, iResult, libusb_strerror(libusb_error(iResult)));
+				tResult = PAPA_SCHLUMPF_RESULT_USBError;
+				break;
+			}
+
+			++uiSlotsBusy;
+			ulOffset += ulChunk;
+		}
+
+		/* Wait for the oldest command. */
+		if( tResult==PAPA_SCHLUMPF_RESULT_Ok && uiSlotsBusy!=0 )
+		{
+			ptSlot = m_ptPipelineSlots + uiSlotFirst;
+			__pipeline_wait(ptSlot);
+			uiSlotFirst = (uiSlotFirst + 1U) % PIPELINE_DEPTH;
+			--uiSlotsBusy;
+
+			tResult = __pipeline_check(ptSlot, sizeof(uint32_t) + ptSlot->ulChunk);
+			if( tResult==PAPA_SCHLUMPF_RESULT_Ok )
+			{
+				tResult = pfnConsumer(pvUser, ptSlot->ulOffset, ptSlot->uResponse.tReadArea.aucData, ptSlot->ulChunk);
+			}
+		}
+	}
+
+	/* Take back all commands which are still in flight. Their responses or
+	 * the response of a timed out command might still arrive.
+	 */
+	iDrain = (uiSlotsBusy!=0 || tResult==PAPA_SCHLUMPF_RESULT_USBError) ? 1 : 0;
+	while( uiSlotsBusy!=0 )
 	{
-		/* Failed to get the list of all USB devices. */
-		fprintf(stderr, "%s: failed to detect USB devices: %ld:%s\n", m_pcPluginId, ssizDevList, libusb_strerror(libusb_error(ssizDevList)));
+		__pipeline_cancel(m_ptPipelineSlots + uiSlotFirst);
+		uiSlotFirst = (uiSlotFirst + 1U) % PIPELINE_DEPTH;
+		--uiSlotsBusy;
+	}
+	if( iDrain!=0 )
+	{
+		__drain_responses();
+	}
+
+	if( tResult==PAPA_SCHLUMPF_RESULT_Ok )
+	{
+		__sample_throughput(ulSize, &tStart);
+	}
+
+	return tResult;
+}
+
+
+
+#ifdef __linux__
+/* Read an area in chunks directly into the buffer of the caller.
+ * The response of a read command has a 4 byte status in front of the data.
+ * It is received right in front of the chunk and overwrites the last 4 bytes
+ * of the chunk below. The chunks are read from the end of the area to the
+ * start, so the chunk below always arrives later and repairs the data. The
+ * transfer callback saves the status before this happens. This works as
+ * usbfs copies the received data when the transfer is reaped, right before
+ * the callback.
+ *
+ * The first chunk has no room for the status and a response with a
+ * multiple of 64 bytes is followed by a ZLP which needs room after the data.
+ * These chunks are received in the slot and copied.
+ */
+PAPA_SCHLUMPF_RESULT_T PapaSchlumpfFlex::__pipeline_read_area_in_place(uint32_t ulAddress, uint32_t ulSize, unsigned char *pucBuffer)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	int iResult;
+	int iDrain;
+	unsigned int uiSlotFirst;
+	unsigned int uiSlotsBusy;
+	unsigned int uiTimeoutMs;
+	uint32_t ulEnd;
+	uint32_t ulOffset;
+	uint32_t ulChunk;
+	uint32_t ulChunkMax;
+	PIPELINE_SLOT_T *ptSlot;
+	struct timespec tStart;
+
+
+	clock_gettime(CLOCK_MONOTONIC, &tStart);
+
+	tResult = PAPA_SCHLUMPF_RESULT_Ok;
+	uiSlotFirst = 0;
+	uiSlotsBusy = 0;
+	ulEnd = ulSize;
+	/* Full chunks should not need a ZLP. */
+	ulChunkMax = sizeof(m_ptPipelineSlots->uResponse.tReadArea.aucData);
+	if( ((ulChunkMax + sizeof(uint32_t)) & 0x0000003fU)==0 )
+	{
+		ulChunkMax -= sizeof(uint32_t);
+	}
+	/* A command in the pipeline must wait for all commands before it. */
+	uiTimeoutMs = __get_timeout(PIPELINE_DEPTH * sizeof(PIPELINE_COMMAND_T), PIPELINE_DEPTH, PIPELINE_DEPTH * TIMEOUT_PCI_DMA_MS);
+
+	while( tResult==PAPA_SCHLUMPF_RESULT_Ok && (ulEnd!=0 || uiSlotsBusy!=0) )
+	{
+		/* Fill all free slots with new commands. */
+		while( ulEnd!=0 && uiSlotsBusy<PIPELINE_DEPTH )
+		{
+			ptSlot = m_ptPipelineSlots + ((uiSlotFirst + uiSlotsBusy) % PIPELINE_DEPTH);
+
+			ulChunk = ulEnd;
+			if( ulChunk>ulChunkMax )
+			{
+				ulChunk = ulChunkMax;
+			}
+			ulOffset = ulEnd - ulChunk;
+
+			if( ulOffset>=sizeof(uint32_t) && ((ulChunk + sizeof(uint32_t)) & 0x0000003fU)!=0 )
+			{
+				ptSlot->pucInPlace = pucBuffer + ulOffset - sizeof(uint32_t);
+				ptSlot->sizInPlace = (int)(sizeof(uint32_t) + ulChunk);
+			}
+			else
+			{
+				ptSlot->pucInPlace = NULL;
+			}
+			ptSlot->ulOffset = ulOffset;
+			ptSlot->ulChunk = ulChunk;
+			ptSlot->uCommand.tReadArea.ulCommand = PAPA_SCHLUMPF_USB_COMMAND_DMAMemReadArea;
+			ptSlot->uCommand.tReadArea.ulDeviceAddress = ulAddress + ulOffset;
+			ptSlot->uCommand.tReadArea.ulSize = ulChunk;
+			iResult = __pipeline_submit(ptSlot, sizeof(PAPA_SCHLUMPF_USB_COMMAND_DMA_MEM_READ_AREA_T), uiTimeoutMs);
+			if( iResult!=0 )
+			{
+				fprintf(stderr, "%s: failed to submit the transfer: %d:%s\n", m_pcPluginId, iResult, libusb_strerror(libusb_error(iResult)));
+				tResult = PAPA_SCHLUMPF_RESULT_USBError;
+				break;
+			}
+
+			++uiSlotsBusy;
+			ulEnd = ulOffset;
+		}
+
+		/* Wait for the oldest command. */
+		if( tResult==PAPA_SCHLUMPF_RESULT_Ok && uiSlotsBusy!=0 )
+		{
+			ptSlot = m_ptPipelineSlots + uiSlotFirst;
+			__pipeline_wait(ptSlot);
+			uiSlotFirst = (uiSlotFirst + 1U) % PIPELINE_DEPTH;
+			--uiSlotsBusy;
+
+			tResult = __pipeline_check(ptSlot, sizeof(uint32_t) + ptSlot->ulChunk);
+			if( tResult==PAPA_SCHLUMPF_RESULT_Ok && ptSlot->pucInPlace==NULL )
+			{
+				memcpy(pucBuffer + ptSlot->ulOffset, ptSlot->uResponse.tReadArea.aucData, ptSlot->ulChunk);
+			}
+		}
+	}
+
+	/* Take back all commands which are still in flight. Their responses or
+	 * the response of a timed out command might still arrive.
+	 */
+	iDrain = (uiSlotsBusy!=0 || tResult==PAPA_SCHLUMPF_RESULT_USBError) ? 1 : 0;
+	while( uiSlotsBusy!=0 )
+	{
+		__pipeline_cancel(m_ptPipelineSlots + uiSlotFirst);
+		uiSlotFirst = (uiSlotFirst + 1U) % PIPELINE_DEPTH;
+		--uiSlotsBusy;
+	}
+	if( iDrain!=0 )
+	{
+		__drain_responses();
+	}
+
+	if( tResult==PAPA_SCHLUMPF_RESULT_Ok )
+	{
+		__sample_throughput(ulSize, &tStart);
+	}
+
+	return tResult;
+}
+#endif
+
+
+
+/* Write an area in chunks. This works like __pipeline_read_area, but the
+ * producer fills the data of each chunk before the command is sent.
+ */
+PAPA_SCHLUMPF_RESULT_T PapaSchlumpfFlex::__pipeline_write_area(uint32_t ulAddress, uint32_t ulSize, PFN_PIPELINE_PRODUCER_T pfnProducer, void *pvUser)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	int iResult;
+	int iDrain;
+	unsigned int uiSlotFirst;
+	unsigned int uiSlotsBusy;
+	unsigned int uiTimeoutMs;
+	uint32_t ulOffset;
+	uint32_t ulChunk;
+	uint32_t ulChunkMax;
+	PIPELINE_SLOT_T *ptSlot;
+	struct timespec tStart;
+
+
+	clock_gettime(CLOCK_MONOTONIC, &tStart);
+
+	tResult = PAPA_SCHLUMPF_RESULT_Ok;
+	uiSlotFirst = 0;
+	uiSlotsBusy = 0;
+	ulOffset = 0;
+	ulChunkMax = sizeof(m_ptPipelineSlots->uCommand.tWriteArea.aucData);
+	/* A command in the pipeline must wait for all commands before it. */
+	uiTimeoutMs = __get_timeout(PIPELINE_DEPTH * sizeof(PIPELINE_COMMAND_T), PIPELINE_DEPTH, PIPELINE_DEPTH * TIMEOUT_PCI_DMA_MS);
+
+	while( tResult==PAPA_SCHLUMPF_RESULT_Ok && (ulOffset<ulSize || uiSlotsBusy!=0) )
+	{
+		/* Fill all free slots with new commands. */
+		while( ulOffset<ulSize && uiSlotsBusy<PIPELINE_DEPTH )
+		{
+			ptSlot = m_ptPipelineSlots + ((uiSlotFirst + uiSlotsBusy) % PIPELINE_DEPTH);
+
+			ulChunk = ulSize - ulOffset;
+			if( ulChunk>ulChunkMax )
+			{
+				ulChunk = ulChunkMax;
+			}
+
+			ptSlot->pucInPlace = NULL;
+			ptSlot->ulOffset = ulOffset;
+			ptSlot->ulChunk = ulChunk;
+			ptSlot->uCommand.tWriteArea.ulCommand = PAPA_SCHLUMPF_USB_COMMAND_DMAMemWriteArea;
+			ptSlot->uCommand.tWriteArea.ulDeviceAddress = ulAddress + ulOffset;
+			ptSlot->uCommand.tWriteArea.ulSize = ulChunk;
+			tResult = pfnProducer(pvUser, ulOffset, ptSlot->uCommand.tWriteArea.aucData, ulChunk);
+			if( tResult!=PAPA_SCHLUMPF_RESULT_Ok )
+			{
+				break;
+			}
+
+			iResult = __pipeline_submit(ptSlot, sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint32_t) + ulChunk, uiTimeoutMs);
+			if( iResult!=0 )
+			{
+				fprintf(stderr, "%s: failed to submit the transfer: %d:%s\n", m_pcPluginId, iResult, libusb_strerror(libusb_error(iResult)));
+				tResult = PAPA_SCHLUMPF_RESULT_USBError;
+				break;
+			}
+
+			++uiSlotsBusy;
+			ulOffset += ulChunk;
+		}
+
+		/* Wait for the oldest command. */
+		if( tResult==PAPA_SCHLUMPF_RESULT_Ok && uiSlotsBusy!=0 )
+		{
+			ptSlot = m_ptPipelineSlots + uiSlotFirst;
+			__pipeline_wait(ptSlot);
+			uiSlotFirst = (uiSlotFirst + 1U) % PIPELINE_DEPTH;
+			--uiSlotsBusy;
+
+			tResult = __pipeline_check(ptSlot, sizeof(PAPA_SCHLUMPF_USB_COMMAND_RESULT_STATUS_T));
+		}
+	}
+
+	/* Take back all commands which are still in flight. Their responses or
+	 * the response of a timed out command might still arrive.
+	 */
+	iDrain = (uiSlotsBusy!=0 || tResult==PAPA_SCHLUMPF_RESULT_USBError) ? 1 : 0;
+	while( uiSlotsBusy!=0 )
+	{
+		__pipeline_cancel(m_ptPipelineSlots + uiSlotFirst);
+		uiSlotFirst = (uiSlotFirst + 1U) % PIPELINE_DEPTH;
+		--uiSlotsBusy;
+	}
+	if( iDrain!=0 )
+	{
+		__drain_responses();
+	}
+
+	if( tResult==PAPA_SCHLUMPF_RESULT_Ok )
+	{
+		__sample_throughput(ulSize, &tStart);
+	}
+
+	return tResult;
+}
+
+
+
+/* Read an area with one MemReadStream command. The firmware sends all chunks
+ * without further commands. Up to PIPELINE_DEPTH receive transfers wait for
+ * them. The stream is aborted if a chunk can not be used.
+ */
+PAPA_SCHLUMPF_RESULT_T PapaSchlumpfFlex::__stream_read_area(uint32_t ulAddress, uint32_t ulSize, PFN_PIPELINE_CONSUMER_T pfnConsumer, void *pvUser)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	int iResult;
+	int iAbort;
+	int iTimeout;
+	unsigned int uiSlotFirst;
+	unsigned int uiSlotsBusy;
+	unsigned int uiTimeoutMs;
+	uint32_t ulTransfers;
+	uint32_t ulSubmitted;
+	uint32_t ulReceived;
+	uint32_t ulOffset;
+	uint32_t ulChunk;
+	uint32_t ulStatus;
+	size_t sizReceived;
+	unsigned long ulSendUs;
+	unsigned long ulTotalUs;
+	PIPELINE_SLOT_T *ptSlot;
+	PAPA_SCHLUMPF_TRANSFER_T *ptTransferIn;
+	PAPA_SCHLUMPF_USB_COMMAND_MEM_READ_STREAM_T tCommand;
+	struct timespec tStart;
+
+
+	clock_gettime(CLOCK_MONOTONIC, &tStart);
+
+	tResult = PAPA_SCHLUMPF_RESULT_Ok;
+	iAbort = 0;
+	iTimeout = 0;
+	ulStatus = PAPA_SCHLUMPF_TRACE_STATUS_NO_RESPONSE;
+	uiSlotFirst = 0;
+	uiSlotsBusy = 0;
+	ulSubmitted = 0;
+	ulReceived = 0;
+	sizReceived = 0;
+	ulTransfers = (ulSize + PAPA_SCHLUMPF_STREAM_CHUNK_SIZE - 1U) / PAPA_SCHLUMPF_STREAM_CHUNK_SIZE;
+	/* A receive transfer waits for all transfers before it. */
+	uiTimeoutMs = __get_timeout(PIPELINE_DEPTH * sizeof(PAPA_SCHLUMPF_USB_COMMAND_RESULT_MEM_READ_STREAM_T), PIPELINE_DEPTH, PIPELINE_DEPTH * TIMEOUT_PCI_DMA_MS);
+
+	tCommand.ulCommand = PAPA_SCHLUMPF_USB_COMMAND_MemReadStream;
+	tCommand.ulDeviceAddress = ulAddress;
+	tCommand.ulSize = ulSize;
+	iResult = m_ptTransport->send((const unsigned char*)&tCommand, sizeof(tCommand), uiTimeoutMs);
+	ulSendUs = __get_elapsed_us(&tStart);
+	if( iResult!=0 )
+	{
+		fprintf(stderr, "%s: failed to send packet: %d:%s\n", m_pcPluginId, iResult, libusb_strerror(libusb_error(iResult)));
+		iTimeout = (iResult==LIBUSB_ERROR_TIMEOUT) ? 1 : 0;
 		tResult = PAPA_SCHLUMPF_RESULT_USBError;
+		iAbort = 1;
 	}
-	else
+
+	while( tResult==PAPA_SCHLUMPF_RESULT_Ok && ulReceived<ulTransfers )
 	{
-		/* No Papa Schlumpf device found yet. */
-		ptDevPapaSchlumpf = NULL;
+		/* Keep receive transfers waiting for the next chunks. */
+		while( ulSubmitted<ulTransfers && uiSlotsBusy<PIPELINE_DEPTH )
+		{
+			ptSlot = m_ptPipelineSlots + ((uiSlotFirst + uiSlotsBusy) % PIPELINE_DEPTH);
+			iResult = __pipeline_submit_receive(ptSlot, uiTimeoutMs);
+			if( iResult!=0 )
+			{
+				fprintf(stderr, "%s: failed to submit the transfer: %d:%s\n", m_pcPluginId, iResult, libusb_strerror(libusb_error(iResult)));
+				tResult = PAPA_SCHLUMPF_RESULT_USBError;
+				iAbort = 1;
+				break;
+			}
 
-		/* Loop over all devices. */
-		ptDevCnt = ptDeviceList;
-		ptDevEnd = ptDevCnt + ssizDevList;
-		while( ptDevCnt<ptDevEnd )
+			++uiSlotsBusy;
+			++ulSubmitted;
+		}
+
+		if( tResult==PAPA_SCHLUMPF_RESULT_Ok )
 		{
-			ptDevice = *ptDevCnt;
+			ptSlot = m_ptPipelineSlots + uiSlotFirst;
+			__pipeline_wait(ptSlot);
+			uiSlotFirst = (uiSlotFirst + 1U) % PIPELINE_DEPTH;
+			--uiSlotsBusy;
+
+			ulOffset = ulReceived * PAPA_SCHLUMPF_STREAM_CHUNK_SIZE;
+			ulChunk = ulSize - ulOffset;
+			if( ulChunk>PAPA_SCHLUMPF_STREAM_CHUNK_SIZE )
+			{
+				ulChunk = PAPA_SCHLUMPF_STREAM_CHUNK_SIZE;
+			}
 
-			/* Try to open the device. */
-			iLibUsbResult = libusb_open(ptDevice, &ptDevHandle);
-			if( iLibUsbResult==LIBUSB_SUCCESS )
+			ptTransferIn = ptSlot->ptTransferIn;
+			if( ptTransferIn->tStatus!=PAPA_SCHLUMPF_TRANSFER_STATUS_Completed )
+			{
+				fprintf(stderr, "%s: failed to receive packet: %d\n", m_pcPluginId, ptTransferIn->tStatus);
+				iTimeout = (ptTransferIn->tStatus==PAPA_SCHLUMPF_TRANSFER_STATUS_TimedOut) ? 1 : 0;
+				tResult = PAPA_SCHLUMPF_RESULT_USBError;
+				iAbort = 1;
+			}
+			else if( ptTransferIn->sizTransfered<(int)(2U * sizeof(uint32_t)) )
+			{
+				fprintf(stderr, "%s: the received packet is too small, it has only %d bytes.\n", m_pcPluginId, ptTransferIn->sizTransfered);
+				tResult = PAPA_SCHLUMPF_RESULT_USBError;
+				iAbort = 1;
+			}
+			else
 			{
-				/* Get the device descriptor. */
-				iLibUsbResult = libusb_get_descriptor(ptDevHandle, LIBUSB_DT_DEVICE, 0, (unsigned char*)&sDevDesc, sizeof(struct libusb_device_descriptor));
-				if( iLibUsbResult==sizeof(struct libusb_device_descriptor) )
+				sizReceived += (size_t)ptTransferIn->sizTransfered;
+				ulStatus = ptSlot->uResponse.tStream.ulStatus;
+				if( ulStatus!=USB_COMMAND_STATUS_Ok )
 				{
-					printf("Looking at USB device VID=0x%04x, PID=0x%04x\n", sDevDesc.idVendor, sDevDesc.idProduct);
+					/* The firmware ends the stream after an error. */
+					fprintf(stderr, "%s: received an error: %d.\n", m_pcPluginId, ulStatus);
+					tResult = PAPA_SCHLUMPF_RESULT_CommandFailed;
+				}
+				else if( ptSlot->uResponse.tStream.ulSequence!=ulReceived )
+				{
+					fprintf(stderr, "%s: expected transfer %u of the stream, but got %u.\n", m_pcPluginId, ulReceived, ptSlot->uResponse.tStream.ulSequence);
+					tResult = PAPA_SCHLUMPF_RESULT_USBError;
+					iAbort = 1;
+				}
+				else if( ptTransferIn->sizTransfered!=(int)(2U * sizeof(uint32_t) + ulChunk) )
+				{
+					fprintf(stderr, "%s: received an unexpected amount of data. wanted %d bytes, but got %d.\n", m_pcPluginId, (int)(2U * sizeof(uint32_t) + ulChunk), ptTransferIn->sizTransfered);
+					tResult = PAPA_SCHLUMPF_RESULT_USBError;
+					iAbort = 1;
+				}
+				else
+				{
+					tResult = pfnConsumer(pvUser, ulOffset, ptSlot->uResponse.tStream.aucData, ulChunk);
+					if( tResult!=PAPA_SCHLUMPF_RESULT_Ok )
+					{
+						iAbort = 1;
+					}
+					++ulReceived;
+				}
+			}
+		}
+	}
+
+	/* The firmware ends the stream only after an error status. Stop it in all other cases. */
+	if( iAbort!=0 )
+	{
+		__stream_abort(uiSlotFirst, uiSlotsBusy, uiTimeoutMs);
+	}
+	else
+	{
+		/* Take back the receive transfers which are still waiting. */
+		while( uiSlotsBusy!=0 )
+		{
+			ptSlot = m_ptPipelineSlots + uiSlotFirst;
+			m_ptTransport->cancel(ptSlot->ptTransferIn);
+			__pipeline_wait(ptSlot);
+			uiSlotFirst = (uiSlotFirst + 1U) % PIPELINE_DEPTH;
+			--uiSlotsBusy;
+		}
+	}
+
+	/* The whole stream counts as one command. */
+	ulTotalUs = __get_elapsed_us(&tStart);
+	__record_statistics(PAPA_SCHLUMPF_USB_COMMAND_MemReadStream, sizeof(tCommand) + sizReceived, ulSendUs, (ulTotalUs>ulSendUs) ? (ulTotalUs - ulSendUs) : 0, ulTotalUs, (tResult!=PAPA_SCHLUMPF_RESULT_Ok) ? 1 : 0, iTimeout);
+	if( m_ptTrace!=NULL )
+	{
+		m_ptTrace->record((const unsigned char*)&tCommand, sizeof(tCommand), ulStatus, NULL, 0, &tStart, ulTotalUs);
+	}
+
+	if( tResult==PAPA_SCHLUMPF_RESULT_Ok )
+	{
+		__sample_throughput(ulSize, &tStart);
+	}
+
+	return tResult;
+}
 
-					/* Is this a "Papa Schlumpf" device? */
-					if( sDevDesc.idVendor==PAPA_SCHLUMPF_USB_VENDOR_ID && sDevDesc.idProduct==PAPA_SCHLUMPF_USB_PRODUCT_ID )
-					{
-						printf("Found a Papa Schlumpf device!\n");
 
-						if( ptDevPapaSchlumpf == NULL)
-						{
-							/* Check if this device is the first which gets found*/
-							ptDevPapaSchlumpf = ptDevice;
-						}
-						else
-						{
-							printf("Error! More than one Papa Schlumpf device connected!\n");
-							tResult = PAPA_SCHLUMPF_RESULT_MoreThanOneDeviceFound;
-							break;
-						}
-					}
-				}
 
-				/* Close the device. */
-				libusb_close(ptDevHandle);
-			}
+/* Stop a running stream and drop all transfers up to the answer of the abort
+ * command. The receive transfers in the uiSlotsBusy slots from uiSlotFirst on
+ * are still waiting. All slots are free afterwards. Without the answer all
+ * late transfers are dropped.
+ */
+void PapaSchlumpfFlex::__stream_abort(unsigned int uiSlotFirst, unsigned int uiSlotsBusy, unsigned int uiTimeoutMs)
+{
+	int iResult;
+	int iDone;
+	int iAnswered;
+	PIPELINE_SLOT_T *ptSlot;
+	PAPA_SCHLUMPF_TRANSFER_T *ptTransferIn;
+	PAPA_SCHLUMPF_USB_COMMAND_MEM_READ_STREAM_ABORT_T tCommand;
 
-			/* Next device in the list... */
-			++ptDevCnt;
-		}
 
-		/* Did no error occur and found a device? */
-		if( tResult==PAPA_SCHLUMPF_RESULT_Ok )
+	iAnswered = 0;
+	tCommand.ulCommand = PAPA_SCHLUMPF_USB_COMMAND_MemReadStreamAbort;
+	iResult = m_ptTransport->send((const unsigned char*)&tCommand, sizeof(tCommand), uiTimeoutMs);
+	if( iResult!=0 )
+	{
+		fprintf(stderr, "%s: failed to abort the stream: %d:%s\n", m_pcPluginId, iResult, libusb_strerror(libusb_error(iResult)));
+	}
+	else
+	{
+		iDone = 0;
+		while( iDone==0 )
 		{
-			if( ptDevPapaSchlumpf==NULL )
+			/* The firmware sends the next transfer only if the host receives the last one. */
+			while( uiSlotsBusy<PIPELINE_DEPTH )
 			{
-				fprintf(stderr, "%s: no hardware found!\n", m_pcPluginId);
-				tResult = PAPA_SCHLUMPF_RESULT_NoDeviceFound;
+				ptSlot = m_ptPipelineSlots + ((uiSlotFirst + uiSlotsBusy) % PIPELINE_DEPTH);
+				iResult = __pipeline_submit_receive(ptSlot, uiTimeoutMs);
+				if( iResult!=0 )
+				{
+					fprintf(stderr, "%s: failed to submit the transfer: %d:%s\n", m_pcPluginId, iResult, libusb_strerror(libusb_error(iResult)));
+					iDone = 1;
+					break;
+				}
+				++uiSlotsBusy;
 			}
-			else
+
+			if( uiSlotsBusy!=0 )
 			{
-				/* Open the device. */
-				iLibUsbResult = libusb_open(ptDevPapaSchlumpf, &ptDevHandlePapaSchlumpf);
-				if( iLibUsbResult==LIBUSB_SUCCESS )
+				ptSlot = m_ptPipelineSlots + uiSlotFirst;
+				__pipeline_wait(ptSlot);
+				uiSlotFirst = (uiSlotFirst + 1U) % PIPELINE_DEPTH;
+				--uiSlotsBusy;
+
+				ptTransferIn = ptSlot->ptTransferIn;
+				if( ptTransferIn->tStatus!=PAPA_SCHLUMPF_TRANSFER_STATUS_Completed )
 				{
-					/* Claim interface #0. */
-					iLibUsbResult = libusb_claim_interface(ptDevHandlePapaSchlumpf, 0);
-					if( iLibUsbResult==LIBUSB_SUCCESS )
-					{
-						/* The handle to the device is now open. */
-						m_ptDevHandlePapaSchlumpf = ptDevHandlePapaSchlumpf;
-					}
-					else
-					{
-						fprintf(stderr, "%s: failed to claim the interface: %d:%s\n", m_pcPluginId, iLibUsbResult, libusb_strerror(libusb_error(iLibUsbResult)));
-						libusb_close(ptDevHandlePapaSchlumpf);
-						tResult = PAPA_SCHLUMPF_RESULT_USBError;
-					}
+					fprintf(stderr, "%s: failed to receive the answer to the abort command: %d\n", m_pcPluginId, ptTransferIn->tStatus);
+					iDone = 1;
 				}
-				else
+				else if( ptTransferIn->sizTransfered==(int)(2U * sizeof(uint32_t)) && ptSlot->uResponse.tStream.ulSequence==PAPA_SCHLUMPF_STREAM_SEQUENCE_ABORTED )
 				{
-					fprintf(stderr, "%s: failed to open the usb devices: %d:%s\n", m_pcPluginId, iLibUsbResult, libusb_strerror(libusb_error(iLibUsbResult)));
-					tResult = PAPA_SCHLUMPF_RESULT_USBError;
+					iAnswered = 1;
+					iDone = 1;
 				}
 			}
 		}
+	}
 
-
-		/* Free the device list. */
-		if( ptDeviceList!=NULL )
-		{
-			libusb_free_device_list(ptDeviceList, 1);
-		}
+	/* Nothing follows the answer, so no data is lost here. */
+	while( uiSlotsBusy!=0 )
+	{
+		ptSlot = m_ptPipelineSlots + uiSlotFirst;
+		m_ptTransport->cancel(ptSlot->ptTransferIn);
+		__pipeline_wait(ptSlot);
+		uiSlotFirst = (uiSlotFirst + 1U) % PIPELINE_DEPTH;
+		--uiSlotsBusy;
 	}
 
-	return tResult;
+	if( iAnswered==0 )
+	{
+		__drain_responses();
+	}
 }
 
 
 
-int PapaSchlumpfFlex::__send_packet(const unsigned char *pucOutBuf, int sizOutBuf, unsigned int uiTimeoutMs)
+PAPA_SCHLUMPF_RESULT_T PapaSchlumpfFlex::__consume_to_memory(void *pvUser, uint32_t ulOffset, const unsigned char *pucData, uint32_t ulChunk)
 {
-	int iResult;
-	int iTransfered = 0;
-	/* libusb_bulk_transfer expects a non-const pointer, but this is an out transfer. */
-	unsigned char *pucBuf = (unsigned char*)pucOutBuf;
+	memcpy((unsigned char*)pvUser + ulOffset, pucData, ulChunk);
+	return PAPA_SCHLUMPF_RESULT_Ok;
+}
 
 
-	iResult = libusb_bulk_transfer(m_ptDevHandlePapaSchlumpf, 0x01, pucBuf, sizOutBuf, &iTransfered, uiTimeoutMs);
-	return iResult;
+
+PAPA_SCHLUMPF_RESULT_T PapaSchlumpfFlex::__produce_from_memory(void *pvUser, uint32_t ulOffset, unsigned char *pucData, uint32_t ulChunk)
+{
+	memcpy(pucData, (const unsigned char*)pvUser + ulOffset, ulChunk);
+	return PAPA_SCHLUMPF_RESULT_Ok;
 }
 
 
 
-int PapaSchlumpfFlex::__receivePacket(unsigned char *pucInBuf, int sizInBufMax, int *psizInBuf, unsigned int uiTimeoutMs)
+PAPA_SCHLUMPF_RESULT_T PapaSchlumpfFlex::__consume_to_file(void *pvUser, uint32_t ulOffset, const unsigned char *pucData, uint32_t ulChunk)
 {
-	int iResult;
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	PIPELINE_FILE_T *ptFile;
+	ssize_t sizWritten;
 
 
-	iResult = libusb_bulk_transfer(m_ptDevHandlePapaSchlumpf, 0x81, pucInBuf, sizInBufMax, psizInBuf, uiTimeoutMs);
-	return iResult;
+	ptFile = (PIPELINE_FILE_T*)pvUser;
+
+	tResult = PAPA_SCHLUMPF_RESULT_Ok;
+	while( ulChunk!=0 )
+	{
+		sizWritten = pwrite(ptFile->iFd, pucData, ulChunk, ptFile->tFileOffset + (off_t)ulOffset);
+		if( sizWritten<0 && errno==EINTR )
+		{
+			continue;
+		}
+		else if( sizWritten<=0 )
+		{
+			fprintf(stderr, "%s: failed to write to the file: %s\n", ptFile->pcPluginId, strerror(errno));
+			tResult = PAPA_SCHLUMPF_RESULT_FileError;
+			break;
+		}
+
+		pucData += sizWritten;
+		ulOffset += (uint32_t)sizWritten;
+		ulChunk -= (uint32_t)sizWritten;
+	}
+
+	return tResult;
 }
 
 
 
-void PapaSchlumpfFlex::__disconnect(void)
+PAPA_SCHLUMPF_RESULT_T PapaSchlumpfFlex::__produce_from_file(void *pvUser, uint32_t ulOffset, unsigned char *pucData, uint32_t ulChunk)
 {
-	if( m_ptLibUsbContext!=NULL )
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	PIPELINE_FILE_T *ptFile;
+	ssize_t sizRead;
+
+
+	ptFile = (PIPELINE_FILE_T*)pvUser;
+
+	tResult = PAPA_SCHLUMPF_RESULT_Ok;
+	while( ulChunk!=0 )
 	{
-		if( m_ptDevHandlePapaSchlumpf!=NULL )
+		sizRead = pread(ptFile->iFd, pucData, ulChunk, ptFile->tFileOffset + (off_t)ulOffset);
+		if( sizRead<0 && errno==EINTR )
 		{
-			/* Release and close the handle. */
-			libusb_release_interface(m_ptDevHandlePapaSchlumpf, 0);
-			libusb_close(m_ptDevHandlePapaSchlumpf);
-
-			m_ptDevHandlePapaSchlumpf = NULL;
+			continue;
+		}
+		else if( sizRead<=0 )
+		{
+			fprintf(stderr, "%s: failed to read from the file: %s\n", ptFile->pcPluginId, (sizRead==0) ? "unexpected end of file" : strerror(errno));
+			tResult = PAPA_SCHLUMPF_RESULT_FileError;
+			break;
 		}
 
-		/* Close the libusb context. */
-		libusb_exit(m_ptLibUsbContext);
-		m_ptLibUsbContext = NULL;
+		pucData += sizRead;
+		ulOffset += (uint32_t)sizRead;
+		ulChunk -= (uint32_t)sizRead;
+	}
+
+	return tResult;
+}
+
+
+
+void PapaSchlumpfFlex::__disconnect(void)
+{
+	/* Stop the event handling before the transport is closed. */
+	__pipeline_stop();
+
+	if( m_ptTransport!=NULL )
+	{
+		/* The USB transport releases and closes the handle. */
+		delete m_ptTransport;
+		m_ptTransport = NULL;
 	}
 
+	/* The shared libusb context stays open for the next connect. */
+	m_ptLibUsbContext = NULL;
+
 	/* On a disconnect all plugins are automatically disconnected. */
 	m_uiPluginConnections = 0;
 }
@@ -1405,6 +4423,379 @@ void run_test(void)
 
 
 
+const PapaSchlumpfFlex::COMMAND_NAME_T PapaSchlumpfFlex::atCommandNames[] =
+{
+	{ PAPA_SCHLUMPF_USB_COMMAND_GetFirmwareVersion, "GetFirmwareVersion" },
+	{ PAPA_SCHLUMPF_USB_COMMAND_ResetPCI,           "ResetPCI" },
+	{ PAPA_SCHLUMPF_USB_COMMAND_DMAIoRead,          "DMAIoRead" },
+	{ PAPA_SCHLUMPF_USB_COMMAND_DMAMemRead,         "DMAMemRead" },
+	{ PAPA_SCHLUMPF_USB_COMMAND_DMACfg0Read,        "DMACfg0Read" },
+	{ PAPA_SCHLUMPF_USB_COMMAND_DMACfg1Read,        "DMACfg1Read" },
+	{ PAPA_SCHLUMPF_USB_COMMAND_DMAIoWrite,         "DMAIoWrite" },
+	{ PAPA_SCHLUMPF_USB_COMMAND_DMAMemWrite,        "DMAMemWrite" },
+	{ PAPA_SCHLUMPF_USB_COMMAND_DMACfg0Write,       "DMACfg0Write" },
+	{ PAPA_SCHLUMPF_USB_COMMAND_DMACfg1Write,       "DMACfg1Write" },
+	{ PAPA_SCHLUMPF_USB_COMMAND_DMAMemReadArea,     "DMAMemReadArea" },
+	{ PAPA_SCHLUMPF_USB_COMMAND_DMAMemWriteArea,    "DMAMemWriteArea" },
+	{ PAPA_SCHLUMPF_USB_COMMAND_SetPCIReset,        "SetPCIReset" },
+	{ PAPA_SCHLUMPF_USB_COMMAND_SetupNetx,          "SetupNetx" },
+	{ PAPA_SCHLUMPF_USB_COMMAND_Batch,              "Batch" },
+	{ PAPA_SCHLUMPF_USB_COMMAND_DmaListUpload,      "DmaListUpload" },
+	{ PAPA_SCHLUMPF_USB_COMMAND_DmaListRun,         "DmaListRun" },
+	{ PAPA_SCHLUMPF_USB_COMMAND_DMAMemModify,       "DMAMemModify" },
+	{ PAPA_SCHLUMPF_USB_COMMAND_DMAIoModify,        "DMAIoModify" },
+	{ PAPA_SCHLUMPF_USB_COMMAND_PollMem,            "PollMem" },
+	{ PAPA_SCHLUMPF_USB_COMMAND_MemChecksum,        "MemChecksum" },
+	{ PAPA_SCHLUMPF_USB_COMMAND_MemFill,            "MemFill" },
+	{ PAPA_SCHLUMPF_USB_COMMAND_MemCopy,            "MemCopy" },
+	{ PAPA_SCHLUMPF_USB_COMMAND_MemReadScatter,     "MemReadScatter" },
+	{ PAPA_SCHLUMPF_USB_COMMAND_MemWriteScatter,    "MemWriteScatter" },
+	{ PAPA_SCHLUMPF_USB_COMMAND_DMACfg0ReadArea,    "DMACfg0ReadArea" },
+	{ PAPA_SCHLUMPF_USB_COMMAND_DMACfg1ReadArea,    "DMACfg1ReadArea" },
+	{ PAPA_SCHLUMPF_USB_COMMAND_EnumerateBus,       "EnumerateBus" },
+	{ PAPA_SCHLUMPF_USB_COMMAND_MemReadStream,      "MemReadStream" },
+	{ PAPA_SCHLUMPF_USB_COMMAND_MemReadStreamAbort, "MemReadStreamAbort" }
+};
+
+
+
+/* Push a table with the statistics since the last reset.
+ * The field "seconds" is the wall clock time since the reset. Compare it with
+ * the sum of the "totalUs" fields to see how much time is spent outside the
+ * USB transfers, e.g. in Lua. The field "commands" has one entry for each
+ * command which was used. The key is the name of the command. Each entry has
+ * the number of calls, the bytes in both directions, the number of errors
+ * and timeouts, the sum of the send, receive and total times in
+ * microseconds and a latency histogram. Each element of the histogram has
+ * the upper limit of the bucket in microseconds and the number of commands.
+ */
+void PapaSchlumpfFlex::getStatistics(lua_State *MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT)
+{
+	const COMMAND_STATISTICS_T *ptStatistics;
+	const COMMAND_NAME_T *ptCnt, *ptEnd;
+	unsigned int uiBucket;
+	lua_Integer iIndex;
+
+
+	lua_newtable(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT);
+	lua_pushnumber(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, (lua_Number)__get_elapsed_us(&m_tStatisticsStart) / 1000000.0);
+	lua_setfield(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, -2, "seconds");
+
+	lua_newtable(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT);
+	ptCnt = atCommandNames;
+	ptEnd = atCommandNames + (sizeof(atCommandNames)/sizeof(atCommandNames[0]));
+	while( ptCnt<ptEnd )
+	{
+		ptStatistics = m_atStatistics + ptCnt->ulCommand;
+		if( ptStatistics->ulCalls!=0 )
+		{
+			lua_newtable(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT);
+			lua_pushnumber(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, ptCnt->ulCommand);
+			lua_setfield(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, -2, "id");
+			lua_pushnumber(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, ptStatistics->ulCalls);
+			lua_setfield(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, -2, "calls");
+			lua_pushnumber(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, (lua_Number)ptStatistics->ullBytes);
+			lua_setfield(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, -2, "bytes");
+			lua_pushnumber(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, ptStatistics->ulErrors);
+			lua_setfield(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, -2, "errors");
+			lua_pushnumber(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, ptStatistics->ulTimeouts);
+			lua_setfield(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, -2, "timeouts");
+			lua_pushnumber(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, (lua_Number)ptStatistics->ullSendUs);
+			lua_setfield(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, -2, "sendUs");
+			lua_pushnumber(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, (lua_Number)ptStatistics->ullReceiveUs);
+			lua_setfield(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, -2, "receiveUs");
+			lua_pushnumber(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, (lua_Number)ptStatistics->ullTotalUs);
+			lua_setfield(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, -2, "totalUs");
+
+			lua_newtable(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT);
+			iIndex = 1;
+			for(uiBucket=0; uiBucket<STATISTICS_HISTOGRAM_BUCKETS; ++uiBucket)
+			{
+				if( ptStatistics->aulHistogram[uiBucket]!=0 )
+				{
+					lua_newtable(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT);
+					if( uiBucket<(STATISTICS_HISTOGRAM_BUCKETS - 1U) )
+					{
+						lua_pushnumber(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, (lua_Number)((2UL << uiBucket) - 1UL));
+						lua_setfield(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, -2, "maxUs");
+					}
+					lua_pushnumber(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, ptStatistics->aulHistogram[uiBucket]);
+					lua_setfield(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, -2, "count");
+					lua_rawseti(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, -2, iIndex);
+					++iIndex;
+				}
+			}
+			lua_setfield(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, -2, "histogram");
+
+			lua_setfield(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, -2, ptCnt->pcName);
+		}
+		++ptCnt;
+	}
+	lua_setfield(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, -2, "commands");
+}
+
+
+
+void PapaSchlumpfFlex::resetStatistics(void)
+{
+	memset(m_atStatistics, 0, sizeof(m_atStatistics));
+	clock_gettime(CLOCK_MONOTONIC, &m_tStatisticsStart);
+}
+
+
+
+/* Record all following commands and responses in a ring buffer with
+ * ulBufferSize bytes. If the buffer is full, the oldest records are dropped.
+ * Without iWithPayload only the first bytes of each command and response are
+ * stored. This is enough to replay all commands except the data of area
+ * writes, batches and DMA lists.
+ * A running trace is discarded.
+ */
+RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::traceStart(uint32_t ulBufferSize, int iWithPayload)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	PapaSchlumpfTrace *ptTrace;
+
+
+	if( m_ptTrace!=NULL )
+	{
+		delete m_ptTrace;
+		m_ptTrace = NULL;
+	}
+
+	ptTrace = new PapaSchlumpfTrace();
+	tResult = ptTrace->start(ulBufferSize, iWithPayload);
+	if( tResult==PAPA_SCHLUMPF_RESULT_Ok )
+	{
+		m_ptTrace = ptTrace;
+	}
+	else
+	{
+		delete ptTrace;
+	}
+
+	return tResult;
+}
+
+
+
+/* Stop the trace and write the records to the file pcPath.
+ * Without a path the records are discarded. Nothing happens if no trace is running.
+ */
+RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfFlex::traceStop(const char *pcPath)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+
+
+	tResult = PAPA_SCHLUMPF_RESULT_Ok;
+	if( m_ptTrace!=NULL )
+	{
+		if( pcPath!=NULL )
+		{
+			tResult = m_ptTrace->save(pcPath);
+		}
+		delete m_ptTrace;
+		m_ptTrace = NULL;
+	}
+
+	return tResult;
+}
+
+
+
+/* Send all commands of a trace file to the connected device and compare the
+ * results with the recording. The commands are sent one after the other
+ * without the pauses of the recording, so the times show only the USB
+ * transfers and the firmware. A trace recorded without the payload of the
+ * commands can not be replayed.
+ * Push a table with the fields "records", "dropped" (the records which were
+ * lost in the ring buffer during the recording), "recordedUs", "replayedUs",
+ * "statusMismatches" and "responseMismatches". The field "commands" has the
+ * number of calls and both times for each command.
+ */
+RESULT_INT_NOTHING_OR_NIL_WITH_ERR PapaSchlumpfFlex::replayTrace(const char *pcPath, lua_State *MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	PapaSchlumpfTraceReader tReader;
+	PAPA_SCHLUMPF_TRACE_FILE_HEADER_T tHeader;
+	PAPA_SCHLUMPF_TRACE_RECORD_T tRecord;
+	PIPELINE_COMMAND_T uCommand;
+	PIPELINE_RESPONSE_T uResponse;
+	unsigned char aucRecordedData[sizeof(PIPELINE_RESPONSE_T)];
+	int iRecord;
+	int iResult;
+	int iTransfered;
+	uint32_t ulStatus;
+	uint32_t ulTransfers;
+	uint32_t ulTransfer;
+	struct timespec tStart;
+	unsigned long ulReplayedUs;
+	unsigned long ulRecords;
+	unsigned long ulStatusMismatches;
+	unsigned long ulResponseMismatches;
+	unsigned long long ullRecordedUs;
+	unsigned long long ullReplayedUs;
+	unsigned long aulCalls[STATISTICS_COMMANDS];
+	unsigned long long aullRecordedUs[STATISTICS_COMMANDS];
+	unsigned long long aullReplayedUs[STATISTICS_COMMANDS];
+	const COMMAND_NAME_T *ptCnt, *ptEnd;
+
+
+	if( m_ptTransport==NULL )
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_NotConnected;
+	}
+	else
+	{
+		tResult = tReader.open(pcPath, &tHeader);
+		if( tResult==PAPA_SCHLUMPF_RESULT_Ok )
+		{
+			ulRecords = 0;
+			ulStatusMismatches = 0;
+			ulResponseMismatches = 0;
+			ullRecordedUs = 0;
+			ullReplayedUs = 0;
+			memset(aulCalls, 0, sizeof(aulCalls));
+			memset(aullRecordedUs, 0, sizeof(aullRecordedUs));
+			memset(aullReplayedUs, 0, sizeof(aullReplayedUs));
+
+			do
+			{
+				iRecord = tReader.read(&tRecord, uCommand.auc, sizeof(uCommand), aucRecordedData, sizeof(aucRecordedData));
+				if( iRecord<0 )
+				{
+					tResult = PAPA_SCHLUMPF_RESULT_FileError;
+				}
+				else if( iRecord>0 && tRecord.usCommandStored<tRecord.usCommandSize )
+				{
+					/* Do not send the zeros instead of the missing payload to the device. */
+					fprintf(stderr, "%s: record %lu has only %d of %d bytes of the command. Record the trace with the payload to replay it.\n", m_pcPluginId, ulRecords, tRecord.usCommandStored, tRecord.usCommandSize);
+					tResult = PAPA_SCHLUMPF_RESULT_FileError;
+				}
+				else if( iRecord>0 && tRecord.usCommandSize!=0 )
+				{
+					clock_gettime(CLOCK_MONOTONIC, &tStart);
+
+					iResult = __send_packet(uCommand.auc, tRecord.usCommandSize);
+					if( iResult==0 )
+					{
+						/* Allow twice the recorded time for slow commands like a PCI reset. */
+						iResult = __receivePacket(uResponse.auc, sizeof(uResponse), &iTransfered, (tRecord.ulDurationUs * 2U) / 1000U, 1);
+					}
+					if( iResult==0 && tRecord.ulCommand==PAPA_SCHLUMPF_USB_COMMAND_MemReadStream )
+					{
+						/* A stream has one transfer for each chunk. The firmware ends it after an error.
+						 * The trace has only the last status of a stream and no data.
+						 */
+						ulTransfers = (uCommand.tStream.ulSize + PAPA_SCHLUMPF_STREAM_CHUNK_SIZE - 1U) / PAPA_SCHLUMPF_STREAM_CHUNK_SIZE;
+						ulTransfer = 1;
+						while( iResult==0 && ulTransfer<ulTransfers && iTransfered>=(int)(2U * sizeof(uint32_t)) && uResponse.tStream.ulStatus==USB_COMMAND_STATUS_Ok )
+						{
+							iResult = __receivePacket(uResponse.auc, sizeof(uResponse), &iTransfered, 0, 1);
+							++ulTransfer;
+						}
+					}
+					ulReplayedUs = __get_elapsed_us(&tStart);
+					if( iResult!=0 )
+					{
+						fprintf(stderr, "%s: failed to replay record %lu: %d:%s\n", m_pcPluginId, ulRecords, iResult, libusb_strerror(libusb_error(iResult)));
+						tResult = PAPA_SCHLUMPF_RESULT_USBError;
+					}
+					else
+					{
+						ulStatus = PAPA_SCHLUMPF_TRACE_STATUS_NO_RESPONSE;
+						if( iTransfered>=(int)sizeof(uint32_t) )
+						{
+							ulStatus = uResponse.tStatus.ulStatus;
+						}
+						if( ulStatus!=tRecord.ulStatus )
+						{
+							++ulStatusMismatches;
+						}
+						else if( tRecord.ulCommand!=PAPA_SCHLUMPF_USB_COMMAND_MemReadStream && (iTransfered!=tRecord.usResponseSize || memcmp(uResponse.auc + sizeof(uint32_t), aucRecordedData, tRecord.usResponseStored)!=0) )
+						{
+							++ulResponseMismatches;
+						}
+
+						++ulRecords;
+						ullRecordedUs += tRecord.ulDurationUs;
+						ullReplayedUs += ulReplayedUs;
+						if( tRecord.ulCommand<STATISTICS_COMMANDS )
+						{
+							++aulCalls[tRecord.ulCommand];
+							aullRecordedUs[tRecord.ulCommand] += tRecord.ulDurationUs;
+							aullReplayedUs[tRecord.ulCommand] += ulReplayedUs;
+						}
+					}
+				}
+			} while( tResult==PAPA_SCHLUMPF_RESULT_Ok && iRecord>0 );
+
+			tReader.close();
+
+			if( tResult==PAPA_SCHLUMPF_RESULT_Ok )
+			{
+				lua_newtable(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT);
+				lua_pushnumber(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, ulRecords);
+				lua_setfield(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, -2, "records");
+				lua_pushnumber(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, tHeader.ulDropped);
+				lua_setfield(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, -2, "dropped");
+				lua_pushnumber(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, (lua_Number)ullRecordedUs);
+				lua_setfield(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, -2, "recordedUs");
+				lua_pushnumber(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, (lua_Number)ullReplayedUs);
+				lua_setfield(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, -2, "replayedUs");
+				lua_pushnumber(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, ulStatusMismatches);
+				lua_setfield(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, -2, "statusMismatches");
+				lua_pushnumber(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, ulResponseMismatches);
+				lua_setfield(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, -2, "responseMismatches");
+
+				lua_newtable(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT);
+				ptCnt = atCommandNames;
+				ptEnd = atCommandNames + (sizeof(atCommandNames)/sizeof(atCommandNames[0]));
+				while( ptCnt<ptEnd )
+				{
+					if( aulCalls[ptCnt->ulCommand]!=0 )
+					{
+						lua_newtable(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT);
+						lua_pushnumber(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, aulCalls[ptCnt->ulCommand]);
+						lua_setfield(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, -2, "calls");
+						lua_pushnumber(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, (lua_Number)aullRecordedUs[ptCnt->ulCommand]);
+						lua_setfield(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, -2, "recordedUs");
+						lua_pushnumber(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, (lua_Number)aullReplayedUs[ptCnt->ulCommand]);
+						lua_setfield(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, -2, "replayedUs");
+						lua_setfield(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, -2, ptCnt->pcName);
+					}
+					++ptCnt;
+				}
+				lua_setfield(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, -2, "commands");
+			}
+		}
+	}
+
+	return tResult;
+}
+
+
+
+/* Set a fixed timeout for all following transfers. 0 selects the adaptive
+ * timeouts again. Use this around single calls which need more time than the
+ * estimates allow, e.g. a slow PCI device.
+ */
+void PapaSchlumpfFlex::setTimeout(unsigned int uiTimeoutMs)
+{
+	m_uiTimeoutOverrideMs = uiTimeoutMs;
+}
+
+
+
+/* Get the current estimates for the round trip time of a small command and the throughput of area transfers. */
+void PapaSchlumpfFlex::getLinkEstimate(PUL_ARGUMENT_OUT pulLatencyUs, PUL_ARGUMENT_OUT pulBytesPerSecond)
+{
+	*pulLatencyUs = m_ulLatencyUs;
+	*pulBytesPerSecond = m_ulBytesPerSecond;
+}
+
+
+
 const PapaSchlumpfFlex::ERRORMESSAGE_T PapaSchlumpfFlex::atErrorMessages[] =
 {
 	{
@@ -1430,12 +4821,39 @@ const PapaSchlumpfFlex::ERRORMESSAGE_T PapaSchlumpfFlex::atErrorMessages[] =
 	{
 		PAPA_SCHLUMPF_RESULT_CommandFailed,
 		"The Papa Schlumpf device returned an error running the command."
+	},
+	{
+		PAPA_SCHLUMPF_RESULT_InvalidSize,
+		"The size is invalid."
+	},
+	{
+		PAPA_SCHLUMPF_RESULT_OutOfMemory,
+		"Failed to allocate memory."
+	},
+	{
+		PAPA_SCHLUMPF_RESULT_UnknownProgram,
+		"The Papa Schlumpf device does not know the DMA list program. Upload it again."
+	},
+	{
+		PAPA_SCHLUMPF_RESULT_FileError,
+		"Failed to access the file. Please examine the debug log for details."
+	},
+	{
+		PAPA_SCHLUMPF_RESULT_InvalidJob,
+		"The job description is invalid. Please examine the debug log for details."
 	}
 };
 
 
 
 const char *PapaSchlumpfFlex::get_error_string(int iResult)
+{
+	return __get_error_string(iResult);
+}
+
+
+
+const char *PapaSchlumpfFlex::__get_error_string(int iResult)
 {
 	PAPA_SCHLUMPF_RESULT_T tResult;
 	const char *pcErrorString;
@@ -4,6 +4,12 @@
 
 #ifndef SWIG
 #include <libusb.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include "papa_schlumpf_firmware_interface.h"
+#include "papa_schlumpf_transport.h"
 #endif
 
 
@@ -16,6 +22,15 @@ typedef char ** PPC_ARGUMENT_OUT;
 typedef int RESULT_INT_TRUE_OR_NIL_WITH_ERR;
 typedef int RESULT_INT_NOTHING_OR_NIL_WITH_ERR;
 typedef int RESULT_INT_INT_OR_NIL_WITH_ERR;
+typedef int RESULT_INT_NOTHING_OR_NIL_WITH_ERR_AND_CODE;
+
+/* This is compatible with the definition in lua.h . */
+typedef struct lua_State lua_State;
+
+#ifndef SWIG
+/* The trace recorder is only used internally. */
+class PapaSchlumpfTrace;
+#endif
 
 
 typedef enum PAPA_SCHLUMPF_RESULT_ENUM
@@ -27,17 +42,46 @@ typedef enum PAPA_SCHLUMPF_RESULT_ENUM
 	PAPA_SCHLUMPF_RESULT_NoDeviceFound = -4,
 	PAPA_SCHLUMPF_RESULT_CommandFailed = -5,
 	PAPA_SCHLUMPF_RESULT_InvalidSize = -6,
-	PAPA_SCHLUMPF_RESULT_OutOfMemory = -7
+	PAPA_SCHLUMPF_RESULT_OutOfMemory = -7,
+	PAPA_SCHLUMPF_RESULT_UnknownProgram = -8,
+	PAPA_SCHLUMPF_RESULT_FileError = -9,
+	PAPA_SCHLUMPF_RESULT_InvalidJob = -10
 } PAPA_SCHLUMPF_RESULT_T;
 
 
+/* A buffer which can be reused for several reads.
+ * The read functions receive the data directly into this buffer. Lua gets
+ * only copies of the parts which are really needed.
+ */
+class PapaSchlumpfBuffer
+{
+public:
+	PapaSchlumpfBuffer(size_t sizBuffer);
+	~PapaSchlumpfBuffer(void);
+
+	size_t size(void);
+	void get(size_t sizOffset, size_t sizLength, lua_State *MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT);
+	void fill(unsigned char ucValue);
+
+#ifndef SWIG
+	unsigned char *data(void);
+
+private:
+	unsigned char *m_pucBuffer;
+	size_t m_sizBuffer;
+#endif
+};
+
+
 class PapaSchlumpfFlex
 {
 public:
 	PapaSchlumpfFlex(void);
 	~PapaSchlumpfFlex(void);
 
-	RESULT_INT_TRUE_OR_NIL_WITH_ERR connect(void);
+	RESULT_INT_NOTHING_OR_NIL_WITH_ERR listDevices(lua_State *MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT);
+	RESULT_INT_TRUE_OR_NIL_WITH_ERR connect(const char *pcSelector=NULL);
+	RESULT_INT_TRUE_OR_NIL_WITH_ERR reconnect(void);
 	RESULT_INT_NOTHING_OR_NIL_WITH_ERR getFirmwareVersion(PUL_ARGUMENT_OUT pulVersionMajor, PUL_ARGUMENT_OUT pulVersionMinor, PUL_ARGUMENT_OUT pulVersionSub, PPC_ARGUMENT_OUT ppcVcsVersion);
 	RESULT_INT_TRUE_OR_NIL_WITH_ERR resetPCI(uint32_t ulResetActiveToClock, uint32_t ulResetActiveDelayAfterClock, uint32_t ulBusIdleDelay);
 	RESULT_INT_TRUE_OR_NIL_WITH_ERR setPCIReset(uint32_t ulResetState);
@@ -45,26 +89,210 @@ public:
 	RESULT_INT_NOTHING_OR_NIL_WITH_ERR ioRead(uint32_t ulAddress, PUL_ARGUMENT_OUT pulData);
 	RESULT_INT_NOTHING_OR_NIL_WITH_ERR memRead(uint32_t ulAddress, PUL_ARGUMENT_OUT pulData);
 	RESULT_INT_NOTHING_OR_NIL_WITH_ERR memReadArea(uint32_t ulAddress, uint32_t ulSize, char **ppcBUFFER_OUT, size_t *psizBUFFER_OUT);
+	RESULT_INT_TRUE_OR_NIL_WITH_ERR memReadAreaToBuffer(uint32_t ulAddress, uint32_t ulSize, PapaSchlumpfBuffer *ptBuffer, uint32_t ulBufferOffset);
+	RESULT_INT_TRUE_OR_NIL_WITH_ERR memReadAreaToFile(uint32_t ulAddress, uint32_t ulSize, const char *pcPath);
+	RESULT_INT_NOTHING_OR_NIL_WITH_ERR memReadStream(uint32_t ulAddress, uint32_t ulSize, char **ppcBUFFER_OUT, size_t *psizBUFFER_OUT);
+	RESULT_INT_TRUE_OR_NIL_WITH_ERR memReadStreamToFile(uint32_t ulAddress, uint32_t ulSize, const char *pcPath);
 	RESULT_INT_NOTHING_OR_NIL_WITH_ERR cfg0Read(uint32_t ulAddress, PUL_ARGUMENT_OUT pulData);
 	RESULT_INT_NOTHING_OR_NIL_WITH_ERR cfg1Read(uint32_t ulAddress, PUL_ARGUMENT_OUT pulData);
+	RESULT_INT_NOTHING_OR_NIL_WITH_ERR cfg0ReadArea(uint32_t ulAddress, uint32_t ulSize, char **ppcBUFFER_OUT, size_t *psizBUFFER_OUT);
+	RESULT_INT_NOTHING_OR_NIL_WITH_ERR cfg1ReadArea(uint32_t ulAddress, uint32_t ulSize, char **ppcBUFFER_OUT, size_t *psizBUFFER_OUT);
 	RESULT_INT_TRUE_OR_NIL_WITH_ERR ioWrite(uint32_t ulAddress, uint32_t ulData);
 	RESULT_INT_TRUE_OR_NIL_WITH_ERR memWrite(uint32_t ulAddress, uint32_t ulData);
 	RESULT_INT_TRUE_OR_NIL_WITH_ERR memWriteArea(uint32_t ulAddress, const char *pcBUFFER_IN, size_t sizBUFFER_IN);
+	RESULT_INT_TRUE_OR_NIL_WITH_ERR memWriteAreaFromFile(uint32_t ulAddress, const char *pcPath, uint32_t ulFileOffset, uint32_t ulSize);
 	RESULT_INT_TRUE_OR_NIL_WITH_ERR cfg0Write(uint32_t ulAddress, uint32_t ulData);
 	RESULT_INT_TRUE_OR_NIL_WITH_ERR cfg1Write(uint32_t ulAddress, uint32_t ulData);
+	RESULT_INT_NOTHING_OR_NIL_WITH_ERR ioModify(uint32_t ulAddress, uint32_t ulMask, uint32_t ulData, PUL_ARGUMENT_OUT pulOldData);
+	RESULT_INT_NOTHING_OR_NIL_WITH_ERR memModify(uint32_t ulAddress, uint32_t ulMask, uint32_t ulData, PUL_ARGUMENT_OUT pulOldData);
+	RESULT_INT_TRUE_OR_NIL_WITH_ERR memFill(uint32_t ulAddress, uint32_t ulSize, const char *pcBUFFER_IN, size_t sizBUFFER_IN);
+	RESULT_INT_TRUE_OR_NIL_WITH_ERR memCopy(uint32_t ulDestinationAddress, uint32_t ulSourceAddress, uint32_t ulSize);
+	RESULT_INT_NOTHING_OR_NIL_WITH_ERR memReadScatter(const char *pcBUFFER_IN, size_t sizBUFFER_IN, char **ppcBUFFER_OUT, size_t *psizBUFFER_OUT);
+	RESULT_INT_TRUE_OR_NIL_WITH_ERR memWriteScatter(const char *pcBUFFER_IN, size_t sizBUFFER_IN);
+	RESULT_INT_NOTHING_OR_NIL_WITH_ERR memChecksum(uint32_t ulAddress, uint32_t ulSize, PUL_ARGUMENT_OUT pulChecksum);
+	void checksum(const char *pcBUFFER_IN, size_t sizBUFFER_IN, PUL_ARGUMENT_OUT pulChecksum);
+	RESULT_INT_NOTHING_OR_NIL_WITH_ERR pollMem(uint32_t ulType, uint32_t ulAddress, uint32_t ulMask, uint32_t ulExpected, uint32_t ulTimeoutUs, PUL_ARGUMENT_OUT pulMatched, PUL_ARGUMENT_OUT pulData, PUL_ARGUMENT_OUT pulIterations, PUL_ARGUMENT_OUT pulElapsedUs);
+	RESULT_INT_NOTHING_OR_NIL_WITH_ERR enumerateBus(uint32_t ulFlags, PUL_ARGUMENT_OUT pulTruncated, char **ppcBUFFER_OUT, size_t *psizBUFFER_OUT);
+	RESULT_INT_NOTHING_OR_NIL_WITH_ERR executeBatch(const char *pcBUFFER_IN, size_t sizBUFFER_IN, char **ppcBUFFER_OUT, size_t *psizBUFFER_OUT);
+	RESULT_INT_NOTHING_OR_NIL_WITH_ERR dmaListUpload(const char *pcBUFFER_IN, size_t sizBUFFER_IN, PUL_ARGUMENT_OUT pulProgramId, PUL_ARGUMENT_OUT pulProgramHash);
+	RESULT_INT_NOTHING_OR_NIL_WITH_ERR_AND_CODE dmaListRun(uint32_t ulProgramId, uint32_t ulProgramHash, PUL_ARGUMENT_OUT pulFailure, PUL_ARGUMENT_OUT pulFailedIndex, PUL_ARGUMENT_OUT pulFailedValue, char **ppcBUFFER_OUT, size_t *psizBUFFER_OUT);
 	RESULT_INT_TRUE_OR_NIL_WITH_ERR disconnect(void);
 	RESULT_INT_TRUE_OR_NIL_WITH_ERR plugin_connect(void);
 	RESULT_INT_TRUE_OR_NIL_WITH_ERR plugin_disconnect(void);
 
+	void setTimeout(unsigned int uiTimeoutMs);
+	void getLinkEstimate(PUL_ARGUMENT_OUT pulLatencyUs, PUL_ARGUMENT_OUT pulBytesPerSecond);
+
+	void getStatistics(lua_State *MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT);
+	void resetStatistics(void);
+
+	RESULT_INT_TRUE_OR_NIL_WITH_ERR traceStart(uint32_t ulBufferSize, int iWithPayload);
+	RESULT_INT_TRUE_OR_NIL_WITH_ERR traceStop(const char *pcPath=NULL);
+	RESULT_INT_NOTHING_OR_NIL_WITH_ERR replayTrace(const char *pcPath, lua_State *MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT);
+
 	const char *get_error_string(int iResult);
 
 /* Do not wrap the private members. */
 #ifndef SWIG
+	/* Read an area directly into a buffer of the caller. The buffer must have at least ulSize bytes. */
+	PAPA_SCHLUMPF_RESULT_T memReadArea(uint32_t ulAddress, uint32_t ulSize, void *pvBuffer);
+
+	/* Connect to a firmware through another transport than USB, e.g. a simulator.
+	 * The object takes the ownership of the transport.
+	 */
+	PAPA_SCHLUMPF_RESULT_T connectTransport(PapaSchlumpfTransport *ptTransport);
+
+	/* Close the shared libusb context. This is called when the plugin is unloaded. */
+	static void __close_libusb_context(void);
+
 private:
-	PAPA_SCHLUMPF_RESULT_T __scan_for_papa_schlumpf_hardware(void);
-	int __send_packet(const unsigned char *pucOutBuf, int sizOutBuf, unsigned int uiTimeoutMs);
-	int __receivePacket(unsigned char *pucInBuf, int sizInBufMax, int *psizInBuf, unsigned int uiTimeoutMs);
+	/* The orchestrator and the hotplug tracker use the shared context, the device helpers and the error messages. */
+	friend class PapaSchlumpfOrchestrator;
+	friend class PapaSchlumpfHotplug;
+	friend class PapaSchlumpfSimulator;
+
+	/* The number of commands which can be in flight at the same time. */
+	static const unsigned int PIPELINE_DEPTH = 4;
+
+	/* The timeouts are derived from the estimated latency and throughput of the link.
+	 * Start with conservative estimates for a full speed device.
+	 */
+	static const unsigned long TIMEOUT_INITIAL_LATENCY_US = 5000;
+	static const unsigned long TIMEOUT_INITIAL_BYTES_PER_SECOND = 200000;
+	static const unsigned int TIMEOUT_SAFETY_FACTOR = 4;
+	static const unsigned int TIMEOUT_MINIMUM_MS = 100;
+	static const unsigned int TIMEOUT_MAXIMUM_MS = 60000;
+	/* The firmware waits this long for a DMA transfer on the PCI bus before it gives up. */
+	static const unsigned int TIMEOUT_PCI_DMA_MS = 1000;
+
+	/* Collect statistics for the command IDs below this limit. */
+	static const unsigned int STATISTICS_COMMANDS = 32;
+	/* Bucket n of the latency histogram counts the latencies from 2^n to 2^(n+1)-1 microseconds. The last bucket has all longer ones. */
+	static const unsigned int STATISTICS_HISTOGRAM_BUCKETS = 24;
+
+	typedef struct COMMAND_STATISTICS_STRUCT
+	{
+		unsigned long ulCalls;
+		unsigned long long ullBytes;
+		unsigned long ulErrors;
+		unsigned long ulTimeouts;
+		unsigned long long ullSendUs;
+		unsigned long long ullReceiveUs;
+		unsigned long long ullTotalUs;
+		unsigned long aulHistogram[STATISTICS_HISTOGRAM_BUCKETS];
+	} COMMAND_STATISTICS_T;
+
+	typedef struct COMMAND_NAME_STRUCT
+	{
+		uint32_t ulCommand;
+		const char *pcName;
+	} COMMAND_NAME_T;
+	static const COMMAND_NAME_T atCommandNames[];
+
+	/* Make the buffer a little bit bigger to allow proper termination of transactions.
+	 * The netX sends a zero packet regardless of if the maximum transaction size was reached or not.
+	 * If the PC uses the maximum transaction size for the read request, the following zero packet will not
+	 * be received and is stuck in the netX.
+	 *
+	 * Example:
+	 * The maximum transaction size is set to 128 bytes. If the PC requests a memory size of 124, the netX will
+	 * respond with 4 bytes status plus 124 bytes data. This makes 128 bytes in total. The netX will also send
+	 * a zero packet to terminate the transaction. If the PC limits the read operation to 128 bytes, it will
+	 * not wait for the following zero packet sent by the netX. It messes up the following communication.
+	 */
+	typedef union PIPELINE_RESPONSE_UNION
+	{
+		PAPA_SCHLUMPF_USB_COMMAND_RESULT_STATUS_T tStatus;
+		PAPA_SCHLUMPF_USB_COMMAND_RESULT_DMA_MEM_READ_AREA_T tReadArea;
+		PAPA_SCHLUMPF_USB_COMMAND_RESULT_MEM_READ_STREAM_T tStream;
+		unsigned char auc[sizeof(PAPA_SCHLUMPF_USB_COMMAND_RESULT_DMA_MEM_READ_AREA_T) + 4];
+	} PIPELINE_RESPONSE_T;
+
+	typedef union PIPELINE_COMMAND_UNION
+	{
+		PAPA_SCHLUMPF_USB_COMMAND_DMA_MEM_READ_AREA_T tReadArea;
+		PAPA_SCHLUMPF_USB_COMMAND_DMA_MEM_WRITE_AREA_T tWriteArea;
+		PAPA_SCHLUMPF_USB_COMMAND_MEM_READ_STREAM_T tStream;
+		unsigned char auc[PAPA_SCHLUMPF_MAXIMUM_PACKET_SIZE];
+	} PIPELINE_COMMAND_T;
+
+	/* One command/response pair of the pipeline. */
+	typedef struct PIPELINE_SLOT_STRUCT
+	{
+		PapaSchlumpfFlex *ptThis;
+		PAPA_SCHLUMPF_TRANSFER_T *ptTransferOut;
+		PAPA_SCHLUMPF_TRANSFER_T *ptTransferIn;
+		int iOutPending;
+		int iInPending;
+		unsigned char *pucInPlace;
+		int sizInPlace;
+		struct timespec tSubmitted;
+		struct timespec tOutDone;
+		struct timespec tInDone;
+		uint32_t ulOffset;
+		uint32_t ulChunk;
+		PIPELINE_COMMAND_T uCommand;
+		PIPELINE_RESPONSE_T uResponse;
+	} PIPELINE_SLOT_T;
+
+	/* The pipeline calls one of these functions for every chunk.
+	 * A producer fills the data for a write command, a consumer gets the data of a read response.
+	 */
+	typedef PAPA_SCHLUMPF_RESULT_T (*PFN_PIPELINE_PRODUCER_T)(void *pvUser, uint32_t ulOffset, unsigned char *pucData, uint32_t ulChunk);
+	typedef PAPA_SCHLUMPF_RESULT_T (*PFN_PIPELINE_CONSUMER_T)(void *pvUser, uint32_t ulOffset, const unsigned char *pucData, uint32_t ulChunk);
+
+	static libusb_context *__get_libusb_context(void);
+	static void __add_libusb_user(void);
+	static void __remove_libusb_user(void);
+	PAPA_SCHLUMPF_RESULT_T __connect(const char *pcLastPath, const char *pcSelector);
+	PAPA_SCHLUMPF_RESULT_T __scan_for_papa_schlumpf_hardware(const char *pcSelector);
+	PAPA_SCHLUMPF_RESULT_T __open_device_at_path(const char *pcPath);
+	PAPA_SCHLUMPF_RESULT_T __open_device(libusb_device *ptDevice);
+	static void __get_device_path(libusb_device *ptDevice, char *pcPath, size_t sizPath);
+	int __get_device_serial(libusb_device *ptDevice, char *pcSerial, size_t sizSerial);
+	int __send_packet(const unsigned char *pucOutBuf, int sizOutBuf);
+	int __receivePacket(unsigned char *pucInBuf, int sizInBufMax, int *psizInBuf, unsigned int uiExecutionMs, unsigned int uiDmaTransfers);
+	void __drain_responses(void);
+	unsigned int __get_timeout(size_t sizTransfer, unsigned int uiCommands, unsigned int uiExecutionMs);
+	static unsigned long __get_elapsed_us(const struct timespec *ptStart);
+	void __sample_latency(const struct timespec *ptStart);
+	void __sample_throughput(uint32_t ulSize, const struct timespec *ptStart);
+	static unsigned long __get_difference_us(const struct timespec *ptStart, const struct timespec *ptEnd);
+	void __record_statistics(uint32_t ulCommand, size_t sizBytes, unsigned long ulSendUs, unsigned long ulReceiveUs, unsigned long ulTotalUs, int iError, int iTimeout);
 	void __disconnect(void);
+	PAPA_SCHLUMPF_RESULT_T __cfg_read_area(uint32_t ulCommand, uint32_t ulAddress, uint32_t ulSize, char **ppcBUFFER_OUT, size_t *psizBUFFER_OUT);
+	PAPA_SCHLUMPF_RESULT_T __modify(uint32_t ulCommand, uint32_t ulAddress, uint32_t ulMask, uint32_t ulData, unsigned long *pulOldData);
+	PAPA_SCHLUMPF_RESULT_T __execute_batch_packet(const PAPA_SCHLUMPF_BATCH_ENTRY_T *ptEntries, uint32_t ulEntries, PAPA_SCHLUMPF_BATCH_RESULT_T *ptResults, uint32_t *pulProcessed);
+	PAPA_SCHLUMPF_RESULT_T __scatter(uint32_t ulCommand, const PAPA_SCHLUMPF_SCATTER_DESCRIPTOR_T *ptDescriptors, size_t sizDescriptors, unsigned char *pucData);
+	PAPA_SCHLUMPF_RESULT_T __scatter_packet(uint32_t ulCommand, const PAPA_SCHLUMPF_SCATTER_DESCRIPTOR_T *ptDescriptors, uint32_t ulDescriptors, unsigned char *pucData, uint32_t ulDwords);
+
+	PAPA_SCHLUMPF_RESULT_T __pipeline_start(void);
+	void __pipeline_stop(void);
+	static void __pipeline_transfer_callback(PAPA_SCHLUMPF_TRANSFER_T *ptTransfer);
+	int __pipeline_submit(PIPELINE_SLOT_T *ptSlot, int sizCommand, unsigned int uiTimeoutMs);
+	int __pipeline_submit_receive(PIPELINE_SLOT_T *ptSlot, unsigned int uiTimeoutMs);
+	void __pipeline_wait(PIPELINE_SLOT_T *ptSlot);
+	void __pipeline_cancel(PIPELINE_SLOT_T *ptSlot);
+	PAPA_SCHLUMPF_RESULT_T __pipeline_check(PIPELINE_SLOT_T *ptSlot, int sizExpected);
+	PAPA_SCHLUMPF_RESULT_T __pipeline_read_area(uint32_t ulAddress, uint32_t ulSize, PFN_PIPELINE_CONSUMER_T pfnConsumer, void *pvUser);
+#ifdef __linux__
+	PAPA_SCHLUMPF_RESULT_T __pipeline_read_area_in_place(uint32_t ulAddress, uint32_t ulSize, unsigned char *pucBuffer);
+#endif
+	PAPA_SCHLUMPF_RESULT_T __pipeline_write_area(uint32_t ulAddress, uint32_t ulSize, PFN_PIPELINE_PRODUCER_T pfnProducer, void *pvUser);
+	PAPA_SCHLUMPF_RESULT_T __stream_read_area(uint32_t ulAddress, uint32_t ulSize, PFN_PIPELINE_CONSUMER_T pfnConsumer, void *pvUser);
+	void __stream_abort(unsigned int uiSlotFirst, unsigned int uiSlotsBusy, unsigned int uiTimeoutMs);
+	static PAPA_SCHLUMPF_RESULT_T __consume_to_memory(void *pvUser, uint32_t ulOffset, const unsigned char *pucData, uint32_t ulChunk);
+	static PAPA_SCHLUMPF_RESULT_T __produce_from_memory(void *pvUser, uint32_t ulOffset, unsigned char *pucData, uint32_t ulChunk);
+	static PAPA_SCHLUMPF_RESULT_T __consume_to_file(void *pvUser, uint32_t ulOffset, const unsigned char *pucData, uint32_t ulChunk);
+	static PAPA_SCHLUMPF_RESULT_T __produce_from_file(void *pvUser, uint32_t ulOffset, unsigned char *pucData, uint32_t ulChunk);
+
+	/* This is the user data for __consume_to_file and __produce_from_file. */
+	typedef struct PIPELINE_FILE_STRUCT
+	{
+		int iFd;
+		off_t tFileOffset;
+		const char *pcPluginId;
+	} PIPELINE_FILE_T;
 
 	typedef struct ERRORMESSAGE_STRUCT
 	{
@@ -72,18 +300,58 @@ private:
 		const char *pcMessage;
 	} ERRORMESSAGE_T;
 	static const ERRORMESSAGE_T atErrorMessages[];
+	static const char *__get_error_string(int iResult);
 
-	/* This is the context of the libusb. */
+	/* The shared libusb context, the number of users and the mutex for both. */
+	static libusb_context *s_ptLibUsbContext;
+	static unsigned int s_uiLibUsbUsers;
+	static pthread_mutex_t s_tLibUsbContextMutex;
+
+	/* This is the context of the libusb. It points to the shared context while a device is connected. */
 	libusb_context *m_ptLibUsbContext;
 
-	/* This is the handle for the papa_schlumpf device. */
-	libusb_device_handle *m_ptDevHandlePapaSchlumpf;
+	/* The selector and the USB path of the last successful connect. */
+	char *m_pcLastSelector;
+	char m_acLastPath[64];
+
+	/* This is the connection to the papa_schlumpf device. It is NULL if no device is connected. */
+	PapaSchlumpfTransport *m_ptTransport;
+
+	/* The pipeline slots for the asynchronous transfers. */
+	PIPELINE_SLOT_T *m_ptPipelineSlots;
+
+	/* The mutex and condition protect the "pending" flags of the slots. */
+	pthread_mutex_t m_tPipelineMutex;
+	pthread_cond_t m_tPipelineCondition;
 
 	/* This is the name of the plugin. It is used for error messages on the screen. */
 	char *m_pcPluginId;
 
 	/* A counter for the number of connected plugins. */
 	unsigned int m_uiPluginConnections;
+
+	/* A fixed timeout for all transfers. 0 selects the adaptive timeouts. */
+	unsigned int m_uiTimeoutOverrideMs;
+
+	/* The running estimates of the round trip time of a small command and of the throughput. */
+	unsigned long m_ulLatencyUs;
+	unsigned long m_ulBytesPerSecond;
+
+	/* The round trip measurement of the current command. */
+	int m_iRoundTripActive;
+	struct timespec m_tRoundTripStart;
+	size_t m_sizRoundTrip;
+	uint32_t m_ulRoundTripCommand;
+	const unsigned char *m_pucRoundTripCommand;
+	size_t m_sizRoundTripCommand;
+	unsigned long m_ulRoundTripSendUs;
+
+	/* The statistics for each command since the last reset. */
+	COMMAND_STATISTICS_T m_atStatistics[STATISTICS_COMMANDS];
+	struct timespec m_tStatisticsStart;
+
+	/* The trace recorder. It is NULL if no trace is running. */
+	PapaSchlumpfTrace *m_ptTrace;
 #endif
 };
 
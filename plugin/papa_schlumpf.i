@@ -68,6 +68,24 @@
 %}
 
 
+%typemap(out) RESULT_INT_NOTHING_OR_NIL_WITH_ERR_AND_CODE
+%{
+	if( $1<0 )
+	{
+		lua_pushnil(L);
+		lua_pushstring(L, arg1->get_error_string($1));
+		lua_pushnumber(L, $1);
+		SWIG_arg = 3;
+	}
+	else
+	{
+%}
+%typemap(ret) RESULT_INT_NOTHING_OR_NIL_WITH_ERR_AND_CODE
+%{
+	}
+%}
+
+
 %typemap(out) RESULT_INT_INT_OR_NIL_WITH_ERR
 %{
 	if( $1>=0 )
@@ -85,7 +103,13 @@
 
 
 %include "papa_schlumpf.h"
+%include "papa_schlumpf_orchestrator.h"
+%include "papa_schlumpf_hotplug.h"
+%include "papa_schlumpf_simulator.h"
 
 %{
 	#include "papa_schlumpf.h"
+	#include "papa_schlumpf_orchestrator.h"
+	#include "papa_schlumpf_hotplug.h"
+	#include "papa_schlumpf_simulator.h"
 %}
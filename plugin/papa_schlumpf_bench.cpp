@@ -0,0 +1,482 @@
+/* This is a micro benchmark of the plugin. It runs against the firmware
+ * simulator and writes the results as JSON to the file in the first
+ * argument. The exit code is 0 if all operations succeeded.
+ */
+#include "papa_schlumpf.h"
+#include "papa_schlumpf_simulator.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "simulator.h"
+
+
+/* Each measurement runs at least this long. */
+#define BENCH_MINIMUM_MS 200
+
+/* The simulated memory for all measurements. */
+#define BENCH_MEMORY_ADDRESS 0x10000000U
+#define BENCH_MEMORY_SIZE 0x00100000U
+
+/* The number of reads in the batch measurement. */
+#define BENCH_BATCH_ENTRIES 64
+
+
+/* The simulated links. */
+typedef struct BENCH_PROFILE_STRUCT
+{
+	const char *pcName;
+	unsigned int uiLatencyUs;
+	unsigned int uiBytesPerMs;
+} BENCH_PROFILE_T;
+
+static const BENCH_PROFILE_T atProfiles[] =
+{
+	{ "host",           0,   0 },
+	{ "usb_high_speed", 125, 40000 }
+};
+
+/* The sizes for memReadArea and memWriteArea. The plugin splits an area in packets. */
+static const uint32_t aulAreaSizes[] =
+{
+	4,
+	64,
+	1024,
+	4096,
+	16384,
+	65536,
+	262144
+};
+
+#define ARRAY_SIZE(a) (sizeof(a)/sizeof(a[0]))
+
+
+typedef struct BENCH_CONTEXT_STRUCT
+{
+	PapaSchlumpfFlex *ptFlex;
+	uint32_t ulSize;
+	unsigned char *pucData;
+	char *pcBatch;
+	size_t sizBatch;
+} BENCH_CONTEXT_T;
+
+typedef PAPA_SCHLUMPF_RESULT_T (*PFN_BENCH_OPERATION_T)(BENCH_CONTEXT_T *ptContext);
+
+
+typedef struct BENCH_MEASUREMENT_STRUCT
+{
+	unsigned long ulIterations;
+	double dSeconds;
+} BENCH_MEASUREMENT_T;
+
+
+
+static double get_seconds(void)
+{
+	struct timespec tNow;
+
+
+	clock_gettime(CLOCK_MONOTONIC, &tNow);
+	return (double)tNow.tv_sec + ((double)tNow.tv_nsec / 1000000000.0);
+}
+
+
+
+/* Run the operation until the minimum time is over. */
+static PAPA_SCHLUMPF_RESULT_T measure(PFN_BENCH_OPERATION_T pfnOperation, BENCH_CONTEXT_T *ptContext, BENCH_MEASUREMENT_T *ptMeasurement)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	double dStart;
+	double dElapsed;
+	unsigned long ulIterations;
+
+
+	ulIterations = 0;
+	dElapsed = 0.0;
+	dStart = get_seconds();
+	do
+	{
+		tResult = pfnOperation(ptContext);
+		if( tResult!=PAPA_SCHLUMPF_RESULT_Ok )
+		{
+			break;
+		}
+		++ulIterations;
+		dElapsed = get_seconds() - dStart;
+	} while( dElapsed<(BENCH_MINIMUM_MS/1000.0) );
+
+	ptMeasurement->ulIterations = ulIterations;
+	ptMeasurement->dSeconds = dElapsed;
+
+	return tResult;
+}
+
+
+
+static PAPA_SCHLUMPF_RESULT_T operation_mem_read(BENCH_CONTEXT_T *ptContext)
+{
+	unsigned long ulData;
+
+
+	return (PAPA_SCHLUMPF_RESULT_T)ptContext->ptFlex->memRead(BENCH_MEMORY_ADDRESS, &ulData);
+}
+
+
+
+static PAPA_SCHLUMPF_RESULT_T operation_mem_write(BENCH_CONTEXT_T *ptContext)
+{
+	return (PAPA_SCHLUMPF_RESULT_T)ptContext->ptFlex->memWrite(BENCH_MEMORY_ADDRESS, 0x12345678U);
+}
+
+
+
+/* Use the same path as Lua. It allocates the result buffer. */
+static PAPA_SCHLUMPF_RESULT_T operation_mem_read_area(BENCH_CONTEXT_T *ptContext)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	char *pcData;
+	size_t sizData;
+
+
+	pcData = NULL;
+	sizData = 0;
+	tResult = (PAPA_SCHLUMPF_RESULT_T)ptContext->ptFlex->memReadArea(BENCH_MEMORY_ADDRESS, ptContext->ulSize, &pcData, &sizData);
+	if( pcData!=NULL )
+	{
+		free(pcData);
+	}
+
+	return tResult;
+}
+
+
+
+static PAPA_SCHLUMPF_RESULT_T operation_mem_write_area(BENCH_CONTEXT_T *ptContext)
+{
+	return (PAPA_SCHLUMPF_RESULT_T)ptContext->ptFlex->memWriteArea(BENCH_MEMORY_ADDRESS, (const char*)ptContext->pucData, ptContext->ulSize);
+}
+
+
+
+/* Read all addresses of the batch with single commands. */
+static PAPA_SCHLUMPF_RESULT_T operation_single_reads(BENCH_CONTEXT_T *ptContext)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	unsigned int uiCnt;
+	unsigned long ulData;
+
+
+	tResult = PAPA_SCHLUMPF_RESULT_Ok;
+	for(uiCnt=0; uiCnt<BENCH_BATCH_ENTRIES; ++uiCnt)
+	{
+		tResult = (PAPA_SCHLUMPF_RESULT_T)ptContext->ptFlex->memRead(BENCH_MEMORY_ADDRESS + uiCnt*sizeof(uint32_t), &ulData);
+		if( tResult!=PAPA_SCHLUMPF_RESULT_Ok )
+		{
+			break;
+		}
+	}
+
+	return tResult;
+}
+
+
+
+static PAPA_SCHLUMPF_RESULT_T operation_batch_reads(BENCH_CONTEXT_T *ptContext)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	char *pcResults;
+	size_t sizResults;
+
+
+	pcResults = NULL;
+	sizResults = 0;
+	tResult = (PAPA_SCHLUMPF_RESULT_T)ptContext->ptFlex->executeBatch(ptContext->pcBatch, ptContext->sizBatch, &pcResults, &sizResults);
+	if( pcResults!=NULL )
+	{
+		free(pcResults);
+	}
+	if( tResult==PAPA_SCHLUMPF_RESULT_Ok && sizResults!=BENCH_BATCH_ENTRIES*sizeof(PAPA_SCHLUMPF_BATCH_RESULT_T) )
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_CommandFailed;
+	}
+
+	return tResult;
+}
+
+
+
+/* Write an area and read it back. */
+static PAPA_SCHLUMPF_RESULT_T verify_area(BENCH_CONTEXT_T *ptContext)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	unsigned char *pucReadBack;
+
+
+	tResult = PAPA_SCHLUMPF_RESULT_OutOfMemory;
+	pucReadBack = (unsigned char*)malloc(ptContext->ulSize);
+	if( pucReadBack!=NULL )
+	{
+		tResult = (PAPA_SCHLUMPF_RESULT_T)ptContext->ptFlex->memWriteArea(BENCH_MEMORY_ADDRESS, (const char*)ptContext->pucData, ptContext->ulSize);
+		if( tResult==PAPA_SCHLUMPF_RESULT_Ok )
+		{
+			tResult = ptContext->ptFlex->memReadArea(BENCH_MEMORY_ADDRESS, ptContext->ulSize, pucReadBack);
+			if( tResult==PAPA_SCHLUMPF_RESULT_Ok && memcmp(ptContext->pucData, pucReadBack, ptContext->ulSize)!=0 )
+			{
+				fprintf(stderr, "The read back data of %u bytes differs.\n", ptContext->ulSize);
+				tResult = PAPA_SCHLUMPF_RESULT_CommandFailed;
+			}
+		}
+		free(pucReadBack);
+	}
+
+	return tResult;
+}
+
+
+
+/* Read the largest area which fits into one scatter response. The response
+ * must fit into the FIFO of the endpoint.
+ */
+static PAPA_SCHLUMPF_RESULT_T verify_scatter_maximum(BENCH_CONTEXT_T *ptContext)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	PAPA_SCHLUMPF_SCATTER_DESCRIPTOR_T tDescriptor;
+	uint32_t ulSize;
+	char *pcData;
+	size_t sizData;
+
+
+	ulSize = PAPA_SCHLUMPF_SCATTER_READ_MAXIMUM_DWORDS * sizeof(uint32_t);
+	tResult = (PAPA_SCHLUMPF_RESULT_T)ptContext->ptFlex->memWriteArea(BENCH_MEMORY_ADDRESS, (const char*)ptContext->pucData, ulSize);
+	if( tResult==PAPA_SCHLUMPF_RESULT_Ok )
+	{
+		tDescriptor.ulDeviceAddress = BENCH_MEMORY_ADDRESS;
+		tDescriptor.ulDwords = PAPA_SCHLUMPF_SCATTER_READ_MAXIMUM_DWORDS;
+		pcData = NULL;
+		sizData = 0;
+		tResult = (PAPA_SCHLUMPF_RESULT_T)ptContext->ptFlex->memReadScatter((const char*)&tDescriptor, sizeof(tDescriptor), &pcData, &sizData);
+		if( tResult==PAPA_SCHLUMPF_RESULT_Ok && (sizData!=ulSize || memcmp(ptContext->pucData, pcData, ulSize)!=0) )
+		{
+			fprintf(stderr, "The scatter read of %u bytes differs.\n", ulSize);
+			tResult = PAPA_SCHLUMPF_RESULT_CommandFailed;
+		}
+		if( pcData!=NULL )
+		{
+			free(pcData);
+		}
+	}
+
+	return tResult;
+}
+
+
+
+static double per_second(const BENCH_MEASUREMENT_T *ptMeasurement, double dUnits)
+{
+	double dResult;
+
+
+	dResult = 0.0;
+	if( ptMeasurement->dSeconds>0.0 )
+	{
+		dResult = ((double)ptMeasurement->ulIterations * dUnits) / ptMeasurement->dSeconds;
+	}
+
+	return dResult;
+}
+
+
+
+static PAPA_SCHLUMPF_RESULT_T run_profile(const BENCH_PROFILE_T *ptProfile, BENCH_CONTEXT_T *ptContext, PapaSchlumpfSimulator *ptSimulator, FILE *ptJson)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	PapaSchlumpfFlex tFlex;
+	BENCH_MEASUREMENT_T tRead;
+	BENCH_MEASUREMENT_T tWrite;
+	BENCH_MEASUREMENT_T tSingle;
+	BENCH_MEASUREMENT_T tBatch;
+	unsigned int uiCnt;
+	double dSingle;
+	double dBatch;
+
+
+	printf("Profile %s: latency %u us, %u bytes/ms\n", ptProfile->pcName, ptProfile->uiLatencyUs, ptProfile->uiBytesPerMs);
+
+	ptSimulator->setTiming(ptProfile->uiLatencyUs, ptProfile->uiBytesPerMs);
+	tResult = (PAPA_SCHLUMPF_RESULT_T)ptSimulator->connect(&tFlex);
+	if( tResult!=PAPA_SCHLUMPF_RESULT_Ok )
+	{
+		fprintf(stderr, "Failed to connect to the simulator: %s\n", tFlex.get_error_string(tResult));
+		return tResult;
+	}
+	ptContext->ptFlex = &tFlex;
+
+	fprintf(ptJson, "    {\n");
+	fprintf(ptJson, "      \"name\": \"%s\",\n", ptProfile->pcName);
+	fprintf(ptJson, "      \"latency_us\": %u,\n", ptProfile->uiLatencyUs);
+	fprintf(ptJson, "      \"bytes_per_ms\": %u,\n", ptProfile->uiBytesPerMs);
+
+	/* Single register operations. */
+	tResult = measure(operation_mem_read, ptContext, &tRead);
+	if( tResult==PAPA_SCHLUMPF_RESULT_Ok )
+	{
+		tResult = measure(operation_mem_write, ptContext, &tWrite);
+	}
+	if( tResult!=PAPA_SCHLUMPF_RESULT_Ok )
+	{
+		fprintf(stderr, "The single register operations failed: %s\n", tFlex.get_error_string(tResult));
+		return tResult;
+	}
+	printf("  memRead   %10.0f ops/s\n", per_second(&tRead, 1.0));
+	printf("  memWrite  %10.0f ops/s\n", per_second(&tWrite, 1.0));
+	fprintf(ptJson, "      \"single\": {\n");
+	fprintf(ptJson, "        \"memRead_ops_per_second\": %.1f,\n", per_second(&tRead, 1.0));
+	fprintf(ptJson, "        \"memWrite_ops_per_second\": %.1f\n", per_second(&tWrite, 1.0));
+	fprintf(ptJson, "      },\n");
+
+	/* The area transfers. */
+	fprintf(ptJson, "      \"areas\": [\n");
+	for(uiCnt=0; uiCnt<ARRAY_SIZE(aulAreaSizes); ++uiCnt)
+	{
+		ptContext->ulSize = aulAreaSizes[uiCnt];
+		tResult = verify_area(ptContext);
+		if( tResult==PAPA_SCHLUMPF_RESULT_Ok )
+		{
+			tResult = measure(operation_mem_read_area, ptContext, &tRead);
+		}
+		if( tResult==PAPA_SCHLUMPF_RESULT_Ok )
+		{
+			tResult = measure(operation_mem_write_area, ptContext, &tWrite);
+		}
+		if( tResult!=PAPA_SCHLUMPF_RESULT_Ok )
+		{
+			fprintf(stderr, "The area transfer with %u bytes failed: %s\n", ptContext->ulSize, tFlex.get_error_string(tResult));
+			return tResult;
+		}
+
+		printf("  area %7u bytes: read %10.0f bytes/s, write %10.0f bytes/s\n", ptContext->ulSize, per_second(&tRead, ptContext->ulSize), per_second(&tWrite, ptContext->ulSize));
+		fprintf(ptJson, "        {\n");
+		fprintf(ptJson, "          \"size\": %u,\n", ptContext->ulSize);
+		fprintf(ptJson, "          \"memReadArea_calls_per_second\": %.1f,\n", per_second(&tRead, 1.0));
+		fprintf(ptJson, "          \"memReadArea_bytes_per_second\": %.1f,\n", per_second(&tRead, ptContext->ulSize));
+		fprintf(ptJson, "          \"memWriteArea_calls_per_second\": %.1f,\n", per_second(&tWrite, 1.0));
+		fprintf(ptJson, "          \"memWriteArea_bytes_per_second\": %.1f\n", per_second(&tWrite, ptContext->ulSize));
+		fprintf(ptJson, "        }%s\n", (uiCnt+1<ARRAY_SIZE(aulAreaSizes)) ? "," : "");
+	}
+	fprintf(ptJson, "      ],\n");
+
+	tResult = verify_scatter_maximum(ptContext);
+	if( tResult!=PAPA_SCHLUMPF_RESULT_Ok )
+	{
+		fprintf(stderr, "The scatter read with the maximum size failed: %s\n", tFlex.get_error_string(tResult));
+		return tResult;
+	}
+
+	/* Compare single reads with one batch. */
+	tResult = measure(operation_single_reads, ptContext, &tSingle);
+	if( tResult==PAPA_SCHLUMPF_RESULT_Ok )
+	{
+		tResult = measure(operation_batch_reads, ptContext, &tBatch);
+	}
+	if( tResult!=PAPA_SCHLUMPF_RESULT_Ok )
+	{
+		fprintf(stderr, "The batch comparison failed: %s\n", tFlex.get_error_string(tResult));
+		return tResult;
+	}
+	dSingle = per_second(&tSingle, BENCH_BATCH_ENTRIES);
+	dBatch = per_second(&tBatch, BENCH_BATCH_ENTRIES);
+	printf("  batch of %u reads: single %10.0f ops/s, batch %10.0f ops/s, speedup %.2f\n", BENCH_BATCH_ENTRIES, dSingle, dBatch, (dSingle>0.0) ? dBatch/dSingle : 0.0);
+	fprintf(ptJson, "      \"batch\": {\n");
+	fprintf(ptJson, "        \"entries\": %u,\n", BENCH_BATCH_ENTRIES);
+	fprintf(ptJson, "        \"single_ops_per_second\": %.1f,\n", dSingle);
+	fprintf(ptJson, "        \"batch_ops_per_second\": %.1f,\n", dBatch);
+	fprintf(ptJson, "        \"speedup\": %.3f\n", (dSingle>0.0) ? dBatch/dSingle : 0.0);
+	fprintf(ptJson, "      }\n");
+	fprintf(ptJson, "    }");
+
+	tFlex.disconnect();
+	ptContext->ptFlex = NULL;
+
+	return PAPA_SCHLUMPF_RESULT_Ok;
+}
+
+
+
+int main(int argc, char **argv)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	PapaSchlumpfSimulator tSimulator;
+	BENCH_CONTEXT_T tContext;
+	PAPA_SCHLUMPF_BATCH_ENTRY_T *ptEntries;
+	FILE *ptJson;
+	unsigned int uiCnt;
+	int iResult;
+
+
+	if( argc!=2 )
+	{
+		fprintf(stderr, "Usage: %s OUTPUT.json\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	memset(&tContext, 0, sizeof(tContext));
+	tContext.pucData = (unsigned char*)malloc(BENCH_MEMORY_SIZE);
+	ptEntries = (PAPA_SCHLUMPF_BATCH_ENTRY_T*)malloc(BENCH_BATCH_ENTRIES * sizeof(PAPA_SCHLUMPF_BATCH_ENTRY_T));
+	if( tContext.pucData==NULL || ptEntries==NULL )
+	{
+		fprintf(stderr, "Failed to allocate the buffers.\n");
+		return EXIT_FAILURE;
+	}
+	for(uiCnt=0; uiCnt<BENCH_MEMORY_SIZE; ++uiCnt)
+	{
+		tContext.pucData[uiCnt] = (unsigned char)((uiCnt * 7U) + (uiCnt >> 8U));
+	}
+	for(uiCnt=0; uiCnt<BENCH_BATCH_ENTRIES; ++uiCnt)
+	{
+		ptEntries[uiCnt].ulOperation = PAPA_SCHLUMPF_BATCH_OPERATION_MemRead;
+		ptEntries[uiCnt].ulDeviceAddress = BENCH_MEMORY_ADDRESS + uiCnt*sizeof(uint32_t);
+		ptEntries[uiCnt].ulData = 0;
+	}
+	tContext.pcBatch = (char*)ptEntries;
+	tContext.sizBatch = BENCH_BATCH_ENTRIES * sizeof(PAPA_SCHLUMPF_BATCH_ENTRY_T);
+
+	tSimulator.reset();
+	tResult = (PAPA_SCHLUMPF_RESULT_T)tSimulator.addRegion(SIMULATOR_SPACE_Mem, BENCH_MEMORY_ADDRESS, BENCH_MEMORY_SIZE);
+	if( tResult!=PAPA_SCHLUMPF_RESULT_Ok )
+	{
+		fprintf(stderr, "Failed to add the simulated memory.\n");
+		return EXIT_FAILURE;
+	}
+
+	ptJson = fopen(argv[1], "w");
+	if( ptJson==NULL )
+	{
+		fprintf(stderr, "Failed to open %s for writing.\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	fprintf(ptJson, "{\n");
+	fprintf(ptJson, "  \"minimum_ms\": %u,\n", BENCH_MINIMUM_MS);
+	fprintf(ptJson, "  \"profiles\": [\n");
+	iResult = EXIT_SUCCESS;
+	for(uiCnt=0; uiCnt<ARRAY_SIZE(atProfiles); ++uiCnt)
+	{
+		tResult = run_profile(atProfiles + uiCnt, &tContext, &tSimulator, ptJson);
+		if( tResult!=PAPA_SCHLUMPF_RESULT_Ok )
+		{
+			iResult = EXIT_FAILURE;
+			break;
+		}
+		fprintf(ptJson, "%s\n", (uiCnt+1<ARRAY_SIZE(atProfiles)) ? "," : "");
+	}
+	fprintf(ptJson, "  ]\n");
+	fprintf(ptJson, "}\n");
+	fclose(ptJson);
+
+	free(ptEntries);
+	free(tContext.pucData);
+
+	return iResult;
+}
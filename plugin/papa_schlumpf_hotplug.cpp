@@ -0,0 +1,341 @@
+#include "papa_schlumpf_hotplug.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <lua.h>
+
+
+PapaSchlumpfHotplug::PapaSchlumpfHotplug(void)
+ : m_ptLibUsbContext(NULL)
+ , m_tCallbackHandle(0)
+ , m_ptEvents(NULL)
+ , m_sizEvents(0)
+ , m_sizEventsMax(0)
+ , m_ptDevices(NULL)
+ , m_sizDevices(0)
+ , m_sizDevicesMax(0)
+{
+	pthread_mutex_init(&m_tMutex, NULL);
+}
+
+
+
+PapaSchlumpfHotplug::~PapaSchlumpfHotplug(void)
+{
+	stop();
+
+	if( m_ptEvents!=NULL )
+	{
+		free(m_ptEvents);
+		m_ptEvents = NULL;
+	}
+	if( m_ptDevices!=NULL )
+	{
+		free(m_ptDevices);
+		m_ptDevices = NULL;
+	}
+
+	pthread_mutex_destroy(&m_tMutex);
+}
+
+
+
+/* Register the hotplug callback for the Papa Schlumpf devices.
+ * All devices which are already attached are reported as new devices.
+ */
+RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfHotplug::start(void)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	int iResult;
+	libusb_context *ptLibUsbContext;
+
+
+	tResult = PAPA_SCHLUMPF_RESULT_Ok;
+	if( m_ptLibUsbContext==NULL )
+	{
+		if( libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG)==0 )
+		{
+			fprintf(stderr, "papa_schlumpf: libusb has no hotplug support on this platform.\n");
+			tResult = PAPA_SCHLUMPF_RESULT_USBError;
+		}
+		else
+		{
+			ptLibUsbContext = PapaSchlumpfFlex::__get_libusb_context();
+			if( ptLibUsbContext==NULL )
+			{
+				tResult = PAPA_SCHLUMPF_RESULT_USBError;
+			}
+			else
+			{
+				/* Keep the shared context open as long as the callback is registered. */
+				PapaSchlumpfFlex::__add_libusb_user();
+
+				iResult = libusb_hotplug_register_callback(ptLibUsbContext,
+				                                           (libusb_hotplug_event)(LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT),
+				                                           LIBUSB_HOTPLUG_ENUMERATE,
+				                                           PAPA_SCHLUMPF_USB_VENDOR_ID,
+				                                           PAPA_SCHLUMPF_USB_PRODUCT_ID,
+				                                           LIBUSB_HOTPLUG_MATCH_ANY,
+				                                           __hotplug_callback,
+				                                           this,
+				                                           &m_tCallbackHandle);
+				if( iResult!=LIBUSB_SUCCESS )
+				{
+					fprintf(stderr, "papa_schlumpf: failed to register the hotplug callback: %d:%s\n", iResult, libusb_strerror(libusb_error(iResult)));
+					PapaSchlumpfFlex::__remove_libusb_user();
+					tResult = PAPA_SCHLUMPF_RESULT_USBError;
+				}
+				else
+				{
+					m_ptLibUsbContext = ptLibUsbContext;
+				}
+			}
+		}
+	}
+
+	return tResult;
+}
+
+
+
+RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfHotplug::stop(void)
+{
+	if( m_ptLibUsbContext!=NULL )
+	{
+		libusb_hotplug_deregister_callback(m_ptLibUsbContext, m_tCallbackHandle);
+		m_ptLibUsbContext = NULL;
+		PapaSchlumpfFlex::__remove_libusb_user();
+	}
+
+	/* Without the callback the list of devices is not up to date anymore. */
+	pthread_mutex_lock(&m_tMutex);
+	m_sizDevices = 0;
+	pthread_mutex_unlock(&m_tMutex);
+
+	return PAPA_SCHLUMPF_RESULT_Ok;
+}
+
+
+
+/* Wait until at least one event arrived or the timeout is over.
+ * This handles the USB events in the calling thread. It works together with
+ * the event threads of connected devices which use the same context.
+ * Return the number of events which can be fetched with getEvents.
+ */
+RESULT_INT_INT_OR_NIL_WITH_ERR PapaSchlumpfHotplug::waitForEvents(unsigned int uiTimeoutMs)
+{
+	int iResult;
+	unsigned int sizEvents;
+	struct timespec tStart;
+	struct timespec tNow;
+	unsigned long ulElapsedMs;
+	unsigned long ulLeftMs;
+	struct timeval tTimeout;
+
+
+	if( m_ptLibUsbContext==NULL )
+	{
+		iResult = PAPA_SCHLUMPF_RESULT_NotConnected;
+	}
+	else
+	{
+		/* Handle the pending events first. A timeout of 0 checks only for them. */
+		tTimeout.tv_sec = 0;
+		tTimeout.tv_usec = 0;
+		libusb_handle_events_timeout_completed(m_ptLibUsbContext, &tTimeout, NULL);
+
+		clock_gettime(CLOCK_MONOTONIC, &tStart);
+		do
+		{
+			sizEvents = __get_event_count();
+			if( sizEvents!=0 )
+			{
+				break;
+			}
+
+			clock_gettime(CLOCK_MONOTONIC, &tNow);
+			ulElapsedMs = (unsigned long)((tNow.tv_sec - tStart.tv_sec) * 1000 + (tNow.tv_nsec - tStart.tv_nsec) / 1000000);
+			if( ulElapsedMs>=uiTimeoutMs )
+			{
+				break;
+			}
+
+			ulLeftMs = uiTimeoutMs - ulElapsedMs;
+			tTimeout.tv_sec = (time_t)(ulLeftMs / 1000);
+			tTimeout.tv_usec = (suseconds_t)((ulLeftMs % 1000) * 1000);
+			libusb_handle_events_timeout_completed(m_ptLibUsbContext, &tTimeout, NULL);
+		} while( 1 );
+
+		iResult = (int)sizEvents;
+	}
+
+	return iResult;
+}
+
+
+
+/* Push a list of all events since the last call and clear the list.
+ * Each event is a table with the fields "event" ("arrived" or "left") and "path".
+ */
+void PapaSchlumpfHotplug::getEvents(lua_State *MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT)
+{
+	unsigned int uiCnt;
+	const HOTPLUG_EVENT_T *ptEvent;
+
+
+	pthread_mutex_lock(&m_tMutex);
+
+	lua_createtable(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, m_sizEvents, 0);
+	for(uiCnt=0; uiCnt<m_sizEvents; ++uiCnt)
+	{
+		ptEvent = m_ptEvents + uiCnt;
+
+		lua_createtable(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, 0, 2);
+		lua_pushstring(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, (ptEvent->iArrived!=0) ? "arrived" : "left");
+		lua_setfield(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, -2, "event");
+		lua_pushstring(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, ptEvent->acPath);
+		lua_setfield(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, -2, "path");
+		lua_rawseti(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, -2, uiCnt + 1);
+	}
+	m_sizEvents = 0;
+
+	pthread_mutex_unlock(&m_tMutex);
+}
+
+
+
+/* Push a list with the USB paths of all attached devices. */
+void PapaSchlumpfHotplug::getDevices(lua_State *MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT)
+{
+	unsigned int uiCnt;
+
+
+	pthread_mutex_lock(&m_tMutex);
+
+	lua_createtable(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, m_sizDevices, 0);
+	for(uiCnt=0; uiCnt<m_sizDevices; ++uiCnt)
+	{
+		lua_pushstring(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, m_ptDevices[uiCnt].acPath);
+		lua_rawseti(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, -2, uiCnt + 1);
+	}
+
+	pthread_mutex_unlock(&m_tMutex);
+}
+
+
+
+const char *PapaSchlumpfHotplug::get_error_string(int iResult)
+{
+	return PapaSchlumpfFlex::__get_error_string(iResult);
+}
+
+
+
+/* This runs in the thread which handles the USB events. It must not call any
+ * synchronous libusb function, so the device is identified only by its path.
+ */
+int LIBUSB_CALL PapaSchlumpfHotplug::__hotplug_callback(libusb_context *ptContext, libusb_device *ptDevice, libusb_hotplug_event tEvent, void *pvUser)
+{
+	PapaSchlumpfHotplug *ptThis;
+	char acPath[64];
+
+
+	ptThis = (PapaSchlumpfHotplug*)pvUser;
+
+	PapaSchlumpfFlex::__get_device_path(ptDevice, acPath, sizeof(acPath));
+	ptThis->__add_event((tEvent==LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED) ? 1 : 0, acPath);
+
+	/* Keep the callback registered. */
+	return 0;
+}
+
+
+
+void PapaSchlumpfHotplug::__add_event(int iArrived, const char *pcPath)
+{
+	unsigned int sizMax;
+	unsigned int uiCnt;
+	HOTPLUG_EVENT_T *ptEvents;
+	HOTPLUG_DEVICE_T *ptDevices;
+
+
+	pthread_mutex_lock(&m_tMutex);
+
+	/* Update the list of devices. */
+	for(uiCnt=0; uiCnt<m_sizDevices; ++uiCnt)
+	{
+		if( strcmp(m_ptDevices[uiCnt].acPath, pcPath)==0 )
+		{
+			break;
+		}
+	}
+	if( iArrived==0 )
+	{
+		if( uiCnt<m_sizDevices )
+		{
+			--m_sizDevices;
+			m_ptDevices[uiCnt] = m_ptDevices[m_sizDevices];
+		}
+	}
+	else if( uiCnt>=m_sizDevices )
+	{
+		if( m_sizDevices>=m_sizDevicesMax )
+		{
+			sizMax = (m_sizDevicesMax==0) ? 8 : (m_sizDevicesMax * 2);
+			ptDevices = (HOTPLUG_DEVICE_T*)realloc(m_ptDevices, sizMax * sizeof(HOTPLUG_DEVICE_T));
+			if( ptDevices!=NULL )
+			{
+				m_ptDevices = ptDevices;
+				m_sizDevicesMax = sizMax;
+			}
+		}
+		if( m_sizDevices<m_sizDevicesMax )
+		{
+			strncpy(m_ptDevices[m_sizDevices].acPath, pcPath, sizeof(m_ptDevices[m_sizDevices].acPath) - 1);
+			m_ptDevices[m_sizDevices].acPath[sizeof(m_ptDevices[m_sizDevices].acPath) - 1] = '\0';
+			++m_sizDevices;
+		}
+	}
+
+	/* Append the event. */
+	if( m_sizEvents>=m_sizEventsMax )
+	{
+		sizMax = (m_sizEventsMax==0) ? 8 : (m_sizEventsMax * 2);
+		ptEvents = (HOTPLUG_EVENT_T*)realloc(m_ptEvents, sizMax * sizeof(HOTPLUG_EVENT_T));
+		if( ptEvents!=NULL )
+		{
+			m_ptEvents = ptEvents;
+			m_sizEventsMax = sizMax;
+		}
+	}
+	if( m_sizEvents<m_sizEventsMax )
+	{
+		m_ptEvents[m_sizEvents].iArrived = iArrived;
+		strncpy(m_ptEvents[m_sizEvents].acPath, pcPath, sizeof(m_ptEvents[m_sizEvents].acPath) - 1);
+		m_ptEvents[m_sizEvents].acPath[sizeof(m_ptEvents[m_sizEvents].acPath) - 1] = '\0';
+		++m_sizEvents;
+	}
+	else
+	{
+		fprintf(stderr, "papa_schlumpf: failed to store the hotplug event for %s.\n", pcPath);
+	}
+
+	pthread_mutex_unlock(&m_tMutex);
+}
+
+
+
+unsigned int PapaSchlumpfHotplug::__get_event_count(void)
+{
+	unsigned int sizEvents;
+
+
+	pthread_mutex_lock(&m_tMutex);
+	sizEvents = m_sizEvents;
+	pthread_mutex_unlock(&m_tMutex);
+
+	return sizEvents;
+}
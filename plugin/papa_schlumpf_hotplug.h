@@ -0,0 +1,65 @@
+#include "papa_schlumpf.h"
+
+
+#ifndef __PAPA_SCHLUMPF_HOTPLUG_H__
+#define __PAPA_SCHLUMPF_HOTPLUG_H__
+
+
+/* Track the attached Papa Schlumpf devices with hotplug events.
+ * libusb reports the events from the thread which handles the USB events.
+ * This class only collects them. Lua gets them with waitForEvents and
+ * getEvents, so all callbacks in Lua run in the Lua thread.
+ */
+class PapaSchlumpfHotplug
+{
+public:
+	PapaSchlumpfHotplug(void);
+	~PapaSchlumpfHotplug(void);
+
+	RESULT_INT_TRUE_OR_NIL_WITH_ERR start(void);
+	RESULT_INT_TRUE_OR_NIL_WITH_ERR stop(void);
+	RESULT_INT_INT_OR_NIL_WITH_ERR waitForEvents(unsigned int uiTimeoutMs);
+	void getEvents(lua_State *MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT);
+	void getDevices(lua_State *MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT);
+
+	const char *get_error_string(int iResult);
+
+/* Do not wrap the private members. */
+#ifndef SWIG
+private:
+	typedef struct HOTPLUG_EVENT_STRUCT
+	{
+		int iArrived;
+		char acPath[64];
+	} HOTPLUG_EVENT_T;
+
+	typedef struct HOTPLUG_DEVICE_STRUCT
+	{
+		char acPath[64];
+	} HOTPLUG_DEVICE_T;
+
+	static int LIBUSB_CALL __hotplug_callback(libusb_context *ptContext, libusb_device *ptDevice, libusb_hotplug_event tEvent, void *pvUser);
+	void __add_event(int iArrived, const char *pcPath);
+	unsigned int __get_event_count(void);
+
+	/* The shared libusb context while the callback is registered. */
+	libusb_context *m_ptLibUsbContext;
+	libusb_hotplug_callback_handle m_tCallbackHandle;
+
+	/* The mutex protects the events and the devices. */
+	pthread_mutex_t m_tMutex;
+
+	/* The events since the last call of getEvents. */
+	HOTPLUG_EVENT_T *m_ptEvents;
+	unsigned int m_sizEvents;
+	unsigned int m_sizEventsMax;
+
+	/* The attached devices. */
+	HOTPLUG_DEVICE_T *m_ptDevices;
+	unsigned int m_sizDevices;
+	unsigned int m_sizDevicesMax;
+#endif
+};
+
+
+#endif  /* __PAPA_SCHLUMPF_HOTPLUG_H__ */
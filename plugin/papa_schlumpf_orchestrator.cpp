@@ -0,0 +1,787 @@
+#include "papa_schlumpf_orchestrator.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <lua.h>
+
+
+/* The arguments of each operation follow the name in the step table.
+ * "n" is a number, "s" is a string. Upper case letters are optional.
+ */
+const PapaSchlumpfOrchestrator::JOB_OPERATION_NAME_T PapaSchlumpfOrchestrator::atOperationNames[] =
+{
+	{ JOB_OPERATION_ResetPCI,             "resetPCI",             "NNN" },
+	{ JOB_OPERATION_SetupNetx,            "setupNetx",            "" },
+	{ JOB_OPERATION_Delay,                "delay",                "n" },
+	{ JOB_OPERATION_IoRead,               "ioRead",               "n" },
+	{ JOB_OPERATION_MemRead,              "memRead",              "n" },
+	{ JOB_OPERATION_Cfg0Read,             "cfg0Read",             "n" },
+	{ JOB_OPERATION_Cfg1Read,             "cfg1Read",             "n" },
+	{ JOB_OPERATION_IoWrite,              "ioWrite",              "nn" },
+	{ JOB_OPERATION_MemWrite,             "memWrite",             "nn" },
+	{ JOB_OPERATION_Cfg0Write,            "cfg0Write",            "nn" },
+	{ JOB_OPERATION_Cfg1Write,            "cfg1Write",            "nn" },
+	{ JOB_OPERATION_MemReadArea,          "memReadArea",          "nn" },
+	{ JOB_OPERATION_MemWriteArea,         "memWriteArea",         "ns" },
+	{ JOB_OPERATION_MemWriteAreaFromFile, "memWriteAreaFromFile", "nsNN" },
+	{ JOB_OPERATION_Batch,                "batch",                "s" }
+};
+
+
+
+PapaSchlumpfOrchestrator::PapaSchlumpfOrchestrator(void)
+ : m_ptSteps(NULL)
+ , m_sizSteps(0)
+ , m_ptWorkers(NULL)
+ , m_sizWorkers(0)
+ , m_sizWorkersMax(0)
+{
+}
+
+
+
+PapaSchlumpfOrchestrator::~PapaSchlumpfOrchestrator(void)
+{
+	__free_job();
+}
+
+
+
+/* Run a job on several devices in parallel and push a table with the results.
+ * The job table is the first argument after "self".
+ * This function returns an error only if the job itself is invalid or no
+ * device was found. Errors on a device are in the results table.
+ */
+RESULT_INT_NOTHING_OR_NIL_WITH_ERR PapaSchlumpfOrchestrator::run(lua_State *ptLuaStateForTableAccess, lua_State *MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	WORKER_T *ptCnt, *ptEnd;
+	int iResult;
+
+
+	/* Forget the last job. */
+	__free_job();
+
+	/* Copy the complete job before any worker starts. The workers must not touch the Lua state. */
+	tResult = __parse_job(ptLuaStateForTableAccess, 2);
+	if( tResult==PAPA_SCHLUMPF_RESULT_Ok )
+	{
+		tResult = __parse_devices(ptLuaStateForTableAccess, 2);
+		if( tResult==PAPA_SCHLUMPF_RESULT_Ok )
+		{
+			/* Start one worker for each device. */
+			ptCnt = m_ptWorkers;
+			ptEnd = m_ptWorkers + m_sizWorkers;
+			while( ptCnt<ptEnd )
+			{
+				iResult = pthread_create(&ptCnt->tThread, NULL, __worker_thread, ptCnt);
+				if( iResult!=0 )
+				{
+					fprintf(stderr, "papa_schlumpf: failed to start the worker for %s: %d\n", ptCnt->pcSelector, iResult);
+					ptCnt->tResult = PAPA_SCHLUMPF_RESULT_OutOfMemory;
+					snprintf(ptCnt->acError, sizeof(ptCnt->acError), "Failed to start the worker thread.");
+				}
+				else
+				{
+					ptCnt->iThreadRunning = 1;
+				}
+				++ptCnt;
+			}
+
+			/* Wait until all workers are finished. */
+			ptCnt = m_ptWorkers;
+			while( ptCnt<ptEnd )
+			{
+				if( ptCnt->iThreadRunning!=0 )
+				{
+					pthread_join(ptCnt->tThread, NULL);
+					ptCnt->iThreadRunning = 0;
+				}
+				++ptCnt;
+			}
+
+			__push_results(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT);
+		}
+	}
+
+	__free_job();
+
+	return tResult;
+}
+
+
+
+const char *PapaSchlumpfOrchestrator::get_error_string(int iResult)
+{
+	return PapaSchlumpfFlex::__get_error_string(iResult);
+}
+
+
+
+PAPA_SCHLUMPF_RESULT_T PapaSchlumpfOrchestrator::__parse_job(lua_State *ptLuaState, int iJobIndex)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	unsigned int sizSteps;
+	unsigned int uiCnt;
+	int iType;
+
+
+	/* Count the steps. The job is a list without holes. */
+	sizSteps = 0;
+	do
+	{
+		lua_rawgeti(ptLuaState, iJobIndex, sizSteps + 1);
+		iType = lua_type(ptLuaState, -1);
+		lua_pop(ptLuaState, 1);
+		if( iType!=LUA_TNIL )
+		{
+			++sizSteps;
+		}
+	} while( iType!=LUA_TNIL );
+
+	if( sizSteps==0 )
+	{
+		fprintf(stderr, "papa_schlumpf: the job has no steps.\n");
+		tResult = PAPA_SCHLUMPF_RESULT_InvalidJob;
+	}
+	else
+	{
+		m_ptSteps = (JOB_STEP_T*)calloc(sizSteps, sizeof(JOB_STEP_T));
+		if( m_ptSteps==NULL )
+		{
+			tResult = PAPA_SCHLUMPF_RESULT_OutOfMemory;
+		}
+		else
+		{
+			m_sizSteps = sizSteps;
+
+			tResult = PAPA_SCHLUMPF_RESULT_Ok;
+			for(uiCnt=0; uiCnt<sizSteps; ++uiCnt)
+			{
+				lua_rawgeti(ptLuaState, iJobIndex, uiCnt + 1);
+				if( lua_type(ptLuaState, -1)!=LUA_TTABLE )
+				{
+					fprintf(stderr, "papa_schlumpf: step %d of the job is not a table.\n", uiCnt + 1);
+					tResult = PAPA_SCHLUMPF_RESULT_InvalidJob;
+				}
+				else
+				{
+					tResult = __parse_step(ptLuaState, uiCnt + 1, m_ptSteps + uiCnt);
+				}
+				lua_pop(ptLuaState, 1);
+
+				if( tResult!=PAPA_SCHLUMPF_RESULT_Ok )
+				{
+					break;
+				}
+			}
+		}
+	}
+
+	return tResult;
+}
+
+
+
+/* Parse the step table on top of the stack. */
+PAPA_SCHLUMPF_RESULT_T PapaSchlumpfOrchestrator::__parse_step(lua_State *ptLuaState, int iStepIndex, JOB_STEP_T *ptStep)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	const JOB_OPERATION_NAME_T *ptCnt, *ptEnd;
+	const JOB_OPERATION_NAME_T *ptOperation;
+	const char *pcName;
+	const char *pcArguments;
+	const char *pcData;
+	size_t sizData;
+	unsigned int uiNumbers;
+	int iArgument;
+	int iType;
+	int iOptional;
+
+
+	tResult = PAPA_SCHLUMPF_RESULT_Ok;
+
+	/* The first element is the name of the operation. */
+	ptOperation = NULL;
+	lua_rawgeti(ptLuaState, -1, 1);
+	pcName = NULL;
+	if( lua_type(ptLuaState, -1)==LUA_TSTRING )
+	{
+		pcName = lua_tostring(ptLuaState, -1);
+
+		ptCnt = atOperationNames;
+		ptEnd = atOperationNames + (sizeof(atOperationNames)/sizeof(atOperationNames[0]));
+		while( ptCnt<ptEnd )
+		{
+			if( strcmp(ptCnt->pcName, pcName)==0 )
+			{
+				ptOperation = ptCnt;
+				break;
+			}
+			++ptCnt;
+		}
+	}
+	if( ptOperation==NULL )
+	{
+		fprintf(stderr, "papa_schlumpf: step %d has an unknown operation: %s\n", iStepIndex, (pcName==NULL) ? "(not a string)" : pcName);
+		tResult = PAPA_SCHLUMPF_RESULT_InvalidJob;
+	}
+	lua_pop(ptLuaState, 1);
+
+	if( tResult==PAPA_SCHLUMPF_RESULT_Ok )
+	{
+		ptStep->tOperation = ptOperation->tOperation;
+		ptStep->iHasExpect = 0;
+		ptStep->ulExpect = 0;
+		ptStep->ulMask = 0xffffffffU;
+		ptStep->pcData = NULL;
+		ptStep->sizData = 0;
+
+		/* Set the defaults for the optional arguments. */
+		if( ptStep->tOperation==JOB_OPERATION_ResetPCI )
+		{
+			ptStep->aulParameter[0] = 500;
+			ptStep->aulParameter[1] = 1;
+			ptStep->aulParameter[2] = 10000;
+		}
+		else
+		{
+			ptStep->aulParameter[0] = 0;
+			ptStep->aulParameter[1] = 0;
+			ptStep->aulParameter[2] = 0;
+		}
+
+		/* Get the arguments after the name. */
+		uiNumbers = 0;
+		iArgument = 2;
+		pcArguments = ptOperation->pcArguments;
+		while( *pcArguments!='\0' )
+		{
+			lua_rawgeti(ptLuaState, -1, iArgument);
+			iType = lua_type(ptLuaState, -1);
+			iOptional = (*pcArguments>='A' && *pcArguments<='Z');
+			if( iType==LUA_TNIL && iOptional!=0 )
+			{
+				/* Keep the default. */
+				if( *pcArguments=='N' )
+				{
+					++uiNumbers;
+				}
+			}
+			else if( *pcArguments=='n' || *pcArguments=='N' )
+			{
+				if( iType!=LUA_TNUMBER )
+				{
+					fprintf(stderr, "papa_schlumpf: argument %d of step %d (%s) must be a number.\n", iArgument - 1, iStepIndex, ptOperation->pcName);
+					tResult = PAPA_SCHLUMPF_RESULT_InvalidJob;
+				}
+				else
+				{
+					ptStep->aulParameter[uiNumbers] = (uint32_t)lua_tonumber(ptLuaState, -1);
+					++uiNumbers;
+				}
+			}
+			else
+			{
+				if( iType!=LUA_TSTRING )
+				{
+					fprintf(stderr, "papa_schlumpf: argument %d of step %d (%s) must be a string.\n", iArgument - 1, iStepIndex, ptOperation->pcName);
+					tResult = PAPA_SCHLUMPF_RESULT_InvalidJob;
+				}
+				else
+				{
+					/* Copy the data. The string can contain 0 bytes, but it is also terminated for the path. */
+					pcData = lua_tolstring(ptLuaState, -1, &sizData);
+					ptStep->pcData = (char*)malloc(sizData + 1);
+					if( ptStep->pcData==NULL )
+					{
+						tResult = PAPA_SCHLUMPF_RESULT_OutOfMemory;
+					}
+					else
+					{
+						memcpy(ptStep->pcData, pcData, sizData);
+						ptStep->pcData[sizData] = '\0';
+						ptStep->sizData = sizData;
+					}
+				}
+			}
+			lua_pop(ptLuaState, 1);
+
+			if( tResult!=PAPA_SCHLUMPF_RESULT_Ok )
+			{
+				break;
+			}
+
+			++iArgument;
+			++pcArguments;
+		}
+	}
+
+	/* A read can be compared with an expected value. */
+	if( tResult==PAPA_SCHLUMPF_RESULT_Ok && ptStep->tOperation>=JOB_OPERATION_IoRead && ptStep->tOperation<=JOB_OPERATION_Cfg1Read )
+	{
+		lua_getfield(ptLuaState, -1, "expect");
+		iType = lua_type(ptLuaState, -1);
+		if( iType==LUA_TNUMBER )
+		{
+			ptStep->iHasExpect = 1;
+			ptStep->ulExpect = (uint32_t)lua_tonumber(ptLuaState, -1);
+		}
+		else if( iType!=LUA_TNIL )
+		{
+			fprintf(stderr, "papa_schlumpf: the expected value of step %d must be a number.\n", iStepIndex);
+			tResult = PAPA_SCHLUMPF_RESULT_InvalidJob;
+		}
+		lua_pop(ptLuaState, 1);
+
+		lua_getfield(ptLuaState, -1, "mask");
+		iType = lua_type(ptLuaState, -1);
+		if( iType==LUA_TNUMBER )
+		{
+			ptStep->ulMask = (uint32_t)lua_tonumber(ptLuaState, -1);
+		}
+		else if( iType!=LUA_TNIL )
+		{
+			fprintf(stderr, "papa_schlumpf: the mask of step %d must be a number.\n", iStepIndex);
+			tResult = PAPA_SCHLUMPF_RESULT_InvalidJob;
+		}
+		lua_pop(ptLuaState, 1);
+	}
+
+	return tResult;
+}
+
+
+
+/* Create the workers for the devices in the "devices" field of the job or for all devices. */
+PAPA_SCHLUMPF_RESULT_T PapaSchlumpfOrchestrator::__parse_devices(lua_State *ptLuaState, int iJobIndex)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	int iType;
+	int iIndex;
+
+
+	lua_getfield(ptLuaState, iJobIndex, "devices");
+	iType = lua_type(ptLuaState, -1);
+	if( iType==LUA_TNIL )
+	{
+		tResult = __find_all_devices();
+	}
+	else if( iType!=LUA_TTABLE )
+	{
+		fprintf(stderr, "papa_schlumpf: the devices of the job must be a list of strings.\n");
+		tResult = PAPA_SCHLUMPF_RESULT_InvalidJob;
+	}
+	else
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_Ok;
+		iIndex = 1;
+		do
+		{
+			lua_rawgeti(ptLuaState, -1, iIndex);
+			iType = lua_type(ptLuaState, -1);
+			if( iType==LUA_TSTRING )
+			{
+				tResult = __add_worker(lua_tostring(ptLuaState, -1));
+			}
+			else if( iType!=LUA_TNIL )
+			{
+				fprintf(stderr, "papa_schlumpf: device %d of the job is not a string.\n", iIndex);
+				tResult = PAPA_SCHLUMPF_RESULT_InvalidJob;
+			}
+			lua_pop(ptLuaState, 1);
+			++iIndex;
+		} while( tResult==PAPA_SCHLUMPF_RESULT_Ok && iType!=LUA_TNIL );
+	}
+	lua_pop(ptLuaState, 1);
+
+	if( tResult==PAPA_SCHLUMPF_RESULT_Ok && m_sizWorkers==0 )
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_NoDeviceFound;
+	}
+
+	return tResult;
+}
+
+
+
+/* Add a worker for each Papa Schlumpf device. The USB path selects the device. */
+PAPA_SCHLUMPF_RESULT_T PapaSchlumpfOrchestrator::__find_all_devices(void)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	int iResult;
+	libusb_context *ptLibUsbContext;
+	ssize_t ssizDevList;
+	libusb_device **ptDeviceList;
+	libusb_device **ptDevCnt, **ptDevEnd;
+	libusb_device *ptDevice;
+	struct libusb_device_descriptor sDevDesc;
+	char acPath[64];
+
+
+	ptLibUsbContext = PapaSchlumpfFlex::__get_libusb_context();
+	if( ptLibUsbContext==NULL )
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_USBError;
+	}
+	else
+	{
+		ptDeviceList = NULL;
+		ssizDevList = libusb_get_device_list(ptLibUsbContext, &ptDeviceList);
+		if( ssizDevList<0 )
+		{
+			fprintf(stderr, "papa_schlumpf: failed to detect USB devices: %ld:%s\n", ssizDevList, libusb_strerror(libusb_error(ssizDevList)));
+			tResult = PAPA_SCHLUMPF_RESULT_USBError;
+		}
+		else
+		{
+			tResult = PAPA_SCHLUMPF_RESULT_Ok;
+
+			ptDevCnt = ptDeviceList;
+			ptDevEnd = ptDevCnt + ssizDevList;
+			while( ptDevCnt<ptDevEnd )
+			{
+				ptDevice = *ptDevCnt;
+
+				iResult = libusb_get_device_descriptor(ptDevice, &sDevDesc);
+				if( iResult==LIBUSB_SUCCESS && sDevDesc.idVendor==PAPA_SCHLUMPF_USB_VENDOR_ID && sDevDesc.idProduct==PAPA_SCHLUMPF_USB_PRODUCT_ID )
+				{
+					PapaSchlumpfFlex::__get_device_path(ptDevice, acPath, sizeof(acPath));
+					tResult = __add_worker(acPath);
+					if( tResult!=PAPA_SCHLUMPF_RESULT_Ok )
+					{
+						break;
+					}
+				}
+
+				++ptDevCnt;
+			}
+
+			libusb_free_device_list(ptDeviceList, 1);
+		}
+	}
+
+	return tResult;
+}
+
+
+
+PAPA_SCHLUMPF_RESULT_T PapaSchlumpfOrchestrator::__add_worker(const char *pcSelector)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	unsigned int sizWorkersMax;
+	WORKER_T *ptWorkers;
+	WORKER_T *ptWorker;
+
+
+	tResult = PAPA_SCHLUMPF_RESULT_Ok;
+
+	/* Grow the list of workers. */
+	if( m_sizWorkers>=m_sizWorkersMax )
+	{
+		sizWorkersMax = (m_sizWorkersMax==0) ? 8 : (m_sizWorkersMax * 2);
+		ptWorkers = (WORKER_T*)realloc(m_ptWorkers, sizWorkersMax * sizeof(WORKER_T));
+		if( ptWorkers==NULL )
+		{
+			tResult = PAPA_SCHLUMPF_RESULT_OutOfMemory;
+		}
+		else
+		{
+			m_ptWorkers = ptWorkers;
+			m_sizWorkersMax = sizWorkersMax;
+		}
+	}
+
+	if( tResult==PAPA_SCHLUMPF_RESULT_Ok )
+	{
+		ptWorker = m_ptWorkers + m_sizWorkers;
+		memset(ptWorker, 0, sizeof(WORKER_T));
+		ptWorker->ptThis = this;
+		ptWorker->tResult = PAPA_SCHLUMPF_RESULT_Ok;
+		ptWorker->pcSelector = strdup(pcSelector);
+		ptWorker->ptStepResults = (STEP_RESULT_T*)calloc(m_sizSteps, sizeof(STEP_RESULT_T));
+		if( ptWorker->pcSelector==NULL || ptWorker->ptStepResults==NULL )
+		{
+			free(ptWorker->pcSelector);
+			free(ptWorker->ptStepResults);
+			tResult = PAPA_SCHLUMPF_RESULT_OutOfMemory;
+		}
+		else
+		{
+			++m_sizWorkers;
+		}
+	}
+
+	return tResult;
+}
+
+
+
+void PapaSchlumpfOrchestrator::__push_results(lua_State *ptLuaState)
+{
+	const WORKER_T *ptWorker;
+	const STEP_RESULT_T *ptStepResult;
+	unsigned int uiWorker;
+	unsigned int uiStep;
+
+
+	lua_createtable(ptLuaState, m_sizWorkers, 0);
+	for(uiWorker=0; uiWorker<m_sizWorkers; ++uiWorker)
+	{
+		ptWorker = m_ptWorkers + uiWorker;
+
+		lua_newtable(ptLuaState);
+		lua_pushstring(ptLuaState, ptWorker->pcSelector);
+		lua_setfield(ptLuaState, -2, "device");
+		if( ptWorker->tResult==PAPA_SCHLUMPF_RESULT_Ok )
+		{
+			lua_pushboolean(ptLuaState, 1);
+			lua_setfield(ptLuaState, -2, "result");
+		}
+		else
+		{
+			lua_pushstring(ptLuaState, ptWorker->acError);
+			lua_setfield(ptLuaState, -2, "error");
+			lua_pushnumber(ptLuaState, ptWorker->uiFailedStep);
+			lua_setfield(ptLuaState, -2, "failedStep");
+		}
+		lua_pushnumber(ptLuaState, ptWorker->dSeconds);
+		lua_setfield(ptLuaState, -2, "seconds");
+
+		lua_newtable(ptLuaState);
+		for(uiStep=0; uiStep<m_sizSteps; ++uiStep)
+		{
+			ptStepResult = ptWorker->ptStepResults + uiStep;
+			if( ptStepResult->iHasValue!=0 )
+			{
+				lua_pushnumber(ptLuaState, ptStepResult->ulValue);
+				lua_rawseti(ptLuaState, -2, uiStep + 1);
+			}
+			else if( ptStepResult->pcData!=NULL )
+			{
+				lua_pushlstring(ptLuaState, ptStepResult->pcData, ptStepResult->sizData);
+				lua_rawseti(ptLuaState, -2, uiStep + 1);
+			}
+		}
+		lua_setfield(ptLuaState, -2, "reads");
+
+		lua_rawseti(ptLuaState, -2, uiWorker + 1);
+	}
+}
+
+
+
+void PapaSchlumpfOrchestrator::__free_job(void)
+{
+	WORKER_T *ptWorker;
+	unsigned int uiWorker;
+	unsigned int uiStep;
+
+
+	if( m_ptWorkers!=NULL )
+	{
+		for(uiWorker=0; uiWorker<m_sizWorkers; ++uiWorker)
+		{
+			ptWorker = m_ptWorkers + uiWorker;
+			for(uiStep=0; uiStep<m_sizSteps; ++uiStep)
+			{
+				free(ptWorker->ptStepResults[uiStep].pcData);
+			}
+			free(ptWorker->ptStepResults);
+			free(ptWorker->pcSelector);
+		}
+		free(m_ptWorkers);
+		m_ptWorkers = NULL;
+	}
+	m_sizWorkers = 0;
+	m_sizWorkersMax = 0;
+
+	if( m_ptSteps!=NULL )
+	{
+		for(uiStep=0; uiStep<m_sizSteps; ++uiStep)
+		{
+			free(m_ptSteps[uiStep].pcData);
+		}
+		free(m_ptSteps);
+		m_ptSteps = NULL;
+	}
+	m_sizSteps = 0;
+}
+
+
+
+void *PapaSchlumpfOrchestrator::__worker_thread(void *pvUser)
+{
+	WORKER_T *ptWorker;
+
+
+	ptWorker = (WORKER_T*)pvUser;
+	ptWorker->ptThis->__run_worker(ptWorker);
+
+	return NULL;
+}
+
+
+
+/* Connect to one device and run all steps. Stop at the first error. */
+void PapaSchlumpfOrchestrator::__run_worker(WORKER_T *ptWorker)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	PapaSchlumpfFlex *ptDevice;
+	struct timespec tStart;
+	unsigned int uiStep;
+
+
+	clock_gettime(CLOCK_MONOTONIC, &tStart);
+
+	/* Each worker has its own device handle on the shared libusb context. */
+	ptDevice = new PapaSchlumpfFlex();
+	tResult = (PAPA_SCHLUMPF_RESULT_T)ptDevice->connect(ptWorker->pcSelector);
+	if( tResult!=PAPA_SCHLUMPF_RESULT_Ok )
+	{
+		snprintf(ptWorker->acError, sizeof(ptWorker->acError), "Failed to connect: %s", PapaSchlumpfFlex::__get_error_string(tResult));
+		ptWorker->uiFailedStep = 0;
+	}
+	else
+	{
+		for(uiStep=0; uiStep<m_sizSteps; ++uiStep)
+		{
+			tResult = __run_step(ptDevice, m_ptSteps + uiStep, ptWorker->ptStepResults + uiStep, ptWorker->acError, sizeof(ptWorker->acError));
+			if( tResult!=PAPA_SCHLUMPF_RESULT_Ok )
+			{
+				ptWorker->uiFailedStep = uiStep + 1;
+				break;
+			}
+		}
+
+		ptDevice->disconnect();
+	}
+	delete ptDevice;
+
+	ptWorker->tResult = tResult;
+	ptWorker->dSeconds = __get_seconds(&tStart);
+}
+
+
+
+PAPA_SCHLUMPF_RESULT_T PapaSchlumpfOrchestrator::__run_step(PapaSchlumpfFlex *ptDevice, const JOB_STEP_T *ptStep, STEP_RESULT_T *ptStepResult, char *pcError, size_t sizError)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	int iResult;
+	unsigned long ulValue;
+	char *pcData;
+	size_t sizData;
+
+
+	iResult = PAPA_SCHLUMPF_RESULT_Ok;
+	ulValue = 0;
+	switch( ptStep->tOperation )
+	{
+	case JOB_OPERATION_ResetPCI:
+		iResult = ptDevice->resetPCI(ptStep->aulParameter[0], ptStep->aulParameter[1], ptStep->aulParameter[2]);
+		break;
+
+	case JOB_OPERATION_SetupNetx:
+		iResult = ptDevice->setupNetx();
+		break;
+
+	case JOB_OPERATION_Delay:
+		usleep(ptStep->aulParameter[0] * 1000U);
+		break;
+
+	case JOB_OPERATION_IoRead:
+		iResult = ptDevice->ioRead(ptStep->aulParameter[0], &ulValue);
+		break;
+
+	case JOB_OPERATION_MemRead:
+		iResult = ptDevice->memRead(ptStep->aulParameter[0], &ulValue);
+		break;
+
+	case JOB_OPERATION_Cfg0Read:
+		iResult = ptDevice->cfg0Read(ptStep->aulParameter[0], &ulValue);
+		break;
+
+	case JOB_OPERATION_Cfg1Read:
+		iResult = ptDevice->cfg1Read(ptStep->aulParameter[0], &ulValue);
+		break;
+
+	case JOB_OPERATION_IoWrite:
+		iResult = ptDevice->ioWrite(ptStep->aulParameter[0], ptStep->aulParameter[1]);
+		break;
+
+	case JOB_OPERATION_MemWrite:
+		iResult = ptDevice->memWrite(ptStep->aulParameter[0], ptStep->aulParameter[1]);
+		break;
+
+	case JOB_OPERATION_Cfg0Write:
+		iResult = ptDevice->cfg0Write(ptStep->aulParameter[0], ptStep->aulParameter[1]);
+		break;
+
+	case JOB_OPERATION_Cfg1Write:
+		iResult = ptDevice->cfg1Write(ptStep->aulParameter[0], ptStep->aulParameter[1]);
+		break;
+
+	case JOB_OPERATION_MemReadArea:
+		pcData = NULL;
+		sizData = 0;
+		iResult = ptDevice->memReadArea(ptStep->aulParameter[0], ptStep->aulParameter[1], &pcData, &sizData);
+		if( iResult==PAPA_SCHLUMPF_RESULT_Ok )
+		{
+			ptStepResult->pcData = pcData;
+			ptStepResult->sizData = sizData;
+		}
+		break;
+
+	case JOB_OPERATION_MemWriteArea:
+		iResult = ptDevice->memWriteArea(ptStep->aulParameter[0], ptStep->pcData, ptStep->sizData);
+		break;
+
+	case JOB_OPERATION_MemWriteAreaFromFile:
+		iResult = ptDevice->memWriteAreaFromFile(ptStep->aulParameter[0], ptStep->pcData, ptStep->aulParameter[1], ptStep->aulParameter[2]);
+		break;
+
+	case JOB_OPERATION_Batch:
+		pcData = NULL;
+		sizData = 0;
+		iResult = ptDevice->executeBatch(ptStep->pcData, ptStep->sizData, &pcData, &sizData);
+		if( iResult==PAPA_SCHLUMPF_RESULT_Ok )
+		{
+			ptStepResult->pcData = pcData;
+			ptStepResult->sizData = sizData;
+		}
+		break;
+	}
+
+	tResult = (PAPA_SCHLUMPF_RESULT_T)iResult;
+	if( tResult!=PAPA_SCHLUMPF_RESULT_Ok )
+	{
+		snprintf(pcError, sizError, "%s", PapaSchlumpfFlex::__get_error_string(tResult));
+	}
+	else if( ptStep->tOperation>=JOB_OPERATION_IoRead && ptStep->tOperation<=JOB_OPERATION_Cfg1Read )
+	{
+		ptStepResult->iHasValue = 1;
+		ptStepResult->ulValue = ulValue;
+
+		if( ptStep->iHasExpect!=0 && ((uint32_t)ulValue & ptStep->ulMask)!=(ptStep->ulExpect & ptStep->ulMask) )
+		{
+			snprintf(pcError, sizError, "Read 0x%08lx from 0x%08x, but expected 0x%08x with mask 0x%08x.", ulValue, ptStep->aulParameter[0], ptStep->ulExpect, ptStep->ulMask);
+			tResult = PAPA_SCHLUMPF_RESULT_CommandFailed;
+		}
+	}
+
+	return tResult;
+}
+
+
+
+double PapaSchlumpfOrchestrator::__get_seconds(const struct timespec *ptStart)
+{
+	struct timespec tNow;
+
+
+	clock_gettime(CLOCK_MONOTONIC, &tNow);
+	return (double)(tNow.tv_sec - ptStart->tv_sec) + (double)(tNow.tv_nsec - ptStart->tv_nsec) / 1000000000.0;
+}
@@ -0,0 +1,139 @@
+#include "papa_schlumpf.h"
+
+
+#ifndef SWIG
+#include <pthread.h>
+#include <time.h>
+#endif
+
+
+#ifndef __PAPA_SCHLUMPF_ORCHESTRATOR_H__
+#define __PAPA_SCHLUMPF_ORCHESTRATOR_H__
+
+
+/* Run the same job on all connected Papa Schlumpf devices at the same time.
+ * Each device gets its own worker thread and its own USB handle.
+ *
+ * The job is a table with one step per element. Each step is a table with
+ * the name of the operation and its parameters:
+ *
+ *   { 'resetPCI' [, ulResetActiveToClock, ulResetActiveDelayAfterClock, ulBusIdleDelay] }
+ *   { 'setupNetx' }
+ *   { 'delay', ulMilliseconds }
+ *   { 'ioRead' | 'memRead' | 'cfg0Read' | 'cfg1Read', ulAddress [, expect=ulValue] [, mask=ulMask] }
+ *   { 'ioWrite' | 'memWrite' | 'cfg0Write' | 'cfg1Write', ulAddress, ulData }
+ *   { 'memReadArea', ulAddress, ulSize }
+ *   { 'memWriteArea', ulAddress, strData }
+ *   { 'memWriteAreaFromFile', ulAddress, strPath [, ulFileOffset, ulSize] }
+ *   { 'batch', strEntries }
+ *
+ * The optional field "devices" of the job is a list of device selectors (USB
+ * path or serial number). Without this field the job runs on all devices.
+ *
+ * The result is a list with one table per device. It has the fields "device"
+ * (the selector), "result" (true or nil), "error", "failedStep", "seconds"
+ * and "reads". The "reads" table has the read value or data for each step
+ * which returns something, indexed by the step number.
+ */
+class PapaSchlumpfOrchestrator
+{
+public:
+	PapaSchlumpfOrchestrator(void);
+	~PapaSchlumpfOrchestrator(void);
+
+	RESULT_INT_NOTHING_OR_NIL_WITH_ERR run(lua_State *ptLuaStateForTableAccess, lua_State *MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT);
+
+	const char *get_error_string(int iResult);
+
+/* Do not wrap the private members. */
+#ifndef SWIG
+private:
+	typedef enum JOB_OPERATION_ENUM
+	{
+		JOB_OPERATION_ResetPCI,
+		JOB_OPERATION_SetupNetx,
+		JOB_OPERATION_Delay,
+		JOB_OPERATION_IoRead,
+		JOB_OPERATION_MemRead,
+		JOB_OPERATION_Cfg0Read,
+		JOB_OPERATION_Cfg1Read,
+		JOB_OPERATION_IoWrite,
+		JOB_OPERATION_MemWrite,
+		JOB_OPERATION_Cfg0Write,
+		JOB_OPERATION_Cfg1Write,
+		JOB_OPERATION_MemReadArea,
+		JOB_OPERATION_MemWriteArea,
+		JOB_OPERATION_MemWriteAreaFromFile,
+		JOB_OPERATION_Batch
+	} JOB_OPERATION_T;
+
+	typedef struct JOB_OPERATION_NAME_STRUCT
+	{
+		JOB_OPERATION_T tOperation;
+		const char *pcName;
+		const char *pcArguments;
+	} JOB_OPERATION_NAME_T;
+	static const JOB_OPERATION_NAME_T atOperationNames[];
+
+	/* One step of the job. It is shared by all workers and must not change while they run. */
+	typedef struct JOB_STEP_STRUCT
+	{
+		JOB_OPERATION_T tOperation;
+		uint32_t aulParameter[3];
+		int iHasExpect;
+		uint32_t ulExpect;
+		uint32_t ulMask;
+		char *pcData;
+		size_t sizData;
+	} JOB_STEP_T;
+
+	/* The result of one step on one device. */
+	typedef struct STEP_RESULT_STRUCT
+	{
+		int iHasValue;
+		unsigned long ulValue;
+		char *pcData;
+		size_t sizData;
+	} STEP_RESULT_T;
+
+	/* Everything about one device. Only the worker thread writes here while it runs. */
+	typedef struct WORKER_STRUCT
+	{
+		PapaSchlumpfOrchestrator *ptThis;
+		char *pcSelector;
+		pthread_t tThread;
+		int iThreadRunning;
+		PAPA_SCHLUMPF_RESULT_T tResult;
+		char acError[256];
+		unsigned int uiFailedStep;
+		double dSeconds;
+		STEP_RESULT_T *ptStepResults;
+	} WORKER_T;
+
+	PAPA_SCHLUMPF_RESULT_T __parse_job(lua_State *ptLuaState, int iJobIndex);
+	PAPA_SCHLUMPF_RESULT_T __parse_step(lua_State *ptLuaState, int iStepIndex, JOB_STEP_T *ptStep);
+	PAPA_SCHLUMPF_RESULT_T __parse_devices(lua_State *ptLuaState, int iJobIndex);
+	PAPA_SCHLUMPF_RESULT_T __find_all_devices(void);
+	PAPA_SCHLUMPF_RESULT_T __add_worker(const char *pcSelector);
+	void __push_results(lua_State *ptLuaState);
+	void __free_job(void);
+
+	static void *__worker_thread(void *pvUser);
+	void __run_worker(WORKER_T *ptWorker);
+	PAPA_SCHLUMPF_RESULT_T __run_step(PapaSchlumpfFlex *ptDevice, const JOB_STEP_T *ptStep, STEP_RESULT_T *ptStepResult, char *pcError, size_t sizError);
+
+	static double __get_seconds(const struct timespec *ptStart);
+
+	/* The steps of the job. */
+	JOB_STEP_T *m_ptSteps;
+	unsigned int m_sizSteps;
+
+	/* One worker for each device. */
+	WORKER_T *m_ptWorkers;
+	unsigned int m_sizWorkers;
+	unsigned int m_sizWorkersMax;
+#endif
+};
+
+
+#endif  /* __PAPA_SCHLUMPF_ORCHESTRATOR_H__ */
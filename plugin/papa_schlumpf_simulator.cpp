@@ -0,0 +1,150 @@
+#include "papa_schlumpf_simulator.h"
+#include "papa_schlumpf_transport_simulator.h"
+
+#include <stdlib.h>
+
+#include <lua.h>
+
+#include "simulator.h"
+
+
+PapaSchlumpfSimulator::PapaSchlumpfSimulator(void)
+ : m_uiLatencyUs(0)
+ , m_uiBytesPerMs(0)
+{
+}
+
+
+
+PapaSchlumpfSimulator::~PapaSchlumpfSimulator(void)
+{
+}
+
+
+
+/* Remove all regions and clear the counters. */
+void PapaSchlumpfSimulator::reset(void)
+{
+	simulator_reset();
+}
+
+
+
+RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfSimulator::addRegion(unsigned int uiSpace, uint32_t ulAddress, uint32_t ulSize)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	int iResult;
+
+
+	/* The region must be DWORD aligned and must not overlap other regions. */
+	tResult = PAPA_SCHLUMPF_RESULT_InvalidSize;
+	if( uiSpace<SIMULATOR_SPACES )
+	{
+		iResult = simulator_add_region((SIMULATOR_SPACE_T)uiSpace, ulAddress, ulSize);
+		if( iResult==0 )
+		{
+			tResult = PAPA_SCHLUMPF_RESULT_Ok;
+		}
+	}
+
+	return tResult;
+}
+
+
+
+RESULT_INT_NOTHING_OR_NIL_WITH_ERR PapaSchlumpfSimulator::read(unsigned int uiSpace, uint32_t ulAddress, PUL_ARGUMENT_OUT pulData)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	int iResult;
+	uint32_t ulData;
+
+
+	tResult = PAPA_SCHLUMPF_RESULT_CommandFailed;
+	if( uiSpace<SIMULATOR_SPACES )
+	{
+		iResult = simulator_read((SIMULATOR_SPACE_T)uiSpace, ulAddress, &ulData);
+		if( iResult==0 )
+		{
+			*pulData = ulData;
+			tResult = PAPA_SCHLUMPF_RESULT_Ok;
+		}
+	}
+
+	return tResult;
+}
+
+
+
+RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfSimulator::write(unsigned int uiSpace, uint32_t ulAddress, uint32_t ulData)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	int iResult;
+
+
+	tResult = PAPA_SCHLUMPF_RESULT_CommandFailed;
+	if( uiSpace<SIMULATOR_SPACES )
+	{
+		iResult = simulator_write((SIMULATOR_SPACE_T)uiSpace, ulAddress, ulData);
+		if( iResult==0 )
+		{
+			tResult = PAPA_SCHLUMPF_RESULT_Ok;
+		}
+	}
+
+	return tResult;
+}
+
+
+
+void PapaSchlumpfSimulator::getCounters(lua_State *MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT)
+{
+	SIMULATOR_COUNTERS_T tCounters;
+
+
+	simulator_get_counters(&tCounters);
+
+	lua_newtable(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT);
+	lua_pushnumber(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, tCounters.ulCommands);
+	lua_setfield(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, -2, "commands");
+	lua_pushnumber(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, tCounters.ulPackets);
+	lua_setfield(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, -2, "packets");
+	lua_pushnumber(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, tCounters.ulDmaTransfers);
+	lua_setfield(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, -2, "dmaTransfers");
+	lua_pushnumber(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, tCounters.ulDmaDwords);
+	lua_setfield(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, -2, "dmaDwords");
+	lua_pushnumber(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, tCounters.ulDmaErrors);
+	lua_setfield(MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT, -2, "dmaErrors");
+}
+
+
+
+void PapaSchlumpfSimulator::setTiming(unsigned int uiLatencyUs, unsigned int uiBytesPerMs)
+{
+	m_uiLatencyUs = uiLatencyUs;
+	m_uiBytesPerMs = uiBytesPerMs;
+}
+
+
+
+/* Connect the object to the simulated firmware. An existing connection of the object is closed. */
+RESULT_INT_TRUE_OR_NIL_WITH_ERR PapaSchlumpfSimulator::connect(PapaSchlumpfFlex *ptFlex)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	PapaSchlumpfTransportSimulator *ptTransport;
+
+
+	ptTransport = new PapaSchlumpfTransportSimulator();
+	ptTransport->setTiming(m_uiLatencyUs, m_uiBytesPerMs);
+
+	/* The object owns the transport now. */
+	tResult = ptFlex->connectTransport(ptTransport);
+
+	return tResult;
+}
+
+
+
+const char *PapaSchlumpfSimulator::get_error_string(int iResult)
+{
+	return PapaSchlumpfFlex::__get_error_string(iResult);
+}
@@ -0,0 +1,41 @@
+#include "papa_schlumpf.h"
+
+
+#ifndef __PAPA_SCHLUMPF_SIMULATOR_H__
+#define __PAPA_SCHLUMPF_SIMULATOR_H__
+
+
+/* Configure the simulated firmware and connect a PapaSchlumpfFlex object to it.
+ * The firmware runs in this process on top of a model of the PCI memory,
+ * configuration and I/O spaces. The spaces have the values of DMATYPE in Lua.
+ * There is only one simulated firmware per process. All objects of this
+ * class share it.
+ */
+class PapaSchlumpfSimulator
+{
+public:
+	PapaSchlumpfSimulator(void);
+	~PapaSchlumpfSimulator(void);
+
+	void reset(void);
+	RESULT_INT_TRUE_OR_NIL_WITH_ERR addRegion(unsigned int uiSpace, uint32_t ulAddress, uint32_t ulSize);
+	RESULT_INT_NOTHING_OR_NIL_WITH_ERR read(unsigned int uiSpace, uint32_t ulAddress, PUL_ARGUMENT_OUT pulData);
+	RESULT_INT_TRUE_OR_NIL_WITH_ERR write(unsigned int uiSpace, uint32_t ulAddress, uint32_t ulData);
+	void getCounters(lua_State *MUHKUH_SWIG_OUTPUT_CUSTOM_OBJECT);
+
+	/* The timing is used for the next connect. A link speed of 0 is infinitely fast. */
+	void setTiming(unsigned int uiLatencyUs, unsigned int uiBytesPerMs);
+	RESULT_INT_TRUE_OR_NIL_WITH_ERR connect(PapaSchlumpfFlex *ptFlex);
+
+	const char *get_error_string(int iResult);
+
+/* Do not wrap the private members. */
+#ifndef SWIG
+private:
+	unsigned int m_uiLatencyUs;
+	unsigned int m_uiBytesPerMs;
+#endif
+};
+
+
+#endif  /* __PAPA_SCHLUMPF_SIMULATOR_H__ */
@@ -0,0 +1,408 @@
+#include "papa_schlumpf_trace.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+
+PapaSchlumpfTrace::PapaSchlumpfTrace(void)
+ : m_pucRing(NULL)
+ , m_sizRing(0)
+ , m_sizHead(0)
+ , m_sizTail(0)
+ , m_sizUsed(0)
+ , m_ulRecords(0)
+ , m_ulDropped(0)
+ , m_iWithPayload(0)
+{
+	memset(&m_tStart, 0, sizeof(m_tStart));
+}
+
+
+
+PapaSchlumpfTrace::~PapaSchlumpfTrace(void)
+{
+	if( m_pucRing!=NULL )
+	{
+		free(m_pucRing);
+		m_pucRing = NULL;
+	}
+	m_sizRing = 0;
+}
+
+
+
+/* Allocate the ring buffer and start the time stamps at 0. */
+PAPA_SCHLUMPF_RESULT_T PapaSchlumpfTrace::start(size_t sizBuffer, int iWithPayload)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+
+
+	if( sizBuffer<sizeof(PAPA_SCHLUMPF_TRACE_RECORD_T) )
+	{
+		tResult = PAPA_SCHLUMPF_RESULT_InvalidSize;
+	}
+	else
+	{
+		if( m_pucRing!=NULL )
+		{
+			free(m_pucRing);
+		}
+		m_pucRing = (unsigned char*)malloc(sizBuffer);
+		if( m_pucRing==NULL )
+		{
+			m_sizRing = 0;
+			tResult = PAPA_SCHLUMPF_RESULT_OutOfMemory;
+		}
+		else
+		{
+			m_sizRing = sizBuffer;
+			m_sizHead = 0;
+			m_sizTail = 0;
+			m_sizUsed = 0;
+			m_ulRecords = 0;
+			m_ulDropped = 0;
+			m_iWithPayload = iWithPayload;
+			clock_gettime(CLOCK_MONOTONIC, &m_tStart);
+			tResult = PAPA_SCHLUMPF_RESULT_Ok;
+		}
+	}
+
+	return tResult;
+}
+
+
+
+/* Add one command to the ring buffer.
+ * pucResponseData points to the data after the status. It can be NULL if
+ * the data is not available anymore. sizResponse is the size of the complete
+ * response including the status.
+ */
+void PapaSchlumpfTrace::record(const unsigned char *pucCommand, size_t sizCommand, uint32_t ulStatus, const unsigned char *pucResponseData, size_t sizResponse, const struct timespec *ptStart, unsigned long ulDurationUs)
+{
+	PAPA_SCHLUMPF_TRACE_RECORD_T tRecord;
+	size_t sizCommandStored;
+	size_t sizResponseStored;
+	size_t sizTotal;
+	long long llTimestampUs;
+
+
+	memset(&tRecord, 0, sizeof(tRecord));
+
+	llTimestampUs = (long long)(ptStart->tv_sec - m_tStart.tv_sec) * 1000000LL + (long long)(ptStart->tv_nsec - m_tStart.tv_nsec) / 1000LL;
+	tRecord.ullTimestampUs = (llTimestampUs<0) ? 0 : (uint64_t)llTimestampUs;
+
+	/* All commands start with the command ID. The DMA commands continue with the address, the areas with the size. */
+	tRecord.ulCommand = PAPA_SCHLUMPF_TRACE_STATUS_NO_RESPONSE;
+	if( sizCommand>=sizeof(uint32_t) )
+	{
+		memcpy(&tRecord.ulCommand, pucCommand, sizeof(uint32_t));
+	}
+	if( ((tRecord.ulCommand>=PAPA_SCHLUMPF_USB_COMMAND_DMAIoRead && tRecord.ulCommand<=PAPA_SCHLUMPF_USB_COMMAND_DMAMemWriteArea) || tRecord.ulCommand==PAPA_SCHLUMPF_USB_COMMAND_DMAMemModify || tRecord.ulCommand==PAPA_SCHLUMPF_USB_COMMAND_DMAIoModify) && sizCommand>=2*sizeof(uint32_t) )
+	{
+		memcpy(&tRecord.ulAddress, pucCommand + sizeof(uint32_t), sizeof(uint32_t));
+		tRecord.ulSize = sizeof(uint32_t);
+	}
+	/* The poll command has the type before the address. */
+	if( tRecord.ulCommand==PAPA_SCHLUMPF_USB_COMMAND_PollMem && sizCommand>=3*sizeof(uint32_t) )
+	{
+		memcpy(&tRecord.ulAddress, pucCommand + 2*sizeof(uint32_t), sizeof(uint32_t));
+		tRecord.ulSize = sizeof(uint32_t);
+	}
+	if( (tRecord.ulCommand==PAPA_SCHLUMPF_USB_COMMAND_DMAMemReadArea || tRecord.ulCommand==PAPA_SCHLUMPF_USB_COMMAND_DMAMemWriteArea) && sizCommand>=3*sizeof(uint32_t) )
+	{
+		memcpy(&tRecord.ulSize, pucCommand + 2*sizeof(uint32_t), sizeof(uint32_t));
+	}
+	if( (tRecord.ulCommand==PAPA_SCHLUMPF_USB_COMMAND_MemChecksum || tRecord.ulCommand==PAPA_SCHLUMPF_USB_COMMAND_MemFill || tRecord.ulCommand==PAPA_SCHLUMPF_USB_COMMAND_DMACfg0ReadArea || tRecord.ulCommand==PAPA_SCHLUMPF_USB_COMMAND_DMACfg1ReadArea || tRecord.ulCommand==PAPA_SCHLUMPF_USB_COMMAND_MemReadStream) && sizCommand>=3*sizeof(uint32_t) )
+	{
+		memcpy(&tRecord.ulAddress, pucCommand + sizeof(uint32_t), sizeof(uint32_t));
+		memcpy(&tRecord.ulSize, pucCommand + 2*sizeof(uint32_t), sizeof(uint32_t));
+	}
+	/* The scatter commands show the first area. */
+	if( (tRecord.ulCommand==PAPA_SCHLUMPF_USB_COMMAND_MemReadScatter || tRecord.ulCommand==PAPA_SCHLUMPF_USB_COMMAND_MemWriteScatter) && sizCommand>=4*sizeof(uint32_t) )
+	{
+		memcpy(&tRecord.ulAddress, pucCommand + 2*sizeof(uint32_t), sizeof(uint32_t));
+		memcpy(&tRecord.ulSize, pucCommand + 3*sizeof(uint32_t), sizeof(uint32_t));
+		tRecord.ulSize *= sizeof(uint32_t);
+	}
+	/* The copy command shows the destination. */
+	if( tRecord.ulCommand==PAPA_SCHLUMPF_USB_COMMAND_MemCopy && sizCommand>=4*sizeof(uint32_t) )
+	{
+		memcpy(&tRecord.ulAddress, pucCommand + sizeof(uint32_t), sizeof(uint32_t));
+		memcpy(&tRecord.ulSize, pucCommand + 3*sizeof(uint32_t), sizeof(uint32_t));
+	}
+	tRecord.ulStatus = ulStatus;
+	tRecord.ulDurationUs = (uint32_t)ulDurationUs;
+
+	if( sizResponse<sizeof(uint32_t) || pucResponseData==NULL )
+	{
+		sizResponseStored = 0;
+	}
+	else
+	{
+		sizResponseStored = sizResponse - sizeof(uint32_t);
+	}
+	sizCommandStored = sizCommand;
+	if( m_iWithPayload==0 )
+	{
+		if( sizCommandStored>PAPA_SCHLUMPF_TRACE_HEADER_BYTES )
+		{
+			sizCommandStored = PAPA_SCHLUMPF_TRACE_HEADER_BYTES;
+		}
+		if( sizResponseStored>PAPA_SCHLUMPF_TRACE_HEADER_BYTES )
+		{
+			sizResponseStored = PAPA_SCHLUMPF_TRACE_HEADER_BYTES;
+		}
+	}
+	tRecord.usCommandSize = (uint16_t)sizCommand;
+	tRecord.usCommandStored = (uint16_t)sizCommandStored;
+	tRecord.usResponseSize = (uint16_t)sizResponse;
+	tRecord.usResponseStored = (uint16_t)sizResponseStored;
+
+	sizTotal = sizeof(tRecord) + sizCommandStored + sizResponseStored;
+	if( sizTotal>m_sizRing )
+	{
+		++m_ulDropped;
+	}
+	else
+	{
+		/* Make room for the new record. */
+		while( (m_sizRing - m_sizUsed)<sizTotal )
+		{
+			__drop_oldest();
+		}
+
+		__ring_write(&tRecord, sizeof(tRecord));
+		__ring_write(pucCommand, sizCommandStored);
+		__ring_write(pucResponseData, sizResponseStored);
+		++m_ulRecords;
+	}
+}
+
+
+
+/* Write all records in the ring buffer to a file. */
+PAPA_SCHLUMPF_RESULT_T PapaSchlumpfTrace::save(const char *pcPath)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+	PAPA_SCHLUMPF_TRACE_FILE_HEADER_T tHeader;
+	FILE *ptFile;
+	size_t sizOffset;
+	size_t sizChunk;
+	size_t sizWritten;
+
+
+	ptFile = fopen(pcPath, "wb");
+	if( ptFile==NULL )
+	{
+		fprintf(stderr, "papa_schlumpf: failed to create the trace file %s: %s\n", pcPath, strerror(errno));
+		tResult = PAPA_SCHLUMPF_RESULT_FileError;
+	}
+	else
+	{
+		memcpy(tHeader.acMagic, PAPA_SCHLUMPF_TRACE_MAGIC, sizeof(tHeader.acMagic));
+		tHeader.ulVersion = PAPA_SCHLUMPF_TRACE_VERSION;
+		tHeader.ulFlags = (m_iWithPayload!=0) ? PAPA_SCHLUMPF_TRACE_FLAG_PAYLOAD : 0;
+		tHeader.ulRecords = (uint32_t)m_ulRecords;
+		tHeader.ulDropped = (uint32_t)m_ulDropped;
+		sizWritten = fwrite(&tHeader, sizeof(tHeader), 1, ptFile);
+
+		/* The records are in the ring buffer from the tail to the head. They wrap around at most once. */
+		sizOffset = m_sizTail;
+		sizChunk = m_sizUsed;
+		if( sizChunk>(m_sizRing - sizOffset) )
+		{
+			sizChunk = m_sizRing - sizOffset;
+		}
+		if( sizWritten==1 && sizChunk!=0 )
+		{
+			sizWritten = fwrite(m_pucRing + sizOffset, sizChunk, 1, ptFile);
+		}
+		if( sizWritten==1 && sizChunk<m_sizUsed )
+		{
+			sizWritten = fwrite(m_pucRing, m_sizUsed - sizChunk, 1, ptFile);
+		}
+
+		if( fclose(ptFile)!=0 || sizWritten!=1 )
+		{
+			fprintf(stderr, "papa_schlumpf: failed to write the trace file %s.\n", pcPath);
+			tResult = PAPA_SCHLUMPF_RESULT_FileError;
+		}
+		else
+		{
+			tResult = PAPA_SCHLUMPF_RESULT_Ok;
+		}
+	}
+
+	return tResult;
+}
+
+
+
+void PapaSchlumpfTrace::__ring_write(const void *pvData, size_t sizData)
+{
+	const unsigned char *pucData;
+	size_t sizChunk;
+
+
+	pucData = (const unsigned char*)pvData;
+	while( sizData!=0 )
+	{
+		sizChunk = m_sizRing - m_sizHead;
+		if( sizChunk>sizData )
+		{
+			sizChunk = sizData;
+		}
+		memcpy(m_pucRing + m_sizHead, pucData, sizChunk);
+		m_sizHead = (m_sizHead + sizChunk) % m_sizRing;
+		m_sizUsed += sizChunk;
+		pucData += sizChunk;
+		sizData -= sizChunk;
+	}
+}
+
+
+
+void PapaSchlumpfTrace::__ring_read(size_t sizOffset, void *pvData, size_t sizData)
+{
+	unsigned char *pucData;
+	size_t sizChunk;
+
+
+	pucData = (unsigned char*)pvData;
+	while( sizData!=0 )
+	{
+		sizChunk = m_sizRing - sizOffset;
+		if( sizChunk>sizData )
+		{
+			sizChunk = sizData;
+		}
+		memcpy(pucData, m_pucRing + sizOffset, sizChunk);
+		sizOffset = (sizOffset + sizChunk) % m_sizRing;
+		pucData += sizChunk;
+		sizData -= sizChunk;
+	}
+}
+
+
+
+void PapaSchlumpfTrace::__drop_oldest(void)
+{
+	PAPA_SCHLUMPF_TRACE_RECORD_T tRecord;
+	size_t sizRecord;
+
+
+	__ring_read(m_sizTail, &tRecord, sizeof(tRecord));
+	sizRecord = sizeof(tRecord) + tRecord.usCommandStored + tRecord.usResponseStored;
+	m_sizTail = (m_sizTail + sizRecord) % m_sizRing;
+	m_sizUsed -= sizRecord;
+	--m_ulRecords;
+	++m_ulDropped;
+}
+
+
+
+PapaSchlumpfTraceReader::PapaSchlumpfTraceReader(void)
+ : m_ptFile(NULL)
+ , m_pcPath(NULL)
+{
+}
+
+
+
+PapaSchlumpfTraceReader::~PapaSchlumpfTraceReader(void)
+{
+	close();
+}
+
+
+
+/* Open a trace file and check the header. */
+PAPA_SCHLUMPF_RESULT_T PapaSchlumpfTraceReader::open(const char *pcPath, PAPA_SCHLUMPF_TRACE_FILE_HEADER_T *ptHeader)
+{
+	PAPA_SCHLUMPF_RESULT_T tResult;
+
+
+	close();
+
+	m_ptFile = fopen(pcPath, "rb");
+	if( m_ptFile==NULL )
+	{
+		fprintf(stderr, "papa_schlumpf: failed to open the trace file %s: %s\n", pcPath, strerror(errno));
+		tResult = PAPA_SCHLUMPF_RESULT_FileError;
+	}
+	else if( fread(ptHeader, sizeof(PAPA_SCHLUMPF_TRACE_FILE_HEADER_T), 1, m_ptFile)!=1 || memcmp(ptHeader->acMagic, PAPA_SCHLUMPF_TRACE_MAGIC, sizeof(ptHeader->acMagic))!=0 )
+	{
+		fprintf(stderr, "papa_schlumpf: %s is no trace file.\n", pcPath);
+		close();
+		tResult = PAPA_SCHLUMPF_RESULT_FileError;
+	}
+	else if( ptHeader->ulVersion!=PAPA_SCHLUMPF_TRACE_VERSION )
+	{
+		fprintf(stderr, "papa_schlumpf: the trace file %s has the unknown version %d.\n", pcPath, ptHeader->ulVersion);
+		close();
+		tResult = PAPA_SCHLUMPF_RESULT_FileError;
+	}
+	else
+	{
+		m_pcPath = pcPath;
+		tResult = PAPA_SCHLUMPF_RESULT_Ok;
+	}
+
+	return tResult;
+}
+
+
+
+/* Read the next record.
+ * The command is padded with zeros up to its complete size if only the
+ * first bytes were stored.
+ * Return 1 for a record, 0 at the end of the file and -1 for an error.
+ */
+int PapaSchlumpfTraceReader::read(PAPA_SCHLUMPF_TRACE_RECORD_T *ptRecord, unsigned char *pucCommand, size_t sizCommandMax, unsigned char *pucResponseData, size_t sizResponseDataMax)
+{
+	int iResult;
+	size_t sizRead;
+
+
+	iResult = -1;
+	sizRead = fread(ptRecord, 1, sizeof(PAPA_SCHLUMPF_TRACE_RECORD_T), m_ptFile);
+	if( sizRead==0 && feof(m_ptFile)!=0 )
+	{
+		iResult = 0;
+	}
+	else if( sizRead!=sizeof(PAPA_SCHLUMPF_TRACE_RECORD_T) )
+	{
+		fprintf(stderr, "papa_schlumpf: the trace file %s is truncated.\n", m_pcPath);
+	}
+	else if( ptRecord->usCommandSize>sizCommandMax || ptRecord->usCommandStored>ptRecord->usCommandSize || ptRecord->usResponseStored>sizResponseDataMax )
+	{
+		fprintf(stderr, "papa_schlumpf: the trace file %s has an invalid record.\n", m_pcPath);
+	}
+	else
+	{
+		memset(pucCommand, 0, ptRecord->usCommandSize);
+		if( fread(pucCommand, 1, ptRecord->usCommandStored, m_ptFile)!=ptRecord->usCommandStored || fread(pucResponseData, 1, ptRecord->usResponseStored, m_ptFile)!=ptRecord->usResponseStored )
+		{
+			fprintf(stderr, "papa_schlumpf: the trace file %s is truncated.\n", m_pcPath);
+		}
+		else
+		{
+			iResult = 1;
+		}
+	}
+
+	return iResult;
+}
+
+
+
+void PapaSchlumpfTraceReader::close(void)
+{
+	if( m_ptFile!=NULL )
+	{
+		fclose(m_ptFile);
+		m_ptFile = NULL;
+	}
+	m_pcPath = NULL;
+}
@@ -0,0 +1,102 @@
+#include "papa_schlumpf.h"
+
+#include <stdio.h>
+#include <time.h>
+
+
+#ifndef __PAPA_SCHLUMPF_TRACE_H__
+#define __PAPA_SCHLUMPF_TRACE_H__
+
+
+/* A trace file starts with this header. It is followed by the records.
+ * All values are stored in the byte order of the PC.
+ */
+typedef struct PAPA_SCHLUMPF_TRACE_FILE_HEADER_STRUCT
+{
+	char acMagic[4];
+	uint32_t ulVersion;
+	uint32_t ulFlags;
+	uint32_t ulRecords;
+	uint32_t ulDropped;
+} PAPA_SCHLUMPF_TRACE_FILE_HEADER_T;
+
+#define PAPA_SCHLUMPF_TRACE_MAGIC "PSTR"
+#define PAPA_SCHLUMPF_TRACE_VERSION 1
+/* The records have the complete commands and responses. */
+#define PAPA_SCHLUMPF_TRACE_FLAG_PAYLOAD 0x00000001U
+/* This is the status of a command without a response, e.g. after a USB error. */
+#define PAPA_SCHLUMPF_TRACE_STATUS_NO_RESPONSE 0xffffffffU
+/* Without the payload only the first bytes of the command and the response are stored.
+ * This is enough for the header of all commands and the data of a single read.
+ */
+#define PAPA_SCHLUMPF_TRACE_HEADER_BYTES 16U
+
+
+/* One command and its response.
+ * The record is followed by "usCommandStored" bytes of the command and
+ * "usResponseStored" bytes of the response data after the status.
+ */
+typedef struct PAPA_SCHLUMPF_TRACE_RECORD_STRUCT
+{
+	uint64_t ullTimestampUs;
+	uint32_t ulCommand;
+	uint32_t ulAddress;
+	uint32_t ulSize;
+	uint32_t ulStatus;
+	uint32_t ulDurationUs;
+	uint32_t ulReserved;
+	uint16_t usCommandSize;
+	uint16_t usCommandStored;
+	uint16_t usResponseSize;
+	uint16_t usResponseStored;
+} PAPA_SCHLUMPF_TRACE_RECORD_T;
+
+
+/* Record the commands of one device in a ring buffer.
+ * If the buffer is full, the oldest records are dropped.
+ */
+class PapaSchlumpfTrace
+{
+public:
+	PapaSchlumpfTrace(void);
+	~PapaSchlumpfTrace(void);
+
+	PAPA_SCHLUMPF_RESULT_T start(size_t sizBuffer, int iWithPayload);
+	void record(const unsigned char *pucCommand, size_t sizCommand, uint32_t ulStatus, const unsigned char *pucResponseData, size_t sizResponse, const struct timespec *ptStart, unsigned long ulDurationUs);
+	PAPA_SCHLUMPF_RESULT_T save(const char *pcPath);
+
+private:
+	void __ring_write(const void *pvData, size_t sizData);
+	void __ring_read(size_t sizOffset, void *pvData, size_t sizData);
+	void __drop_oldest(void);
+
+	unsigned char *m_pucRing;
+	size_t m_sizRing;
+	size_t m_sizHead;
+	size_t m_sizTail;
+	size_t m_sizUsed;
+	unsigned long m_ulRecords;
+	unsigned long m_ulDropped;
+	int m_iWithPayload;
+	struct timespec m_tStart;
+};
+
+
+/* Read the records of a trace file one by one. */
+class PapaSchlumpfTraceReader
+{
+public:
+	PapaSchlumpfTraceReader(void);
+	~PapaSchlumpfTraceReader(void);
+
+	PAPA_SCHLUMPF_RESULT_T open(const char *pcPath, PAPA_SCHLUMPF_TRACE_FILE_HEADER_T *ptHeader);
+	int read(PAPA_SCHLUMPF_TRACE_RECORD_T *ptRecord, unsigned char *pucCommand, size_t sizCommandMax, unsigned char *pucResponseData, size_t sizResponseDataMax);
+	void close(void);
+
+private:
+	FILE *m_ptFile;
+	const char *m_pcPath;
+};
+
+
+#endif  /* __PAPA_SCHLUMPF_TRACE_H__ */
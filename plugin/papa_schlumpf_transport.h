@@ -0,0 +1,82 @@
+#include <stddef.h>
+#include <stdint.h>
+
+
+#ifndef __PAPA_SCHLUMPF_TRANSPORT_H__
+#define __PAPA_SCHLUMPF_TRANSPORT_H__
+
+
+typedef enum PAPA_SCHLUMPF_TRANSFER_STATUS_ENUM
+{
+	PAPA_SCHLUMPF_TRANSFER_STATUS_Completed = 0,
+	PAPA_SCHLUMPF_TRANSFER_STATUS_Error = 1,
+	PAPA_SCHLUMPF_TRANSFER_STATUS_TimedOut = 2,
+	PAPA_SCHLUMPF_TRANSFER_STATUS_Cancelled = 3,
+	PAPA_SCHLUMPF_TRANSFER_STATUS_NoDevice = 4
+} PAPA_SCHLUMPF_TRANSFER_STATUS_T;
+
+
+typedef struct PAPA_SCHLUMPF_TRANSFER_STRUCT PAPA_SCHLUMPF_TRANSFER_T;
+
+/* The transport calls this function when an asynchronous transfer is finished.
+ * It runs in the thread which handles the events of the transport.
+ */
+typedef void (*PFN_PAPA_SCHLUMPF_TRANSFER_CALLBACK_T)(PAPA_SCHLUMPF_TRANSFER_T *ptTransfer);
+
+/* One asynchronous transfer. Allocate it with the "allocTransfer" function of the transport. */
+struct PAPA_SCHLUMPF_TRANSFER_STRUCT
+{
+	/* These fields are set by the caller before "submit".
+	 * iIn is 0 for a command to the device and 1 for a response.
+	 * A command with iAddZeroPacket is terminated with a zero length packet.
+	 */
+	int iIn;
+	unsigned char *pucBuffer;
+	int sizBuffer;
+	int iAddZeroPacket;
+	unsigned int uiTimeoutMs;
+	PFN_PAPA_SCHLUMPF_TRANSFER_CALLBACK_T pfnCallback;
+	void *pvUser;
+
+	/* These fields are set by the transport before the callback. */
+	PAPA_SCHLUMPF_TRANSFER_STATUS_T tStatus;
+	int sizTransfered;
+
+	/* This belongs to the transport. */
+	void *pvTransport;
+};
+
+
+/* The connection to a Papa Schlumpf firmware.
+ * PapaSchlumpfFlex encodes the commands and checks the responses. A transport
+ * only moves the packets. All functions which return an int return 0 for
+ * success or one of the LIBUSB_ERROR codes, so all transports report errors
+ * the same way.
+ */
+class PapaSchlumpfTransport
+{
+public:
+	virtual ~PapaSchlumpfTransport(void) {}
+
+	/* Send one command or receive one response. */
+	virtual int send(const unsigned char *pucData, int sizData, unsigned int uiTimeoutMs) = 0;
+	virtual int receive(unsigned char *pucData, int sizDataMax, int *psizData, unsigned int uiTimeoutMs) = 0;
+
+	/* Start and stop the handling of asynchronous transfers.
+	 * The callbacks of submitted transfers run only between these calls.
+	 */
+	virtual int startEvents(void) = 0;
+	virtual void stopEvents(void) = 0;
+
+	virtual PAPA_SCHLUMPF_TRANSFER_T *allocTransfer(void) = 0;
+	virtual void freeTransfer(PAPA_SCHLUMPF_TRANSFER_T *ptTransfer) = 0;
+	virtual int submit(PAPA_SCHLUMPF_TRANSFER_T *ptTransfer) = 0;
+	/* Cancelling a finished transfer is allowed. The callback runs for every transfer which was still pending. */
+	virtual int cancel(PAPA_SCHLUMPF_TRANSFER_T *ptTransfer) = 0;
+
+	/* A short name for messages, e.g. the USB path. */
+	virtual const char *getName(void) = 0;
+};
+
+
+#endif  /* __PAPA_SCHLUMPF_TRANSPORT_H__ */
@@ -0,0 +1,224 @@
+#include "papa_schlumpf_transport_libusb.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+
+PapaSchlumpfTransportLibUsb::PapaSchlumpfTransportLibUsb(libusb_context *ptLibUsbContext, libusb_device_handle *ptDevHandle, const char *pcPath)
+ : m_ptLibUsbContext(ptLibUsbContext)
+ , m_ptDevHandle(ptDevHandle)
+ , m_iEventThreadRunning(0)
+ , m_iEventThreadStop(0)
+{
+	strncpy(m_acPath, pcPath, sizeof(m_acPath) - 1);
+	m_acPath[sizeof(m_acPath) - 1] = '\0';
+}
+
+
+
+PapaSchlumpfTransportLibUsb::~PapaSchlumpfTransportLibUsb(void)
+{
+	stopEvents();
+
+	if( m_ptDevHandle!=NULL )
+	{
+		/* Release and close the handle. */
+		libusb_release_interface(m_ptDevHandle, 0);
+		libusb_close(m_ptDevHandle);
+		m_ptDevHandle = NULL;
+	}
+}
+
+
+
+int PapaSchlumpfTransportLibUsb::send(const unsigned char *pucData, int sizData, unsigned int uiTimeoutMs)
+{
+	int iTransfered;
+	/* libusb_bulk_transfer expects a non-const pointer, but this is an out transfer. */
+	unsigned char *pucBuf = (unsigned char*)pucData;
+
+
+	return libusb_bulk_transfer(m_ptDevHandle, ENDPOINT_OUT, pucBuf, sizData, &iTransfered, uiTimeoutMs);
+}
+
+
+
+int PapaSchlumpfTransportLibUsb::receive(unsigned char *pucData, int sizDataMax, int *psizData, unsigned int uiTimeoutMs)
+{
+	return libusb_bulk_transfer(m_ptDevHandle, ENDPOINT_IN, pucData, sizDataMax, psizData, uiTimeoutMs);
+}
+
+
+
+/* Start the event thread. It handles the completion of all asynchronous transfers. */
+int PapaSchlumpfTransportLibUsb::startEvents(void)
+{
+	int iResult;
+
+
+	iResult = LIBUSB_SUCCESS;
+	if( m_iEventThreadRunning==0 )
+	{
+		m_iEventThreadStop = 0;
+		iResult = pthread_create(&m_tEventThread, NULL, __event_thread, this);
+		if( iResult!=0 )
+		{
+			fprintf(stderr, "papa_schlumpf: failed to start the USB event thread: %d\n", iResult);
+			iResult = LIBUSB_ERROR_OTHER;
+		}
+		else
+		{
+			m_iEventThreadRunning = 1;
+		}
+	}
+
+	return iResult;
+}
+
+
+
+void PapaSchlumpfTransportLibUsb::stopEvents(void)
+{
+	if( m_iEventThreadRunning!=0 )
+	{
+		/* Request a stop and wake up the thread. */
+		m_iEventThreadStop = 1;
+		libusb_interrupt_event_handler(m_ptLibUsbContext);
+		pthread_join(m_tEventThread, NULL);
+		m_iEventThreadRunning = 0;
+	}
+}
+
+
+
+PAPA_SCHLUMPF_TRANSFER_T *PapaSchlumpfTransportLibUsb::allocTransfer(void)
+{
+	PAPA_SCHLUMPF_TRANSFER_T *ptTransfer;
+	struct libusb_transfer *ptLibUsbTransfer;
+
+
+	ptTransfer = (PAPA_SCHLUMPF_TRANSFER_T*)calloc(1, sizeof(PAPA_SCHLUMPF_TRANSFER_T));
+	if( ptTransfer!=NULL )
+	{
+		ptLibUsbTransfer = libusb_alloc_transfer(0);
+		if( ptLibUsbTransfer==NULL )
+		{
+			free(ptTransfer);
+			ptTransfer = NULL;
+		}
+		else
+		{
+			ptTransfer->pvTransport = ptLibUsbTransfer;
+		}
+	}
+
+	return ptTransfer;
+}
+
+
+
+void PapaSchlumpfTransportLibUsb::freeTransfer(PAPA_SCHLUMPF_TRANSFER_T *ptTransfer)
+{
+	if( ptTransfer!=NULL )
+	{
+		libusb_free_transfer((struct libusb_transfer*)(ptTransfer->pvTransport));
+		free(ptTransfer);
+	}
+}
+
+
+
+int PapaSchlumpfTransportLibUsb::submit(PAPA_SCHLUMPF_TRANSFER_T *ptTransfer)
+{
+	struct libusb_transfer *ptLibUsbTransfer;
+
+
+	ptLibUsbTransfer = (struct libusb_transfer*)(ptTransfer->pvTransport);
+	libusb_fill_bulk_transfer(ptLibUsbTransfer, m_ptDevHandle, (ptTransfer->iIn!=0) ? ENDPOINT_IN : ENDPOINT_OUT, ptTransfer->pucBuffer, ptTransfer->sizBuffer, __transfer_callback, ptTransfer, ptTransfer->uiTimeoutMs);
+	ptLibUsbTransfer->flags = (ptTransfer->iAddZeroPacket!=0) ? LIBUSB_TRANSFER_ADD_ZERO_PACKET : 0;
+
+	return libusb_submit_transfer(ptLibUsbTransfer);
+}
+
+
+
+int PapaSchlumpfTransportLibUsb::cancel(PAPA_SCHLUMPF_TRANSFER_T *ptTransfer)
+{
+	int iResult;
+
+
+	/* A finished transfer returns LIBUSB_ERROR_NOT_FOUND. */
+	iResult = libusb_cancel_transfer((struct libusb_transfer*)(ptTransfer->pvTransport));
+	if( iResult==LIBUSB_ERROR_NOT_FOUND )
+	{
+		iResult = LIBUSB_SUCCESS;
+	}
+
+	return iResult;
+}
+
+
+
+const char *PapaSchlumpfTransportLibUsb::getName(void)
+{
+	return m_acPath;
+}
+
+
+
+void *PapaSchlumpfTransportLibUsb::__event_thread(void *pvUser)
+{
+	PapaSchlumpfTransportLibUsb *ptThis;
+	struct timeval tTimeout;
+
+
+	ptThis = (PapaSchlumpfTransportLibUsb*)pvUser;
+	while( ptThis->m_iEventThreadStop==0 )
+	{
+		/* Wake up from time to time to look at the stop flag. */
+		tTimeout.tv_sec = 0;
+		tTimeout.tv_usec = 100000;
+		libusb_handle_events_timeout_completed(ptThis->m_ptLibUsbContext, &tTimeout, NULL);
+	}
+
+	return NULL;
+}
+
+
+
+void LIBUSB_CALL PapaSchlumpfTransportLibUsb::__transfer_callback(struct libusb_transfer *ptLibUsbTransfer)
+{
+	PAPA_SCHLUMPF_TRANSFER_T *ptTransfer;
+
+
+	ptTransfer = (PAPA_SCHLUMPF_TRANSFER_T*)(ptLibUsbTransfer->user_data);
+	switch( ptLibUsbTransfer->status )
+	{
+	case LIBUSB_TRANSFER_COMPLETED:
+		ptTransfer->tStatus = PAPA_SCHLUMPF_TRANSFER_STATUS_Completed;
+		break;
+
+	case LIBUSB_TRANSFER_TIMED_OUT:
+		ptTransfer->tStatus = PAPA_SCHLUMPF_TRANSFER_STATUS_TimedOut;
+		break;
+
+	case LIBUSB_TRANSFER_CANCELLED:
+		ptTransfer->tStatus = PAPA_SCHLUMPF_TRANSFER_STATUS_Cancelled;
+		break;
+
+	case LIBUSB_TRANSFER_NO_DEVICE:
+		ptTransfer->tStatus = PAPA_SCHLUMPF_TRANSFER_STATUS_NoDevice;
+		break;
+
+	case LIBUSB_TRANSFER_ERROR:
+	case LIBUSB_TRANSFER_STALL:
+	case LIBUSB_TRANSFER_OVERFLOW:
+	default:
+		ptTransfer->tStatus = PAPA_SCHLUMPF_TRANSFER_STATUS_Error;
+		break;
+	}
+	ptTransfer->sizTransfered = ptLibUsbTransfer->actual_length;
+
+	ptTransfer->pfnCallback(ptTransfer);
+}
@@ -0,0 +1,51 @@
+#include "papa_schlumpf_transport.h"
+
+#include <libusb.h>
+#include <pthread.h>
+
+
+#ifndef __PAPA_SCHLUMPF_TRANSPORT_LIBUSB_H__
+#define __PAPA_SCHLUMPF_TRANSPORT_LIBUSB_H__
+
+
+/* The transport for a Papa Schlumpf device on USB.
+ * It owns the device handle and releases the interface in the destructor.
+ * An event thread handles the completion of the asynchronous transfers.
+ */
+class PapaSchlumpfTransportLibUsb : public PapaSchlumpfTransport
+{
+public:
+	PapaSchlumpfTransportLibUsb(libusb_context *ptLibUsbContext, libusb_device_handle *ptDevHandle, const char *pcPath);
+	~PapaSchlumpfTransportLibUsb(void);
+
+	int send(const unsigned char *pucData, int sizData, unsigned int uiTimeoutMs);
+	int receive(unsigned char *pucData, int sizDataMax, int *psizData, unsigned int uiTimeoutMs);
+
+	int startEvents(void);
+	void stopEvents(void);
+
+	PAPA_SCHLUMPF_TRANSFER_T *allocTransfer(void);
+	void freeTransfer(PAPA_SCHLUMPF_TRANSFER_T *ptTransfer);
+	int submit(PAPA_SCHLUMPF_TRANSFER_T *ptTransfer);
+	int cancel(PAPA_SCHLUMPF_TRANSFER_T *ptTransfer);
+
+	const char *getName(void);
+
+private:
+	static const unsigned char ENDPOINT_OUT = 0x01;
+	static const unsigned char ENDPOINT_IN = 0x81;
+
+	static void *__event_thread(void *pvUser);
+	static void LIBUSB_CALL __transfer_callback(struct libusb_transfer *ptLibUsbTransfer);
+
+	libusb_context *m_ptLibUsbContext;
+	libusb_device_handle *m_ptDevHandle;
+	char m_acPath[64];
+
+	pthread_t m_tEventThread;
+	int m_iEventThreadRunning;
+	volatile int m_iEventThreadStop;
+};
+
+
+#endif  /* __PAPA_SCHLUMPF_TRANSPORT_LIBUSB_H__ */
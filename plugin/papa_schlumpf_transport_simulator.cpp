@@ -0,0 +1,543 @@
+#include "papa_schlumpf_transport_simulator.h"
+
+#include <libusb.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "simulator.h"
+
+
+PapaSchlumpfTransportSimulator::PapaSchlumpfTransportSimulator(void)
+ : m_uiLatencyUs(0)
+ , m_uiBytesPerMs(0)
+ , m_ptResponseFirst(NULL)
+ , m_ptResponseLast(NULL)
+ , m_ptPendingIn(NULL)
+ , m_ptFinished(NULL)
+ , m_iEventThreadRunning(0)
+ , m_iEventThreadStop(0)
+{
+	pthread_condattr_t tConditionAttributes;
+
+
+	/* All times are on the monotonic clock. */
+	pthread_mutex_init(&m_tMutex, NULL);
+	pthread_condattr_init(&tConditionAttributes);
+	pthread_condattr_setclock(&tConditionAttributes, CLOCK_MONOTONIC);
+	pthread_cond_init(&m_tCondition, &tConditionAttributes);
+	pthread_condattr_destroy(&tConditionAttributes);
+
+	clock_gettime(CLOCK_MONOTONIC, &m_tLinkFree);
+}
+
+
+
+PapaSchlumpfTransportSimulator::~PapaSchlumpfTransportSimulator(void)
+{
+	RESPONSE_T *ptResponse;
+
+
+	stopEvents();
+
+	while( m_ptResponseFirst!=NULL )
+	{
+		ptResponse = m_ptResponseFirst;
+		m_ptResponseFirst = ptResponse->ptNext;
+		free(ptResponse);
+	}
+
+	pthread_cond_destroy(&m_tCondition);
+	pthread_mutex_destroy(&m_tMutex);
+}
+
+
+
+void PapaSchlumpfTransportSimulator::setTiming(unsigned int uiLatencyUs, unsigned int uiBytesPerMs)
+{
+	pthread_mutex_lock(&m_tMutex);
+	m_uiLatencyUs = uiLatencyUs;
+	m_uiBytesPerMs = uiBytesPerMs;
+	pthread_mutex_unlock(&m_tMutex);
+}
+
+
+
+int PapaSchlumpfTransportSimulator::send(const unsigned char *pucData, int sizData, unsigned int uiTimeoutMs)
+{
+	(void)uiTimeoutMs;
+
+	return __execute(pucData, sizData);
+}
+
+
+
+int PapaSchlumpfTransportSimulator::receive(unsigned char *pucData, int sizDataMax, int *psizData, unsigned int uiTimeoutMs)
+{
+	int iResult;
+	struct timespec tNow;
+	struct timespec tDeadline;
+	struct timespec tWake;
+	RESPONSE_T *ptResponse;
+
+
+	clock_gettime(CLOCK_MONOTONIC, &tDeadline);
+	__add_us(&tDeadline, (unsigned long long)uiTimeoutMs * 1000ULL);
+
+	ptResponse = NULL;
+	iResult = LIBUSB_SUCCESS;
+	pthread_mutex_lock(&m_tMutex);
+	do
+	{
+		clock_gettime(CLOCK_MONOTONIC, &tNow);
+		if( m_ptResponseFirst!=NULL && __is_before(&tNow, &(m_ptResponseFirst->tReady))==0 )
+		{
+			ptResponse = m_ptResponseFirst;
+			m_ptResponseFirst = ptResponse->ptNext;
+			if( m_ptResponseFirst==NULL )
+			{
+				m_ptResponseLast = NULL;
+			}
+		}
+		/* A timeout of 0 waits forever like libusb. */
+		else if( uiTimeoutMs!=0 && __is_before(&tNow, &tDeadline)==0 )
+		{
+			iResult = LIBUSB_ERROR_TIMEOUT;
+		}
+		else
+		{
+			tWake = tNow;
+			__add_us(&tWake, 100000);
+			if( uiTimeoutMs!=0 && __is_before(&tDeadline, &tWake)!=0 )
+			{
+				tWake = tDeadline;
+			}
+			if( m_ptResponseFirst!=NULL && __is_before(&(m_ptResponseFirst->tReady), &tWake)!=0 )
+			{
+				tWake = m_ptResponseFirst->tReady;
+			}
+			pthread_cond_timedwait(&m_tCondition, &m_tMutex, &tWake);
+		}
+	} while( ptResponse==NULL && iResult==LIBUSB_SUCCESS );
+	pthread_mutex_unlock(&m_tMutex);
+
+	if( ptResponse!=NULL )
+	{
+		if( ptResponse->sizData>sizDataMax )
+		{
+			/* The rest of the response is lost like on a real USB link. */
+			memcpy(pucData, ptResponse->aucData, sizDataMax);
+			*psizData = sizDataMax;
+			iResult = LIBUSB_ERROR_OVERFLOW;
+		}
+		else
+		{
+			memcpy(pucData, ptResponse->aucData, ptResponse->sizData);
+			*psizData = ptResponse->sizData;
+		}
+		free(ptResponse);
+	}
+
+	return iResult;
+}
+
+
+
+int PapaSchlumpfTransportSimulator::startEvents(void)
+{
+	int iResult;
+
+
+	iResult = LIBUSB_SUCCESS;
+	if( m_iEventThreadRunning==0 )
+	{
+		m_iEventThreadStop = 0;
+		iResult = pthread_create(&m_tEventThread, NULL, __event_thread, this);
+		if( iResult!=0 )
+		{
+			fprintf(stderr, "papa_schlumpf: failed to start the simulator event thread: %d\n", iResult);
+			iResult = LIBUSB_ERROR_OTHER;
+		}
+		else
+		{
+			m_iEventThreadRunning = 1;
+		}
+	}
+
+	return iResult;
+}
+
+
+
+void PapaSchlumpfTransportSimulator::stopEvents(void)
+{
+	if( m_iEventThreadRunning!=0 )
+	{
+		pthread_mutex_lock(&m_tMutex);
+		m_iEventThreadStop = 1;
+		pthread_cond_broadcast(&m_tCondition);
+		pthread_mutex_unlock(&m_tMutex);
+
+		pthread_join(m_tEventThread, NULL);
+		m_iEventThreadRunning = 0;
+	}
+}
+
+
+
+PAPA_SCHLUMPF_TRANSFER_T *PapaSchlumpfTransportSimulator::allocTransfer(void)
+{
+	TRANSFER_BLOCK_T *ptBlock;
+	PAPA_SCHLUMPF_TRANSFER_T *ptTransfer;
+
+
+	ptTransfer = NULL;
+	ptBlock = (TRANSFER_BLOCK_T*)calloc(1, sizeof(TRANSFER_BLOCK_T));
+	if( ptBlock!=NULL )
+	{
+		ptTransfer = &(ptBlock->tTransfer);
+		ptTransfer->pvTransport = &(ptBlock->tSimulator);
+	}
+
+	return ptTransfer;
+}
+
+
+
+void PapaSchlumpfTransportSimulator::freeTransfer(PAPA_SCHLUMPF_TRANSFER_T *ptTransfer)
+{
+	if( ptTransfer!=NULL )
+	{
+		/* Forget the transfer if it is still in a list. */
+		pthread_mutex_lock(&m_tMutex);
+		__remove(&m_ptPendingIn, ptTransfer);
+		__remove(&m_ptFinished, ptTransfer);
+		pthread_mutex_unlock(&m_tMutex);
+
+		/* The transfer is the first member of the block. */
+		free(ptTransfer);
+	}
+}
+
+
+
+int PapaSchlumpfTransportSimulator::submit(PAPA_SCHLUMPF_TRANSFER_T *ptTransfer)
+{
+	int iResult;
+	SIMULATOR_TRANSFER_T *ptSimulatorTransfer;
+
+
+	ptSimulatorTransfer = (SIMULATOR_TRANSFER_T*)(ptTransfer->pvTransport);
+	ptTransfer->sizTransfered = 0;
+
+	if( ptTransfer->iIn==0 )
+	{
+		/* The command runs right now. The transfer is finished in the event thread. */
+		iResult = __execute(ptTransfer->pucBuffer, ptTransfer->sizBuffer);
+		if( iResult==LIBUSB_SUCCESS )
+		{
+			pthread_mutex_lock(&m_tMutex);
+			ptTransfer->sizTransfered = ptTransfer->sizBuffer;
+			__complete(ptTransfer, PAPA_SCHLUMPF_TRANSFER_STATUS_Completed);
+			pthread_mutex_unlock(&m_tMutex);
+		}
+	}
+	else
+	{
+		ptSimulatorTransfer->iHasDeadline = (ptTransfer->uiTimeoutMs!=0) ? 1 : 0;
+		clock_gettime(CLOCK_MONOTONIC, &(ptSimulatorTransfer->tDeadline));
+		__add_us(&(ptSimulatorTransfer->tDeadline), (unsigned long long)ptTransfer->uiTimeoutMs * 1000ULL);
+
+		pthread_mutex_lock(&m_tMutex);
+		__append(&m_ptPendingIn, ptTransfer);
+		pthread_cond_broadcast(&m_tCondition);
+		pthread_mutex_unlock(&m_tMutex);
+
+		iResult = LIBUSB_SUCCESS;
+	}
+
+	return iResult;
+}
+
+
+
+int PapaSchlumpfTransportSimulator::cancel(PAPA_SCHLUMPF_TRANSFER_T *ptTransfer)
+{
+	pthread_mutex_lock(&m_tMutex);
+	if( __remove(&m_ptPendingIn, ptTransfer)!=0 )
+	{
+		__complete(ptTransfer, PAPA_SCHLUMPF_TRANSFER_STATUS_Cancelled);
+	}
+	pthread_mutex_unlock(&m_tMutex);
+
+	return LIBUSB_SUCCESS;
+}
+
+
+
+const char *PapaSchlumpfTransportSimulator::getName(void)
+{
+	return "simulator";
+}
+
+
+
+void PapaSchlumpfTransportSimulator::__add_us(struct timespec *ptTime, unsigned long long ullUs)
+{
+	unsigned long long ullNs;
+
+
+	ullNs = (unsigned long long)ptTime->tv_nsec + (ullUs % 1000000ULL) * 1000ULL;
+	ptTime->tv_sec += (time_t)(ullUs / 1000000ULL + ullNs / 1000000000ULL);
+	ptTime->tv_nsec = (long)(ullNs % 1000000000ULL);
+}
+
+
+
+/* Return 1 if A is before B, otherwise 0. */
+int PapaSchlumpfTransportSimulator::__is_before(const struct timespec *ptA, const struct timespec *ptB)
+{
+	int iIsBefore;
+
+
+	if( ptA->tv_sec!=ptB->tv_sec )
+	{
+		iIsBefore = (ptA->tv_sec<ptB->tv_sec) ? 1 : 0;
+	}
+	else
+	{
+		iIsBefore = (ptA->tv_nsec<ptB->tv_nsec) ? 1 : 0;
+	}
+
+	return iIsBefore;
+}
+
+
+
+void PapaSchlumpfTransportSimulator::__append(PAPA_SCHLUMPF_TRANSFER_T **pptHead, PAPA_SCHLUMPF_TRANSFER_T *ptTransfer)
+{
+	PAPA_SCHLUMPF_TRANSFER_T **pptCnt;
+
+
+	((SIMULATOR_TRANSFER_T*)(ptTransfer->pvTransport))->ptNext = NULL;
+
+	pptCnt = pptHead;
+	while( *pptCnt!=NULL )
+	{
+		pptCnt = &(((SIMULATOR_TRANSFER_T*)((*pptCnt)->pvTransport))->ptNext);
+	}
+	*pptCnt = ptTransfer;
+}
+
+
+
+/* Remove a transfer from a list. Return 1 if it was in the list, otherwise 0. */
+int PapaSchlumpfTransportSimulator::__remove(PAPA_SCHLUMPF_TRANSFER_T **pptHead, PAPA_SCHLUMPF_TRANSFER_T *ptTransfer)
+{
+	int iFound;
+	PAPA_SCHLUMPF_TRANSFER_T **pptCnt;
+
+
+	iFound = 0;
+	pptCnt = pptHead;
+	while( *pptCnt!=NULL )
+	{
+		if( *pptCnt==ptTransfer )
+		{
+			*pptCnt = ((SIMULATOR_TRANSFER_T*)(ptTransfer->pvTransport))->ptNext;
+			iFound = 1;
+			break;
+		}
+		pptCnt = &(((SIMULATOR_TRANSFER_T*)((*pptCnt)->pvTransport))->ptNext);
+	}
+
+	return iFound;
+}
+
+
+
+/* Run one command in the simulator. This must be called without the mutex. */
+int PapaSchlumpfTransportSimulator::__execute(const unsigned char *pucData, int sizData)
+{
+	int iResult;
+	EXECUTE_CONTEXT_T tContext;
+
+
+	/* A zero packet terminates a command with a multiple of 64 bytes on USB.
+	 * The simulator gets each command in one piece, so there is nothing to do.
+	 */
+	iResult = 0;
+	if( sizData!=0 )
+	{
+		tContext.ptThis = this;
+		tContext.sizCommand = sizData;
+		iResult = simulator_execute(pucData, (size_t)sizData, __receive_packet, &tContext);
+		if( iResult!=0 )
+		{
+			iResult = LIBUSB_ERROR_IO;
+		}
+	}
+
+	return iResult;
+}
+
+
+
+/* Queue one packet from the simulated firmware. It runs in the thread of __execute. */
+void PapaSchlumpfTransportSimulator::__receive_packet(void *pvUser, const unsigned char *pucPacket, size_t sizPacket)
+{
+	EXECUTE_CONTEXT_T *ptContext;
+	PapaSchlumpfTransportSimulator *ptThis;
+	RESPONSE_T *ptResponse;
+	struct timespec tNow;
+	unsigned long long ullTransferUs;
+
+
+	ptContext = (EXECUTE_CONTEXT_T*)pvUser;
+	ptThis = ptContext->ptThis;
+
+	ptResponse = (RESPONSE_T*)malloc(offsetof(RESPONSE_T, aucData) + sizPacket);
+	if( ptResponse==NULL )
+	{
+		fprintf(stderr, "papa_schlumpf: the simulator dropped a response of %lu bytes.\n", (unsigned long)sizPacket);
+	}
+	else
+	{
+		ptResponse->ptNext = NULL;
+		ptResponse->sizData = (int)sizPacket;
+		memcpy(ptResponse->aucData, pucPacket, sizPacket);
+
+		pthread_mutex_lock(&(ptThis->m_tMutex));
+
+		/* The link moves the command and the response after all earlier packets. */
+		clock_gettime(CLOCK_MONOTONIC, &tNow);
+		if( __is_before(&(ptThis->m_tLinkFree), &tNow)!=0 )
+		{
+			ptThis->m_tLinkFree = tNow;
+		}
+		if( ptThis->m_uiBytesPerMs!=0 )
+		{
+			ullTransferUs = ((unsigned long long)ptContext->sizCommand + (unsigned long long)sizPacket) * 1000ULL / ptThis->m_uiBytesPerMs;
+			__add_us(&(ptThis->m_tLinkFree), ullTransferUs);
+		}
+		/* Only the first packet of a command carries the command. */
+		ptContext->sizCommand = 0;
+
+		ptResponse->tReady = ptThis->m_tLinkFree;
+		__add_us(&(ptResponse->tReady), ptThis->m_uiLatencyUs);
+
+		if( ptThis->m_ptResponseLast==NULL )
+		{
+			ptThis->m_ptResponseFirst = ptResponse;
+		}
+		else
+		{
+			ptThis->m_ptResponseLast->ptNext = ptResponse;
+		}
+		ptThis->m_ptResponseLast = ptResponse;
+
+		pthread_cond_broadcast(&(ptThis->m_tCondition));
+		pthread_mutex_unlock(&(ptThis->m_tMutex));
+	}
+}
+
+
+
+/* Move a transfer to the finished list. The caller must hold the mutex. */
+void PapaSchlumpfTransportSimulator::__complete(PAPA_SCHLUMPF_TRANSFER_T *ptTransfer, PAPA_SCHLUMPF_TRANSFER_STATUS_T tStatus)
+{
+	ptTransfer->tStatus = tStatus;
+	__append(&m_ptFinished, ptTransfer);
+	pthread_cond_broadcast(&m_tCondition);
+}
+
+
+
+/* Match the responses with the receive transfers and run the callbacks. */
+void *PapaSchlumpfTransportSimulator::__event_thread(void *pvUser)
+{
+	PapaSchlumpfTransportSimulator *ptThis;
+	PAPA_SCHLUMPF_TRANSFER_T *ptTransfer;
+	SIMULATOR_TRANSFER_T *ptSimulatorTransfer;
+	RESPONSE_T *ptResponse;
+	struct timespec tNow;
+	struct timespec tWake;
+
+
+	ptThis = (PapaSchlumpfTransportSimulator*)pvUser;
+
+	pthread_mutex_lock(&(ptThis->m_tMutex));
+	while( ptThis->m_iEventThreadStop==0 )
+	{
+		ptTransfer = ptThis->m_ptFinished;
+		if( ptTransfer!=NULL )
+		{
+			/* Run the callback without the mutex. It may submit new transfers. */
+			__remove(&(ptThis->m_ptFinished), ptTransfer);
+			pthread_mutex_unlock(&(ptThis->m_tMutex));
+			ptTransfer->pfnCallback(ptTransfer);
+			pthread_mutex_lock(&(ptThis->m_tMutex));
+			continue;
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &tNow);
+		tWake = tNow;
+		__add_us(&tWake, 100000);
+
+		ptTransfer = ptThis->m_ptPendingIn;
+		if( ptTransfer!=NULL )
+		{
+			ptSimulatorTransfer = (SIMULATOR_TRANSFER_T*)(ptTransfer->pvTransport);
+			ptResponse = ptThis->m_ptResponseFirst;
+			if( ptResponse!=NULL && __is_before(&tNow, &(ptResponse->tReady))==0 )
+			{
+				ptThis->m_ptResponseFirst = ptResponse->ptNext;
+				if( ptThis->m_ptResponseFirst==NULL )
+				{
+					ptThis->m_ptResponseLast = NULL;
+				}
+				__remove(&(ptThis->m_ptPendingIn), ptTransfer);
+
+				if( ptResponse->sizData>ptTransfer->sizBuffer )
+				{
+					memcpy(ptTransfer->pucBuffer, ptResponse->aucData, ptTransfer->sizBuffer);
+					ptTransfer->sizTransfered = ptTransfer->sizBuffer;
+					ptThis->__complete(ptTransfer, PAPA_SCHLUMPF_TRANSFER_STATUS_Error);
+				}
+				else
+				{
+					memcpy(ptTransfer->pucBuffer, ptResponse->aucData, ptResponse->sizData);
+					ptTransfer->sizTransfered = ptResponse->sizData;
+					ptThis->__complete(ptTransfer, PAPA_SCHLUMPF_TRANSFER_STATUS_Completed);
+				}
+				free(ptResponse);
+				continue;
+			}
+
+			if( ptSimulatorTransfer->iHasDeadline!=0 )
+			{
+				if( __is_before(&tNow, &(ptSimulatorTransfer->tDeadline))==0 )
+				{
+					/* The response stays in the queue for the next receive. */
+					__remove(&(ptThis->m_ptPendingIn), ptTransfer);
+					ptThis->__complete(ptTransfer, PAPA_SCHLUMPF_TRANSFER_STATUS_TimedOut);
+					continue;
+				}
+				if( __is_before(&(ptSimulatorTransfer->tDeadline), &tWake)!=0 )
+				{
+					tWake = ptSimulatorTransfer->tDeadline;
+				}
+			}
+			if( ptResponse!=NULL && __is_before(&(ptResponse->tReady), &tWake)!=0 )
+			{
+				tWake = ptResponse->tReady;
+			}
+		}
+
+		pthread_cond_timedwait(&(ptThis->m_tCondition), &(ptThis->m_tMutex), &tWake);
+	}
+	pthread_mutex_unlock(&(ptThis->m_tMutex));
+
+	return NULL;
+}
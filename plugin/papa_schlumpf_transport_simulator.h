@@ -0,0 +1,106 @@
+#include "papa_schlumpf_transport.h"
+
+#include <pthread.h>
+#include <time.h>
+
+
+#ifndef __PAPA_SCHLUMPF_TRANSPORT_SIMULATOR_H__
+#define __PAPA_SCHLUMPF_TRANSPORT_SIMULATOR_H__
+
+
+/* The transport for the firmware simulator.
+ * A command runs in the simulated firmware as soon as it is sent. Its
+ * response is ready after the latency and the time for the command and
+ * response bytes at the link speed. The link moves one packet at a time, but
+ * the latencies of several commands overlap like on a real USB link.
+ * An event thread completes the asynchronous transfers.
+ */
+class PapaSchlumpfTransportSimulator : public PapaSchlumpfTransport
+{
+public:
+	PapaSchlumpfTransportSimulator(void);
+	~PapaSchlumpfTransportSimulator(void);
+
+	/* A link speed of 0 is infinitely fast. */
+	void setTiming(unsigned int uiLatencyUs, unsigned int uiBytesPerMs);
+
+	int send(const unsigned char *pucData, int sizData, unsigned int uiTimeoutMs);
+	int receive(unsigned char *pucData, int sizDataMax, int *psizData, unsigned int uiTimeoutMs);
+
+	int startEvents(void);
+	void stopEvents(void);
+
+	PAPA_SCHLUMPF_TRANSFER_T *allocTransfer(void);
+	void freeTransfer(PAPA_SCHLUMPF_TRANSFER_T *ptTransfer);
+	int submit(PAPA_SCHLUMPF_TRANSFER_T *ptTransfer);
+	int cancel(PAPA_SCHLUMPF_TRANSFER_T *ptTransfer);
+
+	const char *getName(void);
+
+private:
+	/* One response of the firmware which was not received yet. */
+	typedef struct RESPONSE_STRUCT
+	{
+		struct RESPONSE_STRUCT *ptNext;
+		struct timespec tReady;
+		int sizData;
+		unsigned char aucData[1];
+	} RESPONSE_T;
+
+	/* The part of an asynchronous transfer which belongs to this transport. */
+	typedef struct SIMULATOR_TRANSFER_STRUCT
+	{
+		PAPA_SCHLUMPF_TRANSFER_T *ptNext;
+		int iHasDeadline;
+		struct timespec tDeadline;
+	} SIMULATOR_TRANSFER_T;
+
+	/* allocTransfer gets both parts in one block. */
+	typedef struct TRANSFER_BLOCK_STRUCT
+	{
+		PAPA_SCHLUMPF_TRANSFER_T tTransfer;
+		SIMULATOR_TRANSFER_T tSimulator;
+	} TRANSFER_BLOCK_T;
+
+	/* This is the user data for __receive_packet. */
+	typedef struct EXECUTE_CONTEXT_STRUCT
+	{
+		PapaSchlumpfTransportSimulator *ptThis;
+		int sizCommand;
+	} EXECUTE_CONTEXT_T;
+
+	static void __add_us(struct timespec *ptTime, unsigned long long ullUs);
+	static int __is_before(const struct timespec *ptA, const struct timespec *ptB);
+	static void __append(PAPA_SCHLUMPF_TRANSFER_T **pptHead, PAPA_SCHLUMPF_TRANSFER_T *ptTransfer);
+	static int __remove(PAPA_SCHLUMPF_TRANSFER_T **pptHead, PAPA_SCHLUMPF_TRANSFER_T *ptTransfer);
+	static void __receive_packet(void *pvUser, const unsigned char *pucPacket, size_t sizPacket);
+	static void *__event_thread(void *pvUser);
+
+	int __execute(const unsigned char *pucData, int sizData);
+	void __complete(PAPA_SCHLUMPF_TRANSFER_T *ptTransfer, PAPA_SCHLUMPF_TRANSFER_STATUS_T tStatus);
+
+	/* The mutex and the condition protect all members below. */
+	pthread_mutex_t m_tMutex;
+	pthread_cond_t m_tCondition;
+
+	unsigned int m_uiLatencyUs;
+	unsigned int m_uiBytesPerMs;
+
+	/* The time when the link is free again. */
+	struct timespec m_tLinkFree;
+
+	/* The responses in the order of the commands. */
+	RESPONSE_T *m_ptResponseFirst;
+	RESPONSE_T *m_ptResponseLast;
+
+	/* The submitted receive transfers and the finished transfers which wait for their callback. */
+	PAPA_SCHLUMPF_TRANSFER_T *m_ptPendingIn;
+	PAPA_SCHLUMPF_TRANSFER_T *m_ptFinished;
+
+	pthread_t m_tEventThread;
+	int m_iEventThreadRunning;
+	int m_iEventThreadStop;
+};
+
+
+#endif  /* __PAPA_SCHLUMPF_TRANSPORT_SIMULATOR_H__ */
@@ -0,0 +1,32 @@
+#include "papa_schlumpf_crc32.h"
+
+
+/* The firmware and the plugin both use this code. A table with 16 entries
+ * processes one nibble per step. It is small enough for the firmware RAM.
+ */
+static const uint32_t aulCrc32Nibble[16] =
+{
+	0x00000000U, 0x1db71064U, 0x3b6e20c8U, 0x26d930acU,
+	0x76dc4190U, 0x6b6b51f4U, 0x4db26158U, 0x5005713cU,
+	0xedb88320U, 0xf00f9344U, 0xd6d6a3e8U, 0xcb61b38cU,
+	0x9b64c2b0U, 0x86d3d2d4U, 0xa00ae278U, 0xbdbdf21cU
+};
+
+
+
+uint32_t papa_schlumpf_crc32(uint32_t ulCrc, const unsigned char *pucData, size_t sizData)
+{
+	const unsigned char *pucEnd;
+
+
+	ulCrc = ~ulCrc;
+	pucEnd = pucData + sizData;
+	while( pucData<pucEnd )
+	{
+		ulCrc ^= *(pucData++);
+		ulCrc = (ulCrc >> 4U) ^ aulCrc32Nibble[ulCrc & 0x0fU];
+		ulCrc = (ulCrc >> 4U) ^ aulCrc32Nibble[ulCrc & 0x0fU];
+	}
+
+	return ~ulCrc;
+}
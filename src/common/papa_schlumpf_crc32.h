@@ -0,0 +1,23 @@
+#ifndef __PAPA_SCHLUMPF_CRC32_H__
+#define __PAPA_SCHLUMPF_CRC32_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The CRC32 of the MemChecksum command. This is the CRC32 of zlib and
+ * Ethernet. Start with 0 and pass the result of the previous call to add
+ * more data.
+ */
+uint32_t papa_schlumpf_crc32(uint32_t ulCrc, const unsigned char *pucData, size_t sizData);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif  /* __PAPA_SCHLUMPF_CRC32_H__ */
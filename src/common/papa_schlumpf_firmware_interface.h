@@ -11,6 +11,9 @@
 // DEBUG: To test chunking.
 //#define PAPA_SCHLUMPF_MAXIMUM_PACKET_SIZE         128
 
+/* This is the FIFO of the IN endpoint. A response which is sent in one piece must fit into it. */
+#define PAPA_SCHLUMPF_USB_IN_FIFO_SIZE            0x0f00
+
 /* Commands received over USB. */
 typedef enum PAPA_SCHLUMPF_USB_COMMAND_ENUM
 {
@@ -27,7 +30,23 @@ typedef enum PAPA_SCHLUMPF_USB_COMMAND_ENUM
 	PAPA_SCHLUMPF_USB_COMMAND_DMAMemReadArea = 10,
 	PAPA_SCHLUMPF_USB_COMMAND_DMAMemWriteArea = 11,
 	PAPA_SCHLUMPF_USB_COMMAND_SetPCIReset = 12,
-	PAPA_SCHLUMPF_USB_COMMAND_SetupNetx = 13
+	PAPA_SCHLUMPF_USB_COMMAND_SetupNetx = 13,
+	PAPA_SCHLUMPF_USB_COMMAND_Batch = 14,
+	PAPA_SCHLUMPF_USB_COMMAND_DmaListUpload = 15,
+	PAPA_SCHLUMPF_USB_COMMAND_DmaListRun = 16,
+	PAPA_SCHLUMPF_USB_COMMAND_DMAMemModify = 17,
+	PAPA_SCHLUMPF_USB_COMMAND_DMAIoModify = 18,
+	PAPA_SCHLUMPF_USB_COMMAND_PollMem = 19,
+	PAPA_SCHLUMPF_USB_COMMAND_MemChecksum = 20,
+	PAPA_SCHLUMPF_USB_COMMAND_MemFill = 21,
+	PAPA_SCHLUMPF_USB_COMMAND_MemCopy = 22,
+	PAPA_SCHLUMPF_USB_COMMAND_MemReadScatter = 23,
+	PAPA_SCHLUMPF_USB_COMMAND_MemWriteScatter = 24,
+	PAPA_SCHLUMPF_USB_COMMAND_DMACfg0ReadArea = 25,
+	PAPA_SCHLUMPF_USB_COMMAND_DMACfg1ReadArea = 26,
+	PAPA_SCHLUMPF_USB_COMMAND_EnumerateBus = 27,
+	PAPA_SCHLUMPF_USB_COMMAND_MemReadStream = 28,
+	PAPA_SCHLUMPF_USB_COMMAND_MemReadStreamAbort = 29
 } PAPA_SCHLUMPF_USB_COMMANDS_T;
 
 
@@ -40,7 +59,8 @@ typedef enum PAPA_SCHLUMPF_USB_COMMAND_STATUS_ENUM
 	USB_COMMAND_STATUS_Timeout             = 2,
 	USB_COMMAND_STATUS_PciInitFailed       = 3,
 	USB_COMMAND_STATUS_PciTransferFailed   = 4,
-	USB_COMMAND_STATUS_InvalidSize         = 5
+	USB_COMMAND_STATUS_InvalidSize         = 5,
+	USB_COMMAND_STATUS_UnknownProgram      = 6
 } PAPA_SCHLUMPF_USB_COMMAND_STATUS_T;
 
 
@@ -149,6 +169,20 @@ typedef struct PAPA_SCHLUMPF_USB_COMMAND_DMA_CFG1_WRITE_STRUCT
 
 
 
+/* Read a DWORD, replace the bits in the mask with the bits of the data and
+ * write it back: new = (old & ~mask) | (data & mask). The response has the
+ * old value.
+ */
+typedef struct PAPA_SCHLUMPF_USB_COMMAND_DMA_MODIFY_STRUCT
+{
+	uint32_t ulCommand;
+	uint32_t ulDeviceAddress;
+	uint32_t ulMask;
+	uint32_t ulData;
+} PAPA_SCHLUMPF_USB_COMMAND_DMA_MODIFY_T;
+
+
+
 typedef struct PAPA_SCHLUMPF_USB_COMMAND_RESULT_STATUS_STRUCT
 {
 	uint32_t ulStatus;
@@ -207,6 +241,14 @@ typedef struct PAPA_SCHLUMPF_USB_COMMAND_RESULT_DMA_CFG1_READ_STRUCT
 
 
 
+typedef struct PAPA_SCHLUMPF_USB_COMMAND_RESULT_DMA_MODIFY_STRUCT
+{
+	uint32_t ulStatus;
+	uint32_t ulData;
+} PAPA_SCHLUMPF_USB_COMMAND_RESULT_DMA_MODIFY_T;
+
+
+
 typedef struct PAPA_SCHLUMPF_USB_COMMAND_SET_PCI_RESET_STRUCT
 {
 	uint32_t ulCommand;
@@ -214,4 +256,412 @@ typedef struct PAPA_SCHLUMPF_USB_COMMAND_SET_PCI_RESET_STRUCT
 } PAPA_SCHLUMPF_USB_COMMAND_SET_PCI_RESET_T;
 
 
+
+/* The operations in a batch command. */
+typedef enum PAPA_SCHLUMPF_BATCH_OPERATION_ENUM
+{
+	PAPA_SCHLUMPF_BATCH_OPERATION_IoRead = 0,
+	PAPA_SCHLUMPF_BATCH_OPERATION_MemRead = 1,
+	PAPA_SCHLUMPF_BATCH_OPERATION_Cfg0Read = 2,
+	PAPA_SCHLUMPF_BATCH_OPERATION_Cfg1Read = 3,
+	PAPA_SCHLUMPF_BATCH_OPERATION_IoWrite = 4,
+	PAPA_SCHLUMPF_BATCH_OPERATION_MemWrite = 5,
+	PAPA_SCHLUMPF_BATCH_OPERATION_Cfg0Write = 6,
+	PAPA_SCHLUMPF_BATCH_OPERATION_Cfg1Write = 7
+} PAPA_SCHLUMPF_BATCH_OPERATION_T;
+
+
+
+/* One sub-command of a batch. The data field is ignored for read operations. */
+typedef struct PAPA_SCHLUMPF_BATCH_ENTRY_STRUCT
+{
+	uint32_t ulOperation;
+	uint32_t ulDeviceAddress;
+	uint32_t ulData;
+} PAPA_SCHLUMPF_BATCH_ENTRY_T;
+
+/* The result of one sub-command. The data field is only valid for read operations. */
+typedef struct PAPA_SCHLUMPF_BATCH_RESULT_STRUCT
+{
+	uint32_t ulStatus;
+	uint32_t ulData;
+} PAPA_SCHLUMPF_BATCH_RESULT_T;
+
+#define PAPA_SCHLUMPF_BATCH_MAXIMUM_ENTRIES ((PAPA_SCHLUMPF_MAXIMUM_PACKET_SIZE-sizeof(uint32_t)-sizeof(uint32_t))/sizeof(PAPA_SCHLUMPF_BATCH_ENTRY_T))
+
+
+
+/* The firmware runs all entries in order. It stops at the first failed
+ * entry. The result has one element for each processed entry.
+ */
+typedef struct PAPA_SCHLUMPF_USB_COMMAND_BATCH_STRUCT
+{
+	uint32_t ulCommand;
+	uint32_t ulEntries;
+	PAPA_SCHLUMPF_BATCH_ENTRY_T atEntries[PAPA_SCHLUMPF_BATCH_MAXIMUM_ENTRIES];
+} PAPA_SCHLUMPF_USB_COMMAND_BATCH_T;
+
+
+
+typedef struct PAPA_SCHLUMPF_USB_COMMAND_RESULT_BATCH_STRUCT
+{
+	uint32_t ulStatus;
+	uint32_t ulEntries;
+	PAPA_SCHLUMPF_BATCH_RESULT_T atResults[PAPA_SCHLUMPF_BATCH_MAXIMUM_ENTRIES];
+} PAPA_SCHLUMPF_USB_COMMAND_RESULT_BATCH_T;
+
+
+
+/* The firmware keeps a few DMA list programs in its RAM. */
+#define PAPA_SCHLUMPF_DMALIST_MAXIMUM_PROGRAMS 4
+#define PAPA_SCHLUMPF_DMALIST_MAXIMUM_ENTRIES 128
+
+/* One entry of a DMA list program. The action and type fields use the
+ * values of DMAACTION_T and DMATYPE_T from the firmware.
+ */
+typedef struct PAPA_SCHLUMPF_DMALIST_ENTRY_STRUCT
+{
+	uint32_t ulAction;
+	uint32_t ulType;
+	uint32_t ulAddress;
+	uint32_t ulData;
+} PAPA_SCHLUMPF_DMALIST_ENTRY_T;
+
+/* The reason why a DMA list program stopped. These are the values of DMALIST_FAILURE_T. */
+typedef enum PAPA_SCHLUMPF_DMALIST_FAILURE_ENUM
+{
+	PAPA_SCHLUMPF_DMALIST_FAILURE_None = 0,
+	PAPA_SCHLUMPF_DMALIST_FAILURE_Compare = 1,
+	PAPA_SCHLUMPF_DMALIST_FAILURE_Transfer = 2,
+	PAPA_SCHLUMPF_DMALIST_FAILURE_InvalidEntry = 3
+} PAPA_SCHLUMPF_DMALIST_FAILURE_T;
+
+
+
+/* Store a DMA list program in the firmware.
+ * The firmware returns the ID of the program and a hash of its contents.
+ * Uploading an existing program returns the ID of the existing copy. If all
+ * program slots are used, the oldest upload is replaced.
+ */
+typedef struct PAPA_SCHLUMPF_USB_COMMAND_DMALIST_UPLOAD_STRUCT
+{
+	uint32_t ulCommand;
+	uint32_t ulEntries;
+	PAPA_SCHLUMPF_DMALIST_ENTRY_T atEntries[PAPA_SCHLUMPF_DMALIST_MAXIMUM_ENTRIES];
+} PAPA_SCHLUMPF_USB_COMMAND_DMALIST_UPLOAD_T;
+
+
+
+typedef struct PAPA_SCHLUMPF_USB_COMMAND_RESULT_DMALIST_UPLOAD_STRUCT
+{
+	uint32_t ulStatus;
+	uint32_t ulProgramId;
+	uint32_t ulProgramHash;
+} PAPA_SCHLUMPF_USB_COMMAND_RESULT_DMALIST_UPLOAD_T;
+
+
+
+/* Run a stored DMA list program.
+ * The hash must match the hash returned by the upload. Otherwise the
+ * firmware responds with USB_COMMAND_STATUS_UnknownProgram.
+ */
+typedef struct PAPA_SCHLUMPF_USB_COMMAND_DMALIST_RUN_STRUCT
+{
+	uint32_t ulCommand;
+	uint32_t ulProgramId;
+	uint32_t ulProgramHash;
+} PAPA_SCHLUMPF_USB_COMMAND_DMALIST_RUN_T;
+
+
+
+/* The status is OK if the program was found. The result of the program is
+ * in ulFailure. ulFailedIndex is the index of the failed entry or the
+ * number of entries if the program passed. ulFailedValue is the received
+ * value of a failed compare. The response contains ulDumpCount elements of
+ * aulDump.
+ */
+typedef struct PAPA_SCHLUMPF_USB_COMMAND_RESULT_DMALIST_RUN_STRUCT
+{
+	uint32_t ulStatus;
+	uint32_t ulFailure;
+	uint32_t ulFailedIndex;
+	uint32_t ulFailedValue;
+	uint32_t ulDumpCount;
+	uint32_t aulDump[PAPA_SCHLUMPF_DMALIST_MAXIMUM_ENTRIES];
+} PAPA_SCHLUMPF_USB_COMMAND_RESULT_DMALIST_RUN_T;
+
+
+
+/* The firmware does not answer any other command while it polls. */
+#define PAPA_SCHLUMPF_POLL_MAXIMUM_TIMEOUT_US 10000000
+
+/* Read an address until (value & mask) == expected or the timeout expires.
+ * The type uses the values of DMATYPE_T from the firmware. The address is
+ * read at least once, even with a timeout of 0.
+ */
+typedef struct PAPA_SCHLUMPF_USB_COMMAND_POLL_MEM_STRUCT
+{
+	uint32_t ulCommand;
+	uint32_t ulType;
+	uint32_t ulDeviceAddress;
+	uint32_t ulMask;
+	uint32_t ulExpected;
+	uint32_t ulTimeoutUs;
+} PAPA_SCHLUMPF_USB_COMMAND_POLL_MEM_T;
+
+
+
+/* The status is OK if all reads succeeded. ulMatched is 1 if the value
+ * matched and 0 if the timeout expired. ulData is the last value.
+ */
+typedef struct PAPA_SCHLUMPF_USB_COMMAND_RESULT_POLL_MEM_STRUCT
+{
+	uint32_t ulStatus;
+	uint32_t ulMatched;
+	uint32_t ulData;
+	uint32_t ulIterations;
+	uint32_t ulElapsedUs;
+} PAPA_SCHLUMPF_USB_COMMAND_RESULT_POLL_MEM_T;
+
+
+
+/* The slowest expected speed of the MemChecksum command. The host uses it
+ * for the timeout.
+ */
+#define PAPA_SCHLUMPF_CHECKSUM_MINIMUM_BYTES_PER_MS 1024
+
+/* Build the CRC32 of a memory area in the firmware.
+ * The size must be a multiple of 4, but it is not limited by the DMA
+ * buffer. The CRC32 is the one of papa_schlumpf_crc32.h over the bytes in
+ * the order of DMAMemReadArea.
+ */
+typedef struct PAPA_SCHLUMPF_USB_COMMAND_MEM_CHECKSUM_STRUCT
+{
+	uint32_t ulCommand;
+	uint32_t ulDeviceAddress;
+	uint32_t ulSize;
+} PAPA_SCHLUMPF_USB_COMMAND_MEM_CHECKSUM_T;
+
+
+
+typedef struct PAPA_SCHLUMPF_USB_COMMAND_RESULT_MEM_CHECKSUM_STRUCT
+{
+	uint32_t ulStatus;
+	uint32_t ulChecksum;
+} PAPA_SCHLUMPF_USB_COMMAND_RESULT_MEM_CHECKSUM_T;
+
+
+
+#define PAPA_SCHLUMPF_FILL_MAXIMUM_PATTERN_DWORDS 16
+
+/* The slowest expected speed of the MemFill command. The host uses it for
+ * the timeout.
+ */
+#define PAPA_SCHLUMPF_FILL_MINIMUM_BYTES_PER_MS 4096
+
+/* Repeat a pattern of 1 to PAPA_SCHLUMPF_FILL_MAXIMUM_PATTERN_DWORDS DWORDs
+ * over a memory area. The size must be a multiple of 4, but it is not
+ * limited by the DMA buffer. The last repetition of the pattern is cut at
+ * the end of the area. The host sends only the used part of aulPattern.
+ */
+typedef struct PAPA_SCHLUMPF_USB_COMMAND_MEM_FILL_STRUCT
+{
+	uint32_t ulCommand;
+	uint32_t ulDeviceAddress;
+	uint32_t ulSize;
+	uint32_t ulPatternDwords;
+	uint32_t aulPattern[PAPA_SCHLUMPF_FILL_MAXIMUM_PATTERN_DWORDS];
+} PAPA_SCHLUMPF_USB_COMMAND_MEM_FILL_T;
+
+
+
+/* The slowest expected speed of the MemCopy command. The host uses it for
+ * the timeout.
+ */
+#define PAPA_SCHLUMPF_COPY_MINIMUM_BYTES_PER_MS 1024
+
+/* Copy an area in the PCI memory space through the DMA buffer. The size
+ * must be a multiple of 4, but it is not limited by the DMA buffer.
+ * Overlapping areas are copied like memmove.
+ */
+typedef struct PAPA_SCHLUMPF_USB_COMMAND_MEM_COPY_STRUCT
+{
+	uint32_t ulCommand;
+	uint32_t ulDestinationAddress;
+	uint32_t ulSourceAddress;
+	uint32_t ulSize;
+} PAPA_SCHLUMPF_USB_COMMAND_MEM_COPY_T;
+
+
+
+/* One area of a scatter command. */
+typedef struct PAPA_SCHLUMPF_SCATTER_DESCRIPTOR_STRUCT
+{
+	uint32_t ulDeviceAddress;
+	uint32_t ulDwords;
+} PAPA_SCHLUMPF_SCATTER_DESCRIPTOR_T;
+
+#define PAPA_SCHLUMPF_SCATTER_MAXIMUM_DESCRIPTORS 64
+#define PAPA_SCHLUMPF_SCATTER_COMMAND_DWORDS ((PAPA_SCHLUMPF_MAXIMUM_PACKET_SIZE-sizeof(uint32_t)-sizeof(uint32_t))/sizeof(uint32_t))
+/* The response of MemReadScatter is sent in one piece. */
+#define PAPA_SCHLUMPF_SCATTER_READ_MAXIMUM_DWORDS ((PAPA_SCHLUMPF_USB_IN_FIFO_SIZE-sizeof(uint32_t))/sizeof(uint32_t))
+
+/* Read or write several memory areas with one command. aulData starts with
+ * ulDescriptors elements of PAPA_SCHLUMPF_SCATTER_DESCRIPTOR_T. For
+ * MemWriteScatter the data of all areas follows the descriptors. The
+ * descriptors and the data must fit into PAPA_SCHLUMPF_SCATTER_COMMAND_DWORDS.
+ * The firmware processes the areas in order. It stops at the first failed
+ * transfer.
+ */
+typedef struct PAPA_SCHLUMPF_USB_COMMAND_SCATTER_STRUCT
+{
+	uint32_t ulCommand;
+	uint32_t ulDescriptors;
+	uint32_t aulData[PAPA_SCHLUMPF_SCATTER_COMMAND_DWORDS];
+} PAPA_SCHLUMPF_USB_COMMAND_SCATTER_T;
+
+
+
+/* The data of all areas without gaps. The size of all areas must not
+ * exceed PAPA_SCHLUMPF_SCATTER_READ_MAXIMUM_DWORDS. The response has only
+ * the status if the command failed.
+ */
+typedef struct PAPA_SCHLUMPF_USB_COMMAND_RESULT_MEM_READ_SCATTER_STRUCT
+{
+	uint32_t ulStatus;
+	uint32_t aulData[PAPA_SCHLUMPF_SCATTER_READ_MAXIMUM_DWORDS];
+} PAPA_SCHLUMPF_USB_COMMAND_RESULT_MEM_READ_SCATTER_T;
+
+
+
+/* The configuration header of a function has 256 bytes. */
+#define PAPA_SCHLUMPF_CFG_AREA_MAXIMUM_DWORDS 64
+
+/* Read a range of configuration registers with one DMA. The register
+ * offset in the address plus the size must not exceed the 256 bytes of the
+ * header. The size must be a multiple of 4.
+ */
+typedef struct PAPA_SCHLUMPF_USB_COMMAND_DMA_CFG_READ_AREA_STRUCT
+{
+	uint32_t ulCommand;
+	uint32_t ulDeviceAddress;
+	uint32_t ulSize;
+} PAPA_SCHLUMPF_USB_COMMAND_DMA_CFG_READ_AREA_T;
+
+
+
+/* The response has only the status if the command failed. */
+typedef struct PAPA_SCHLUMPF_USB_COMMAND_RESULT_DMA_CFG_READ_AREA_STRUCT
+{
+	uint32_t ulStatus;
+	uint32_t aulData[PAPA_SCHLUMPF_CFG_AREA_MAXIMUM_DWORDS];
+} PAPA_SCHLUMPF_USB_COMMAND_RESULT_DMA_CFG_READ_AREA_T;
+
+
+
+#define PAPA_SCHLUMPF_ENUMERATE_MAXIMUM_FUNCTIONS 64
+#define PAPA_SCHLUMPF_ENUMERATE_BARS 6
+
+/* The host waits this long for the scan of all buses. */
+#define PAPA_SCHLUMPF_ENUMERATE_TIMEOUT_MS 5000
+
+/* Size the BARs of all functions. The firmware disables the decoders of a
+ * function while it writes all ones to the BARs. It restores the BARs and
+ * the command register afterwards.
+ */
+#define PAPA_SCHLUMPF_ENUMERATE_FLAG_SizeBars 0x00000001U
+
+/* Scan the IDSEL lines of the local bus with type 0 accesses. Continue
+ * behind each bridge with type 1 accesses. The bus numbers of the bridges
+ * must be set already, the firmware does not change them.
+ */
+typedef struct PAPA_SCHLUMPF_USB_COMMAND_ENUMERATE_BUS_STRUCT
+{
+	uint32_t ulCommand;
+	uint32_t ulFlags;
+} PAPA_SCHLUMPF_USB_COMMAND_ENUMERATE_BUS_T;
+
+
+
+/* One function which was found. On the local bus the bus is 0 and the
+ * device is the IDSEL line, i.e. bit 16+ucDevice of the address.
+ * ulAddress is the configuration address of register 0 for the access type
+ * of the bus. ulBusNumbers is register 0x18 of a bridge and 0 for all other
+ * header types. aulBarMask has the BAR values read back after writing all
+ * ones. It is 0 if the BARs were not sized or the header has less BARs.
+ */
+typedef struct PAPA_SCHLUMPF_ENUMERATE_FUNCTION_STRUCT
+{
+	uint32_t ulAddress;
+	uint8_t ucBus;
+	uint8_t ucDevice;
+	uint8_t ucFunction;
+	uint8_t ucHeaderType;
+	uint32_t ulVidPid;
+	uint32_t ulClassRev;
+	uint32_t ulBusNumbers;
+	uint32_t aulBarMask[PAPA_SCHLUMPF_ENUMERATE_BARS];
+} PAPA_SCHLUMPF_ENUMERATE_FUNCTION_T;
+
+
+
+/* The response contains ulFunctions elements of atFunctions. ulTruncated
+ * is 1 if more functions were found than fit into the response.
+ */
+typedef struct PAPA_SCHLUMPF_USB_COMMAND_RESULT_ENUMERATE_BUS_STRUCT
+{
+	uint32_t ulStatus;
+	uint32_t ulTruncated;
+	uint32_t ulFunctions;
+	PAPA_SCHLUMPF_ENUMERATE_FUNCTION_T atFunctions[PAPA_SCHLUMPF_ENUMERATE_MAXIMUM_FUNCTIONS];
+} PAPA_SCHLUMPF_USB_COMMAND_RESULT_ENUMERATE_BUS_T;
+
+
+
+/* A stream sends the data in transfers of this size. A transfer with the
+ * header fits into the FIFO of the endpoint and is not a multiple of 64
+ * bytes, so it needs no zero packet.
+ */
+#define PAPA_SCHLUMPF_STREAM_CHUNK_SIZE 0x0ef0
+
+/* The answer to MemReadStreamAbort has this sequence number. */
+#define PAPA_SCHLUMPF_STREAM_SEQUENCE_ABORTED 0xffffffffU
+
+/* Read an area with one command. The firmware answers with one transfer for
+ * each PAPA_SCHLUMPF_STREAM_CHUNK_SIZE bytes of the area without further
+ * requests. It handles other commands between the transfers. Any command
+ * ends a running stream.
+ */
+typedef struct PAPA_SCHLUMPF_USB_COMMAND_MEM_READ_STREAM_STRUCT
+{
+	uint32_t ulCommand;
+	uint32_t ulDeviceAddress;
+	uint32_t ulSize;
+} PAPA_SCHLUMPF_USB_COMMAND_MEM_READ_STREAM_T;
+
+
+
+/* One transfer of a stream. The sequence numbers count from 0. A transfer
+ * with an error has only the status and the sequence number. It is the last
+ * one of the stream.
+ */
+typedef struct PAPA_SCHLUMPF_USB_COMMAND_RESULT_MEM_READ_STREAM_STRUCT
+{
+	uint32_t ulStatus;
+	uint32_t ulSequence;
+	uint8_t aucData[PAPA_SCHLUMPF_STREAM_CHUNK_SIZE];
+} PAPA_SCHLUMPF_USB_COMMAND_RESULT_MEM_READ_STREAM_T;
+
+
+
+/* Stop a running stream. The answer is a stream transfer with only the
+ * status and PAPA_SCHLUMPF_STREAM_SEQUENCE_ABORTED. It follows the last
+ * transfer of the stream, so the host can drop everything up to it.
+ */
+typedef struct PAPA_SCHLUMPF_USB_COMMAND_MEM_READ_STREAM_ABORT_STRUCT
+{
+	uint32_t ulCommand;
+} PAPA_SCHLUMPF_USB_COMMAND_MEM_READ_STREAM_ABORT_T;
+
+
 #endif  /* __PAPA_SCHLUMPF_FIRMWARE_INTERFACE_H__ */
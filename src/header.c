@@ -28,6 +28,7 @@ const VERSION_HEADER_T tVersionHeader =
 	.ulVersionMajor = VERSION_MAJOR,
 	.ulVersionMinor = VERSION_MINOR,
 	.ulVersionMicro = VERSION_MICRO,
-	.acVersionVcs = VERSION_VCS
+	.acVersionVcs = VERSION_VCS,
+	.acSerialNumber = { '0', '0', '0', '0', '0', '0', '0', '0', '0', '0', '0', '0', '0', '0', '0', '0' }
 };
 
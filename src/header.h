@@ -29,6 +29,10 @@ typedef struct VERSION_HEADER_STRUCT
 	unsigned long ulVersionMinor;
 	unsigned long ulVersionMicro;
 	const char    acVersionVcs[16];
+	/* The serial number of the board. It is reported in the USB descriptors.
+	 * Production tools patch it in the image for each board.
+	 */
+	const char    acSerialNumber[16];
 } VERSION_HEADER_T;
 
 extern const VERSION_HEADER_T tVersionHeader __attribute__ ((section (".header")));
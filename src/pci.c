@@ -14,14 +14,14 @@
 
 
 /* Startaddress of DMA buffer */
-extern volatile unsigned long g_ul_PCI_DMA_Buffer_Start[];
+extern volatile uint32_t g_ul_PCI_DMA_Buffer_Start[];
 /* Endaddress of DMA buffer */
-extern volatile unsigned long g_ul_PCI_DMA_Buffer_End[];
+extern volatile uint32_t g_ul_PCI_DMA_Buffer_End[];
 
 /* Pointer to start address of DMA buffer */
-volatile unsigned long *g_pul_PCI_DMA_Buffer_Start;
+volatile uint32_t *g_pul_PCI_DMA_Buffer_Start;
 /* Pointer to end address of DMA buffer */
-volatile unsigned long *g_pul_PCI_DMA_Buffer_End;
+volatile uint32_t *g_pul_PCI_DMA_Buffer_End;
 
 //-------------------------------------
 
@@ -54,6 +54,27 @@ void delay100US(unsigned int uDelay100Us)
 	ptHostControlledGlobalRegisterBlockArea->aulIrq_status__host[0] = 1<<25;
 }
 
+/**
+ * Get a free running time in microseconds.
+ * The time wraps around after about 71 minutes. Use the difference of 2
+ * values to measure a time.
+ *
+ */
+
+uint32_t pciGetTimeUs(void)
+{
+	HOSTDEF(ptSystimeArea);
+	uint32_t ulSeconds;
+	uint32_t ulNanoseconds;
+
+
+	/* Reading the seconds latches the nanoseconds. */
+	ulSeconds = ptSystimeArea->ulSystime_s;
+	ulNanoseconds = ptSystimeArea->ulSystime_ns;
+
+	return (ulSeconds * 1000000U) + (ulNanoseconds / 1000U);
+}
+
 //-------------------------------------
 
 void pciInitGlobals(void)
@@ -356,37 +377,6 @@ void pciSetMemoryWindow0(unsigned long ulStartAdr, unsigned long ulLength)
 
 //-------------------------------------
 
-/**
- * Swap bit 0 and bit 30.
- *
- * @param ulDeviceAdr	32 Bit where bits should getting swapped
- */
-
-unsigned long swapBit0_Bit30(unsigned long ulDeviceAdr)
-{
-	unsigned int val0  = (ulDeviceAdr & MSK_BIT0) >> SRT_BIT0; // check and shift Bit 0 on position 0
-	unsigned int val30 = (ulDeviceAdr & MSK_BIT30) >> SRT_BIT30; // check and shift Bit 30 on position 0
-
-	// Clear bit 0 and bit 30.
-	ulDeviceAdr &= ~(MSK_BIT0|MSK_BIT30);
-
-	// Combine the bits in other order.
-	ulDeviceAdr |= val0 << SRT_BIT30;
-	ulDeviceAdr |= val30 << SRT_BIT0;
-
-	return ulDeviceAdr;
-}
-
-void swapBi0_Bit30_array(volatile unsigned long *aulData, unsigned long ulCount)
-{
-	for(unsigned int i = 0; i < ulCount; i++)
-	{
-		aulData[i] = swapBit0_Bit30(aulData[i]);
-	}
-}
-
-//-------------------------------------
-
 /**
  * Set PCI start address.
  * Set netX start address.
@@ -397,7 +387,7 @@ void swapBi0_Bit30_array(volatile unsigned long *aulData, unsigned long ulCount)
  * @param uDmaCtrl             DMA control bits
  */
 
-int pciDma_Ch0(unsigned int uPciStartAdr, volatile unsigned long *pulNetxMemStartAdr, unsigned int uDmaCtrl)
+int pciDma_Ch0(unsigned int uPciStartAdr, volatile uint32_t *pulNetxMemStartAdr, unsigned int uDmaCtrl)
 {
 	HOSTDEF(ptNetxControlledDmaRegisterBlockArea);
 	unsigned long ulResult;
@@ -529,460 +519,3 @@ int pciWriteReq(unsigned int uWrCtrl, unsigned int uData)
 
 	return (uDelay!=0);
 }
-
-//-------------------------------------
-
-/** Read PCI configuration register over a DMA transfer.
- *
- * Do this using a configuration cycle.
- *
- * @param uDeviceAdr    Device address according to the PCI Device Scan
- * @param pulNetxAdr    Destination data pointer
- * @param uDwords       Data length
- *
- * @return iResult      0 if OK, !=0 on error
- */
-
-int pciDma_CfgRead(unsigned int uDeviceAdr, volatile unsigned long *pulNetxAdr, unsigned int uDwords)
-{
-	unsigned int uDmaCtrl;
-	int iResult;
-
-
-	/* Initiate DMA Buffer (START) */
-	uDmaCtrl = MSK_DPMAS_NETX_DMA_CTRL_START;
-	/* Transfer Type: Configuration Cycle (DMA_TYPE) */
-	uDmaCtrl |= VAL_DPMAS_NETX_DMA_CTRL_DMA_TYPE_Configuration_Cycle << SRT_DPMAS_NETX_DMA_CTRL_DMA_TYPE;
-
-	iResult = pciDma_Ch0(uDeviceAdr, pulNetxAdr, uDmaCtrl|(uDwords<<SRT_DPMAS_NETX_DMA_CTRL_TRANSFER_LENGTH));
-
-	/* Swap bits after reading. */
-	swapBi0_Bit30_array(pulNetxAdr, uDwords);
-
-	return iResult;
-}
-
-/** Write PCI configuration register over a DMA transfer.
- *
- * Do this using a configuration cycle in direction from netX to host.
- *
- * @param uDeviceAdr    Device address according to the PCI Device Scan
- * @param pulNetxAdr    Destination data pointer
- * @param uDwords       Data length
- *
- * @return iResult      0 if OK, !=0 on error
- */
-
-int pciDma_CfgWrite(unsigned int uDeviceAdr, volatile unsigned long *pulNetxAdr, unsigned int uDwords)
-{
-	unsigned int uDmaCtrl;
-	int iResult;
-
-
-	/* Initiate DMA Buffer (START) */
-	uDmaCtrl  = MSK_DPMAS_NETX_DMA_CTRL_START;
-	/* Transfer Type: Configuration Cycle (DMA_TYPE) */
-	uDmaCtrl |= VAL_DPMAS_NETX_DMA_CTRL_DMA_TYPE_Configuration_Cycle << SRT_DPMAS_NETX_DMA_CTRL_DMA_TYPE;
-	/* Transfer direction 1: netX to Host (DIRECTION) */
-	uDmaCtrl |= VAL_DPMAS_NETX_DMA_CTRL_DIRECTION_netx_to_host << SRT_DPMAS_NETX_DMA_CTRL_DIRECTION;
-
-	/* Swap before writing. */
-	swapBi0_Bit30_array(pulNetxAdr, uDwords);
-
-	iResult = pciDma_Ch0(uDeviceAdr, pulNetxAdr, uDmaCtrl|(uDwords << SRT_DPMAS_NETX_DMA_CTRL_TRANSFER_LENGTH));
-	return iResult;
-}
-
-/** Read PCI configuration register over a DMA transfer.
- *
- * Do this using a memory cycle.
- *
- * @param uDeviceAdr    Device address according to the PCI Device Scan
- * @param *pulNetxAdr   Destination data pointer
- * @param uDwords       Data length
- *
- * @return iResult      0 if OK, !=0 on error
- */
-
-int pciDma_MemRead(unsigned int uDeviceAdr, volatile unsigned long *pulNetxAdr, unsigned int uDwords)
-{
-	unsigned int uDmaCtrl;
-	int iResult;
-
-
-	/* Initiate DMA Buffer (START) */
-	uDmaCtrl  = MSK_DPMAS_NETX_DMA_CTRL_START;
-	/* Transfer Type: Memory Cycle (DMA_TYPE) */
-	uDmaCtrl |= VAL_DPMAS_NETX_DMA_CTRL_DMA_TYPE_Memory_Cycle << SRT_DPMAS_NETX_DMA_CTRL_DMA_TYPE;
-
-	iResult = pciDma_Ch0(uDeviceAdr, pulNetxAdr, uDmaCtrl|(uDwords<<SRT_DPMAS_NETX_DMA_CTRL_TRANSFER_LENGTH));
-
-	/* Swap bits after reading. */
-	swapBi0_Bit30_array(pulNetxAdr, uDwords);
-
-	return iResult;
-}
-
-/** Write PCI DMA memory.
- *
- * Do this using a memory cycle in direction from netX to host.
- *
- * @param uDeviceAdr    Device address according to the PCI Device Scan
- * @param *pulNetxAdr   Destination data pointer
- * @param uDwords       Data length
- *
- * @return iResult      0 if OK, !=0 on error
- */
-
-int pciDma_MemWrite(unsigned int uDeviceAdr, volatile unsigned long *pulNetxAdr, unsigned int uDwords)
-{
-	unsigned int uDmaCtrl;
-	int iResult;
-
-
-	/* Initiate DMA Buffer (START) */
-	uDmaCtrl = MSK_DPMAS_NETX_DMA_CTRL_START;
-	/* Transfer Type: Memory Cycle (DMA_TYPE) */
-	uDmaCtrl |= VAL_DPMAS_NETX_DMA_CTRL_DMA_TYPE_Memory_Cycle << SRT_DPMAS_NETX_DMA_CTRL_DMA_TYPE;
-	/* Transfer direction 1: netX to Host (DIRECTION) */
-	uDmaCtrl |= VAL_DPMAS_NETX_DMA_CTRL_DIRECTION_netx_to_host << SRT_DPMAS_NETX_DMA_CTRL_DIRECTION;
-
-	/* Swap bits before writing. */
-	swapBi0_Bit30_array(pulNetxAdr, uDwords);
-
-	iResult = pciDma_Ch0(uDeviceAdr, pulNetxAdr, uDmaCtrl|(uDwords<<SRT_DPMAS_NETX_DMA_CTRL_TRANSFER_LENGTH));
-
-	return iResult;
-}
-
-/** Initiate a Type 1 configuration read cycle.
- *
- * @param uDeviceAdr     Device address according to the PCI Device Scan
- * @param *pulNetxAdr    Destination data pointer
- * @param uDwords        Data length
- *
- * @return iResult       0 if OK, !=0 on error
- */
-int pciDma_CfgRead_Type1(unsigned int uDeviceAdr, volatile unsigned long *pulNetxAdr, unsigned int uDwords)
-{
-	unsigned int uDmaCtrl;
-	int iResult;
-
-
-	/* Initiate DMA Buffer (START) */
-	uDmaCtrl = MSK_DPMAS_NETX_DMA_CTRL_START;
-	/* Transfer Type: Configuration Cycle (DMA_TYPE) */
-	uDmaCtrl |= VAL_DPMAS_NETX_DMA_CTRL_DMA_TYPE_Configuration_Cycle << SRT_DPMAS_NETX_DMA_CTRL_DMA_TYPE;
-
-	/* Set the header type to 1. */
-	uDeviceAdr |= (1 << SRT_PCI_HEADER_TYPE);
-
-	iResult = pciDma_Ch0(uDeviceAdr, pulNetxAdr, uDmaCtrl|(uDwords<<SRT_DPMAS_NETX_DMA_CTRL_TRANSFER_LENGTH));
-
-	/* Swap data after reading. */
-	swapBi0_Bit30_array(pulNetxAdr, uDwords);
-
-	return iResult;
-}
-
-/** Initiate a Type 1 configuration write cycle.
- *
- * @param uDeviceAdr     Device address according to the PCI Device Scan
- * @param uDeviceOffs    Source data pointer
- * @param *pulNetxAdr    Destination data pointer
- * @param uDwords        Data length
- *
- * @return iResult       0 if OK, !=0 on error
- */
-int pciDma_CfgWrite_Type1(unsigned int uDeviceAdr, volatile unsigned long *pulNetxAdr, unsigned int uDwords)
-{
-	unsigned int uDmaCtrl;
-	int iResult;
-
-
-	/* Initiate DMA Buffer (START) */
-	uDmaCtrl  = MSK_DPMAS_NETX_DMA_CTRL_START;
-	/* Transfer Type: Configuration Cycle (DMA_TYPE) */
-	uDmaCtrl |= VAL_DPMAS_NETX_DMA_CTRL_DMA_TYPE_Configuration_Cycle << SRT_DPMAS_NETX_DMA_CTRL_DMA_TYPE;
-	/* Transfer direction 1: netX to Host (DIRECTION) */
-	uDmaCtrl |= VAL_DPMAS_NETX_DMA_CTRL_DIRECTION_netx_to_host << SRT_DPMAS_NETX_DMA_CTRL_DIRECTION;
-
-	/* Set the header type to 1. */
-	uDeviceAdr |= (1 << SRT_PCI_HEADER_TYPE);
-
-	/* Swap data before writing. */
-	swapBi0_Bit30_array(pulNetxAdr, uDwords);
-
-	iResult = pciDma_Ch0(uDeviceAdr, pulNetxAdr, uDmaCtrl|(uDwords << SRT_DPMAS_NETX_DMA_CTRL_TRANSFER_LENGTH));
-	return iResult;
-}
-
-
-//-------------------------------------
-
-
-int dmalist_process(const DMALIST_T *ptDmaList, unsigned int sizDmaList, const char *pcName)
-{
-	int iResult;
-	const DMALIST_T *ptCnt;
-	unsigned int uiCnt;
-	DMAACTION_T tAct;
-	unsigned long ulDmaCtrl;
-	unsigned long ulAddress;
-	unsigned long ulDataReceived;
-	unsigned long ulDataExpected;
-	unsigned long ulParity;
-
-
-	/* Be optimistic.
-	 * An empty list is OK.
-	 */
-	iResult = 0;
-
-	/* Loop over all entries in the DMA list. */
-	uiCnt = 0;
-	while( uiCnt<sizDmaList )
-	{
-		/* Get a pointer to the DMA list entry. */
-		ptCnt = ptDmaList + uiCnt;
-
-		ulDmaCtrl  = MSK_DPMAS_NETX_DMA_CTRL_START;
-		/* The number of DWORDS is always 1 in a DMA list. */
-		ulDmaCtrl |= 1U << SRT_DPMAS_NETX_DMA_CTRL_TRANSFER_LENGTH;
-
-		ulAddress  = ptCnt->ulAddress;
-
-		iResult = -1;
-		tAct = ptCnt->tAct;
-		switch( tAct )
-		{
-		case DMAACTION_Write:
-			/* Transfer direction: netX to host */
-			ulDmaCtrl |= VAL_DPMAS_NETX_DMA_CTRL_DIRECTION_netx_to_host << SRT_DPMAS_NETX_DMA_CTRL_DIRECTION;
-
-			/* Swap bit 0 and 30 of the data and write it to the DMA buffer. */
-			g_ul_PCI_DMA_Buffer_Start[0] = swapBit0_Bit30(ptCnt->ulData);
-
-			iResult = 0;
-			break;
-
-		case DMAACTION_Compare:
-			/* Transfer direction: host to netX */
-			ulDmaCtrl |= VAL_DPMAS_NETX_DMA_CTRL_DIRECTION_host_to_netx << SRT_DPMAS_NETX_DMA_CTRL_DIRECTION;
-
-			iResult = 0;
-			break;
-
-		case DMAACTION_Dump:
-			/* Transfer direction: host to netX */
-			ulDmaCtrl |= VAL_DPMAS_NETX_DMA_CTRL_DIRECTION_host_to_netx << SRT_DPMAS_NETX_DMA_CTRL_DIRECTION;
-
-			iResult = 0;
-			break;
-		}
-		if( iResult!=0 )
-		{
-			uprintf("[%s:%d] Invalid action: %d\n", pcName, uiCnt, tAct);
-		}
-		else
-		{
-			iResult = -1;
-			switch( ptCnt->tTyp )
-			{
-			case DMATYPE_IO:
-				/* Transfer type: I/O cycle */
-				ulDmaCtrl |= VAL_DPMAS_NETX_DMA_CTRL_DMA_TYPE_Input_Output_Cycle << SRT_DPMAS_NETX_DMA_CTRL_DMA_TYPE;
-
-				iResult = 0;
-				break;
-
-			case DMATYPE_Mem:
-				/* Transfer type: memory cycle */
-				ulDmaCtrl |= VAL_DPMAS_NETX_DMA_CTRL_DMA_TYPE_Memory_Cycle << SRT_DPMAS_NETX_DMA_CTRL_DMA_TYPE;
-
-				iResult = 0;
-				break;
-
-			case DMATYPE_Cfg0:
-				/* Transfer type: configuration cycle */
-				ulDmaCtrl |= VAL_DPMAS_NETX_DMA_CTRL_DMA_TYPE_Configuration_Cycle << SRT_DPMAS_NETX_DMA_CTRL_DMA_TYPE;
-
-				iResult = 0;
-				break;
-
-			case DMATYPE_Cfg1:
-				/* Transfer type: configuration cycle */
-				ulDmaCtrl |= VAL_DPMAS_NETX_DMA_CTRL_DMA_TYPE_Configuration_Cycle << SRT_DPMAS_NETX_DMA_CTRL_DMA_TYPE;
-
-				/* Set type 1 in the header. */
-				ulAddress |= 1U << SRT_PCI_HEADER_TYPE;
-
-				iResult = 0;
-				break;
-			}
-			if( iResult!=0 )
-			{
-				uprintf("[%s:%d] Invalid type: %d\n", pcName, uiCnt, ptCnt->tTyp);
-			}
-			else
-			{
-				if( tAct==DMAACTION_Write )
-				{
-					/* Do a simple parity check. */
-					ulParity = ulAddress ^ ptCnt->ulData;
-					ulParity = ulParity ^ (ulParity >> 16U);
-					ulParity = ulParity ^ (ulParity >>  8U);
-					ulParity = ulParity ^ (ulParity >>  4U);
-					ulParity = ulParity ^ (ulParity >>  2U);
-					ulParity = ulParity ^ (ulParity >>  1U);
-					ulParity &= 1U;
-					if( ulParity==0 )
-					{
-						uprintf("!!!PARITY ERROR!!!\n");
-					}
-				}
-
-				iResult = pciDma_Ch0(ulAddress, g_ul_PCI_DMA_Buffer_Start, ulDmaCtrl);
-				if( iResult!=0 )
-				{
-					uprintf("[%s:%d] The transfer failed: %d\n", pcName, uiCnt, iResult);
-				}
-				else
-				{
-					switch( tAct )
-					{
-					case DMAACTION_Write:
-						/* Nothing to do after a write. */
-						break;
-
-					case DMAACTION_Compare:
-						/* Compare the received value with the ulData field. */
-						ulDataReceived = swapBit0_Bit30(g_ul_PCI_DMA_Buffer_Start[0]);
-						ulDataExpected = ptCnt->ulData;
-						if( ulDataReceived!=ulDataExpected )
-						{
-							uprintf("[%s:%d] The received data does not match the expected data: 0x%08x / 0x%08x\n", pcName, uiCnt, ulDataReceived, ulDataExpected);
-							iResult = -1;
-						}
-						break;
-
-					case DMAACTION_Dump:
-						/* Just print the received data. */
-						ulDataReceived = swapBit0_Bit30(g_ul_PCI_DMA_Buffer_Start[0]);
-						uprintf("[%s:%d] Received 0x%08x\n", pcName, uiCnt, ulDataReceived);
-						break;
-					}
-				}
-			}
-		}
-
-		/* Do not process the rest of the list if the current entry failed. */
-		if( iResult!=0 )
-		{
-			break;
-		}
-
-		++uiCnt;
-	}
-
-	return iResult;
-}
-
-
-
-int io_register_read_08(unsigned int ulAddress, unsigned char *pucData)
-{
-	int iResult;
-	unsigned long ulDmaCtrl;
-	unsigned long ulByteOffset;
-	unsigned long ulDataReceived;
-
-
-	/* Split the address into a DWORD part with a byte offset. */
-	ulByteOffset = ulAddress & 3U;
-	ulAddress &= 0xfffffffcU;
-
-	ulDmaCtrl  = MSK_DPMAS_NETX_DMA_CTRL_START;
-	/* The number of DWORDS is 1. */
-	ulDmaCtrl |= 1U << SRT_DPMAS_NETX_DMA_CTRL_TRANSFER_LENGTH;
-	ulDmaCtrl |= VAL_DPMAS_NETX_DMA_CTRL_DIRECTION_host_to_netx << SRT_DPMAS_NETX_DMA_CTRL_DIRECTION;
-	ulDmaCtrl |= VAL_DPMAS_NETX_DMA_CTRL_DMA_TYPE_Input_Output_Cycle << SRT_DPMAS_NETX_DMA_CTRL_DMA_TYPE;
-
-	iResult = pciDma_Ch0(ulAddress, g_ul_PCI_DMA_Buffer_Start, ulDmaCtrl);
-	if( iResult!=0 )
-	{
-		/* The transfer failed. */
-		iResult = -1;
-	}
-	else
-	{
-		if( pucData!=NULL )
-		{
-			/* Get the complete DWORD. */
-			ulDataReceived = swapBit0_Bit30(g_ul_PCI_DMA_Buffer_Start[0]);
-			/* Extract the data. */
-			ulDataReceived >>= 8U * ulByteOffset;
-			*pucData = (unsigned char)(ulDataReceived & 0x000000ffU);
-		}
-		iResult = 0;
-	}
-
-	return iResult;
-}
-
-
-
-int io_register_read_32(unsigned int ulAddress, unsigned long *pulData)
-{
-	int iResult;
-	unsigned long ulDmaCtrl;
-	unsigned long ulDataReceived;
-
-
-	ulDmaCtrl  = MSK_DPMAS_NETX_DMA_CTRL_START;
-	/* The number of DWORDS is 1. */
-	ulDmaCtrl |= 1U << SRT_DPMAS_NETX_DMA_CTRL_TRANSFER_LENGTH;
-	ulDmaCtrl |= VAL_DPMAS_NETX_DMA_CTRL_DIRECTION_host_to_netx << SRT_DPMAS_NETX_DMA_CTRL_DIRECTION;
-	ulDmaCtrl |= VAL_DPMAS_NETX_DMA_CTRL_DMA_TYPE_Input_Output_Cycle << SRT_DPMAS_NETX_DMA_CTRL_DMA_TYPE;
-
-	iResult = pciDma_Ch0(ulAddress, g_ul_PCI_DMA_Buffer_Start, ulDmaCtrl);
-	if( iResult!=0 )
-	{
-		/* The transfer failed. */
-		iResult = -1;
-	}
-	else
-	{
-		if( pulData!=NULL )
-		{
-			/* Get the complete DWORD. */
-			ulDataReceived = swapBit0_Bit30(g_ul_PCI_DMA_Buffer_Start[0]);
-			*pulData = ulDataReceived;
-		}
-		iResult = 0;
-	}
-
-	return iResult;
-}
-
-
-
-int io_register_write_32(unsigned int ulAddress, unsigned long ulData)
-{
-	int iResult;
-	unsigned long ulDmaCtrl;
-
-
-	ulDmaCtrl  = MSK_DPMAS_NETX_DMA_CTRL_START;
-	/* The number of DWORDS is 1. */
-	ulDmaCtrl |= 1U << SRT_DPMAS_NETX_DMA_CTRL_TRANSFER_LENGTH;
-	ulDmaCtrl |= VAL_DPMAS_NETX_DMA_CTRL_DIRECTION_netx_to_host << SRT_DPMAS_NETX_DMA_CTRL_DIRECTION;
-	ulDmaCtrl |= VAL_DPMAS_NETX_DMA_CTRL_DMA_TYPE_Input_Output_Cycle << SRT_DPMAS_NETX_DMA_CTRL_DMA_TYPE;
-
-	/* Swap bit 0 and 30 of the data and write it to the DMA buffer. */
-	g_ul_PCI_DMA_Buffer_Start[0] = swapBit0_Bit30(ulData);
-
-	iResult = pciDma_Ch0(ulAddress, g_ul_PCI_DMA_Buffer_Start, ulDmaCtrl);
-
-	return iResult;
-}
@@ -2,6 +2,8 @@
 #ifndef __PCI__
 #define __PCI__
 
+#include <stdint.h>
+
 //-------------------------------------
 
 // reset_ctrl register
@@ -19,6 +21,7 @@ void dpm_init_registers(void);
 void dpm_deinit_registers(void);
 
 void delay100US(unsigned int uDelay100Us);
+uint32_t pciGetTimeUs(void);
 
 void clockOutConfig(unsigned int uFreqValue);
 
@@ -31,9 +34,9 @@ void pciSetPciReset(unsigned long ulResetState);
 int pciResetAndInit(unsigned int uRstActiveToClock, unsigned int uRstActiveDelayAfterClock, unsigned int uBusIdleDelay);
 void pciReset(unsigned int uRstActiveToClock, unsigned int uRstActiveDelayAfterClock, unsigned int uBusIdleDelay);
 
-int pciDma_Ch0(unsigned int uPciStartAdr, volatile unsigned long *pulNetxAdr, unsigned int uDmaCtrl);
+int pciDma_Ch0(unsigned int uPciStartAdr, volatile uint32_t *pulNetxAdr, unsigned int uDmaCtrl);
 
-int pciDeviceScan(unsigned long *pulDevData, volatile unsigned long *pulDmaArea);
+int pciDeviceScan(unsigned long *pulDevData, volatile uint32_t *pulDmaArea);
 
 int pciReadReq(unsigned int uWrCtrl, unsigned int *uData);
 int pciWriteReq(unsigned int uWrCtrl, unsigned int uData);
@@ -45,19 +48,21 @@ unsigned long pciGetDeviceAddr(unsigned long ulPciID, unsigned long *pulDevData)
 int pciNetXDeviceConfigRead(void);
 void pciArbConfig(void);
 
-int pciDma_CfgRead(unsigned int uDeviceAdr, volatile unsigned long *pulNetxAdr, unsigned int uDwords);
-int pciDma_CfgWrite(unsigned int uDeviceAdr, volatile unsigned long *pulNetxAdr, unsigned int uDwords);
+int pciDma_CfgRead(unsigned int uDeviceAdr, volatile uint32_t *pulNetxAdr, unsigned int uDwords);
+int pciDma_CfgWrite(unsigned int uDeviceAdr, volatile uint32_t *pulNetxAdr, unsigned int uDwords);
 
-int pciDma_MemRead(unsigned int uDeviceAdr, volatile unsigned long *pulNetxAdr, unsigned int uDwords);
-int pciDma_MemWrite(unsigned int uDeviceAdr, volatile unsigned long *pulNetxAdr, unsigned int uDwords);
+int pciDma_MemRead(unsigned int uDeviceAdr, volatile uint32_t *pulNetxAdr, unsigned int uDwords);
+int pciDma_MemWrite(unsigned int uDeviceAdr, volatile uint32_t *pulNetxAdr, unsigned int uDwords);
+int pciDma_MemReadSwapped(unsigned int uDeviceAdr, volatile uint32_t *pulNetxAdr, unsigned int uDwords);
+int pciDma_MemWriteSwapped(unsigned int uDeviceAdr, volatile uint32_t *pulNetxAdr, unsigned int uDwords);
 
 unsigned long swapBit0_Bit30(unsigned long ulDeviceAdr);
-void swapBi0_Bit30_array(volatile unsigned long *aulData, unsigned long ulCount);
+void swapBi0_Bit30_array(volatile uint32_t *aulData, unsigned long ulCount);
 
-int pciDma_CfgRead_Type1(unsigned int uDeviceAdr, volatile unsigned long *pulNetxAdr, unsigned int uDwords);
-int pciDma_CfgWrite_Type1(unsigned int uDeviceAdr, volatile unsigned long *pulNetxAdr, unsigned int uDwords);
+int pciDma_CfgRead_Type1(unsigned int uDeviceAdr, volatile uint32_t *pulNetxAdr, unsigned int uDwords);
+int pciDma_CfgWrite_Type1(unsigned int uDeviceAdr, volatile uint32_t *pulNetxAdr, unsigned int uDwords);
 
-int pciDma_TestCBE(unsigned int uDeviceAdr, unsigned int uDeviceOffs, volatile unsigned long *pulNetxAdr, unsigned int uDwords);
+int pciDma_TestCBE(unsigned int uDeviceAdr, unsigned int uDeviceOffs, volatile uint32_t *pulNetxAdr, unsigned int uDwords);
 
 
 #define MSK_DPMAS_NETX_DMA_CTRL_DONE                                     0x80000000
@@ -166,10 +171,38 @@ typedef struct DMALIST_STRUCT
 #define DMA_MEM(ADDRESS,OFFSET)                   DMATYPE_Mem,  MEMADR(ADDRESS,OFFSET)
 
 
-int dmalist_process(const DMALIST_T *ptDmaList, unsigned int sizDmaList, const char *pcName);
+/* The reason why a DMA list stopped. */
+typedef enum DMALIST_FAILURE_ENUM
+{
+	DMALIST_FAILURE_None          = 0,
+	DMALIST_FAILURE_Compare       = 1,
+	DMALIST_FAILURE_Transfer      = 2,
+	DMALIST_FAILURE_InvalidEntry  = 3
+} DMALIST_FAILURE_T;
+
+
+/* Optional details about a processed DMA list.
+ * The caller provides the buffer for the dumped values in pulDump and its
+ * size in sizDumpMax. Dumped values which do not fit are dropped.
+ */
+typedef struct DMALIST_RESULT_STRUCT
+{
+	DMALIST_FAILURE_T tFailure;
+	unsigned int uiFailedIndex;
+	unsigned long ulFailedValue;
+	unsigned long *pulDump;
+	unsigned int sizDumpMax;
+	unsigned int sizDump;
+} DMALIST_RESULT_T;
+
+
+/* Process all entries of a DMA list. Pass NULL in pcName to suppress all
+ * messages and NULL in ptResult if no details are needed.
+ */
+int dmalist_process(const DMALIST_T *ptDmaList, unsigned int sizDmaList, const char *pcName, DMALIST_RESULT_T *ptResult);
 
 int io_register_read_08(unsigned int ulAddress, unsigned char *pucData);
-int io_register_read_32(unsigned int ulAddress, unsigned long *pulData);
-int io_register_write_32(unsigned int ulAddress, unsigned long ulData);
+int io_register_read_32(unsigned int ulAddress, uint32_t *pulData);
+int io_register_write_32(unsigned int ulAddress, uint32_t ulData);
 
 #endif  /* __PCI__ */
@@ -0,0 +1,468 @@
+/**
+ * @file simulator.c A host model of the PCI side of the firmware.
+ *
+ * This replaces pci.c and the USB driver of the firmware. The command
+ * handling in usb_command_execution.c and the transfers in pci_dma.c run
+ * unchanged on top of it. Every DMA ends in pciDma_Ch0, which accesses the
+ * regions of the model instead of the netX DMA controller.
+ *
+ */
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "simulator.h"
+#include "pci.h"
+#include "uprintf.h"
+#include "usb.h"
+#include "usb_command_execution.h"
+
+
+#define SIMULATOR_MAXIMUM_REGIONS 16
+
+typedef struct SIMULATOR_REGION_STRUCT
+{
+	uint32_t ulAddress;
+	uint32_t ulSize;
+	uint32_t *pulData;
+} SIMULATOR_REGION_T;
+
+
+/* The DMA buffer has the same size as the one in netx500.ld . */
+static uint32_t s_aulDmaBuffer[0x8000 / sizeof(uint32_t)];
+
+/* Pointer to start address of DMA buffer */
+volatile uint32_t *g_pul_PCI_DMA_Buffer_Start = s_aulDmaBuffer;
+/* Pointer to end address of DMA buffer */
+volatile uint32_t *g_pul_PCI_DMA_Buffer_End = s_aulDmaBuffer + (sizeof(s_aulDmaBuffer) / sizeof(uint32_t));
+
+
+static pthread_mutex_t s_tMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static SIMULATOR_REGION_T s_atRegions[SIMULATOR_SPACES][SIMULATOR_MAXIMUM_REGIONS];
+static unsigned int s_asizRegions[SIMULATOR_SPACES];
+
+static SIMULATOR_COUNTERS_T s_tCounters;
+
+/* The PCI reset line. All transfers fail while it is active. */
+static unsigned long s_ulPciReset;
+
+/* The receiver of the packets for the running command. */
+static PFN_SIMULATOR_PACKET_T s_pfnPacket;
+static void *s_pvPacketUser;
+
+/* This is the receive buffer of the firmware. */
+static union
+{
+	unsigned char auc[PAPA_SCHLUMPF_MAX_PACKET_SIZE];
+	PAPA_SCHLUMPF_USB_COMMAND_T s;
+} s_uPacketBufferRx;
+
+/* This collects the chunks of a transfer from usb_send_start. */
+static unsigned char s_aucTransferTx[PAPA_SCHLUMPF_MAX_PACKET_SIZE];
+static size_t s_sizTransferTx;
+
+
+
+/* Find the region with a complete access. The caller must hold the mutex. */
+static SIMULATOR_REGION_T *find_region(SIMULATOR_SPACE_T tSpace, uint32_t ulAddress, uint32_t ulSize)
+{
+	SIMULATOR_REGION_T *ptRegion;
+	SIMULATOR_REGION_T *ptEnd;
+	uint64_t ullEnd;
+
+
+	ullEnd = (uint64_t)ulAddress + (uint64_t)ulSize;
+
+	ptRegion = s_atRegions[tSpace];
+	ptEnd = ptRegion + s_asizRegions[tSpace];
+	while( ptRegion<ptEnd )
+	{
+		if( ulAddress>=ptRegion->ulAddress && ullEnd<=((uint64_t)ptRegion->ulAddress + (uint64_t)ptRegion->ulSize) )
+		{
+			return ptRegion;
+		}
+		++ptRegion;
+	}
+
+	return NULL;
+}
+
+
+
+void simulator_reset(void)
+{
+	unsigned int uiSpace;
+	unsigned int uiCnt;
+
+
+	pthread_mutex_lock(&s_tMutex);
+	for(uiSpace=0; uiSpace<SIMULATOR_SPACES; ++uiSpace)
+	{
+		for(uiCnt=0; uiCnt<s_asizRegions[uiSpace]; ++uiCnt)
+		{
+			free(s_atRegions[uiSpace][uiCnt].pulData);
+		}
+		s_asizRegions[uiSpace] = 0;
+	}
+	memset(&s_tCounters, 0, sizeof(s_tCounters));
+	s_ulPciReset = 0;
+	pthread_mutex_unlock(&s_tMutex);
+}
+
+
+
+int simulator_add_region(SIMULATOR_SPACE_T tSpace, uint32_t ulAddress, uint32_t ulSize)
+{
+	int iResult;
+	unsigned int uiCnt;
+	SIMULATOR_REGION_T *ptRegion;
+	uint64_t ullEnd;
+
+
+	iResult = -1;
+	ullEnd = (uint64_t)ulAddress + (uint64_t)ulSize;
+	if( (unsigned int)tSpace<SIMULATOR_SPACES && ulSize!=0 && ((ulAddress|ulSize)&3U)==0 && ullEnd<=0x100000000ULL )
+	{
+		pthread_mutex_lock(&s_tMutex);
+		if( s_asizRegions[tSpace]<SIMULATOR_MAXIMUM_REGIONS )
+		{
+			/* Regions must not overlap. */
+			iResult = 0;
+			for(uiCnt=0; uiCnt<s_asizRegions[tSpace]; ++uiCnt)
+			{
+				ptRegion = s_atRegions[tSpace] + uiCnt;
+				if( ulAddress<((uint64_t)ptRegion->ulAddress + (uint64_t)ptRegion->ulSize) && ullEnd>ptRegion->ulAddress )
+				{
+					iResult = -1;
+					break;
+				}
+			}
+
+			if( iResult==0 )
+			{
+				ptRegion = s_atRegions[tSpace] + s_asizRegions[tSpace];
+				ptRegion->pulData = (uint32_t*)calloc(ulSize / sizeof(uint32_t), sizeof(uint32_t));
+				if( ptRegion->pulData==NULL )
+				{
+					iResult = -1;
+				}
+				else
+				{
+					ptRegion->ulAddress = ulAddress;
+					ptRegion->ulSize = ulSize;
+					++s_asizRegions[tSpace];
+				}
+			}
+		}
+		pthread_mutex_unlock(&s_tMutex);
+	}
+
+	return iResult;
+}
+
+
+
+int simulator_read(SIMULATOR_SPACE_T tSpace, uint32_t ulAddress, uint32_t *pulData)
+{
+	int iResult;
+	SIMULATOR_REGION_T *ptRegion;
+
+
+	iResult = -1;
+	if( (unsigned int)tSpace<SIMULATOR_SPACES )
+	{
+		pthread_mutex_lock(&s_tMutex);
+		ptRegion = find_region(tSpace, ulAddress & ~3U, sizeof(uint32_t));
+		if( ptRegion!=NULL )
+		{
+			*pulData = ptRegion->pulData[((ulAddress & ~3U) - ptRegion->ulAddress) / sizeof(uint32_t)];
+			iResult = 0;
+		}
+		pthread_mutex_unlock(&s_tMutex);
+	}
+
+	return iResult;
+}
+
+
+
+int simulator_write(SIMULATOR_SPACE_T tSpace, uint32_t ulAddress, uint32_t ulData)
+{
+	int iResult;
+	SIMULATOR_REGION_T *ptRegion;
+
+
+	iResult = -1;
+	if( (unsigned int)tSpace<SIMULATOR_SPACES )
+	{
+		pthread_mutex_lock(&s_tMutex);
+		ptRegion = find_region(tSpace, ulAddress & ~3U, sizeof(uint32_t));
+		if( ptRegion!=NULL )
+		{
+			ptRegion->pulData[((ulAddress & ~3U) - ptRegion->ulAddress) / sizeof(uint32_t)] = ulData;
+			iResult = 0;
+		}
+		pthread_mutex_unlock(&s_tMutex);
+	}
+
+	return iResult;
+}
+
+
+
+void simulator_get_counters(SIMULATOR_COUNTERS_T *ptCounters)
+{
+	pthread_mutex_lock(&s_tMutex);
+	memcpy(ptCounters, &s_tCounters, sizeof(SIMULATOR_COUNTERS_T));
+	pthread_mutex_unlock(&s_tMutex);
+}
+
+
+
+int simulator_execute(const unsigned char *pucCommand, size_t sizCommand, PFN_SIMULATOR_PACKET_T pfnPacket, void *pvUser)
+{
+	int iResult;
+
+
+	/* The firmware stops with a command which does not fit into the buffer. */
+	iResult = -1;
+	if( sizCommand>=sizeof(uint32_t) && sizCommand<=sizeof(s_uPacketBufferRx) )
+	{
+		pthread_mutex_lock(&s_tMutex);
+		memcpy(s_uPacketBufferRx.auc, pucCommand, sizCommand);
+		s_pfnPacket = pfnPacket;
+		s_pvPacketUser = pvUser;
+		++s_tCounters.ulCommands;
+
+		execute_command(&(s_uPacketBufferRx.s));
+		/* Run a stream to the end. It can not see an abort. */
+		while( execute_command_continue()!=0 )
+		{
+		}
+
+		s_pfnPacket = NULL;
+		s_pvPacketUser = NULL;
+		pthread_mutex_unlock(&s_tMutex);
+
+		iResult = 0;
+	}
+
+	return iResult;
+}
+
+
+
+/*-------------------------------------------------------------------------*/
+/* These functions replace the firmware. They run with the mutex held.     */
+/*-------------------------------------------------------------------------*/
+
+void uprintf(const char *pcFmt, ...)
+{
+	va_list ptArgument;
+
+
+	va_start(ptArgument, pcFmt);
+	vfprintf(stderr, pcFmt, ptArgument);
+	va_end(ptArgument);
+}
+
+
+
+/* Pass a complete transfer to the host. */
+static void send_transfer(const unsigned char *pucData, size_t sizData)
+{
+	++s_tCounters.ulPackets;
+	if( s_pfnPacket!=NULL )
+	{
+		s_pfnPacket(s_pvPacketUser, pucData, sizData);
+	}
+}
+
+
+
+/* The firmware writes a packet in one piece to the FIFO of the endpoint.
+ * A bigger packet overwrites the buffer behind the FIFO, so it is dropped.
+ */
+void usb_send_packet(const unsigned char *pucPacket, size_t sizPacket)
+{
+	if( sizPacket>PAPA_SCHLUMPF_USB_IN_FIFO_SIZE )
+	{
+		uprintf("The simulator dropped a packet of %lu bytes. It does not fit into the FIFO.\n", (unsigned long)sizPacket);
+	}
+	else
+	{
+		send_transfer(pucPacket, sizPacket);
+	}
+}
+
+
+
+/* Pass the chunks to the host in one piece like the USB core does. A chunk
+ * which is not a multiple of 64 bytes ends the transfer.
+ */
+void usb_send_start(const unsigned char *pucChunk, size_t sizChunk)
+{
+	if( sizChunk>PAPA_SCHLUMPF_USB_IN_FIFO_SIZE )
+	{
+		uprintf("The simulator dropped a chunk of %lu bytes. It does not fit into the FIFO.\n", (unsigned long)sizChunk);
+	}
+	else if( s_sizTransferTx + sizChunk>sizeof(s_aucTransferTx) )
+	{
+		uprintf("The simulator dropped a chunk of %lu bytes.\n", (unsigned long)sizChunk);
+	}
+	else
+	{
+		memcpy(s_aucTransferTx + s_sizTransferTx, pucChunk, sizChunk);
+		s_sizTransferTx += sizChunk;
+	}
+
+	if( (sizChunk&0x3fU)!=0 || sizChunk==0 )
+	{
+		send_transfer(s_aucTransferTx, s_sizTransferTx);
+		s_sizTransferTx = 0;
+	}
+}
+
+
+
+void usb_send_wait(void)
+{
+}
+
+
+
+int pciSetupNetx(void)
+{
+	return 0;
+}
+
+
+
+int pciResetAndInit(unsigned int uRstActiveToClock, unsigned int uRstActiveDelayAfterClock, unsigned int uBusIdleDelay)
+{
+	(void)uRstActiveToClock;
+	(void)uRstActiveDelayAfterClock;
+	(void)uBusIdleDelay;
+
+	s_ulPciReset = 0;
+
+	return 0;
+}
+
+
+
+void pciSetPciReset(unsigned long ulResetState)
+{
+	s_ulPciReset = ulResetState;
+}
+
+
+
+uint32_t pciGetTimeUs(void)
+{
+	struct timespec tNow;
+
+
+	clock_gettime(CLOCK_MONOTONIC, &tNow);
+	return (uint32_t)(((unsigned long long)tNow.tv_sec * 1000000ULL) + ((unsigned long long)tNow.tv_nsec / 1000ULL));
+}
+
+
+
+/* Run one DMA on the model.
+ * The netX swaps bit 0 and 30 of all data. The callers in pci_dma.c
+ * compensate this, so the model swaps the data too.
+ */
+int pciDma_Ch0(unsigned int uPciStartAdr, volatile uint32_t *pulNetxMemStartAdr, unsigned int uDmaCtrl)
+{
+	int iResult;
+	SIMULATOR_SPACE_T tSpace;
+	SIMULATOR_REGION_T *ptRegion;
+	uint32_t ulAddress;
+	unsigned int uiDwords;
+	unsigned int uiCnt;
+	uint32_t *pulData;
+
+
+	++s_tCounters.ulDmaTransfers;
+
+	uiDwords = (uDmaCtrl & MSK_DPMAS_NETX_DMA_CTRL_TRANSFER_LENGTH) >> SRT_DPMAS_NETX_DMA_CTRL_TRANSFER_LENGTH;
+	ulAddress = uPciStartAdr;
+
+	iResult = RESULT_OK;
+	switch( (uDmaCtrl & MSK_DPMAS_NETX_DMA_CTRL_DMA_TYPE) >> SRT_DPMAS_NETX_DMA_CTRL_DMA_TYPE )
+	{
+	case VAL_DPMAS_NETX_DMA_CTRL_DMA_TYPE_Input_Output_Cycle:
+		tSpace = SIMULATOR_SPACE_IO;
+		break;
+
+	case VAL_DPMAS_NETX_DMA_CTRL_DMA_TYPE_Memory_Cycle:
+	case VAL_DPMAS_NETX_DMA_CTRL_DMA_TYPE_Memory_Read_Multiple:
+		tSpace = SIMULATOR_SPACE_Mem;
+		break;
+
+	case VAL_DPMAS_NETX_DMA_CTRL_DMA_TYPE_Configuration_Cycle:
+		/* The lowest address bits select the header type. */
+		tSpace = ((ulAddress & (1U << SRT_PCI_HEADER_TYPE))!=0) ? SIMULATOR_SPACE_Cfg1 : SIMULATOR_SPACE_Cfg0;
+		ulAddress &= ~3U;
+		break;
+
+	default:
+		tSpace = SIMULATOR_SPACE_IO;
+		iResult = RESULT_DMA_ERROR;
+		break;
+	}
+
+	/* The netX side must be in the DMA buffer. */
+	if( pulNetxMemStartAdr<g_pul_PCI_DMA_Buffer_Start || (pulNetxMemStartAdr + uiDwords)>g_pul_PCI_DMA_Buffer_End )
+	{
+		iResult = RESULT_DMA_ERROR;
+	}
+
+	/* Nobody answers while the bus is in reset. */
+	if( s_ulPciReset!=0 )
+	{
+		iResult = RESULT_DMA_ERROR;
+	}
+
+	if( iResult==RESULT_OK )
+	{
+		ptRegion = find_region(tSpace, ulAddress, uiDwords * sizeof(uint32_t));
+		if( ptRegion==NULL )
+		{
+			/* This is a master abort. */
+			iResult = RESULT_DMA_ERROR;
+		}
+		else
+		{
+			pulData = ptRegion->pulData + (ulAddress - ptRegion->ulAddress) / sizeof(uint32_t);
+			if( ((uDmaCtrl & MSK_DPMAS_NETX_DMA_CTRL_DIRECTION) >> SRT_DPMAS_NETX_DMA_CTRL_DIRECTION)==VAL_DPMAS_NETX_DMA_CTRL_DIRECTION_netx_to_host )
+			{
+				for(uiCnt=0; uiCnt<uiDwords; ++uiCnt)
+				{
+					pulData[uiCnt] = (uint32_t)swapBit0_Bit30(pulNetxMemStartAdr[uiCnt]);
+				}
+			}
+			else
+			{
+				for(uiCnt=0; uiCnt<uiDwords; ++uiCnt)
+				{
+					pulNetxMemStartAdr[uiCnt] = (uint32_t)swapBit0_Bit30(pulData[uiCnt]);
+				}
+			}
+			s_tCounters.ulDmaDwords += uiDwords;
+		}
+	}
+
+	if( iResult!=RESULT_OK )
+	{
+		++s_tCounters.ulDmaErrors;
+	}
+
+	return iResult;
+}
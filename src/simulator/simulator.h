@@ -0,0 +1,74 @@
+#ifndef __SIMULATOR_H__
+#define __SIMULATOR_H__
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* The address spaces of the PCI model. The values match DMATYPE_T . */
+typedef enum SIMULATOR_SPACE_ENUM
+{
+	SIMULATOR_SPACE_IO    = 0,
+	SIMULATOR_SPACE_Mem   = 1,
+	SIMULATOR_SPACE_Cfg0  = 2,
+	SIMULATOR_SPACE_Cfg1  = 3
+} SIMULATOR_SPACE_T;
+
+#define SIMULATOR_SPACES 4
+
+
+/* Counters for the work done by the simulated firmware. */
+typedef struct SIMULATOR_COUNTERS_STRUCT
+{
+	unsigned long ulCommands;
+	unsigned long ulPackets;
+	unsigned long ulDmaTransfers;
+	unsigned long ulDmaDwords;
+	unsigned long ulDmaErrors;
+} SIMULATOR_COUNTERS_T;
+
+
+/* The simulator passes every packet which the firmware sends to this function. */
+typedef void (*PFN_SIMULATOR_PACKET_T)(void *pvUser, const unsigned char *pucPacket, size_t sizPacket);
+
+
+/* The simulated firmware has global state, so there is only one simulator
+ * per process. All functions are thread safe.
+ */
+
+/* Remove all regions and clear the counters. */
+void simulator_reset(void);
+
+/* Add a region to one address space. Accesses outside of all regions fail
+ * like a master abort on a real bus. Returns 0 on success or -1 if the region
+ * overlaps another one or there is no more room.
+ */
+int simulator_add_region(SIMULATOR_SPACE_T tSpace, uint32_t ulAddress, uint32_t ulSize);
+
+/* Read or write one DWORD of the model without a firmware command.
+ * Returns 0 on success or -1 if the address is not in a region.
+ */
+int simulator_read(SIMULATOR_SPACE_T tSpace, uint32_t ulAddress, uint32_t *pulData);
+int simulator_write(SIMULATOR_SPACE_T tSpace, uint32_t ulAddress, uint32_t ulData);
+
+void simulator_get_counters(SIMULATOR_COUNTERS_T *ptCounters);
+
+/* Run one command in the firmware. The packets of the response are passed to
+ * pfnPacket before this function returns. Returns 0 on success or -1 if the
+ * command does not fit into the receive buffer of the firmware.
+ */
+int simulator_execute(const unsigned char *pucCommand, size_t sizCommand, PFN_SIMULATOR_PACKET_T pfnPacket, void *pvUser);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif  /* __SIMULATOR_H__ */
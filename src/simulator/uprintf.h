@@ -0,0 +1,9 @@
+#ifndef __UPRINTF_H__
+#define __UPRINTF_H__
+
+
+/* The simulator prints all firmware messages to stderr. */
+void uprintf(const char *pcFmt, ...);
+
+
+#endif  /* __UPRINTF_H__ */
@@ -127,21 +127,47 @@ void usb_loop(void)
  */
 void usb_send_packet(const unsigned char *pucPacket, size_t sizPacket)
 {
-	HOSTDEF(ptUsbCoreArea);
-	unsigned long ulPipeEvent;
+	/* The packet must fit into the FIFO of the endpoint (Usb_Ep1_BufferSize).
+	 * Bigger responses are sent in chunks with usb_send_start and
+	 * usb_send_wait.
+	 */
 
+	usb_send_start(pucPacket, sizPacket);
+	usb_send_wait();
 
-	/* FIXME: Check the size of the packet against the maximum available
-	 * size in the FIFO. For now this routine relies on the maximum of
-	 * 2048 bytes.
-	 */
+	/* Was the last packet a complete packet? */
+	if( (sizPacket&0x3f)==0 )
+	{
+		/* Yes -> send a 0 byte packet. */
+		usb_send_start(pucPacket, 0);
+		usb_send_wait();
+	}
+}
+
+
+/* Start to send one chunk of a transfer and return without waiting.
+ * The host sees all chunks up to the first one which is not a multiple of
+ * 64 bytes as one transfer. A chunk must fit into the FIFO of the endpoint.
+ * The chunk is copied into the FIFO at once, so the buffer can be used
+ * again when this function returns. Call usb_send_wait before the next
+ * chunk, as all chunks use the same FIFO.
+ */
+void usb_send_start(const unsigned char *pucChunk, size_t sizChunk)
+{
+	/* Write the chunk to the FIFO. */
+	usb_io_write_fifo(Usb_Ep1_Buffer>>2, sizChunk, pucChunk);
+	/* Send the chunk. */
+	usb_io_sendDataPacket(1, sizChunk);
+}
+
+
+/* Wait until the chunk from usb_send_start is sent. */
+void usb_send_wait(void)
+{
+	HOSTDEF(ptUsbCoreArea);
+	unsigned long ulPipeEvent;
 
-	/* Write the packet data to the FIFO. */
-	usb_io_write_fifo(Usb_Ep1_Buffer>>2, sizPacket, pucPacket);
-	/* Send the packet. */
-	usb_io_sendDataPacket(1, sizPacket);
 
-	/* Wait until the packet is sent. */
 	do
 	{
 		ulPipeEvent = ptUsbCoreArea->ulPIPE_EV;
@@ -149,22 +175,6 @@ void usb_send_packet(const unsigned char *pucPacket, size_t sizPacket)
 
 	/* Clear the event. */
 	ptUsbCoreArea->ulPIPE_EV = (1<<1);
-
-	/* Was the last packet a complete packet? */
-	if( (sizPacket&0x3f)==0 )
-	{
-		/* Yes -> send a 0 byte packet. */
-		usb_io_sendDataPacket(1, 0);
-
-		/* Wait until the packet is sent. */
-		do
-		{
-			ulPipeEvent = ptUsbCoreArea->ulPIPE_EV;
-		} while( (ulPipeEvent&(1<<1))==0 );
-
-		/* Clear the event. */
-		ptUsbCoreArea->ulPIPE_EV = (1<<1);
-	}
 }
 
 
@@ -33,6 +33,8 @@ void usb_init(void);
 
 void usb_loop(void);
 void usb_send_packet(const unsigned char *pucPacket, size_t sizPacket);
+void usb_send_start(const unsigned char *pucChunk, size_t sizChunk);
+void usb_send_wait(void);
 unsigned long usb_get_rx_fill_level(void);
 //unsigned long usb_get_tx_fill_level(void);
 unsigned char usb_get_byte(void);
@@ -8,13 +8,14 @@
 #include <string.h>
 
 #include "usb_command_execution.h"
+#include "../common/papa_schlumpf_crc32.h"
 #include "pci.h"
 #include "uprintf.h"
 #include "version.h"
 
 
-extern volatile unsigned long *g_pul_PCI_DMA_Buffer_Start;
-extern volatile unsigned long *g_pul_PCI_DMA_Buffer_End;
+extern volatile uint32_t *g_pul_PCI_DMA_Buffer_Start;
+extern volatile uint32_t *g_pul_PCI_DMA_Buffer_End;
 
 
 static void execute_command_get_firmware_version(void)
@@ -128,54 +129,247 @@ static void execute_command_dma_mem_read(PAPA_SCHLUMPF_USB_COMMAND_DMA_MEM_READ_
 
 
 
-static PAPA_SCHLUMPF_USB_COMMAND_RESULT_DMA_MEM_READ_AREA_T tReadAreaResponse;
+/* The response of a read area command is sent in chunks. The next chunk is
+ * read over PCI while the USB core sends the last one. The chunks alternate
+ * between the halves of the DMA buffer. All chunks except the last one are a
+ * multiple of 64 bytes, so the host receives one transfer.
+ */
+#define READ_AREA_CHUNK_SIZE 0x0400U
+
 static void execute_command_dma_mem_read_area(PAPA_SCHLUMPF_USB_COMMAND_DMA_MEM_READ_AREA_T *ptCommand)
 {
 	int iResult;
 	unsigned long ulSize;
-	unsigned int uiSizeDw;
-	size_t sizUsbPacket;
-
-	/* Round the size of the read request up to the next DWORD and convert the byte size to a DWORD size. */
+	unsigned long ulResponseSize;
+	unsigned long ulOffset;
+	unsigned long ulDataOffset;
+	size_t sizChunk;
+	size_t sizData;
+	unsigned int uiHalf;
+	unsigned int uiHalfDw;
+	volatile uint32_t *pulChunk;
+	volatile uint32_t *pulData;
+	uint32_t ulStatus;
+
+
+	/* The size must be a multiple of DWORDs and fit into one response. */
 	ulSize = ptCommand->ulSize;
-	if( (ulSize&3U)!=0 )
+	if( (ulSize&3U)!=0 || ulSize>(PAPA_SCHLUMPF_MAXIMUM_PACKET_SIZE-sizeof(uint32_t)) )
 	{
-		tReadAreaResponse.ulStatus = USB_COMMAND_STATUS_InvalidSize;
-		sizUsbPacket = sizeof(uint32_t);
+		ulStatus = USB_COMMAND_STATUS_InvalidSize;
+		usb_send_packet((unsigned char*)(&ulStatus), sizeof(uint32_t));
 	}
 	else
 	{
-		uiSizeDw = ulSize / sizeof(uint32_t);
+		ulResponseSize = sizeof(uint32_t) + ulSize;
+		uiHalfDw = (unsigned int)(g_pul_PCI_DMA_Buffer_End - g_pul_PCI_DMA_Buffer_Start) / 2U;
+
+		iResult = 0;
+		ulOffset = 0;
+		sizChunk = 0;
+		uiHalf = 0;
+		do
+		{
+			pulChunk = g_pul_PCI_DMA_Buffer_Start + uiHalf * uiHalfDw;
+			sizChunk = ulResponseSize - ulOffset;
+			if( sizChunk>READ_AREA_CHUNK_SIZE )
+			{
+				sizChunk = READ_AREA_CHUNK_SIZE;
+			}
+
+			/* The first chunk starts with the status. */
+			if( ulOffset==0 )
+			{
+				pulChunk[0] = USB_COMMAND_STATUS_Ok;
+				pulData = pulChunk + 1;
+				ulDataOffset = 0;
+				sizData = sizChunk - sizeof(uint32_t);
+			}
+			else
+			{
+				pulData = pulChunk;
+				ulDataOffset = ulOffset - sizeof(uint32_t);
+				sizData = sizChunk;
+			}
+			if( sizData!=0 )
+			{
+				iResult = pciDma_MemRead(ptCommand->ulDeviceAddress + ulDataOffset, pulData, sizData / sizeof(uint32_t));
+			}
+
+			/* The FIFO is free again when the last chunk is sent. */
+			if( ulOffset!=0 )
+			{
+				usb_send_wait();
+			}
+
+			if( iResult==0 )
+			{
+				usb_send_start((const unsigned char*)pulChunk, sizChunk);
+				ulOffset += sizChunk;
+				uiHalf ^= 1U;
+			}
+		} while( iResult==0 && ulOffset<ulResponseSize );
 
-		/* Does the requested size exceed the PCI DMA buffer? */
-		if( ulSize>(unsigned int)(g_pul_PCI_DMA_Buffer_End - g_pul_PCI_DMA_Buffer_Start) )
+		if( iResult==0 )
 		{
-			tReadAreaResponse.ulStatus = USB_COMMAND_STATUS_InvalidSize;
-			sizUsbPacket = sizeof(uint32_t);
+			usb_send_wait();
 		}
-		/* Does the request exceed the USB buffer? */
-		else if( ulSize>sizeof(tReadAreaResponse.aucData) )
+
+		if( ulOffset==0 )
 		{
-			tReadAreaResponse.ulStatus = USB_COMMAND_STATUS_InvalidSize;
-			sizUsbPacket = sizeof(uint32_t);
+			ulStatus = USB_COMMAND_STATUS_PciTransferFailed;
+			usb_send_packet((unsigned char*)(&ulStatus), sizeof(uint32_t));
 		}
-		else
+		/* An error after the first chunk ends the transfer early. The host
+		 * takes a short response as a failed PCI transfer.
+		 */
+		else if( iResult!=0 || (sizChunk&0x3fU)==0 )
 		{
-			iResult = pciDma_MemRead(ptCommand->ulDeviceAddress, g_pul_PCI_DMA_Buffer_Start, uiSizeDw);
-			if( iResult==0 )
-			{
-				tReadAreaResponse.ulStatus = USB_COMMAND_STATUS_Ok;
-				memcpy(tReadAreaResponse.aucData, g_pul_PCI_DMA_Buffer_Start, ulSize);
-				sizUsbPacket = sizeof(uint32_t) + ulSize;
-			}
-			else
+			usb_send_start((const unsigned char*)pulChunk, 0);
+			usb_send_wait();
+		}
+	}
+}
+
+
+
+/* A stream runs between the USB events. Each step reads the next chunk over
+ * PCI while the USB core sends the last one.
+ */
+typedef struct MEM_READ_STREAM_STRUCT
+{
+	int iActive;
+	uint32_t ulDeviceAddress;
+	uint32_t ulSize;
+	uint32_t ulOffset;
+	uint32_t ulSequence;
+	unsigned int uiHalf;
+	volatile uint32_t *pulPending;
+	size_t sizPending;
+} MEM_READ_STREAM_T;
+
+static MEM_READ_STREAM_T tMemReadStream;
+
+/* Wait until the last transfer of the stream is sent. */
+static void mem_read_stream_wait(void)
+{
+	if( tMemReadStream.sizPending!=0 )
+	{
+		usb_send_wait();
+
+		/* Only the last transfer can be a multiple of 64 bytes. */
+		if( (tMemReadStream.sizPending&0x3fU)==0 )
+		{
+			usb_send_start((const unsigned char*)tMemReadStream.pulPending, 0);
+			usb_send_wait();
+		}
+		tMemReadStream.sizPending = 0;
+	}
+}
+
+
+
+static void mem_read_stream_stop(void)
+{
+	mem_read_stream_wait();
+	tMemReadStream.iActive = 0;
+}
+
+
+
+static void execute_command_mem_read_stream(PAPA_SCHLUMPF_USB_COMMAND_MEM_READ_STREAM_T *ptCommand)
+{
+	PAPA_SCHLUMPF_USB_COMMAND_RESULT_MEM_READ_STREAM_T tPacket;
+	uint32_t ulSize;
+
+
+	ulSize = ptCommand->ulSize;
+	if( ulSize==0 || (ulSize&3U)!=0 )
+	{
+		tPacket.ulStatus = USB_COMMAND_STATUS_InvalidSize;
+		tPacket.ulSequence = 0;
+		usb_send_packet((unsigned char*)(&tPacket), sizeof(uint32_t) + sizeof(uint32_t));
+	}
+	else
+	{
+		/* The first chunk is read in the next step. */
+		tMemReadStream.ulDeviceAddress = ptCommand->ulDeviceAddress;
+		tMemReadStream.ulSize = ulSize;
+		tMemReadStream.ulOffset = 0;
+		tMemReadStream.ulSequence = 0;
+		tMemReadStream.uiHalf = 0;
+		tMemReadStream.iActive = 1;
+	}
+}
+
+
+
+static void execute_command_mem_read_stream_abort(void)
+{
+	PAPA_SCHLUMPF_USB_COMMAND_RESULT_MEM_READ_STREAM_T tPacket;
+
+
+	/* The stream is already stopped. */
+	tPacket.ulStatus = USB_COMMAND_STATUS_Ok;
+	tPacket.ulSequence = PAPA_SCHLUMPF_STREAM_SEQUENCE_ABORTED;
+	usb_send_packet((unsigned char*)(&tPacket), sizeof(uint32_t) + sizeof(uint32_t));
+}
+
+
+
+int execute_command_continue(void)
+{
+	int iResult;
+	volatile uint32_t *pulChunk;
+	uint32_t ulChunk;
+	size_t sizTransfer;
+
+
+	if( tMemReadStream.iActive!=0 )
+	{
+		/* The chunk has the status and the sequence number in front. */
+		pulChunk = g_pul_PCI_DMA_Buffer_Start + tMemReadStream.uiHalf * ((unsigned int)(g_pul_PCI_DMA_Buffer_End - g_pul_PCI_DMA_Buffer_Start) / 2U);
+		ulChunk = tMemReadStream.ulSize - tMemReadStream.ulOffset;
+		if( ulChunk>PAPA_SCHLUMPF_STREAM_CHUNK_SIZE )
+		{
+			ulChunk = PAPA_SCHLUMPF_STREAM_CHUNK_SIZE;
+		}
+		iResult = pciDma_MemRead(tMemReadStream.ulDeviceAddress + tMemReadStream.ulOffset, pulChunk + 2, ulChunk / sizeof(uint32_t));
+
+		mem_read_stream_wait();
+
+		pulChunk[1] = tMemReadStream.ulSequence;
+		if( iResult==0 )
+		{
+			pulChunk[0] = USB_COMMAND_STATUS_Ok;
+			sizTransfer = sizeof(uint32_t) + sizeof(uint32_t) + ulChunk;
+			tMemReadStream.ulOffset += ulChunk;
+			++tMemReadStream.ulSequence;
+			tMemReadStream.uiHalf ^= 1U;
+			if( tMemReadStream.ulOffset>=tMemReadStream.ulSize )
 			{
-				tReadAreaResponse.ulStatus = USB_COMMAND_STATUS_PciTransferFailed;
-				sizUsbPacket = sizeof(uint32_t);
+				tMemReadStream.iActive = 0;
 			}
 		}
-		usb_send_packet((unsigned char*)(&tReadAreaResponse), sizUsbPacket);
+		else
+		{
+			/* An error ends the stream. */
+			pulChunk[0] = USB_COMMAND_STATUS_PciTransferFailed;
+			sizTransfer = sizeof(uint32_t) + sizeof(uint32_t);
+			tMemReadStream.iActive = 0;
+		}
+		usb_send_start((const unsigned char*)pulChunk, sizTransfer);
+		tMemReadStream.pulPending = pulChunk;
+		tMemReadStream.sizPending = sizTransfer;
+
+		/* There is nothing to overlap with the last transfer. */
+		if( tMemReadStream.iActive==0 )
+		{
+			mem_read_stream_wait();
+		}
 	}
+
+	return tMemReadStream.iActive;
 }
 
 
@@ -222,6 +416,50 @@ static void execute_command_dma_cfg1_read(PAPA_SCHLUMPF_USB_COMMAND_DMA_CFG1_REA
 
 
 
+/* Read a range of configuration registers of one function. */
+static void execute_command_dma_cfg_read_area(PAPA_SCHLUMPF_USB_COMMAND_DMA_CFG_READ_AREA_T *ptCommand)
+{
+	int iResult;
+	PAPA_SCHLUMPF_USB_COMMAND_RESULT_DMA_CFG_READ_AREA_T tPacket;
+	unsigned long ulSize;
+	unsigned long ulRegister;
+	size_t sizUsbPacket;
+
+
+	ulSize = ptCommand->ulSize;
+	ulRegister = ptCommand->ulDeviceAddress & MSK_PCI_CONFIGURATION_ADDRESS_REGISTER & ~3U;
+	sizUsbPacket = sizeof(uint32_t);
+
+	if( ulSize==0 || (ulSize&3U)!=0 || ulSize>sizeof(tPacket.aulData)-ulRegister )
+	{
+		tPacket.ulStatus = USB_COMMAND_STATUS_InvalidSize;
+	}
+	else
+	{
+		if( ptCommand->ulCommand==PAPA_SCHLUMPF_USB_COMMAND_DMACfg1ReadArea )
+		{
+			iResult = pciDma_CfgRead_Type1(ptCommand->ulDeviceAddress, g_pul_PCI_DMA_Buffer_Start, ulSize / sizeof(uint32_t));
+		}
+		else
+		{
+			iResult = pciDma_CfgRead(ptCommand->ulDeviceAddress, g_pul_PCI_DMA_Buffer_Start, ulSize / sizeof(uint32_t));
+		}
+		if( iResult==0 )
+		{
+			tPacket.ulStatus = USB_COMMAND_STATUS_Ok;
+			memcpy(tPacket.aulData, (const void*)g_pul_PCI_DMA_Buffer_Start, ulSize);
+			sizUsbPacket += ulSize;
+		}
+		else
+		{
+			tPacket.ulStatus = USB_COMMAND_STATUS_PciTransferFailed;
+		}
+	}
+	usb_send_packet((unsigned char*)(&tPacket), sizUsbPacket);
+}
+
+
+
 static void execute_command_dma_io_write(PAPA_SCHLUMPF_USB_COMMAND_DMA_IO_WRITE_T *ptCommand)
 {
 	int iResult;
@@ -346,98 +584,1235 @@ static void execute_command_dma_cfg1_write(PAPA_SCHLUMPF_USB_COMMAND_DMA_CFG1_WR
 
 
 
-void execute_command(PAPA_SCHLUMPF_USB_COMMAND_T *ptCommand)
+static void execute_command_dma_mem_modify(PAPA_SCHLUMPF_USB_COMMAND_DMA_MODIFY_T *ptCommand)
 {
-	PAPA_SCHLUMPF_USB_COMMANDS_T tCommand;
 	int iResult;
-	PAPA_SCHLUMPF_USB_COMMAND_RESULT_STATUS_T tPacketStatus;
+	uint32_t ulValue;
+	PAPA_SCHLUMPF_USB_COMMAND_RESULT_DMA_MODIFY_T tPacket;
 
 
-	tCommand = ptCommand->ulCommand;
-	iResult = -1;
-	switch(tCommand)
+	iResult = pciDma_MemRead(ptCommand->ulDeviceAddress, g_pul_PCI_DMA_Buffer_Start, 1);
+	if( iResult==0 )
 	{
-	case PAPA_SCHLUMPF_USB_COMMAND_GetFirmwareVersion:
-	case PAPA_SCHLUMPF_USB_COMMAND_ResetPCI:
-	case PAPA_SCHLUMPF_USB_COMMAND_DMAIoRead:
-	case PAPA_SCHLUMPF_USB_COMMAND_DMAMemRead:
-	case PAPA_SCHLUMPF_USB_COMMAND_DMACfg0Read:
-	case PAPA_SCHLUMPF_USB_COMMAND_DMACfg1Read:
-	case PAPA_SCHLUMPF_USB_COMMAND_DMAIoWrite:
-	case PAPA_SCHLUMPF_USB_COMMAND_DMAMemWrite:
-	case PAPA_SCHLUMPF_USB_COMMAND_DMACfg0Write:
-	case PAPA_SCHLUMPF_USB_COMMAND_DMACfg1Write:
-	case PAPA_SCHLUMPF_USB_COMMAND_DMAMemReadArea:
-	case PAPA_SCHLUMPF_USB_COMMAND_DMAMemWriteArea:
-	case PAPA_SCHLUMPF_USB_COMMAND_SetPCIReset:
-	case PAPA_SCHLUMPF_USB_COMMAND_SetupNetx:
-		iResult = 0;
-		break;
+		ulValue = *g_pul_PCI_DMA_Buffer_Start;
+		tPacket.ulData = ulValue;
+
+		*g_pul_PCI_DMA_Buffer_Start = (ulValue & ~ptCommand->ulMask) | (ptCommand->ulData & ptCommand->ulMask);
+		iResult = pciDma_MemWrite(ptCommand->ulDeviceAddress, g_pul_PCI_DMA_Buffer_Start, 1);
 	}
-	if( iResult!=0 )
+	if( iResult==0 )
 	{
-		/*Unknown command*/
-		tPacketStatus.ulStatus = USB_COMMAND_STATUS_UnknownCommand;
-		usb_send_packet((unsigned char*)(&tPacketStatus), sizeof(tPacketStatus));
+		tPacket.ulStatus = USB_COMMAND_STATUS_Ok;
 	}
 	else
 	{
-		switch(tCommand)
-		{
-		case PAPA_SCHLUMPF_USB_COMMAND_GetFirmwareVersion:
-			execute_command_get_firmware_version();
-			break;
+		tPacket.ulStatus = USB_COMMAND_STATUS_PciTransferFailed;
+		tPacket.ulData = 0;
+	}
+	usb_send_packet((unsigned char*)(&tPacket), sizeof(tPacket));
+}
 
-		case PAPA_SCHLUMPF_USB_COMMAND_ResetPCI:
-			execute_command_reset_pci((PAPA_SCHLUMPF_USB_COMMAND_RESET_PCI_T*)ptCommand);
-			break;
 
-		case PAPA_SCHLUMPF_USB_COMMAND_DMAIoRead:
-			execute_command_dma_io_read((PAPA_SCHLUMPF_USB_COMMAND_DMA_IO_READ_T*)ptCommand);
-			break;
 
-		case PAPA_SCHLUMPF_USB_COMMAND_DMAMemRead:
-			execute_command_dma_mem_read((PAPA_SCHLUMPF_USB_COMMAND_DMA_MEM_READ_T*)ptCommand);
-			break;
+static void execute_command_dma_io_modify(PAPA_SCHLUMPF_USB_COMMAND_DMA_MODIFY_T *ptCommand)
+{
+	int iResult;
+	uint32_t ulValue;
+	PAPA_SCHLUMPF_USB_COMMAND_RESULT_DMA_MODIFY_T tPacket;
 
-		case PAPA_SCHLUMPF_USB_COMMAND_DMAMemReadArea:
-			execute_command_dma_mem_read_area((PAPA_SCHLUMPF_USB_COMMAND_DMA_MEM_READ_AREA_T*)ptCommand);
-			break;
 
-		case PAPA_SCHLUMPF_USB_COMMAND_DMACfg0Read:
-			execute_command_dma_cfg0_read((PAPA_SCHLUMPF_USB_COMMAND_DMA_CFG0_READ_T*)ptCommand);
-			break;
+	iResult = io_register_read_32(ptCommand->ulDeviceAddress, &ulValue);
+	if( iResult==0 )
+	{
+		tPacket.ulData = ulValue;
+		iResult = io_register_write_32(ptCommand->ulDeviceAddress, (ulValue & ~ptCommand->ulMask) | (ptCommand->ulData & ptCommand->ulMask));
+	}
+	if( iResult==0 )
+	{
+		tPacket.ulStatus = USB_COMMAND_STATUS_Ok;
+	}
+	else
+	{
+		tPacket.ulStatus = USB_COMMAND_STATUS_PciTransferFailed;
+		tPacket.ulData = 0;
+	}
+	usb_send_packet((unsigned char*)(&tPacket), sizeof(tPacket));
+}
 
-		case PAPA_SCHLUMPF_USB_COMMAND_DMACfg1Read:
-			execute_command_dma_cfg1_read((PAPA_SCHLUMPF_USB_COMMAND_DMA_CFG1_READ_T*)ptCommand);
-			break;
 
-		case PAPA_SCHLUMPF_USB_COMMAND_DMAIoWrite:
-			execute_command_dma_io_write((PAPA_SCHLUMPF_USB_COMMAND_DMA_IO_WRITE_T*)ptCommand);
-			break;
 
-		case PAPA_SCHLUMPF_USB_COMMAND_DMAMemWrite:
-			execute_command_dma_mem_write((PAPA_SCHLUMPF_USB_COMMAND_DMA_MEM_WRITE_T*)ptCommand);
-			break;
+/* Read one DWORD from any PCI space. The type is a DMATYPE_T value. */
+static uint32_t poll_read(uint32_t ulType, uint32_t ulDeviceAddress, uint32_t *pulData)
+{
+	int iResult;
+	uint32_t ulStatus;
 
-		case PAPA_SCHLUMPF_USB_COMMAND_DMAMemWriteArea:
-			execute_command_dma_mem_write_area((PAPA_SCHLUMPF_USB_COMMAND_DMA_MEM_WRITE_AREA_T*)ptCommand);
-			break;
 
-		case PAPA_SCHLUMPF_USB_COMMAND_DMACfg0Write:
-			execute_command_dma_cfg0_write((PAPA_SCHLUMPF_USB_COMMAND_DMA_CFG0_WRITE_T*)ptCommand);
-			break;
+	ulStatus = USB_COMMAND_STATUS_Ok;
+	switch( ulType )
+	{
+	case DMATYPE_IO:
+		iResult = io_register_read_32(ulDeviceAddress, pulData);
+		break;
 
-		case PAPA_SCHLUMPF_USB_COMMAND_DMACfg1Write:
-			execute_command_dma_cfg1_write((PAPA_SCHLUMPF_USB_COMMAND_DMA_CFG1_WRITE_T*)ptCommand);
-			break;
+	case DMATYPE_Mem:
+		iResult = pciDma_MemRead(ulDeviceAddress, g_pul_PCI_DMA_Buffer_Start, 1);
+		*pulData = *g_pul_PCI_DMA_Buffer_Start;
+		break;
 
-		case PAPA_SCHLUMPF_USB_COMMAND_SetPCIReset:
-			execute_command_set_pci_reset((PAPA_SCHLUMPF_USB_COMMAND_SET_PCI_RESET_T*)ptCommand);
-			break;
+	case DMATYPE_Cfg0:
+		iResult = pciDma_CfgRead(ulDeviceAddress, g_pul_PCI_DMA_Buffer_Start, 1);
+		*pulData = *g_pul_PCI_DMA_Buffer_Start;
+		break;
 
-		case PAPA_SCHLUMPF_USB_COMMAND_SetupNetx:
-			execute_command_setup_netx();
+	case DMATYPE_Cfg1:
+		iResult = pciDma_CfgRead_Type1(ulDeviceAddress, g_pul_PCI_DMA_Buffer_Start, 1);
+		*pulData = *g_pul_PCI_DMA_Buffer_Start;
+		break;
+
+	default:
+		ulStatus = USB_COMMAND_STATUS_UnknownCommand;
+		iResult = 0;
+		break;
+	}
+
+	if( iResult!=0 )
+	{
+		ulStatus = USB_COMMAND_STATUS_PciTransferFailed;
+	}
+
+	return ulStatus;
+}
+
+
+
+static void execute_command_poll_mem(PAPA_SCHLUMPF_USB_COMMAND_POLL_MEM_T *ptCommand)
+{
+	PAPA_SCHLUMPF_USB_COMMAND_RESULT_POLL_MEM_T tPacket;
+	uint32_t ulStatus;
+	uint32_t ulData;
+	uint32_t ulStartUs;
+	uint32_t ulElapsedUs;
+
+
+	tPacket.ulMatched = 0;
+	tPacket.ulData = 0;
+	tPacket.ulIterations = 0;
+	tPacket.ulElapsedUs = 0;
+
+	if( ptCommand->ulTimeoutUs>PAPA_SCHLUMPF_POLL_MAXIMUM_TIMEOUT_US )
+	{
+		ulStatus = USB_COMMAND_STATUS_InvalidSize;
+	}
+	else
+	{
+		ulData = 0;
+		ulStartUs = pciGetTimeUs();
+		do
+		{
+			ulStatus = poll_read(ptCommand->ulType, ptCommand->ulDeviceAddress, &ulData);
+			++tPacket.ulIterations;
+			/* The difference is correct even if the timer wrapped around. */
+			ulElapsedUs = pciGetTimeUs() - ulStartUs;
+			if( ulStatus!=USB_COMMAND_STATUS_Ok )
+			{
+				break;
+			}
+			if( (ulData & ptCommand->ulMask)==ptCommand->ulExpected )
+			{
+				tPacket.ulMatched = 1;
+				break;
+			}
+		} while( ulElapsedUs<ptCommand->ulTimeoutUs );
+
+		tPacket.ulData = ulData;
+		tPacket.ulElapsedUs = ulElapsedUs;
+	}
+
+	tPacket.ulStatus = ulStatus;
+	usb_send_packet((unsigned char*)(&tPacket), sizeof(tPacket));
+}
+
+
+
+/* Read the area in pieces of the DMA buffer size. Only the CRC goes back over USB. */
+static void execute_command_mem_checksum(PAPA_SCHLUMPF_USB_COMMAND_MEM_CHECKSUM_T *ptCommand)
+{
+	int iResult;
+	PAPA_SCHLUMPF_USB_COMMAND_RESULT_MEM_CHECKSUM_T tPacket;
+	unsigned long ulAddress;
+	unsigned long ulSizeLeft;
+	unsigned long ulChunk;
+	unsigned long ulBufferSize;
+	uint32_t ulCrc;
+
+
+	tPacket.ulChecksum = 0;
+
+	if( (ptCommand->ulSize&3U)!=0 )
+	{
+		tPacket.ulStatus = USB_COMMAND_STATUS_InvalidSize;
+	}
+	else
+	{
+		ulBufferSize = (unsigned long)(g_pul_PCI_DMA_Buffer_End - g_pul_PCI_DMA_Buffer_Start) * sizeof(uint32_t);
+
+		ulCrc = 0;
+		ulAddress = ptCommand->ulDeviceAddress;
+		ulSizeLeft = ptCommand->ulSize;
+		iResult = 0;
+		while( ulSizeLeft!=0 )
+		{
+			ulChunk = ulSizeLeft;
+			if( ulChunk>ulBufferSize )
+			{
+				ulChunk = ulBufferSize;
+			}
+
+			iResult = pciDma_MemRead(ulAddress, g_pul_PCI_DMA_Buffer_Start, ulChunk / sizeof(uint32_t));
+			if( iResult!=0 )
+			{
+				break;
+			}
+			ulCrc = papa_schlumpf_crc32(ulCrc, (const unsigned char*)g_pul_PCI_DMA_Buffer_Start, ulChunk);
+
+			ulAddress += ulChunk;
+			ulSizeLeft -= ulChunk;
+		}
+
+		if( iResult==0 )
+		{
+			tPacket.ulStatus = USB_COMMAND_STATUS_Ok;
+			tPacket.ulChecksum = ulCrc;
+		}
+		else
+		{
+			tPacket.ulStatus = USB_COMMAND_STATUS_PciTransferFailed;
+		}
+	}
+	usb_send_packet((unsigned char*)(&tPacket), sizeof(tPacket));
+}
+
+
+
+/* Fill the DMA buffer with whole repetitions of the pattern and swap it
+ * once. Then write it again and again until the area is full.
+ */
+static void execute_command_mem_fill(PAPA_SCHLUMPF_USB_COMMAND_MEM_FILL_T *ptCommand)
+{
+	int iResult;
+	PAPA_SCHLUMPF_USB_COMMAND_RESULT_STATUS_T tPacket;
+	unsigned long ulAddress;
+	unsigned long ulSizeLeftDw;
+	unsigned long ulChunkDw;
+	unsigned long ulBufferDw;
+	unsigned long ulCnt;
+	unsigned long ulPatternDwords;
+
+
+	ulPatternDwords = ptCommand->ulPatternDwords;
+	ulBufferDw = (unsigned long)(g_pul_PCI_DMA_Buffer_End - g_pul_PCI_DMA_Buffer_Start);
+
+	if( (ptCommand->ulSize&3U)!=0 || ulPatternDwords==0 || ulPatternDwords>PAPA_SCHLUMPF_FILL_MAXIMUM_PATTERN_DWORDS )
+	{
+		tPacket.ulStatus = USB_COMMAND_STATUS_InvalidSize;
+	}
+	else
+	{
+		/* Each chunk starts with the first DWORD of the pattern. */
+		ulBufferDw -= ulBufferDw % ulPatternDwords;
+		ulSizeLeftDw = ptCommand->ulSize / sizeof(uint32_t);
+		ulChunkDw = ulSizeLeftDw;
+		if( ulChunkDw>ulBufferDw )
+		{
+			ulChunkDw = ulBufferDw;
+		}
+		for(ulCnt=0; ulCnt<ulChunkDw; ++ulCnt)
+		{
+			g_pul_PCI_DMA_Buffer_Start[ulCnt] = ptCommand->aulPattern[ulCnt % ulPatternDwords];
+		}
+		swapBi0_Bit30_array(g_pul_PCI_DMA_Buffer_Start, ulChunkDw);
+
+		ulAddress = ptCommand->ulDeviceAddress;
+		iResult = 0;
+		while( ulSizeLeftDw!=0 )
+		{
+			ulChunkDw = ulSizeLeftDw;
+			if( ulChunkDw>ulBufferDw )
+			{
+				ulChunkDw = ulBufferDw;
+			}
+
+			iResult = pciDma_MemWriteSwapped(ulAddress, g_pul_PCI_DMA_Buffer_Start, ulChunkDw);
+			if( iResult!=0 )
+			{
+				break;
+			}
+
+			ulAddress += ulChunkDw * sizeof(uint32_t);
+			ulSizeLeftDw -= ulChunkDw;
+		}
+
+		if( iResult==0 )
+		{
+			tPacket.ulStatus = USB_COMMAND_STATUS_Ok;
+		}
+		else
+		{
+			tPacket.ulStatus = USB_COMMAND_STATUS_PciTransferFailed;
+		}
+	}
+	usb_send_packet((unsigned char*)(&tPacket), sizeof(tPacket));
+}
+
+
+
+/* Copy the area in chunks of the DMA buffer size. The data is not swapped,
+ * it goes back to the bus in the same form as it came in.
+ * If the destination starts inside the source, the chunks are copied from
+ * the end of the area to the start.
+ */
+static void execute_command_mem_copy(PAPA_SCHLUMPF_USB_COMMAND_MEM_COPY_T *ptCommand)
+{
+	int iResult;
+	PAPA_SCHLUMPF_USB_COMMAND_RESULT_STATUS_T tPacket;
+	unsigned long ulDstAddress;
+	unsigned long ulSrcAddress;
+	unsigned long ulSizeLeft;
+	unsigned long ulChunk;
+	unsigned long ulBufferSize;
+	int iBackwards;
+
+
+	if( (ptCommand->ulSize&3U)!=0 )
+	{
+		tPacket.ulStatus = USB_COMMAND_STATUS_InvalidSize;
+	}
+	else
+	{
+		ulBufferSize = (unsigned long)(g_pul_PCI_DMA_Buffer_End - g_pul_PCI_DMA_Buffer_Start) * sizeof(uint32_t);
+
+		ulDstAddress = ptCommand->ulDestinationAddress;
+		ulSrcAddress = ptCommand->ulSourceAddress;
+		ulSizeLeft = ptCommand->ulSize;
+		iBackwards = (ulDstAddress>ulSrcAddress && (ulDstAddress-ulSrcAddress)<ulSizeLeft);
+		if( iBackwards!=0 )
+		{
+			ulDstAddress += ulSizeLeft;
+			ulSrcAddress += ulSizeLeft;
+		}
+
+		iResult = 0;
+		while( ulSizeLeft!=0 )
+		{
+			ulChunk = ulSizeLeft;
+			if( ulChunk>ulBufferSize )
+			{
+				ulChunk = ulBufferSize;
+			}
+
+			if( iBackwards!=0 )
+			{
+				ulDstAddress -= ulChunk;
+				ulSrcAddress -= ulChunk;
+			}
+
+			iResult = pciDma_MemReadSwapped(ulSrcAddress, g_pul_PCI_DMA_Buffer_Start, ulChunk / sizeof(uint32_t));
+			if( iResult!=0 )
+			{
+				break;
+			}
+			iResult = pciDma_MemWriteSwapped(ulDstAddress, g_pul_PCI_DMA_Buffer_Start, ulChunk / sizeof(uint32_t));
+			if( iResult!=0 )
+			{
+				break;
+			}
+
+			if( iBackwards==0 )
+			{
+				ulDstAddress += ulChunk;
+				ulSrcAddress += ulChunk;
+			}
+			ulSizeLeft -= ulChunk;
+		}
+
+		if( iResult==0 )
+		{
+			tPacket.ulStatus = USB_COMMAND_STATUS_Ok;
+		}
+		else
+		{
+			tPacket.ulStatus = USB_COMMAND_STATUS_PciTransferFailed;
+		}
+	}
+	usb_send_packet((unsigned char*)(&tPacket), sizeof(tPacket));
+}
+
+
+
+/* Get the number of data DWORDs of all areas in a scatter command.
+ * Return 0 if the command is invalid or the data exceeds ulMaximumDwords.
+ */
+static unsigned long scatter_get_dwords(const PAPA_SCHLUMPF_USB_COMMAND_SCATTER_T *ptCommand, unsigned long ulMaximumDwords)
+{
+	const PAPA_SCHLUMPF_SCATTER_DESCRIPTOR_T *ptDescriptors;
+	unsigned long ulDescriptors;
+	unsigned long ulCnt;
+	unsigned long ulDwords;
+	unsigned long ulBufferDw;
+
+
+	ulDwords = 0;
+	ulDescriptors = ptCommand->ulDescriptors;
+	ulBufferDw = (unsigned long)(g_pul_PCI_DMA_Buffer_End - g_pul_PCI_DMA_Buffer_Start);
+	if( ulMaximumDwords>ulBufferDw )
+	{
+		ulMaximumDwords = ulBufferDw;
+	}
+
+	if( ulDescriptors!=0 && ulDescriptors<=PAPA_SCHLUMPF_SCATTER_MAXIMUM_DESCRIPTORS )
+	{
+		ptDescriptors = (const PAPA_SCHLUMPF_SCATTER_DESCRIPTOR_T*)ptCommand->aulData;
+		for(ulCnt=0; ulCnt<ulDescriptors; ++ulCnt)
+		{
+			if( ptDescriptors[ulCnt].ulDwords>ulMaximumDwords-ulDwords )
+			{
+				ulDwords = 0;
+				break;
+			}
+			ulDwords += ptDescriptors[ulCnt].ulDwords;
+		}
+	}
+
+	return ulDwords;
+}
+
+
+
+/* Gather all areas in the DMA buffer and swap them at once. */
+static PAPA_SCHLUMPF_USB_COMMAND_RESULT_MEM_READ_SCATTER_T tReadScatterResponse;
+static void execute_command_mem_read_scatter(PAPA_SCHLUMPF_USB_COMMAND_SCATTER_T *ptCommand)
+{
+	int iResult;
+	const PAPA_SCHLUMPF_SCATTER_DESCRIPTOR_T *ptDescriptors;
+	unsigned long ulDwords;
+	unsigned long ulOffset;
+	unsigned long ulCnt;
+	size_t sizUsbPacket;
+
+
+	sizUsbPacket = sizeof(uint32_t);
+	ulDwords = scatter_get_dwords(ptCommand, PAPA_SCHLUMPF_SCATTER_READ_MAXIMUM_DWORDS);
+	if( ulDwords==0 )
+	{
+		tReadScatterResponse.ulStatus = USB_COMMAND_STATUS_InvalidSize;
+	}
+	else
+	{
+		ptDescriptors = (const PAPA_SCHLUMPF_SCATTER_DESCRIPTOR_T*)ptCommand->aulData;
+		iResult = 0;
+		ulOffset = 0;
+		for(ulCnt=0; ulCnt<ptCommand->ulDescriptors; ++ulCnt)
+		{
+			if( ptDescriptors[ulCnt].ulDwords!=0 )
+			{
+				iResult = pciDma_MemReadSwapped(ptDescriptors[ulCnt].ulDeviceAddress, g_pul_PCI_DMA_Buffer_Start + ulOffset, ptDescriptors[ulCnt].ulDwords);
+				if( iResult!=0 )
+				{
+					break;
+				}
+				ulOffset += ptDescriptors[ulCnt].ulDwords;
+			}
+		}
+
+		if( iResult==0 )
+		{
+			swapBi0_Bit30_array(g_pul_PCI_DMA_Buffer_Start, ulDwords);
+			tReadScatterResponse.ulStatus = USB_COMMAND_STATUS_Ok;
+			memcpy(tReadScatterResponse.aulData, (const void*)g_pul_PCI_DMA_Buffer_Start, ulDwords * sizeof(uint32_t));
+			sizUsbPacket += ulDwords * sizeof(uint32_t);
+		}
+		else
+		{
+			tReadScatterResponse.ulStatus = USB_COMMAND_STATUS_PciTransferFailed;
+		}
+	}
+	usb_send_packet((unsigned char*)(&tReadScatterResponse), sizUsbPacket);
+}
+
+
+
+/* Copy the data of all areas to the DMA buffer and swap it at once. */
+static void execute_command_mem_write_scatter(PAPA_SCHLUMPF_USB_COMMAND_SCATTER_T *ptCommand)
+{
+	int iResult;
+	PAPA_SCHLUMPF_USB_COMMAND_RESULT_STATUS_T tPacket;
+	const PAPA_SCHLUMPF_SCATTER_DESCRIPTOR_T *ptDescriptors;
+	unsigned long ulDescriptorDwords;
+	unsigned long ulDwords;
+	unsigned long ulOffset;
+	unsigned long ulCnt;
+
+
+	ulDwords = 0;
+	ulDescriptorDwords = 0;
+	if( ptCommand->ulDescriptors<=PAPA_SCHLUMPF_SCATTER_MAXIMUM_DESCRIPTORS )
+	{
+		ulDescriptorDwords = ptCommand->ulDescriptors * (sizeof(PAPA_SCHLUMPF_SCATTER_DESCRIPTOR_T) / sizeof(uint32_t));
+		ulDwords = scatter_get_dwords(ptCommand, PAPA_SCHLUMPF_SCATTER_COMMAND_DWORDS - ulDescriptorDwords);
+	}
+	if( ulDwords==0 )
+	{
+		tPacket.ulStatus = USB_COMMAND_STATUS_InvalidSize;
+	}
+	else
+	{
+		memcpy((void*)g_pul_PCI_DMA_Buffer_Start, ptCommand->aulData + ulDescriptorDwords, ulDwords * sizeof(uint32_t));
+		swapBi0_Bit30_array(g_pul_PCI_DMA_Buffer_Start, ulDwords);
+
+		ptDescriptors = (const PAPA_SCHLUMPF_SCATTER_DESCRIPTOR_T*)ptCommand->aulData;
+		iResult = 0;
+		ulOffset = 0;
+		for(ulCnt=0; ulCnt<ptCommand->ulDescriptors; ++ulCnt)
+		{
+			if( ptDescriptors[ulCnt].ulDwords!=0 )
+			{
+				iResult = pciDma_MemWriteSwapped(ptDescriptors[ulCnt].ulDeviceAddress, g_pul_PCI_DMA_Buffer_Start + ulOffset, ptDescriptors[ulCnt].ulDwords);
+				if( iResult!=0 )
+				{
+					break;
+				}
+				ulOffset += ptDescriptors[ulCnt].ulDwords;
+			}
+		}
+
+		if( iResult==0 )
+		{
+			tPacket.ulStatus = USB_COMMAND_STATUS_Ok;
+		}
+		else
+		{
+			tPacket.ulStatus = USB_COMMAND_STATUS_PciTransferFailed;
+		}
+	}
+	usb_send_packet((unsigned char*)(&tPacket), sizeof(tPacket));
+}
+
+
+
+/* The local bus has one IDSEL line for each address bit from 16 to 28. */
+#define ENUMERATE_LOCAL_DEVICES 13
+#define ENUMERATE_DEVICES 32
+#define ENUMERATE_FUNCTIONS 8
+#define ENUMERATE_BUSES 256
+#define ENUMERATE_HEADER_DWORDS 16
+
+static PAPA_SCHLUMPF_USB_COMMAND_RESULT_ENUMERATE_BUS_T tEnumerateResponse;
+
+/* Access the configuration space. Bus 0 is the local bus with type 0 accesses. */
+static int enumerate_cfg_read(uint32_t ulBus, uint32_t ulAddress, unsigned int uDwords)
+{
+	int iResult;
+
+
+	if( ulBus==0 )
+	{
+		iResult = pciDma_CfgRead(ulAddress, g_pul_PCI_DMA_Buffer_Start, uDwords);
+	}
+	else
+	{
+		iResult = pciDma_CfgRead_Type1(ulAddress, g_pul_PCI_DMA_Buffer_Start, uDwords);
+	}
+
+	return iResult;
+}
+
+
+
+static int enumerate_cfg_write(uint32_t ulBus, uint32_t ulAddress, uint32_t ulData)
+{
+	int iResult;
+
+
+	*g_pul_PCI_DMA_Buffer_Start = ulData;
+	if( ulBus==0 )
+	{
+		iResult = pciDma_CfgWrite(ulAddress, g_pul_PCI_DMA_Buffer_Start, 1);
+	}
+	else
+	{
+		iResult = pciDma_CfgWrite_Type1(ulAddress, g_pul_PCI_DMA_Buffer_Start, 1);
+	}
+
+	return iResult;
+}
+
+
+
+/* Write all ones to the BARs and read them back. Disable the decoders
+ * while the BARs do not have their real values.
+ */
+static void enumerate_size_bars(uint32_t ulBus, uint32_t ulAddress, uint32_t ulStatusCommand, unsigned int uiBars, uint32_t *pulBarMask)
+{
+	int iResult;
+	unsigned int uiCnt;
+	uint32_t ulBarAddress;
+	uint32_t ulBar;
+
+
+	/* The status bits are cleared by writing 1. Write 0 to keep them. */
+	iResult = enumerate_cfg_write(ulBus, ulAddress + 0x04U, ulStatusCommand & 0x0000fffcU);
+	if( iResult==0 )
+	{
+		for(uiCnt=0; uiCnt<uiBars; ++uiCnt)
+		{
+			ulBarAddress = ulAddress + 0x10U + uiCnt * sizeof(uint32_t);
+			iResult = enumerate_cfg_read(ulBus, ulBarAddress, 1);
+			if( iResult==0 )
+			{
+				ulBar = *g_pul_PCI_DMA_Buffer_Start;
+				iResult = enumerate_cfg_write(ulBus, ulBarAddress, 0xffffffffU);
+				if( iResult==0 )
+				{
+					iResult = enumerate_cfg_read(ulBus, ulBarAddress, 1);
+					if( iResult==0 )
+					{
+						pulBarMask[uiCnt] = *g_pul_PCI_DMA_Buffer_Start;
+					}
+				}
+				enumerate_cfg_write(ulBus, ulBarAddress, ulBar);
+			}
+		}
+		enumerate_cfg_write(ulBus, ulAddress + 0x04U, ulStatusCommand & 0x0000ffffU);
+	}
+}
+
+
+
+/* Read the header of one function and add it to the response.
+ * Return 0 if there is no function at the address. Otherwise return 1 and
+ * the header type. pulSecondaryBus is the secondary bus of a bridge and 0
+ * for all other functions.
+ */
+static int enumerate_function(uint32_t ulBus, uint32_t ulDevice, uint32_t ulFunction, uint32_t ulAddress, uint32_t ulFlags, uint32_t *pulHeaderType, uint32_t *pulSecondaryBus)
+{
+	int iResult;
+	int iFound;
+	uint32_t aulHeader[ENUMERATE_HEADER_DWORDS];
+	PAPA_SCHLUMPF_ENUMERATE_FUNCTION_T *ptFunction;
+	PAPA_SCHLUMPF_ENUMERATE_FUNCTION_T tDummy;
+	uint32_t ulHeaderType;
+	unsigned int uiBars;
+
+
+	iFound = 0;
+
+	/* An empty slot does not answer or returns a vendor ID of 0xffff. */
+	iResult = enumerate_cfg_read(ulBus, ulAddress, 1);
+	if( iResult==0 && (*g_pul_PCI_DMA_Buffer_Start&0x0000ffffU)!=0x0000ffffU && *g_pul_PCI_DMA_Buffer_Start!=0 )
+	{
+		iResult = enumerate_cfg_read(ulBus, ulAddress, ENUMERATE_HEADER_DWORDS);
+		if( iResult==0 )
+		{
+			memcpy(aulHeader, (const void*)g_pul_PCI_DMA_Buffer_Start, sizeof(aulHeader));
+			iFound = 1;
+
+			/* Keep walking the bridges if the response is full. */
+			if( tEnumerateResponse.ulFunctions<PAPA_SCHLUMPF_ENUMERATE_MAXIMUM_FUNCTIONS )
+			{
+				ptFunction = tEnumerateResponse.atFunctions + tEnumerateResponse.ulFunctions;
+				++tEnumerateResponse.ulFunctions;
+			}
+			else
+			{
+				ptFunction = &tDummy;
+				tEnumerateResponse.ulTruncated = 1;
+			}
+
+			ulHeaderType = (aulHeader[3] >> 16U) & 0xffU;
+			memset(ptFunction, 0, sizeof(PAPA_SCHLUMPF_ENUMERATE_FUNCTION_T));
+			ptFunction->ulAddress = ulAddress;
+			ptFunction->ucBus = (uint8_t)ulBus;
+			ptFunction->ucDevice = (uint8_t)ulDevice;
+			ptFunction->ucFunction = (uint8_t)ulFunction;
+			ptFunction->ucHeaderType = (uint8_t)ulHeaderType;
+			ptFunction->ulVidPid = aulHeader[0];
+			ptFunction->ulClassRev = aulHeader[2];
+
+			/* Only the header types 0 and 1 have BARs. */
+			*pulSecondaryBus = 0;
+			uiBars = 0;
+			if( (ulHeaderType&0x7fU)==0 )
+			{
+				uiBars = 6;
+			}
+			else if( (ulHeaderType&0x7fU)==1 )
+			{
+				uiBars = 2;
+				ptFunction->ulBusNumbers = aulHeader[6];
+				*pulSecondaryBus = (aulHeader[6] >> 8U) & 0xffU;
+			}
+			if( (ulFlags&PAPA_SCHLUMPF_ENUMERATE_FLAG_SizeBars)!=0 && uiBars!=0 )
+			{
+				enumerate_size_bars(ulBus, ulAddress, aulHeader[1], uiBars, ptFunction->aulBarMask);
+			}
+
+			*pulHeaderType = ulHeaderType;
+		}
+	}
+
+	return iFound;
+}
+
+
+
+static void execute_command_enumerate_bus(PAPA_SCHLUMPF_USB_COMMAND_ENUMERATE_BUS_T *ptCommand)
+{
+	uint8_t aucBusQueue[ENUMERATE_BUSES];
+	uint32_t aulBusSeen[ENUMERATE_BUSES / 32];
+	unsigned int uiQueueRead;
+	unsigned int uiQueueWrite;
+	uint32_t ulBus;
+	uint32_t ulDevice;
+	uint32_t ulDevices;
+	uint32_t ulFunction;
+	uint32_t ulAddress;
+	uint32_t ulHeaderType;
+	uint32_t ulSecondaryBus;
+	int iFound;
+	size_t sizUsbPacket;
+
+
+	tEnumerateResponse.ulTruncated = 0;
+	tEnumerateResponse.ulFunctions = 0;
+	memset(aulBusSeen, 0, sizeof(aulBusSeen));
+
+	/* Start with the local bus. Each bridge adds its secondary bus once. */
+	aucBusQueue[0] = 0;
+	aulBusSeen[0] = 1;
+	uiQueueRead = 0;
+	uiQueueWrite = 1;
+	while( uiQueueRead<uiQueueWrite )
+	{
+		ulBus = aucBusQueue[uiQueueRead];
+		++uiQueueRead;
+
+		ulDevices = (ulBus==0) ? ENUMERATE_LOCAL_DEVICES : ENUMERATE_DEVICES;
+		for(ulDevice=0; ulDevice<ulDevices; ++ulDevice)
+		{
+			for(ulFunction=0; ulFunction<ENUMERATE_FUNCTIONS; ++ulFunction)
+			{
+				if( ulBus==0 )
+				{
+					ulAddress = (0x00010000U << ulDevice) | (ulFunction << SRT_PCI_CONFIGURATION_ADDRESS_FUNCTION);
+				}
+				else
+				{
+					ulAddress = CFG1ADR(ulBus, ulDevice, ulFunction, 0U);
+				}
+
+				iFound = enumerate_function(ulBus, ulDevice, ulFunction, ulAddress, ptCommand->ulFlags, &ulHeaderType, &ulSecondaryBus);
+				if( iFound==0 )
+				{
+					/* Function 0 must exist on all devices. */
+					if( ulFunction==0 )
+					{
+						break;
+					}
+				}
+				else
+				{
+					if( ulSecondaryBus!=0 && (aulBusSeen[ulSecondaryBus/32]&(1U<<(ulSecondaryBus&31)))==0 )
+					{
+						aulBusSeen[ulSecondaryBus/32] |= 1U << (ulSecondaryBus & 31);
+						aucBusQueue[uiQueueWrite] = (uint8_t)ulSecondaryBus;
+						++uiQueueWrite;
+					}
+
+					/* Look for more functions only on multi function devices. */
+					if( ulFunction==0 && (ulHeaderType&0x80U)==0 )
+					{
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	tEnumerateResponse.ulStatus = USB_COMMAND_STATUS_Ok;
+	sizUsbPacket = sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint32_t) + tEnumerateResponse.ulFunctions * sizeof(PAPA_SCHLUMPF_ENUMERATE_FUNCTION_T);
+	usb_send_packet((unsigned char*)(&tEnumerateResponse), sizUsbPacket);
+}
+
+
+
+static uint32_t batch_execute_entry(const PAPA_SCHLUMPF_BATCH_ENTRY_T *ptEntry, uint32_t *pulData)
+{
+	int iResult;
+	uint32_t ulStatus;
+	uint32_t ulData;
+
+
+	ulStatus = USB_COMMAND_STATUS_Ok;
+	ulData = 0;
+	switch( ptEntry->ulOperation )
+	{
+	case PAPA_SCHLUMPF_BATCH_OPERATION_IoRead:
+		iResult = io_register_read_32(ptEntry->ulDeviceAddress, &ulData);
+		break;
+
+	case PAPA_SCHLUMPF_BATCH_OPERATION_MemRead:
+		iResult = pciDma_MemRead(ptEntry->ulDeviceAddress, g_pul_PCI_DMA_Buffer_Start, 1);
+		ulData = *g_pul_PCI_DMA_Buffer_Start;
+		break;
+
+	case PAPA_SCHLUMPF_BATCH_OPERATION_Cfg0Read:
+		iResult = pciDma_CfgRead(ptEntry->ulDeviceAddress, g_pul_PCI_DMA_Buffer_Start, 1);
+		ulData = *g_pul_PCI_DMA_Buffer_Start;
+		break;
+
+	case PAPA_SCHLUMPF_BATCH_OPERATION_Cfg1Read:
+		iResult = pciDma_CfgRead_Type1(ptEntry->ulDeviceAddress, g_pul_PCI_DMA_Buffer_Start, 1);
+		ulData = *g_pul_PCI_DMA_Buffer_Start;
+		break;
+
+	case PAPA_SCHLUMPF_BATCH_OPERATION_IoWrite:
+		iResult = io_register_write_32(ptEntry->ulDeviceAddress, ptEntry->ulData);
+		break;
+
+	case PAPA_SCHLUMPF_BATCH_OPERATION_MemWrite:
+		*g_pul_PCI_DMA_Buffer_Start = ptEntry->ulData;
+		iResult = pciDma_MemWrite(ptEntry->ulDeviceAddress, g_pul_PCI_DMA_Buffer_Start, 1);
+		break;
+
+	case PAPA_SCHLUMPF_BATCH_OPERATION_Cfg0Write:
+		*g_pul_PCI_DMA_Buffer_Start = ptEntry->ulData;
+		iResult = pciDma_CfgWrite(ptEntry->ulDeviceAddress, g_pul_PCI_DMA_Buffer_Start, 1);
+		break;
+
+	case PAPA_SCHLUMPF_BATCH_OPERATION_Cfg1Write:
+		*g_pul_PCI_DMA_Buffer_Start = ptEntry->ulData;
+		iResult = pciDma_CfgWrite_Type1(ptEntry->ulDeviceAddress, g_pul_PCI_DMA_Buffer_Start, 1);
+		break;
+
+	default:
+		ulStatus = USB_COMMAND_STATUS_UnknownCommand;
+		iResult = 0;
+		break;
+	}
+
+	if( iResult!=0 )
+	{
+		ulStatus = USB_COMMAND_STATUS_PciTransferFailed;
+		ulData = 0;
+	}
+	*pulData = (uint32_t)ulData;
+
+	return ulStatus;
+}
+
+
+
+static PAPA_SCHLUMPF_USB_COMMAND_RESULT_BATCH_T tBatchResponse;
+static void execute_command_batch(PAPA_SCHLUMPF_USB_COMMAND_BATCH_T *ptCommand)
+{
+	unsigned long ulEntries;
+	unsigned long ulCnt;
+	uint32_t ulStatus;
+	size_t sizUsbPacket;
+
+
+	ulEntries = ptCommand->ulEntries;
+	if( ulEntries==0 || ulEntries>PAPA_SCHLUMPF_BATCH_MAXIMUM_ENTRIES )
+	{
+		tBatchResponse.ulStatus = USB_COMMAND_STATUS_InvalidSize;
+		tBatchResponse.ulEntries = 0;
+		ulCnt = 0;
+	}
+	else
+	{
+		tBatchResponse.ulStatus = USB_COMMAND_STATUS_Ok;
+
+		/* Run all entries in order. Stop at the first failed entry. */
+		for(ulCnt=0; ulCnt<ulEntries; ++ulCnt)
+		{
+			ulStatus = batch_execute_entry(ptCommand->atEntries + ulCnt, &(tBatchResponse.atResults[ulCnt].ulData));
+			tBatchResponse.atResults[ulCnt].ulStatus = ulStatus;
+			if( ulStatus!=USB_COMMAND_STATUS_Ok )
+			{
+				++ulCnt;
+				break;
+			}
+		}
+		tBatchResponse.ulEntries = ulCnt;
+	}
+
+	sizUsbPacket = sizeof(uint32_t) + sizeof(uint32_t) + ulCnt * sizeof(PAPA_SCHLUMPF_BATCH_RESULT_T);
+	usb_send_packet((unsigned char*)(&tBatchResponse), sizUsbPacket);
+}
+
+
+
+/* This is one stored DMA list program. A program with 0 entries is a free slot. */
+typedef struct DMALIST_PROGRAM_STRUCT
+{
+	unsigned int sizEntries;
+	uint32_t ulHash;
+	DMALIST_T atEntries[PAPA_SCHLUMPF_DMALIST_MAXIMUM_ENTRIES];
+} DMALIST_PROGRAM_T;
+
+static DMALIST_PROGRAM_T atDmaListPrograms[PAPA_SCHLUMPF_DMALIST_MAXIMUM_PROGRAMS];
+static unsigned int uiDmaListNextReplace;
+
+
+
+/* Build a FNV-1a hash over all fields of a DMA list. */
+static uint32_t dmalist_hash(const PAPA_SCHLUMPF_DMALIST_ENTRY_T *ptEntries, unsigned int sizEntries)
+{
+	const unsigned char *pucCnt;
+	const unsigned char *pucEnd;
+	uint32_t ulHash;
+
+
+	ulHash = 2166136261U;
+	pucCnt = (const unsigned char*)ptEntries;
+	pucEnd = pucCnt + sizEntries * sizeof(PAPA_SCHLUMPF_DMALIST_ENTRY_T);
+	while( pucCnt<pucEnd )
+	{
+		ulHash ^= *(pucCnt++);
+		ulHash *= 16777619U;
+	}
+
+	return ulHash;
+}
+
+
+
+static int dmalist_program_is_equal(const DMALIST_PROGRAM_T *ptProgram, const PAPA_SCHLUMPF_DMALIST_ENTRY_T *ptEntries, unsigned int sizEntries, uint32_t ulHash)
+{
+	int iIsEqual;
+	unsigned int uiCnt;
+	const DMALIST_T *ptEntry;
+
+
+	iIsEqual = 0;
+	if( ptProgram->sizEntries==sizEntries && ptProgram->ulHash==ulHash )
+	{
+		iIsEqual = 1;
+		for(uiCnt=0; uiCnt<sizEntries; ++uiCnt)
+		{
+			ptEntry = ptProgram->atEntries + uiCnt;
+			if( (uint32_t)ptEntry->tAct!=ptEntries[uiCnt].ulAction || (uint32_t)ptEntry->tTyp!=ptEntries[uiCnt].ulType || ptEntry->ulAddress!=ptEntries[uiCnt].ulAddress || ptEntry->ulData!=ptEntries[uiCnt].ulData )
+			{
+				iIsEqual = 0;
+				break;
+			}
+		}
+	}
+
+	return iIsEqual;
+}
+
+
+
+static void execute_command_dmalist_upload(PAPA_SCHLUMPF_USB_COMMAND_DMALIST_UPLOAD_T *ptCommand)
+{
+	PAPA_SCHLUMPF_USB_COMMAND_RESULT_DMALIST_UPLOAD_T tPacket;
+	unsigned int sizEntries;
+	unsigned int uiCnt;
+	unsigned int uiProgramId;
+	uint32_t ulHash;
+	DMALIST_PROGRAM_T *ptProgram;
+	DMALIST_T *ptEntry;
+
+
+	tPacket.ulProgramId = 0;
+	tPacket.ulProgramHash = 0;
+
+	sizEntries = ptCommand->ulEntries;
+	if( sizEntries==0 || sizEntries>PAPA_SCHLUMPF_DMALIST_MAXIMUM_ENTRIES )
+	{
+		tPacket.ulStatus = USB_COMMAND_STATUS_InvalidSize;
+	}
+	else
+	{
+		ulHash = dmalist_hash(ptCommand->atEntries, sizEntries);
+
+		/* Is the program already stored? */
+		uiProgramId = PAPA_SCHLUMPF_DMALIST_MAXIMUM_PROGRAMS;
+		for(uiCnt=0; uiCnt<PAPA_SCHLUMPF_DMALIST_MAXIMUM_PROGRAMS; ++uiCnt)
+		{
+			if( dmalist_program_is_equal(atDmaListPrograms + uiCnt, ptCommand->atEntries, sizEntries, ulHash)!=0 )
+			{
+				uiProgramId = uiCnt;
+				break;
+			}
+		}
+
+		if( uiProgramId==PAPA_SCHLUMPF_DMALIST_MAXIMUM_PROGRAMS )
+		{
+			/* Use the first free slot or replace the oldest upload. */
+			for(uiCnt=0; uiCnt<PAPA_SCHLUMPF_DMALIST_MAXIMUM_PROGRAMS; ++uiCnt)
+			{
+				if( atDmaListPrograms[uiCnt].sizEntries==0 )
+				{
+					uiProgramId = uiCnt;
+					break;
+				}
+			}
+			if( uiProgramId==PAPA_SCHLUMPF_DMALIST_MAXIMUM_PROGRAMS )
+			{
+				uiProgramId = uiDmaListNextReplace;
+				uiDmaListNextReplace = (uiDmaListNextReplace + 1U) % PAPA_SCHLUMPF_DMALIST_MAXIMUM_PROGRAMS;
+			}
+
+			ptProgram = atDmaListPrograms + uiProgramId;
+			for(uiCnt=0; uiCnt<sizEntries; ++uiCnt)
+			{
+				ptEntry = ptProgram->atEntries + uiCnt;
+				ptEntry->tAct = (DMAACTION_T)ptCommand->atEntries[uiCnt].ulAction;
+				ptEntry->tTyp = (DMATYPE_T)ptCommand->atEntries[uiCnt].ulType;
+				ptEntry->ulAddress = ptCommand->atEntries[uiCnt].ulAddress;
+				ptEntry->ulData = ptCommand->atEntries[uiCnt].ulData;
+			}
+			ptProgram->sizEntries = sizEntries;
+			ptProgram->ulHash = ulHash;
+		}
+
+		tPacket.ulStatus = USB_COMMAND_STATUS_Ok;
+		tPacket.ulProgramId = uiProgramId;
+		tPacket.ulProgramHash = ulHash;
+	}
+
+	usb_send_packet((unsigned char*)(&tPacket), sizeof(tPacket));
+}
+
+
+
+static PAPA_SCHLUMPF_USB_COMMAND_RESULT_DMALIST_RUN_T tDmaListRunResponse;
+static unsigned long aulDmaListDump[PAPA_SCHLUMPF_DMALIST_MAXIMUM_ENTRIES];
+static void execute_command_dmalist_run(PAPA_SCHLUMPF_USB_COMMAND_DMALIST_RUN_T *ptCommand)
+{
+	const DMALIST_PROGRAM_T *ptProgram;
+	DMALIST_RESULT_T tResult;
+	unsigned int uiCnt;
+	size_t sizUsbPacket;
+
+
+	tDmaListRunResponse.ulFailure = PAPA_SCHLUMPF_DMALIST_FAILURE_None;
+	tDmaListRunResponse.ulFailedIndex = 0;
+	tDmaListRunResponse.ulFailedValue = 0;
+	tDmaListRunResponse.ulDumpCount = 0;
+
+	if( ptCommand->ulProgramId>=PAPA_SCHLUMPF_DMALIST_MAXIMUM_PROGRAMS )
+	{
+		tDmaListRunResponse.ulStatus = USB_COMMAND_STATUS_UnknownProgram;
+	}
+	else
+	{
+		ptProgram = atDmaListPrograms + ptCommand->ulProgramId;
+		if( ptProgram->sizEntries==0 || ptProgram->ulHash!=ptCommand->ulProgramHash )
+		{
+			tDmaListRunResponse.ulStatus = USB_COMMAND_STATUS_UnknownProgram;
+		}
+		else
+		{
+			tResult.pulDump = aulDmaListDump;
+			tResult.sizDumpMax = PAPA_SCHLUMPF_DMALIST_MAXIMUM_ENTRIES;
+
+			/* Run the program without any messages. The result has all details. */
+			dmalist_process(ptProgram->atEntries, ptProgram->sizEntries, NULL, &tResult);
+
+			tDmaListRunResponse.ulStatus = USB_COMMAND_STATUS_Ok;
+			tDmaListRunResponse.ulFailure = (uint32_t)tResult.tFailure;
+			tDmaListRunResponse.ulFailedIndex = tResult.uiFailedIndex;
+			tDmaListRunResponse.ulFailedValue = tResult.ulFailedValue;
+			tDmaListRunResponse.ulDumpCount = tResult.sizDump;
+			for(uiCnt=0; uiCnt<tResult.sizDump; ++uiCnt)
+			{
+				tDmaListRunResponse.aulDump[uiCnt] = (uint32_t)aulDmaListDump[uiCnt];
+			}
+		}
+	}
+
+	sizUsbPacket = sizeof(tDmaListRunResponse) - sizeof(tDmaListRunResponse.aulDump) + tDmaListRunResponse.ulDumpCount * sizeof(uint32_t);
+	usb_send_packet((unsigned char*)(&tDmaListRunResponse), sizUsbPacket);
+}
+
+
+
+void execute_command(PAPA_SCHLUMPF_USB_COMMAND_T *ptCommand)
+{
+	PAPA_SCHLUMPF_USB_COMMANDS_T tCommand;
+	int iResult;
+	PAPA_SCHLUMPF_USB_COMMAND_RESULT_STATUS_T tPacketStatus;
+
+
+	/* Any command ends a running stream. */
+	mem_read_stream_stop();
+
+	tCommand = ptCommand->ulCommand;
+	iResult = -1;
+	switch(tCommand)
+	{
+	case PAPA_SCHLUMPF_USB_COMMAND_GetFirmwareVersion:
+	case PAPA_SCHLUMPF_USB_COMMAND_ResetPCI:
+	case PAPA_SCHLUMPF_USB_COMMAND_DMAIoRead:
+	case PAPA_SCHLUMPF_USB_COMMAND_DMAMemRead:
+	case PAPA_SCHLUMPF_USB_COMMAND_DMACfg0Read:
+	case PAPA_SCHLUMPF_USB_COMMAND_DMACfg1Read:
+	case PAPA_SCHLUMPF_USB_COMMAND_DMAIoWrite:
+	case PAPA_SCHLUMPF_USB_COMMAND_DMAMemWrite:
+	case PAPA_SCHLUMPF_USB_COMMAND_DMACfg0Write:
+	case PAPA_SCHLUMPF_USB_COMMAND_DMACfg1Write:
+	case PAPA_SCHLUMPF_USB_COMMAND_DMAMemReadArea:
+	case PAPA_SCHLUMPF_USB_COMMAND_DMAMemWriteArea:
+	case PAPA_SCHLUMPF_USB_COMMAND_SetPCIReset:
+	case PAPA_SCHLUMPF_USB_COMMAND_SetupNetx:
+	case PAPA_SCHLUMPF_USB_COMMAND_Batch:
+	case PAPA_SCHLUMPF_USB_COMMAND_DmaListUpload:
+	case PAPA_SCHLUMPF_USB_COMMAND_DmaListRun:
+	case PAPA_SCHLUMPF_USB_COMMAND_DMAMemModify:
+	case PAPA_SCHLUMPF_USB_COMMAND_DMAIoModify:
+	case PAPA_SCHLUMPF_USB_COMMAND_PollMem:
+	case PAPA_SCHLUMPF_USB_COMMAND_MemChecksum:
+	case PAPA_SCHLUMPF_USB_COMMAND_MemFill:
+	case PAPA_SCHLUMPF_USB_COMMAND_MemCopy:
+	case PAPA_SCHLUMPF_USB_COMMAND_MemReadScatter:
+	case PAPA_SCHLUMPF_USB_COMMAND_MemWriteScatter:
+	case PAPA_SCHLUMPF_USB_COMMAND_DMACfg0ReadArea:
+	case PAPA_SCHLUMPF_USB_COMMAND_DMACfg1ReadArea:
+	case PAPA_SCHLUMPF_USB_COMMAND_EnumerateBus:
+	case PAPA_SCHLUMPF_USB_COMMAND_MemReadStream:
+	case PAPA_SCHLUMPF_USB_COMMAND_MemReadStreamAbort:
+		iResult = 0;
+		break;
+	}
+	if( iResult!=0 )
+	{
+		/*Unknown command*/
+		tPacketStatus.ulStatus = USB_COMMAND_STATUS_UnknownCommand;
+		usb_send_packet((unsigned char*)(&tPacketStatus), sizeof(tPacketStatus));
+	}
+	else
+	{
+		switch(tCommand)
+		{
+		case PAPA_SCHLUMPF_USB_COMMAND_GetFirmwareVersion:
+			execute_command_get_firmware_version();
+			break;
+
+		case PAPA_SCHLUMPF_USB_COMMAND_ResetPCI:
+			execute_command_reset_pci((PAPA_SCHLUMPF_USB_COMMAND_RESET_PCI_T*)ptCommand);
+			break;
+
+		case PAPA_SCHLUMPF_USB_COMMAND_DMAIoRead:
+			execute_command_dma_io_read((PAPA_SCHLUMPF_USB_COMMAND_DMA_IO_READ_T*)ptCommand);
+			break;
+
+		case PAPA_SCHLUMPF_USB_COMMAND_DMAMemRead:
+			execute_command_dma_mem_read((PAPA_SCHLUMPF_USB_COMMAND_DMA_MEM_READ_T*)ptCommand);
+			break;
+
+		case PAPA_SCHLUMPF_USB_COMMAND_DMAMemReadArea:
+			execute_command_dma_mem_read_area((PAPA_SCHLUMPF_USB_COMMAND_DMA_MEM_READ_AREA_T*)ptCommand);
+			break;
+
+		case PAPA_SCHLUMPF_USB_COMMAND_DMACfg0Read:
+			execute_command_dma_cfg0_read((PAPA_SCHLUMPF_USB_COMMAND_DMA_CFG0_READ_T*)ptCommand);
+			break;
+
+		case PAPA_SCHLUMPF_USB_COMMAND_DMACfg1Read:
+			execute_command_dma_cfg1_read((PAPA_SCHLUMPF_USB_COMMAND_DMA_CFG1_READ_T*)ptCommand);
+			break;
+
+		case PAPA_SCHLUMPF_USB_COMMAND_DMAIoWrite:
+			execute_command_dma_io_write((PAPA_SCHLUMPF_USB_COMMAND_DMA_IO_WRITE_T*)ptCommand);
+			break;
+
+		case PAPA_SCHLUMPF_USB_COMMAND_DMAMemWrite:
+			execute_command_dma_mem_write((PAPA_SCHLUMPF_USB_COMMAND_DMA_MEM_WRITE_T*)ptCommand);
+			break;
+
+		case PAPA_SCHLUMPF_USB_COMMAND_DMAMemWriteArea:
+			execute_command_dma_mem_write_area((PAPA_SCHLUMPF_USB_COMMAND_DMA_MEM_WRITE_AREA_T*)ptCommand);
+			break;
+
+		case PAPA_SCHLUMPF_USB_COMMAND_DMACfg0Write:
+			execute_command_dma_cfg0_write((PAPA_SCHLUMPF_USB_COMMAND_DMA_CFG0_WRITE_T*)ptCommand);
+			break;
+
+		case PAPA_SCHLUMPF_USB_COMMAND_DMACfg1Write:
+			execute_command_dma_cfg1_write((PAPA_SCHLUMPF_USB_COMMAND_DMA_CFG1_WRITE_T*)ptCommand);
+			break;
+
+		case PAPA_SCHLUMPF_USB_COMMAND_SetPCIReset:
+			execute_command_set_pci_reset((PAPA_SCHLUMPF_USB_COMMAND_SET_PCI_RESET_T*)ptCommand);
+			break;
+
+		case PAPA_SCHLUMPF_USB_COMMAND_SetupNetx:
+			execute_command_setup_netx();
+			break;
+
+		case PAPA_SCHLUMPF_USB_COMMAND_Batch:
+			execute_command_batch((PAPA_SCHLUMPF_USB_COMMAND_BATCH_T*)ptCommand);
+			break;
+
+		case PAPA_SCHLUMPF_USB_COMMAND_DmaListUpload:
+			execute_command_dmalist_upload((PAPA_SCHLUMPF_USB_COMMAND_DMALIST_UPLOAD_T*)ptCommand);
+			break;
+
+		case PAPA_SCHLUMPF_USB_COMMAND_DmaListRun:
+			execute_command_dmalist_run((PAPA_SCHLUMPF_USB_COMMAND_DMALIST_RUN_T*)ptCommand);
+			break;
+
+		case PAPA_SCHLUMPF_USB_COMMAND_DMAMemModify:
+			execute_command_dma_mem_modify((PAPA_SCHLUMPF_USB_COMMAND_DMA_MODIFY_T*)ptCommand);
+			break;
+
+		case PAPA_SCHLUMPF_USB_COMMAND_DMAIoModify:
+			execute_command_dma_io_modify((PAPA_SCHLUMPF_USB_COMMAND_DMA_MODIFY_T*)ptCommand);
+			break;
+
+		case PAPA_SCHLUMPF_USB_COMMAND_PollMem:
+			execute_command_poll_mem((PAPA_SCHLUMPF_USB_COMMAND_POLL_MEM_T*)ptCommand);
+			break;
+
+		case PAPA_SCHLUMPF_USB_COMMAND_MemChecksum:
+			execute_command_mem_checksum((PAPA_SCHLUMPF_USB_COMMAND_MEM_CHECKSUM_T*)ptCommand);
+			break;
+
+		case PAPA_SCHLUMPF_USB_COMMAND_MemFill:
+			execute_command_mem_fill((PAPA_SCHLUMPF_USB_COMMAND_MEM_FILL_T*)ptCommand);
+			break;
+
+		case PAPA_SCHLUMPF_USB_COMMAND_MemCopy:
+			execute_command_mem_copy((PAPA_SCHLUMPF_USB_COMMAND_MEM_COPY_T*)ptCommand);
+			break;
+
+		case PAPA_SCHLUMPF_USB_COMMAND_MemReadScatter:
+			execute_command_mem_read_scatter((PAPA_SCHLUMPF_USB_COMMAND_SCATTER_T*)ptCommand);
+			break;
+
+		case PAPA_SCHLUMPF_USB_COMMAND_MemWriteScatter:
+			execute_command_mem_write_scatter((PAPA_SCHLUMPF_USB_COMMAND_SCATTER_T*)ptCommand);
+			break;
+
+		case PAPA_SCHLUMPF_USB_COMMAND_DMACfg0ReadArea:
+		case PAPA_SCHLUMPF_USB_COMMAND_DMACfg1ReadArea:
+			execute_command_dma_cfg_read_area((PAPA_SCHLUMPF_USB_COMMAND_DMA_CFG_READ_AREA_T*)ptCommand);
+			break;
+
+		case PAPA_SCHLUMPF_USB_COMMAND_EnumerateBus:
+			execute_command_enumerate_bus((PAPA_SCHLUMPF_USB_COMMAND_ENUMERATE_BUS_T*)ptCommand);
+			break;
+
+		case PAPA_SCHLUMPF_USB_COMMAND_MemReadStream:
+			execute_command_mem_read_stream((PAPA_SCHLUMPF_USB_COMMAND_MEM_READ_STREAM_T*)ptCommand);
+			break;
+
+		case PAPA_SCHLUMPF_USB_COMMAND_MemReadStreamAbort:
+			execute_command_mem_read_stream_abort();
 			break;
 		}
 	}
@@ -15,4 +15,7 @@
 
 void execute_command(PAPA_SCHLUMPF_USB_COMMAND_T *ptCommand);
 
+/* Do the next step of a running stream. Returns 0 if no stream is running. */
+int execute_command_continue(void);
+
 #endif /* NETX_SRC_COMMAND_EXECUTION_H_ */
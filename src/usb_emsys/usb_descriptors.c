@@ -21,6 +21,7 @@
 
 #include <stddef.h>
 
+#include "header.h"
 #include "usb_io.h"
 #include "usb_globals.h"
 #include "usb_descriptors.h"
@@ -120,8 +121,10 @@ static const unsigned char aucProduct_eng[] =
 };
 
 
-/* stringDescriptor for the Serial Number */
-static const unsigned char aucSerialNumber_eng[] =
+/* stringDescriptor for the Serial Number
+ * The default is replaced with the serial number from the header in usb_descriptors_init.
+ */
+static unsigned char aucSerialNumber_eng[] =
 {
 	0x22,
 	0x03,
@@ -138,38 +141,38 @@ static const unsigned char * const apucEngStrings[] =
 	aucSerialNumber_eng
 };
 
-#if 0
-static void to_unicode_simple(const unsigned char *pucAsciiString, unsigned char *pucUnicodeBuffer, size_t sizUnicodeBuffer)
+static void to_unicode_simple(const char *pcAsciiString, unsigned char *pucUnicodeBuffer, size_t sizUnicodeBuffer)
 {
-	const unsigned char *pucSrcCnt;
+	const char *pcSrcCnt;
 	unsigned char *pucDstCnt;
 	unsigned char *pucDstEnd;
+	char cChar;
 
 
-	pucSrcCnt = pucAsciiString;
+	pcSrcCnt = pcAsciiString;
 	/* Get the string start in the buffer. */
 	pucDstCnt = pucUnicodeBuffer;
 	pucDstEnd = pucUnicodeBuffer + sizUnicodeBuffer;
 	do
 	{
-		*(pucDstCnt++) = *(pucSrcCnt++);
+		/* Replace non-printable characters. An erased flash has 0x00 or 0xff here. */
+		cChar = *(pcSrcCnt++);
+		if( cChar<0x20 || cChar>0x7e )
+		{
+			cChar = '0';
+		}
+		*(pucDstCnt++) = (unsigned char)cChar;
 		*(pucDstCnt++) = '\0';
 	} while( pucDstCnt<pucDstEnd );
 }
-#endif
+
 
 void usb_descriptors_init(void)
 {
-/*
-	aucProduct_eng[0] = sizeof(aucProduct_eng);
-	aucProduct_eng[1] = 3;
-	to_unicode_simple(g_t_options.t_usb_settings.uCfg.auc+20+8, aucProduct_eng+2, 32);
-
-
-	aucSerialNumber_eng[0] = sizeof(aucSerialNumber_eng);
-	aucSerialNumber_eng[1] = 3;
-	to_unicode_simple(g_t_options.t_usb_settings.uCfg.auc+38+8, aucSerialNumber_eng+2, 32);
-*/
+	/* Report the serial number of the board. This allows the host to
+	 * select one board if several are connected.
+	 */
+	to_unicode_simple(tVersionHeader.acSerialNumber, aucSerialNumber_eng+2, sizeof(aucSerialNumber_eng)-2);
 }
 
 
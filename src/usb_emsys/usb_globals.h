@@ -38,7 +38,7 @@
 
 // buffer size for endpoints
 #define Usb_Ep0_BufferSize      0x0040
-#define Usb_Ep1_BufferSize      0x0f00
+#define Usb_Ep1_BufferSize      PAPA_SCHLUMPF_USB_IN_FIFO_SIZE
 #define Usb_Ep2_BufferSize      0x0080
 
 // endpoint buffers
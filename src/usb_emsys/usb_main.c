@@ -205,6 +205,9 @@ void usb_pingpong(void)
 			}
 		}
 	}
+
+	/* A running stream continues between the USB events. */
+	execute_command_continue();
 }
 
 